@@ -142,7 +142,7 @@ s.psr 40000000
  * to RAM. In my apps, I have to beam the fault dump over Iridium SBD
  * from a remotely-deployed instrument!
  *
- * For examples, see swoTest.c, consoleTest.c, others in src/test/c
+ * For examples, see swoTest.c, rttTest.c, others in src/test/c
  * 
  * We draw HEAVILY on Chap 12 of Yiu's 3rd ed of Cortex M3/M4
  * Definitive Guide, which should be considered a MUST-READ ;)
@@ -177,10 +177,39 @@ static char* dumpBuffer = NULL;
 static faultHandlingDumpProcessor dumpProcessor = NULL;
 static uint32_t startText, endText, mspTop, pspTop;
 static faultHandlingPostFaultAction postFaultAction = POSTHANDLER_LOOP;
+static faultHandlingHistory* history = NULL;
+static const faultHandlingEscalation* escalationPolicy = NULL;
+static int escalationLevels = 0;
+static jmp_buf* recoveryPoint = NULL;
+static uint32_t* stackBottoms[FAULT_HANDLING_STACKS];
+static uint32_t* stackTops[FAULT_HANDLING_STACKS];
+static uint32_t* stackFloors[FAULT_HANDLING_STACKS];	// above any guard
+static int stackGuards[FAULT_HANDLING_STACKS];			// MPU region, or -1
+static int stackCount = 0;
+static faultHandlingSharedLog* sharedLog = NULL;
+static uint32_t sharedCore = 0;
+static void (*sharedNotify)(void) = NULL;
+static volatile int probeActive = 0, probeFaulted = 0;
+static const faultHandlingRegion* regions = NULL;
+static int regionCount = 0;
+static uint32_t* profileBuffer = NULL;
+static uint32_t profileSamples = 0;
+static volatile uint32_t profileCount = 0, profileCycles = 0;
 
 static void faultDumpPrepare(void);
 static void formatRegValue( faultHandlingRegIndex index, uint32_t value );
+static void formatRegLabel( faultHandlingRegIndex index, const char* label );
 static void formatCallStackPair( int index, uint32_t addr, uint32_t val );
+static void formatTraceEvent( int index, uint32_t id, uint32_t arg );
+static void captureWindow( int index, uint32_t base, int words,
+						   int device );
+static uint32_t parseRegValue( faultHandlingRegIndex index );
+static int recover( uint32_t* stack, uint32_t excRet, uint32_t cfsr );
+static void skipInstruction( uint32_t* stack );
+static int searchCallStack( uint32_t* stack, uint32_t excRet,
+							uint32_t* addrs, uint32_t* vals,
+							int max, int maxWords );
+static int stackOverflowed( uint32_t sp, uint32_t cfsr, uint32_t mmfar );
 
 /*
   Our formatted 'fault dump table' of the N registers we are dumping
@@ -219,6 +248,366 @@ void faultHandlingSetPostFaultAction( faultHandlingPostFaultAction pfa ) {
   postFaultAction = pfa;
 }
 
+void faultHandlingSetHistory( faultHandlingHistory* h ) {
+  faultHandlingHistoryBoot( h );
+  history = h;
+}
+
+void faultHandlingSetEscalationPolicy( const faultHandlingEscalation* policy,
+									   int levels,
+									   void (*safeModeEntry)(void) ) {
+  escalationPolicy = policy;
+  escalationLevels = levels;
+  if( history && faultHandlingHistorySafeMode( history ) && safeModeEntry )
+	safeModeEntry();
+}
+
+uint32_t faultHandlingEscalationLevel(void) {
+  return history ? history->level : 0;
+}
+
+#ifdef FAULT_HANDLING_BUILD_ID
+/*
+  Stamped after linking, see faultHandling.h.  volatile, else the
+  compiler would fold our reads of it to the 0 it sees here.
+*/
+const volatile faultHandlingBuildIdentity faultHandlingBuildIdentityRecord
+__attribute__((used)) = { FAULT_HANDLING_BUILD_ID_MAGIC, { 0, 0 } };
+#endif
+
+uint32_t faultHandlingBuildId(void) {
+#ifdef FAULT_HANDLING_BUILD_ID
+  return faultHandlingBuildIdentityRecord.id[0];
+#else
+  return 0;
+#endif
+}
+
+void faultHandlingSetRecoveryPoint( jmp_buf* env ) {
+  recoveryPoint = env;
+}
+
+int faultHandlingSetSharedLog( faultHandlingSharedLog* log, uint32_t core,
+							   void (*notify)(void) ) {
+  sharedLog = NULL;
+  sharedCore = core;
+  sharedNotify = notify;
+
+  // This core's dump must fit a slot, else none would ever be published
+  if( log && FAULT_HANDLING_DUMP_SIZE > FAULT_HANDLING_SHARED_DUMP_SIZE )
+	return -1;
+  sharedLog = log;
+  return 0;
+}
+
+#if (__CORTEX_M > 0)
+
+/*
+  BFSR bits of CFSR: IBUSERR, PRECISERR, IMPRECISERR, UNSTKERR,
+  STKERR, LSPERR, BFARVALID, all write-1-to-clear.
+*/
+#define CFSR_BFSR_Msk         (0x0000FF00)
+#define CFSR_BUS_ERRORS_Msk   ((1 << 9) | (1 << 10))
+
+// MMFSR bits of CFSR, for stack guard hits
+#define CFSR_MSTKERR_Msk      (1 << 4)
+#define CFSR_MMARVALID_Msk    (1 << 7)
+
+// For memory windows
+#define CFSR_BFARVALID_Msk    (1 << 15)
+
+/*
+  Bus errors are ignored (BFHFNMIGN) only at priority -1 or above,
+  hence FAULTMASK.  Setting FAULTMASK inside HardFault is a no-op,
+  which is fine, we are at -1 already.  At -1, any OTHER fault is a
+  lockup, so HFNMIENA is cleared too: an MPU active at -1 would turn
+  a probe of a protected address into an inescapable MemManage.
+*/
+static uint32_t probeBegin( uint32_t* mpuCtrl ) {
+  uint32_t faultmask = __get_FAULTMASK();
+  __set_FAULTMASK( 1 );
+#if defined(__MPU_PRESENT) && (__MPU_PRESENT == 1)
+  *mpuCtrl = MPU->CTRL;
+  MPU->CTRL = *mpuCtrl & ~MPU_CTRL_HFNMIENA_Msk;
+#else
+  *mpuCtrl = 0;
+#endif
+  SCB->CFSR = CFSR_BFSR_Msk;
+  SCB->CCR |= SCB_CCR_BFHFNMIGN_Msk;
+  __DSB();
+  __ISB();
+  return faultmask;
+}
+
+static int probeEnd( uint32_t ccr, uint32_t faultmask, uint32_t mpuCtrl ) {
+  __DSB();
+  uint32_t bfsr = SCB->CFSR & CFSR_BFSR_Msk;
+  SCB->CFSR = bfsr;
+  SCB->CCR = ccr;
+#if defined(__MPU_PRESENT) && (__MPU_PRESENT == 1)
+  MPU->CTRL = mpuCtrl;
+#else
+  (void)mpuCtrl;
+#endif
+  __DSB();
+  __ISB();
+  __set_FAULTMASK( faultmask );
+  return (bfsr & CFSR_BUS_ERRORS_Msk) ?
+	FAULT_HANDLING_PROBE_FAULT : FAULT_HANDLING_PROBE_OK;
+}
+
+/*
+  An unaligned word access is a UsageFault (always, to Device
+  memory), which BFHFNMIGN does not cover: at -1, a lockup.
+*/
+int faultHandlingProbeRead32( uint32_t addr, uint32_t* out ) {
+  if( addr & 3 )
+	return FAULT_HANDLING_PROBE_FAULT;
+  uint32_t ccr = SCB->CCR;
+  uint32_t mpuCtrl;
+  uint32_t faultmask = probeBegin( &mpuCtrl );
+  uint32_t value = *(volatile uint32_t*)addr;
+  int result = probeEnd( ccr, faultmask, mpuCtrl );
+  if( result == FAULT_HANDLING_PROBE_OK )
+	*out = value;
+  return result;
+}
+
+int faultHandlingProbeWrite32( uint32_t addr, uint32_t value ) {
+  if( addr & 3 )
+	return FAULT_HANDLING_PROBE_FAULT;
+  uint32_t ccr = SCB->CCR;
+  uint32_t mpuCtrl;
+  uint32_t faultmask = probeBegin( &mpuCtrl );
+
+  /*
+	A buffered store's bus error is imprecise, and arrives whenever.
+	Disabling the write buffer makes it precise, so ignorable.
+  */
+  uint32_t actlr = SCnSCB->ACTLR;
+  SCnSCB->ACTLR = actlr | SCnSCB_ACTLR_DISDEFWBUF_Msk;
+  __DSB();
+  *(volatile uint32_t*)addr = value;
+  __DSB();
+  SCnSCB->ACTLR = actlr;
+  return probeEnd( ccr, faultmask, mpuCtrl );
+}
+
+#else
+
+/*
+  No BFHFNMIGN on CM0/0+, so the probe really faults, and
+  FaultHandler_C does the skipping. The access itself must be one
+  instruction, hence the volatile.  Interrupts are off meanwhile, so
+  that an ISR's genuine fault is not mistaken for, and skipped as,
+  the probe's.  HardFault is not masked by PRIMASK.  An unaligned
+  access always faults, so is refused up front.
+*/
+int faultHandlingProbeRead32( uint32_t addr, uint32_t* out ) {
+  if( addr & 3 )
+	return FAULT_HANDLING_PROBE_FAULT;
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  probeFaulted = 0;
+  probeActive = 1;
+  uint32_t value = *(volatile uint32_t*)addr;
+  probeActive = 0;
+  int faulted = probeFaulted;
+  __set_PRIMASK( primask );
+  if( faulted )
+	return FAULT_HANDLING_PROBE_FAULT;
+  *out = value;
+  return FAULT_HANDLING_PROBE_OK;
+}
+
+int faultHandlingProbeWrite32( uint32_t addr, uint32_t value ) {
+  if( addr & 3 )
+	return FAULT_HANDLING_PROBE_FAULT;
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  probeFaulted = 0;
+  probeActive = 1;
+  *(volatile uint32_t*)addr = value;
+  probeActive = 0;
+  int faulted = probeFaulted;
+  __set_PRIMASK( primask );
+  return faulted ?
+	FAULT_HANDLING_PROBE_FAULT : FAULT_HANDLING_PROBE_OK;
+}
+
+#endif
+
+int faultHandlingSetRegions( const faultHandlingRegion* table, int count ) {
+  regions = NULL;
+  regionCount = 0;
+
+  uint32_t rows = 0;
+  for( int r = 0; r < count; r++ ) {
+	rows += (table[r].words + FAULT_HANDLING_WINDOW_WORDS - 1) /
+	  FAULT_HANDLING_WINDOW_WORDS;
+	for( uint32_t i = 0; i < table[r].words; i++ ) {
+	  uint32_t value;
+	  if( faultHandlingProbeRead32( table[r].addr + 4*i, &value ) !=
+		  FAULT_HANDLING_PROBE_OK )
+		return -1;
+	}
+  }
+  if( rows > FAULT_HANDLING_REGION_ROWS )
+	return -1;
+
+  regions = table;
+  regionCount = count;
+  return 0;
+}
+
+int faultHandlingStackRegister( uint32_t* bottom, uint32_t* top ) {
+  if( stackCount == FAULT_HANDLING_STACKS )
+	return -1;
+  if( !top )
+	top = (uint32_t*)mspTop;
+
+  /*
+	Never paint the live part of a stack, i.e. this one, if we are
+	running on it. Interrupts off, else an interrupt's stacked
+	frame, below our sp, would be painted over.
+  */
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint32_t* sp = (uint32_t*)(__get_CONTROL() & 2 ? __get_PSP() : __get_MSP());
+  uint32_t* limit = (sp > bottom && sp < top) ? sp : top;
+  for( uint32_t* wp = bottom; wp < limit; wp++ )
+	*wp = FAULT_HANDLING_STACK_PAINT;
+  __set_PRIMASK( primask );
+
+  stackBottoms[stackCount] = bottom;
+  stackTops[stackCount] = top;
+  stackFloors[stackCount] = bottom;
+  stackGuards[stackCount] = -1;
+  return stackCount++;
+}
+
+/*
+  Painted words are at the bottom, in use ones above, so binary
+  search for the lowest unpainted word.
+*/
+uint32_t faultHandlingStackFree( int id ) {
+  if( id < 0 || id >= stackCount )
+	return 0;
+  // Never search a guard region, that's a MemManage fault
+  uint32_t* lo = stackFloors[id];
+  uint32_t* hi = stackTops[id];
+  while( lo < hi ) {
+	uint32_t* mid = lo + (hi - lo) / 2;
+	if( *mid == FAULT_HANDLING_STACK_PAINT )
+	  lo = mid + 1;
+	else
+	  hi = mid;
+  }
+  return (uint32_t)((lo - stackFloors[id]) * sizeof(uint32_t));
+}
+
+#if (__CORTEX_M > 0) && defined(__MPU_PRESENT) && (__MPU_PRESENT == 1)
+
+/*
+  Smallest ARMv7-M MPU region: 32 bytes, RASR.SIZE = log2(32)-1.
+*/
+#define GUARD_SIZE       (32)
+#define GUARD_RASR_SIZE  (4)
+
+int faultHandlingStackGuard( int id, uint32_t region ) {
+  uint32_t regions = (MPU->TYPE >> 8) & 0xFF;
+  if( id < 0 || id >= stackCount || region >= regions )
+	return -1;
+
+  // Whichever stack had this region before now has no guard
+  for( int i = 0; i < stackCount; i++ ) {
+	if( stackGuards[i] == (int)region ) {
+	  stackGuards[i] = -1;
+	  stackFloors[i] = stackBottoms[i];
+	}
+  }
+
+  // A region is aligned to its size, so the guard is the lowest
+  // aligned 32 bytes of the stack
+  uint32_t base = ((uint32_t)stackBottoms[id] + GUARD_SIZE-1) &
+	~(GUARD_SIZE-1);
+  if( base + GUARD_SIZE >= (uint32_t)stackTops[id] )
+	return -1;
+
+  // AP = 0: no access, privileged or not.  XN: nor execute.
+  MPU->RNR = region;
+  MPU->RBAR = base;
+  MPU->RASR = MPU_RASR_XN_Msk | (GUARD_RASR_SIZE << MPU_RASR_SIZE_Pos) |
+	MPU_RASR_ENABLE_Msk;
+
+  /*
+	PRIVDEFENA: everything outside of our regions is as normal.  NOT
+	HFNMIENA, so the MPU is off in HardFault, and the fault handler
+	can run even on an overflowed main stack.
+  */
+  if( !(MPU->CTRL & MPU_CTRL_ENABLE_Msk) )
+	MPU->CTRL = MPU_CTRL_PRIVDEFENA_Msk | MPU_CTRL_ENABLE_Msk;
+  __DSB();
+  __ISB();
+
+  stackGuards[id] = (int)region;
+  stackFloors[id] = (uint32_t*)(base + GUARD_SIZE);
+  return 0;
+}
+
+#else
+
+int faultHandlingStackGuard( int id, uint32_t region ) {
+  (void)id;
+  (void)region;
+  return -1;
+}
+
+#endif
+
+uint32_t faultHandlingStackMinFree(void) {
+  uint32_t result = 0xFFFFFFFF;
+  for( int i = 0; i < stackCount; i++ ) {
+	uint32_t free = faultHandlingStackFree( i );
+	if( free < result )
+	  result = free;
+  }
+  return result;
+}
+
+int faultHandlingCompressDump( uint8_t* buf, int len ) {
+  faultHandlingCompressBases bases;
+  bases.textStart = startText;
+  bases.stackTop = mspTop;
+  bases.sp = parseRegValue( SP );
+  return faultHandlingCompress( dumpBuffer, &bases, buf, len );
+}
+
+void faultHandlingSetProfileBuffer( uint32_t* buf, int samples ) {
+  profileBuffer = NULL;
+  profileSamples = samples > 0 ? (uint32_t)samples : 0;
+  if( !buf || !profileSamples )
+	return;
+
+  // Counters survive a stop, for reading after, a new buffer resets them
+  profileCount = 0;
+  profileCycles = 0;
+#if (__CORTEX_M > 0)
+  // Overhead is measured via the cycle counter, enable it
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+  profileBuffer = buf;
+}
+
+uint32_t faultHandlingProfileCount(void) {
+  return profileCount;
+}
+
+uint32_t faultHandlingProfileCycles(void) {
+  return profileCycles;
+}
+
 /**
  * As per Yiu 3rd Ed, p 401. Other page numbers below refer to same text.
  *
@@ -229,12 +618,25 @@ void faultHandlingSetPostFaultAction( faultHandlingPostFaultAction pfa ) {
  *
  * @param excrt - exception return value in LR at time of fault.
  *
+ * @param psrLabel - dump label for the current psr row: 'psr  ' for
+ * a fault, 'hang ' for a hang, see HangHandler_C.
+ *
+ * @param notify - tell other cores, see faultHandlingSetSharedLog.
+ * Not for hangs, a notified core may well capture itself via
+ * HangHandler, and must not notify back.
+ *
+ * @param regs - r4..r11, as pushed by the asm FaultHandler/HangHandler
+ * in FAULT_HANDLING_FULL_REGS builds.  Junk otherwise, and unused.
+ *
  * We've chosen to order the parameters passed by increasing reg
  * number: r7, r13 (sp), r14 (lr, which is excRet upon fault). This
  * ordering is arbitrary, but accommodates should we ever want to add
  * more regs.
  */
-void FaultHandler_C( uint32_t r7, uint32_t* stack, uint32_t excRet ) {
+static void handleFault( uint32_t r7, uint32_t* stack, uint32_t excRet,
+						 const char* psrLabel, int notify,
+						 const uint32_t* regs ) {
+
 
   // NOT set up correctly if we have no processor!
   if( !dumpProcessor )
@@ -250,8 +652,28 @@ void FaultHandler_C( uint32_t r7, uint32_t* stack, uint32_t excRet ) {
   uint32_t cfsr  = SCB->CFSR;
   uint32_t bfar  = SCB->BFAR;
   uint32_t mmfar = SCB->MMFAR;
+#else
+  // No CFSR on CM0/0+, for the benefit of recover
+  uint32_t cfsr = 0;
 #endif
   
+  /*
+	A stack overflow, caught by a guard region, is labelled as such in
+	the dump, the sp row becoming 'ovf.N' for stack id N. The guard is
+	dropped, since the stacked regs we are about to read may be IN it.
+  */
+#if (__CORTEX_M > 0)
+  int overflowed = stackOverflowed( (uint32_t)stack, cfsr, mmfar );
+#else
+  int overflowed = -1;
+#endif
+  char spLabel[] = "sp   ";
+  if( overflowed >= 0 ) {
+	memcpy( spLabel, "ovf.", 4 );
+	spLabel[4] = "0123456789ABCDEF"[overflowed & 0xf];
+  }
+  formatRegLabel( SP, spLabel );
+
   // see p 264, indicates enabled handlers at time of fault
   uint32_t shcsr = SCB->SHCSR;
 
@@ -279,6 +701,7 @@ void FaultHandler_C( uint32_t r7, uint32_t* stack, uint32_t excRet ) {
   formatRegValue( R7, r7 );
   formatRegValue( SP, sp );
   formatRegValue( EXCRT, excRet );
+  formatRegLabel( PSR, psrLabel );
   formatRegValue( PSR, psrNow );
 
 #if (__CORTEX_M > 0)
@@ -304,63 +727,165 @@ void FaultHandler_C( uint32_t r7, uint32_t* stack, uint32_t excRet ) {
   formatRegValue( STKPC, pc );
   formatRegValue( STKPSR, psr );
 
+#ifdef FAULT_HANDLING_STACK_WATERMARK
+  // A near-zero here suggests the fault is a stack overflow
+  formatRegValue( SFREE, faultHandlingStackMinFree() );
+#endif
 
+#ifdef FAULT_HANDLING_FULL_REGS
+  // regs[3] is r7, already have that
+  formatRegValue( R4, regs[0] );
+  formatRegValue( R5, regs[1] );
+  formatRegValue( R6, regs[2] );
+  formatRegValue( R8, regs[4] );
+  formatRegValue( R9, regs[5] );
+  formatRegValue( R10, regs[6] );
+  formatRegValue( R11, regs[7] );
 
   /*
-	Heuristics to locate the function call stack leading up to the
-	fault.  We basically search the stack (starting at the addr above
-	the stacked regs) until we've found N values that may be pushed LR
-	regs, or until we reach some TopOfStack limit.
-
-	In an application w RTOS, we'd likely have threads that use their
-	own Process stack.  In that case, would be better to terminate the
-	search when see an LR = osThreadExit, rather than when hitting
-	__StackTop (which would likely be a LONG way from a Process
-	Stack). IDEA: can test LR to see if Process Stack is the one we are
-	searching, same way that asm code did to LOCATE that stack.
+	The sp in use at the fault lies just above the exception frame: 8
+	words, 26 if an FP context was stacked (EXC_RETURN bit 4 clear),
+	plus a pad word if stacked psr bit 9 says so, see p 278.  The
+	other sp is untouched by the exception, bar our own asm pushes
+	onto MSP, which regs marks the top of.
   */
-  if( endText > 0 ) {
-	int found = 0;
-	
-	/*
-	  8 regs are stacked prior to fault handler entry, so start 
-	  the 'pushed LR's search above those.
+  uint32_t faultSp = sp + ((excRet & 0x10) ? 32 : 104) +
+	((psr & (1 << 9)) ? 4 : 0);
+  if( excRet & 4 ) {
+	formatRegValue( MSP, (uint32_t)(regs + 8) );
+	formatRegValue( PSP, faultSp );
+  } else {
+	formatRegValue( MSP, faultSp );
+	formatRegValue( PSP, __get_PSP() );
+  }
 
-	  Depending on the stack in use at time of fault, we use
-	  the mspTop or pspTop sentinel to bound the stack search.
-	*/
-	uint32_t TOS = excRet & 4 ? pspTop : mspTop;
-	
-	for( uint32_t* fp = stack + 8; fp < (uint32_t*)TOS; fp++ ) {
-	  
-	  uint32_t val = *fp;
-	
-	  /*
-		Code section is bounded by these two addresses. Any LR would
-		be within that range.
-	  */
-	  if( val < (uint32_t)startText || val > (uint32_t)endText )
-		continue;
-	
-	  // On M3, pc[0] == 1, so any LR must have this property too.
-	  if( (val & 1) == 0 )
-		continue;
+  /*
+	In handler mode, CONTROL.SPSEL (and FPCA) read as cleared, so put
+	back their thread values, as given by EXC_RETURN. PRIMASK and
+	BASEPRI are as they were, a fault does not change them.
+  */
+  uint32_t control = __get_CONTROL();
+  if( excRet & 4 )
+	control |= 2;
+  if( !(excRet & 0x10) )
+	control |= 4;
+  formatRegValue( CTRL, control );
+  formatRegValue( PMASK, __get_PRIMASK() );
+#if (__CORTEX_M > 0)
+  formatRegValue( BPRI, __get_BASEPRI() );
+#endif
+#else
+  (void)regs;
+#endif
 
-	  // Deem that this word is indeed a 'pushed LR'.
-	  formatCallStackPair( found, (uint32_t)fp, val );
+#ifdef FAULT_HANDLING_BUILD_ID
+  formatRegValue( BUILDID, faultHandlingBuildId() );
+#endif
 
-	  // Found as many as we want, or have ROOM for in the dump table ?
-	  found++;
-	  if( found == FAULT_HANDLING_CALLSTACK_ENTRIES )
-		break;
+
+
+  /*
+	The function call stack leading up to the fault, see
+	searchCallStack.  Rows not found are zeroed, they may hold a
+	previous (recovered from) fault's values.
+  */
+  uint32_t addrs[FAULT_HANDLING_CALLSTACK_ENTRIES] = { 0 };
+  uint32_t vals[FAULT_HANDLING_CALLSTACK_ENTRIES] = { 0 };
+  searchCallStack( stack, excRet, addrs, vals,
+				   FAULT_HANDLING_CALLSTACK_ENTRIES, 0 );
+  for( int i = 0; i < FAULT_HANDLING_CALLSTACK_ENTRIES; i++ )
+	formatCallStackPair( i, addrs[i], vals[i] );
+
+  /*
+	The flight recorder: how we got here. Any ring slots never
+	written (too few events since trace init) show as zeros.
+  */
+#if (FAULT_HANDLING_TRACE_DUMP_ENTRIES > 0)
+  faultHandlingTraceEvent events[FAULT_HANDLING_TRACE_DUMP_ENTRIES];
+  int traced = faultHandlingTraceLatest( events,
+										 FAULT_HANDLING_TRACE_DUMP_ENTRIES );
+  for( int i = 0; i < FAULT_HANDLING_TRACE_DUMP_ENTRIES; i++ ) {
+	int e = i - (FAULT_HANDLING_TRACE_DUMP_ENTRIES - traced);
+	if( e < 0 )
+	  formatTraceEvent( i, 0, 0 );
+	else
+	  formatTraceEvent( i, events[e].id, events[e].arg );
+  }
+#endif
+
+  /*
+	Memory windows, see faultHandling.h. Last, since on CM3/4 the
+	guarded reads clear BFSR, we have our copy of CFSR already.
+  */
+#if (FAULT_HANDLING_WINDOWS > 0)
+  int words = FAULT_HANDLING_WINDOW_WORDS;
+  captureWindow( 0, (pc & ~3u) - 8, words, 0 );
+#if (__CORTEX_M > 0)
+  captureWindow( 1, (mmfar & ~3u) - 4,
+				 (cfsr & CFSR_MMARVALID_Msk) ? words : 0, 0 );
+  captureWindow( 2, (bfar & ~3u) - 4,
+				 (cfsr & CFSR_BFARVALID_Msk) ? words : 0, 0 );
+#endif
+#endif
+
+  /*
+	Registered regions, 4 words a row, any rows spare are zeroed, a
+	previous (recovered from) fault may have used them.
+  */
+#if (FAULT_HANDLING_REGION_ROWS > 0)
+  int row = FAULT_HANDLING_WINDOWS;
+  for( int r = 0; r < regionCount; r++ ) {
+	for( uint32_t i = 0; i < regions[r].words;
+		 i += FAULT_HANDLING_WINDOW_WORDS ) {
+	  uint32_t left = regions[r].words - i;
+	  captureWindow( row++, regions[r].addr + 4*i,
+					 left < FAULT_HANDLING_WINDOW_WORDS ?
+					 (int)left : FAULT_HANDLING_WINDOW_WORDS, 1 );
 	}
   }
-  
+  while( row < FAULT_HANDLING_WINDOWS + FAULT_HANDLING_REGION_ROWS )
+	captureWindow( row++, 0, 0, 0 );
+#endif
+
+  /*
+	A fault already in the history (same pc, lr, cause, callers) is
+	just counted. Its dump was shipped out when first seen, no need
+	to fill storage or the Iridium bill with copies.
+  */
+  int repeat = 0;
+  if( history ) {
+#if (__CORTEX_M > 0)
+	uint32_t key[] = { pc, lr, cfsr, vals[0], vals[1] };
+#else
+	uint32_t key[] = { pc, lr, vals[0], vals[1] };
+#endif
+	uint32_t signature =
+	  faultHandlingSignatureOf( key, sizeof(key)/sizeof(key[0]) );
+	repeat = faultHandlingHistoryRecord( history, signature ) > 1;
+  }
+
   // The fault table is now complete, ship it out the door!
-  dumpProcessor();
+  if( !repeat ) {
+	if( sharedLog )
+	  faultHandlingSharedPut( sharedLog, sharedCore, dumpBuffer );
+	dumpProcessor();
+  }
+
+  // Other cores may want to capture their own state, while they can
+  if( notify && sharedNotify )
+	sharedNotify();
+
+  /*
+	Under an escalation policy, the fault rate decides what happens
+	next, so that a fault storm cannot reboot us into a flat battery.
+  */
+  faultHandlingPostFaultAction action = postFaultAction;
+  if( history )
+	action = faultHandlingHistoryEscalate( history, escalationPolicy,
+										   escalationLevels, action );
 
   // Once the fault packaged up and offered to processor, what do we do next?
-  switch( postFaultAction ) {
+  switch( action ) {
 
   case POSTHANDLER_LOOP:
 	while(2)
@@ -378,13 +903,101 @@ void FaultHandler_C( uint32_t r7, uint32_t* stack, uint32_t excRet ) {
 
   case POSTHANDLER_RETURN:
 	break;
+
+  case POSTHANDLER_SAFEMODE:
+	if( history )
+	  history->safeMode = 1;
+	NVIC_SystemReset();
+	break;
+
+  case POSTHANDLER_RECOVER:
+	// If recoverable, our return IS the exception return, to the trampoline
+	if( recover( stack, excRet, cfsr ) )
+	  return;
+	while(4)
+	  ;
+	break;
+
+  case POSTHANDLER_SLEEP:
+	/*
+	  At HardFault (or configurable fault) priority, no interrupt can
+	  preempt us, so nothing should wake us.  NMI/debugger can.
+	*/
+	SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+	while(3)
+	  __WFI();
+	break;
 	
   default:
 	;
   }
 }
 
-						 
+void FaultHandler_C( uint32_t r7, uint32_t* stack, uint32_t excRet,
+					 uint32_t* regs ) {
+
+  /*
+	An expected fault, from a CM0/0+ memory probe: no dump, just skip
+	the faulting access and return to the probe, which checks the flag.
+  */
+  if( probeActive ) {
+	probeFaulted = 1;
+	skipInstruction( stack );
+	return;
+  }
+
+  handleFault( r7, stack, excRet, "psr  ", 1, regs );
+}
+
+/**
+ * A hang, not a fault: reached from any interrupt handler (watchdog
+ * early warning, a liveness check timer) via our asm HangHandler.
+ * The interrupted context is captured and processed exactly as for a
+ * fault, the dump's psr row is labelled 'hang ' instead of 'psr  ',
+ * its IPSR field naming the interrupt that caught the hang.
+ */
+void HangHandler_C( uint32_t r7, uint32_t* stack, uint32_t excRet,
+					uint32_t* regs ) {
+  handleFault( r7, stack, excRet, "hang ", 0, regs );
+}
+
+/**
+ * The sampling profiler, reached from e.g. SysTick_Handler via our
+ * asm ProfileHandler, with the same first three parameters as
+ * FaultHandler_C.
+ *
+ * Records the interrupted pc, lr and the first few 'pushed LRs' on
+ * the interrupted stack, as located by the fault handler's call stack
+ * search.  That search is bounded at FAULT_HANDLING_PROFILE_SCAN
+ * words, a sample costs at most that many loads.
+ */
+void ProfileHandler_C( uint32_t r7, uint32_t* stack, uint32_t excRet ) {
+
+  (void)r7;
+  
+  if( !profileBuffer )
+	return;
+
+#if (__CORTEX_M > 0)
+  uint32_t start = DWT->CYCCNT;
+#endif
+
+  uint32_t* sample = profileBuffer +
+	(profileCount % profileSamples) * FAULT_HANDLING_PROFILE_RECORD;
+
+  // Stacked lr, pc are at offsets 5, 6, see FaultHandler_C
+  sample[0] = stack[6];
+  sample[1] = stack[5];
+  for( int i = 0; i < FAULT_HANDLING_PROFILE_DEPTH; i++ )
+	sample[2+i] = 0;
+  searchCallStack( stack, excRet, NULL, sample + 2,
+				   FAULT_HANDLING_PROFILE_DEPTH, FAULT_HANDLING_PROFILE_SCAN );
+  profileCount++;
+
+#if (__CORTEX_M > 0)
+  profileCycles += DWT->CYCCNT - start;
+#endif
+}
 
 /************************ STATICS, PRIVATE IMPLEMENTATION *****************/
 
@@ -407,7 +1020,29 @@ static const char* const cpuRegLabels[] =
 	"s.r12",
 	"s.lr ",
 	"s.pc ",
-	"s.psr"
+	"s.psr",
+#ifdef FAULT_HANDLING_STACK_WATERMARK
+	"sfree",
+#endif
+#ifdef FAULT_HANDLING_FULL_REGS
+	"r4   ",
+	"r5   ",
+	"r6   ",
+	"r8   ",
+	"r9   ",
+	"r10  ",
+	"r11  ",
+	"msp  ",
+	"psp  ",
+	"ctrl ",
+	"pmask",
+#if (__CORTEX_M > 0)
+	"bpri ",
+#endif
+#endif
+#ifdef FAULT_HANDLING_BUILD_ID
+	"build",
+#endif
   };
 
 static void faultDumpPrepare(void) {
@@ -442,6 +1077,32 @@ static void faultDumpPrepare(void) {
 	formatCallStackPair( i, 0, 0 );
 	cursor += FAULT_HANDLING_CALLSTACK_ROWSIZE;
   }
+
+  /*
+	Latest trace events, if configured. Each line is '4-char-ID
+	8-char-ARG\n' = 14 chars.
+  */
+  for( int i = 0; i < FAULT_HANDLING_TRACE_DUMP_ENTRIES; i++ ) {
+	dumpBuffer[cursor+4] = ' ';
+	dumpBuffer[cursor+13] = '\n';
+	formatTraceEvent( i, 0, 0 );
+	cursor += FAULT_HANDLING_TRACE_ROWSIZE;
+  }
+
+  /*
+	Memory windows and region rows, if configured. Each line is
+	'8-char-BASE 1-char-MASK' then 4 '8-char-WORD's, space separated =
+	47 chars.
+  */
+  for( int i = 0; i < FAULT_HANDLING_WINDOWS+FAULT_HANDLING_REGION_ROWS;
+	   i++ ) {
+	dumpBuffer[cursor+8] = ' ';
+	for( int w = 0; w < FAULT_HANDLING_WINDOW_WORDS; w++ )
+	  dumpBuffer[cursor+10+9*w] = ' ';
+	dumpBuffer[cursor+FAULT_HANDLING_WINDOW_ROWSIZE-1] = '\n';
+	captureWindow( i, 0, 0, 0 );
+	cursor += FAULT_HANDLING_WINDOW_ROWSIZE;
+  }
   
   // Trailing NULL, final byte in the fault dump.
   dumpBuffer[cursor] = 0;
@@ -476,6 +1137,29 @@ static void formatRegValue( faultHandlingRegIndex index, uint32_t value ) {
   }
 }
 
+/**
+ * Relabel one register row, label is 5 chars.
+ */
+static void formatRegLabel( faultHandlingRegIndex index, const char* label ) {
+  int cursor = FAULT_HANDLING_CPUREG_ROWSIZE*index;
+  for( int i = 0; i < 5; i++ )
+	dumpBuffer[cursor+i] = label[i];
+}
+
+/**
+ * Read back one register value from the fault table string, the
+ * inverse of formatRegValue.
+ */
+static uint32_t parseRegValue( faultHandlingRegIndex index ) {
+  int cursor = FAULT_HANDLING_CPUREG_ROWSIZE*index + 6;
+  uint32_t value = 0;
+  for( int i = 0; i < 8; i++ ) {
+	char c = dumpBuffer[cursor+i];
+	value = (value << 4) | (c <= '9' ? c - '0' : c - 'A' + 10);
+  }
+  return value;
+}
+
 static void formatCallStackPair( int index, uint32_t addr, uint32_t val ) {
   
   /*
@@ -494,6 +1178,247 @@ static void formatCallStackPair( int index, uint32_t addr, uint32_t val ) {
   }
 }
 
+static void formatTraceEvent( int index, uint32_t id, uint32_t arg ) {
+  
+  // Trace rows follow the call stack rows
+  int cursor = FAULT_HANDLING_CPUREG_ROWSIZE*FAULT_HANDLING_CPUREG_COUNT +
+	FAULT_HANDLING_CALLSTACK_ROWSIZE*FAULT_HANDLING_CALLSTACK_ENTRIES +
+	FAULT_HANDLING_TRACE_ROWSIZE*index;
+
+  // 16-bit id, 4 hex chars
+  for( int i = 0; i < 4; i++ )
+	dumpBuffer[cursor+i] = hex[(id >> (12-4*i)) & 0xf];
+  for( int i = 0; i < 8; i++ )
+	dumpBuffer[cursor+5+i] = hex[(arg >> (28-4*i)) & 0xf];
+}
+
+/**
+ * Read and format window (or region) row @p index, of @p words words
+ * from @p base, 0 words for a row of zeros.  Each word is read only
+ * if that cannot fault, we are in the fault handler already:
+ *
+ * CM3/4: bus errors are caught as per faultHandlingProbeRead32, which
+ * clears BFSR.  Unless a @p device (registered region) row, only
+ * code, SRAM and external RAM are read, peripheral reads may have
+ * side effects (a FIFO popped, a status flag cleared).
+ *
+ * CM0/0+: any fault here is lockup, so memory windows are limited to
+ * the code range given to faultHandlingSetCallStackParameters, and
+ * registered regions rely on faultHandlingSetRegions' probe.
+ */
+static void captureWindow( int index, uint32_t base, int words,
+						   int device ) {
+
+  uint32_t mask = 0;
+  uint32_t values[FAULT_HANDLING_WINDOW_WORDS] = { 0 };
+  if( words == 0 )
+	base = 0;
+  for( int i = 0; i < words; i++ ) {
+	uint32_t addr = base + 4*i;
+#if (__CORTEX_M > 0)
+	if( !device && addr >= 0x40000000 &&
+		(addr < 0x60000000 || addr >= 0xA0000000) )
+	  continue;
+	if( faultHandlingProbeRead32( addr, values + i ) !=
+		FAULT_HANDLING_PROBE_OK )
+	  continue;
+#else
+	if( device )
+	  values[i] = *(volatile uint32_t*)addr;
+	else if( addr >= startText && addr < endText && endText - addr >= 4 )
+	  values[i] = *(uint32_t*)addr;
+	else
+	  continue;
+#endif
+	mask |= 1u << i;
+  }
+
+  // Windows, then region rows, follow the trace rows
+  int cursor = FAULT_HANDLING_CPUREG_ROWSIZE*FAULT_HANDLING_CPUREG_COUNT +
+	FAULT_HANDLING_CALLSTACK_ROWSIZE*FAULT_HANDLING_CALLSTACK_ENTRIES +
+	FAULT_HANDLING_TRACE_ROWSIZE*FAULT_HANDLING_TRACE_DUMP_ENTRIES +
+	FAULT_HANDLING_WINDOW_ROWSIZE*index;
+
+  for( int i = 0; i < 8; i++ )
+	dumpBuffer[cursor+i] = hex[(base >> (28-4*i)) & 0xf];
+  dumpBuffer[cursor+9] = hex[mask];
+  for( int w = 0; w < FAULT_HANDLING_WINDOW_WORDS; w++ )
+	for( int i = 0; i < 8; i++ )
+	  dumpBuffer[cursor+11+9*w+i] = hex[(values[w] >> (28-4*i)) & 0xf];
+}
+
+/**
+ * Heuristics to locate the function call stack leading up to the
+ * fault (or sample, see ProfileHandler_C).  We basically search the
+ * stack (starting at the addr above the stacked regs) until we've
+ * found N values that may be pushed LR regs, or until we reach some
+ * TopOfStack limit.
+ *
+ * In an application w RTOS, we'd likely have threads that use their
+ * own Process stack.  In that case, would be better to terminate the
+ * search when see an LR = osThreadExit, rather than when hitting
+ * __StackTop (which would likely be a LONG way from a Process
+ * Stack). IDEA: can test LR to see if Process Stack is the one we are
+ * searching, same way that asm code did to LOCATE that stack.
+ *
+ * @param addrs - where each pushed LR was found, may be NULL.
+ *
+ * @param vals - the pushed LRs.
+ *
+ * @param maxWords - limit on the stack words searched, 0 for none.
+ *
+ * @return count of pushed LRs found.
+ */
+static int searchCallStack( uint32_t* stack, uint32_t excRet,
+							uint32_t* addrs, uint32_t* vals,
+							int max, int maxWords ) {
+
+  if( endText == 0 )
+	return 0;
+
+  int found = 0;
+
+  /*
+	8 regs are stacked prior to fault handler entry, so start 
+	the 'pushed LR's search above those.
+
+	Depending on the stack in use at time of fault, we use
+	the mspTop or pspTop sentinel to bound the stack search.
+  */
+  uint32_t TOS = excRet & 4 ? pspTop : mspTop;
+  uint32_t* limit = (uint32_t*)TOS;
+  if( maxWords > 0 && stack + 8 + maxWords < limit )
+	limit = stack + 8 + maxWords;
+
+  for( uint32_t* fp = stack + 8; fp < limit; fp++ ) {
+
+	uint32_t val = *fp;
+
+	/*
+	  Code section is bounded by these two addresses. Any LR would
+	  be within that range.
+	*/
+	if( val < (uint32_t)startText || val > (uint32_t)endText )
+	  continue;
+
+	// On M3, pc[0] == 1, so any LR must have this property too.
+	if( (val & 1) == 0 )
+	  continue;
+
+	// Deem that this word is indeed a 'pushed LR'.
+	if( addrs )
+	  addrs[found] = (uint32_t)fp;
+	vals[found] = val;
+
+	// Found as many as we want, or have ROOM for ?
+	found++;
+	if( found == max )
+	  break;
+  }
+  return found;
+}
+
+/**
+ * Did the fault hit a stack guard, see faultHandlingStackGuard?
+ * Either a data access in the guard (MMFAR valid and in it), or
+ * exception entry stacking the 8 regs into it (MSTKERR, no MMFAR).
+ *
+ * @return id of the overflowed stack, or -1.
+ */
+static int stackOverflowed( uint32_t sp, uint32_t cfsr, uint32_t mmfar ) {
+#if (__CORTEX_M > 0) && defined(__MPU_PRESENT) && (__MPU_PRESENT == 1)
+  for( int i = 0; i < stackCount; i++ ) {
+	if( stackGuards[i] < 0 )
+	  continue;
+	uint32_t hi = (uint32_t)stackFloors[i];
+	uint32_t lo = hi - GUARD_SIZE;
+	int access = (cfsr & CFSR_MMARVALID_Msk) && mmfar >= lo && mmfar < hi;
+	int stacking = (cfsr & CFSR_MSTKERR_Msk) && sp < hi && sp + 32 > lo;
+	if( access || stacking ) {
+	  MPU->RNR = (uint32_t)stackGuards[i];
+	  MPU->RASR = 0;
+	  __DSB();
+	  __ISB();
+	  stackGuards[i] = -1;
+	  return i;
+	}
+  }
+#else
+  (void)sp;
+  (void)cfsr;
+  (void)mmfar;
+#endif
+  return -1;
+}
+
+/**
+ * Advance the stacked pc past the faulting instruction. A Thumb
+ * instruction is 32-bit if its first halfword has top 5 bits 11101,
+ * 11110 or 11111, else 16-bit.
+ */
+static void skipInstruction( uint32_t* stack ) {
+  uint16_t hw = *(uint16_t*)stack[6];
+  stack[6] += ((hw & 0xF800) >= 0xE800) ? 4 : 2;
+#if (__CORTEX_M > 0)
+  SCB->CFSR = SCB->CFSR;
+  SCB->HFSR = SCB->HFSR;
+#endif
+}
+
+/*
+  Where exception return lands for POSTHANDLER_RECOVER: Thread mode,
+  on the faulting stack (minus the exception frame), from where a
+  longjmp is just like any other.
+*/
+static void recoveryTrampoline(void) {
+  longjmp( *recoveryPoint, 1 );
+}
+
+/**
+ * Rewrite the exception frame so that exception return enters
+ * recoveryTrampoline.  See p 394 for the frame layout.
+ *
+ * @param cfsr - as at fault entry, SCB->CFSR may since have been
+ * cleared, see captureWindow.
+ *
+ * @return 1 if the frame was rewritten, 0 if the fault is not one we
+ * can recover from.
+ */
+static int recover( uint32_t* stack, uint32_t excRet, uint32_t cfsr ) {
+
+  if( !recoveryPoint )
+	return 0;
+
+  // EXC_RETURN[3] = 0: faulted in Handler mode, no safe place to go
+  if( (excRet & 8) == 0 )
+	return 0;
+
+#if (__CORTEX_M > 0)
+  /*
+	A stacking/unstacking error (MSTKERR, MUNSTKERR, STKERR,
+	UNSTKERR) means the frame itself is suspect, writing it may
+	re-fault, and we are in HardFault, so that is lockup.
+  */
+  if( cfsr & ((1 << 4) | (1 << 3) | (1 << 12) | (1 << 11)) )
+	return 0;
+
+  // Status regs are write-1-to-clear, the next fault starts afresh
+  SCB->CFSR = SCB->CFSR;
+  SCB->HFSR = SCB->HFSR;
+#else
+  (void)cfsr;
+#endif
+
+  /*
+	Stacked pc, with bit 0 clear (the T bit lives in xPSR).  Stacked
+	xPSR: T bit only, no IPSR, no IT/ICI state, but keep bit 9, the
+	stack alignment padding indicator, since the unstacking uses it.
+  */
+  stack[6] = (uint32_t)recoveryTrampoline & ~1u;
+  stack[7] = (stack[7] & (1u << 9)) | (1u << 24);
+  return 1;
+}
+
 /************************ END PRIVATE IMPLEMENTATION *****************/
 
 /**
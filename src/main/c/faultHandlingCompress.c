@@ -0,0 +1,288 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include "faultHandlingCompress.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Address-relative compression of fault dumps.  See
+ * faultHandlingCompress.h for the encoding.
+ *
+ * Used on the target, at fault time, by
+ * faultHandlingCompressDump(), so no stdlib here, no heap, and only
+ * a few words of stack.  Used on the host, by dumpCompress.c and
+ * faultGuru.c, to restore the values.
+ */
+
+static int isHexDigit( char c ) {
+  return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F');
+}
+
+static uint32_t hexValue( char c ) {
+  return (uint32_t)(c <= '9' ? c - '0' : c - 'A' + 10);
+}
+
+static int isSpace( char c ) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static uint32_t zigzag( uint32_t delta ) {
+  return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+}
+
+static uint32_t unzigzag( uint32_t z ) {
+  return (z >> 1) ^ (uint32_t)-(int32_t)(z & 1);
+}
+
+static int varintLength( uint32_t v ) {
+  int n = 1;
+  while( v >= 0x80 ) {
+	v >>= 7;
+	n++;
+  }
+  return n;
+}
+
+/*
+  Append v as a LEB128 varint at out[cursor], if it fits.  Returns
+  the new cursor, or -1 if no room.
+*/
+static int putVarint( uint8_t* out, int cursor, int outLen, uint32_t v ) {
+  if( cursor + varintLength( v ) > outLen )
+	return -1;
+  while( v >= 0x80 ) {
+	out[cursor++] = (uint8_t)(v | 0x80);
+	v >>= 7;
+  }
+  out[cursor++] = (uint8_t)v;
+  return cursor;
+}
+
+static int getVarint( const uint8_t* in, int cursor, int inLen,
+					  uint32_t* v ) {
+  uint32_t result = 0;
+  for( int shift = 0; shift < 35; shift += 7 ) {
+	if( cursor >= inLen )
+	  return -1;
+	uint8_t b = in[cursor++];
+	result |= (uint32_t)(b & 0x7f) << shift;
+	if( (b & 0x80) == 0 ) {
+	  *v = result;
+	  return cursor;
+	}
+  }
+  return -1;
+}
+
+static void loadBases( const faultHandlingCompressBases* bases,
+					   uint32_t baseValues[FAULT_HANDLING_BASE_COUNT] ) {
+  baseValues[FAULT_HANDLING_BASE_ZERO] = 0;
+  baseValues[FAULT_HANDLING_BASE_TEXT] = bases->textStart;
+  baseValues[FAULT_HANDLING_BASE_STACKTOP] = bases->stackTop;
+  baseValues[FAULT_HANDLING_BASE_SP] = bases->sp;
+  baseValues[FAULT_HANDLING_BASE_SCB] = FAULT_HANDLING_SCB_BASE;
+}
+
+static int isToken( const char* token, int len, const char* want ) {
+  int i = 0;
+  while( i < len && want[i] == token[i] )
+	i++;
+  return i == len && !want[i];
+}
+
+/*
+  Count the values in the dump, needed up front for the header, and
+  note its kind.  A pass over a few hundred chars is cheap, and saves
+  us the need of any scratch buffer for the values.
+*/
+static int countValues( const char* dump, uint32_t* kind ) {
+  int count = 0;
+  *kind = 0;
+  const char* cp = dump;
+  while( *cp ) {
+	while( *cp && isSpace( *cp ) )
+	  cp++;
+	if( !*cp )
+	  break;
+	const char* token = cp;
+	int hex = 1;
+	while( *cp && !isSpace( *cp ) ) {
+	  if( !isHexDigit( *cp ) )
+		hex = 0;
+	  cp++;
+	}
+	if( hex && cp - token <= 8 )
+	  count++;
+	else if( isToken( token, (int)(cp - token), "hang" ) )
+	  *kind |= FAULT_HANDLING_KIND_HANG;
+	else if( cp - token == 5 && isToken( token, 4, "ovf." ) &&
+			 isHexDigit( token[4] ) )
+	  *kind |= FAULT_HANDLING_KIND_OVERFLOW | hexValue( token[4] ) << 4;
+  }
+  return count;
+}
+
+int faultHandlingCompress( const char* dump,
+						   const faultHandlingCompressBases* bases,
+						   uint8_t* out, int outLen ) {
+
+  uint32_t baseValues[FAULT_HANDLING_BASE_COUNT];
+  loadBases( bases, baseValues );
+
+  int cursor = 0;
+  if( outLen < 1 )
+	return -1;
+  out[cursor++] = FAULT_HANDLING_COMPRESS_MAGIC;
+
+  uint32_t kind;
+  cursor = putVarint( out, cursor, outLen, countValues( dump, &kind ) );
+  if( cursor > 0 )
+	cursor = putVarint( out, cursor, outLen, bases->textStart );
+  if( cursor > 0 )
+	cursor = putVarint( out, cursor, outLen, bases->stackTop );
+  if( cursor > 0 )
+	cursor = putVarint( out, cursor, outLen,
+						zigzag( bases->sp - bases->stackTop ) );
+  if( cursor > 0 )
+	cursor = putVarint( out, cursor, outLen, kind );
+  if( cursor < 0 )
+	return -1;
+
+  const char* cp = dump;
+  while( *cp ) {
+	while( *cp && isSpace( *cp ) )
+	  cp++;
+	if( !*cp )
+	  break;
+
+	// Accumulate the token's value as we go, discard if not hex
+	const char* token = cp;
+	uint32_t value = 0;
+	int hex = 1;
+	while( *cp && !isSpace( *cp ) ) {
+	  char c = *cp++;
+	  if( !isHexDigit( c ) ) {
+		hex = 0;
+		continue;
+	  }
+	  value = (value << 4) | hexValue( c );
+	}
+	if( !hex || cp - token > 8 )
+	  continue;
+
+	// Nearest base is the one giving the shortest varint, ties to lowest tag
+	int tag = 0;
+	uint32_t best = zigzag( value - baseValues[0] );
+	for( int b = 1; b < FAULT_HANDLING_BASE_COUNT; b++ ) {
+	  uint32_t z = zigzag( value - baseValues[b] );
+	  if( varintLength( z ) < varintLength( best ) ) {
+		best = z;
+		tag = b;
+	  }
+	}
+
+	if( cursor >= outLen )
+	  return -1;
+	out[cursor++] = (uint8_t)tag;
+	cursor = putVarint( out, cursor, outLen, best );
+	if( cursor < 0 )
+	  return -1;
+  }
+
+  // Checksum byte makes the byte sum of the whole encoding zero
+  if( cursor >= outLen )
+	return -1;
+  uint8_t sum = 0;
+  for( int i = 0; i < cursor; i++ )
+	sum += out[i];
+  out[cursor++] = (uint8_t)-sum;
+
+  return cursor;
+}
+
+int faultHandlingDecompress( const uint8_t* in, int inLen,
+							 faultHandlingCompressBases* bases,
+							 uint32_t* values, int maxValues ) {
+
+  if( inLen < 1 || in[0] != FAULT_HANDLING_COMPRESS_MAGIC )
+	return -1;
+
+  faultHandlingCompressBases decoded;
+  uint32_t count, spDelta;
+  int cursor = 1;
+  cursor = getVarint( in, cursor, inLen, &count );
+  if( cursor > 0 )
+	cursor = getVarint( in, cursor, inLen, &decoded.textStart );
+  if( cursor > 0 )
+	cursor = getVarint( in, cursor, inLen, &decoded.stackTop );
+  if( cursor > 0 )
+	cursor = getVarint( in, cursor, inLen, &spDelta );
+  if( cursor > 0 )
+	cursor = getVarint( in, cursor, inLen, &decoded.kind );
+  if( cursor < 0 || count > (uint32_t)maxValues )
+	return -1;
+  decoded.sp = decoded.stackTop + unzigzag( spDelta );
+
+  uint32_t baseValues[FAULT_HANDLING_BASE_COUNT];
+  loadBases( &decoded, baseValues );
+
+  for( uint32_t i = 0; i < count; i++ ) {
+	if( cursor >= inLen )
+	  return -1;
+	uint8_t tag = in[cursor++];
+	if( tag >= FAULT_HANDLING_BASE_COUNT )
+	  return -1;
+	uint32_t z;
+	cursor = getVarint( in, cursor, inLen, &z );
+	if( cursor < 0 )
+	  return -1;
+	values[i] = baseValues[tag] + unzigzag( z );
+  }
+
+  // Checksum byte is last, and whole encoding must sum to zero
+  if( cursor >= inLen )
+	return -1;
+  uint8_t sum = 0;
+  for( int i = 0; i <= cursor; i++ )
+	sum += in[i];
+  if( sum != 0 )
+	return -1;
+
+  if( bases )
+	*bases = decoded;
+  return (int)count;
+}
+
+// eof
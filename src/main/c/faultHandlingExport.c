@@ -0,0 +1,161 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include "faultHandlingExport.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * ITM and RTT dump exporters, see faultHandlingExport.h.
+ *
+ * Both writers can block, the ITM on a full FIFO, RTT (if
+ * FAULT_HANDLING_RTT_BLOCK) on a full ring, so a dump processor using
+ * them holds the fault handler until the host has read enough.
+ */
+
+#if (__CORTEX_M > 0)
+
+/*
+  Stimulus port access. A read of a port gives 1 when its FIFO can
+  take a write.  Overridable so that host tests can mock the ITM, see
+  src/test/c/mock/mockDevice.h.
+*/
+#ifndef ITM_PORT_READY
+#define ITM_PORT_READY( port )       (ITM->PORT[port].u32 != 0UL)
+#define ITM_PORT_WRITE32( port, w )  (ITM->PORT[port].u32 = (w))
+#define ITM_PORT_WRITE8( port, c )   (ITM->PORT[port].u8 = (c))
+#endif
+
+int faultHandlingITMWrite( uint32_t port, const char* s ) {
+  if( port > 31 || !(ITM->TCR & ITM_TCR_ITMENA_Msk) ||
+	  !(ITM->TER & (1UL << port)) )
+	return -1;
+
+  /*
+	Word writes, 4 chars per FIFO slot, little-endian so the host sees
+	them in order.  Then any tail bytes, one write each.
+  */
+  const uint8_t* cp = (const uint8_t*)s;
+  while( cp[0] && cp[1] && cp[2] && cp[3] ) {
+	uint32_t w = cp[0] | (cp[1] << 8) | (cp[2] << 16) | ((uint32_t)cp[3] << 24);
+	while( !ITM_PORT_READY( port ) )
+	  ;
+	ITM_PORT_WRITE32( port, w );
+	cp += 4;
+  }
+  for( ; *cp; cp++ ) {
+	while( !ITM_PORT_READY( port ) )
+	  ;
+	ITM_PORT_WRITE8( port, *cp );
+  }
+  return 0;
+}
+
+#else
+
+int faultHandlingITMWrite( uint32_t port, const char* s ) {
+  (void)port;
+  (void)s;
+  return -1;
+}
+
+#endif
+
+void faultHandlingRTTInit( faultHandlingRTT* rtt, char* buffer, uint32_t size,
+						   uint32_t flags ) {
+  rtt->maxUpBuffers = 1;
+  rtt->maxDownBuffers = 0;
+  rtt->up[0].name = "faultHandling";
+  rtt->up[0].buffer = buffer;
+  rtt->up[0].size = size;
+  rtt->up[0].wrOff = 0;
+  rtt->up[0].rdOff = 0;
+  rtt->up[0].flags = flags;
+
+  /*
+	The host finds the block by its id, so the id goes last: no
+	half-initialised block can be found.  Held reversed, so that a
+	probe scanning memory never finds a decoy id in our .rodata.
+  */
+  static const char id[] = "TTR REGGES";
+  __DMB();
+  for( int i = 0; i < 16; i++ )
+	rtt->id[i] = 0;
+  for( int i = 9; i >= 0; i-- )
+	rtt->id[9-i] = id[i];
+  __DMB();
+}
+
+// Free space in the ring, one slot always empty: rdOff == wrOff is empty
+static uint32_t rttAvailable( faultHandlingRTTBuffer* b ) {
+  uint32_t rd = b->rdOff;
+  uint32_t wr = b->wrOff;
+  return rd > wr ? rd - wr - 1 : b->size - (wr - rd) - 1;
+}
+
+int faultHandlingRTTWrite( faultHandlingRTT* rtt, const char* s ) {
+  faultHandlingRTTBuffer* b = rtt->up;
+
+  uint32_t len = 0;
+  while( s[len] )
+	len++;
+  if( b->flags == FAULT_HANDLING_RTT_NO_BLOCK_SKIP && len > rttAvailable( b ) )
+	return 0;
+
+  uint32_t done = 0;
+  while( done < len ) {
+	uint32_t n = rttAvailable( b );
+	if( n == 0 ) {
+	  if( b->flags != FAULT_HANDLING_RTT_BLOCK )
+		break;
+	  continue;
+	}
+	if( n > len - done )
+	  n = len - done;
+
+	uint32_t wr = b->wrOff;
+	for( uint32_t i = 0; i < n; i++ ) {
+	  b->buffer[wr] = s[done++];
+	  if( ++wr == b->size )
+		wr = 0;
+	}
+
+	// Data before offset: the host reads the data once it sees wrOff
+	__DMB();
+	b->wrOff = wr;
+  }
+  return (int)done;
+}
+
+// eof
@@ -0,0 +1,147 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include "faultHandlingHistory.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Persistent (across reboots) fault history, see faultHandlingHistory.h.
+ *
+ * Record and Escalate are called from handleFault, once the dump is
+ * formatted: Record is one pass over the FAULT_HANDLING_SIGNATURES
+ * slots of the caller's table, Escalate a few counter updates.
+ */
+
+#define HISTORY_MAGIC (0xFA017015)
+
+void faultHandlingHistoryBoot( faultHandlingHistory* h ) {
+
+  if( h->magic != HISTORY_MAGIC || h->bootsCheck != ~h->boots ) {
+	// Power-on (or corruption), start afresh
+	uint8_t* cp = (uint8_t*)h;
+	for( unsigned i = 0; i < sizeof(*h); i++ )
+	  cp[i] = 0;
+	h->magic = HISTORY_MAGIC;
+  }
+  h->boots++;
+  h->bootsCheck = ~h->boots;
+
+  // A quiet window ends any storm
+  if( h->boots - h->lastFault > FAULT_HANDLING_STORM_WINDOW ) {
+	h->windowFaults = 0;
+	h->level = 0;
+  }
+}
+
+uint32_t faultHandlingSignatureOf( const uint32_t* values, int n ) {
+  uint32_t hash = 2166136261u;
+  for( int i = 0; i < n; i++ ) {
+	for( int b = 0; b < 32; b += 8 ) {
+	  hash ^= (values[i] >> b) & 0xff;
+	  hash *= 16777619u;
+	}
+  }
+  return hash ? hash : 1;
+}
+
+uint32_t faultHandlingHistoryRecord( faultHandlingHistory* h,
+									 uint32_t signature ) {
+
+  faultHandlingSignature* victim = 0;
+  for( int i = 0; i < FAULT_HANDLING_SIGNATURES; i++ ) {
+	faultHandlingSignature* s = h->signatures + i;
+	if( s->signature == signature ) {
+	  s->count++;
+	  s->lastBoot = h->boots;
+	  return s->count;
+	}
+
+	/*
+	  Prefer an unused slot, else the one least recently seen, else
+	  (seen in the same boot) the least counted.  A table full of old
+	  faults must not blind us to a new one, storming now.
+	*/
+	if( !victim ||
+		(victim->signature != 0 &&
+		 (s->signature == 0 || s->lastBoot < victim->lastBoot ||
+		  (s->lastBoot == victim->lastBoot && s->count < victim->count))) )
+	  victim = s;
+  }
+
+  victim->signature = signature;
+  victim->count = 1;
+  victim->firstBoot = victim->lastBoot = h->boots;
+  return 1;
+}
+
+uint32_t faultHandlingHistoryStorm( faultHandlingHistory* h,
+									const faultHandlingEscalation* policy,
+									int levels ) {
+
+  // Window is FAULT_HANDLING_STORM_WINDOW boots, opened by its first fault
+  if( h->windowFaults == 0 ||
+	  h->boots - h->windowStart >= FAULT_HANDLING_STORM_WINDOW ) {
+	h->windowStart = h->boots;
+	h->windowFaults = 0;
+  }
+  h->windowFaults++;
+  h->lastFault = h->boots;
+
+  uint32_t level = 0;
+  while( (int)level < levels && h->windowFaults >= policy[level].faults )
+	level++;
+
+  // Level only rises here, it falls after a quiet window, at boot
+  if( level > h->level )
+	h->level = level;
+  return h->level;
+}
+
+uint32_t faultHandlingHistoryEscalate( faultHandlingHistory* h,
+									   const faultHandlingEscalation* policy,
+									   int levels, uint32_t action ) {
+  if( !policy )
+	return action;
+  uint32_t level = faultHandlingHistoryStorm( h, policy, levels );
+  return level > 0 ? policy[level-1].action : action;
+}
+
+int faultHandlingHistorySafeMode( faultHandlingHistory* h ) {
+  int safeMode = h->safeMode != 0;
+  h->safeMode = 0;
+  return safeMode;
+}
+
+// eof
@@ -0,0 +1,535 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#define _GNU_SOURCE
+
+#include <elf.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "faultHandling.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Structured fault handling on a Linux host: the faultHandling api,
+ * for firmware logic built and run on the host, e.g. in a simulation.
+ * Build lib and application with -DFAULT_HANDLING_HOST, and link this
+ * in place of faultHandling.c.
+ *
+ * The faults are signals: SIGSEGV, SIGBUS, SIGILL, SIGFPE and
+ * SIGABRT (a failed assert).  faultHandlingSetDumpProcessor installs
+ * our handler for them, on an alternate signal stack, so even a stack
+ * overflow is dumped.  The handler reads the faulting registers from
+ * its ucontext_t, searches the stack for pushed return addresses, as
+ * faultHandling.c does, and fills in a dump of the same row formats,
+ * but its own rows (see faultHandlingRegIndex), e.g. on x86-64:
+ *
+r7    5649D9C0
+h.r7  00007FFD
+sp    5649D9A0
+h.sp  00007FFD
+sig   0000000B
+code  00000001
+addr  00000000
+h.adr 00000000
+s.r0  00000000
+h.r0  00000000
+...
+s.pc  B4C6A1D3
+h.pc  000055D2
+h.txt 000055D2
+arch  0000003E
+55D2B4C6 ...
+ *
+ * r7 is the host's frame pointer (rbp, x29, r7 on arm), s.r0-s.r3 its
+ * first four argument registers, arch its ELF e_machine.  So the dump
+ * goes through the same tools as a target's: dumpParse.c reads it,
+ * faultGuru decodes and diagnoses it.
+ *
+ * The handler is async-signal-safe: no stdio, no malloc, no locks.
+ * The stack's extent is read from /proc/self/maps, with open/read
+ * only, into a buffer on the (alternate) stack.
+ *
+ * Of the api, dump processor, call stack parameters, post-fault
+ * action, recovery point and build id apply on the host, as does the
+ * trace ring (faultHandlingTrace.c).  Post-fault actions are as near
+ * as a process gets:
+ *
+ * POSTHANDLER_LOOP, SLEEP: pause() forever, for a debugger to attach.
+ *
+ * POSTHANDLER_RESET, SAFEMODE: die of the signal, as with no handler
+ * at all (and so a core file, if enabled).
+ *
+ * POSTHANDLER_DEBUG: raise SIGTRAP.
+ *
+ * POSTHANDLER_RETURN: return, the faulting instruction runs again.
+ *
+ * POSTHANDLER_RECOVER: longjmp to the recovery point, if any, else
+ * LOOP.
+ *
+ * The alternate stack is that of the thread which set the dump
+ * processor.  Other threads' faults are dumped too, but a stack
+ * overflow in one of them is not.  There is one dump buffer: a fault
+ * while another is being dumped kills the process.
+ */
+
+static char* dumpBuffer = NULL;
+static faultHandlingDumpProcessor dumpProcessor = NULL;
+static uintptr_t startText, endText, mspTop;
+static faultHandlingPostFaultAction postFaultAction = POSTHANDLER_LOOP;
+static jmp_buf* recoveryPoint = NULL;
+static volatile sig_atomic_t handling = 0;
+
+static const int signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+
+#define SIGNALS ((int)(sizeof(signals)/sizeof(signals[0])))
+
+// Big enough for the handler and the dump processor it calls
+#define ALT_STACK_SIZE (64 * 1024)
+
+static char altStack[ALT_STACK_SIZE];
+
+static void faultDumpPrepare(void);
+static void handler( int sig, siginfo_t* info, void* context );
+
+void faultHandlingSetDumpProcessor( char* buf, faultHandlingDumpProcessor p ) {
+  dumpBuffer = buf;
+  dumpProcessor = p;
+  faultDumpPrepare();
+
+  // Without call stack parameters, the executable's own text
+  if( endText == 0 ) {
+	extern char __executable_start[], etext[];
+	startText = (uintptr_t)__executable_start;
+	endText = (uintptr_t)etext;
+  }
+
+  stack_t ss;
+  ss.ss_sp = altStack;
+  ss.ss_size = sizeof altStack;
+  ss.ss_flags = 0;
+  sigaltstack( &ss, NULL );
+
+  /*
+	SA_NODEFER, so that a longjmp out of the handler (RECOVER) leaves
+	the signal unblocked.  A fault IN the handler is caught by the
+	'handling' flag instead.
+  */
+  struct sigaction sa;
+  memset( &sa, 0, sizeof sa );
+  sa.sa_sigaction = handler;
+  sa.sa_flags = SA_SIGINFO | SA_ONSTACK | SA_NODEFER;
+  sigemptyset( &sa.sa_mask );
+  for( int i = 0; i < SIGNALS; i++ )
+	sigaction( signals[i], &sa, NULL );
+}
+
+/**
+ * @param mspTop - a limit on the stack search, 0 for the top of the
+ * faulting thread's stack, as found at fault time.
+ *
+ * @param pspTop - unused, a host has no process stack.
+ */
+void faultHandlingSetCallStackParameters( uint32_t* textLo,
+										  uint32_t* textHi,
+										  uint32_t* mspTop_,
+										  uint32_t* pspTop_ ) {
+  (void)pspTop_;
+  startText = (uintptr_t)textLo;
+  endText = (uintptr_t)textHi;
+  mspTop = (uintptr_t)mspTop_;
+}
+
+void faultHandlingSetPostFaultAction( faultHandlingPostFaultAction pfa ) {
+  postFaultAction = pfa;
+}
+
+void faultHandlingSetRecoveryPoint( jmp_buf* env ) {
+  recoveryPoint = env;
+}
+
+#ifdef FAULT_HANDLING_BUILD_ID
+const volatile faultHandlingBuildIdentity faultHandlingBuildIdentityRecord
+__attribute__((used)) = { FAULT_HANDLING_BUILD_ID_MAGIC, { 0, 0 } };
+#endif
+
+uint32_t faultHandlingBuildId(void) {
+#ifdef FAULT_HANDLING_BUILD_ID
+  return faultHandlingBuildIdentityRecord.id[0];
+#else
+  return 0;
+#endif
+}
+
+/************************ STATICS, PRIVATE IMPLEMENTATION *****************/
+
+/*
+  The faulting registers, from the ucontext, per host: frame pointer,
+  sp, pc, link register (none on x86), and four argument registers.
+*/
+typedef struct {
+  uintptr_t fp, sp, pc, lr;
+  uintptr_t args[4];
+} hostRegs;
+
+#if defined(__x86_64__)
+#define HOST_MACHINE EM_X86_64
+static void hostRegsOf( const ucontext_t* uc, hostRegs* r ) {
+  const greg_t* g = uc->uc_mcontext.gregs;
+  r->fp = (uintptr_t)g[REG_RBP];
+  r->sp = (uintptr_t)g[REG_RSP];
+  r->pc = (uintptr_t)g[REG_RIP];
+  r->lr = 0;
+  r->args[0] = (uintptr_t)g[REG_RDI];
+  r->args[1] = (uintptr_t)g[REG_RSI];
+  r->args[2] = (uintptr_t)g[REG_RDX];
+  r->args[3] = (uintptr_t)g[REG_RCX];
+}
+#elif defined(__i386__)
+#define HOST_MACHINE EM_386
+static void hostRegsOf( const ucontext_t* uc, hostRegs* r ) {
+  const greg_t* g = uc->uc_mcontext.gregs;
+  r->fp = (uintptr_t)g[REG_EBP];
+  r->sp = (uintptr_t)g[REG_ESP];
+  r->pc = (uintptr_t)g[REG_EIP];
+  r->lr = 0;
+  // Arguments are on the stack, these are regparm's, and ebx
+  r->args[0] = (uintptr_t)g[REG_EAX];
+  r->args[1] = (uintptr_t)g[REG_EDX];
+  r->args[2] = (uintptr_t)g[REG_ECX];
+  r->args[3] = (uintptr_t)g[REG_EBX];
+}
+#elif defined(__aarch64__)
+#define HOST_MACHINE EM_AARCH64
+static void hostRegsOf( const ucontext_t* uc, hostRegs* r ) {
+  const mcontext_t* m = &uc->uc_mcontext;
+  r->fp = (uintptr_t)m->regs[29];
+  r->sp = (uintptr_t)m->sp;
+  r->pc = (uintptr_t)m->pc;
+  r->lr = (uintptr_t)m->regs[30];
+  for( int i = 0; i < 4; i++ )
+	r->args[i] = (uintptr_t)m->regs[i];
+}
+#elif defined(__arm__)
+#define HOST_MACHINE EM_ARM
+static void hostRegsOf( const ucontext_t* uc, hostRegs* r ) {
+  const mcontext_t* m = &uc->uc_mcontext;
+  r->fp = m->arm_r7;
+  r->sp = m->arm_sp;
+  r->pc = m->arm_pc;
+  r->lr = m->arm_lr;
+  r->args[0] = m->arm_r0;
+  r->args[1] = m->arm_r1;
+  r->args[2] = m->arm_r2;
+  r->args[3] = m->arm_r3;
+}
+#else
+#error faultHandlingHost.c: no ucontext register access for this host
+#endif
+
+static const char* const cpuRegLabels[] =
+  { "r7   ",
+	"h.r7 ",
+	"sp   ",
+	"h.sp ",
+	"sig  ",
+	"code ",
+	"addr ",
+	"h.adr",
+	"s.r0 ",
+	"h.r0 ",
+	"s.r1 ",
+	"h.r1 ",
+	"s.r2 ",
+	"h.r2 ",
+	"s.r3 ",
+	"h.r3 ",
+	"s.lr ",
+	"h.lr ",
+	"s.pc ",
+	"h.pc ",
+	"h.txt",
+	"arch ",
+#ifdef FAULT_HANDLING_BUILD_ID
+	"build",
+#endif
+  };
+
+_Static_assert( sizeof(cpuRegLabels)/sizeof(cpuRegLabels[0]) ==
+				FAULT_HANDLING_CPUREG_COUNT, "a label per row" );
+
+static void faultDumpPrepare(void) {
+  int cursor = 0;
+  for( int i = 0; i < FAULT_HANDLING_CPUREG_COUNT; i++ ) {
+	memcpy( dumpBuffer + cursor, cpuRegLabels[i], 5 );
+	dumpBuffer[cursor+5] = ' ';
+	memset( dumpBuffer + cursor + 6, '0', 8 );
+	dumpBuffer[cursor+14] = '\n';
+	cursor += FAULT_HANDLING_CPUREG_ROWSIZE;
+  }
+  for( int i = 0; i < FAULT_HANDLING_CALLSTACK_ENTRIES; i++ ) {
+	memset( dumpBuffer + cursor, '0', 17 );
+	dumpBuffer[cursor+8] = ' ';
+	dumpBuffer[cursor+17] = '\n';
+	cursor += FAULT_HANDLING_CALLSTACK_ROWSIZE;
+  }
+  for( int i = 0; i < FAULT_HANDLING_TRACE_DUMP_ENTRIES; i++ ) {
+	memset( dumpBuffer + cursor, '0', 13 );
+	dumpBuffer[cursor+4] = ' ';
+	dumpBuffer[cursor+13] = '\n';
+	cursor += FAULT_HANDLING_TRACE_ROWSIZE;
+  }
+  dumpBuffer[cursor] = 0;
+}
+
+static const char hex[16] = { '0', '1', '2', '3', '4', '5', '6', '7',
+							  '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
+
+static void formatHex( char* at, uint32_t value, int digits ) {
+  for( int i = 0; i < digits; i++ )
+	at[i] = hex[(value >> (4*(digits-1-i))) & 0xf];
+}
+
+static void formatRegValue( faultHandlingRegIndex index, uint32_t value ) {
+  formatHex( dumpBuffer + FAULT_HANDLING_CPUREG_ROWSIZE*index + 6,
+			 value, 8 );
+}
+
+// A host word, as a low word row and its 'h.' row, which follows it
+static void formatRegWide( faultHandlingRegIndex index, uintptr_t value ) {
+  formatRegValue( index, (uint32_t)value );
+  formatRegValue( index + 1, (uint32_t)((uint64_t)value >> 32) );
+}
+
+static void formatCallStackPair( int index, uint32_t addr, uint32_t val ) {
+  char* at = dumpBuffer +
+	FAULT_HANDLING_CPUREG_ROWSIZE*FAULT_HANDLING_CPUREG_COUNT +
+	FAULT_HANDLING_CALLSTACK_ROWSIZE*index;
+  formatHex( at, addr, 8 );
+  formatHex( at + 9, val, 8 );
+}
+
+#if (FAULT_HANDLING_TRACE_DUMP_ENTRIES > 0)
+static void formatTraceEvent( int index, uint32_t id, uint32_t arg ) {
+  char* at = dumpBuffer +
+	FAULT_HANDLING_CPUREG_ROWSIZE*FAULT_HANDLING_CPUREG_COUNT +
+	FAULT_HANDLING_CALLSTACK_ROWSIZE*FAULT_HANDLING_CALLSTACK_ENTRIES +
+	FAULT_HANDLING_TRACE_ROWSIZE*index;
+  formatHex( at, id, 4 );
+  formatHex( at + 5, arg, 8 );
+}
+#endif
+
+/*
+  The mapping holding @p addr, or if none (an overflowed sp, below its
+  stack), the next above it, from /proc/self/maps, whose lines start
+  'lo-hi ', in hex, in address order.  Parsed a byte at a time as
+  read, so no line buffer and no allocation.  Sets *start, returns
+  the end, 0 if none.
+*/
+static uintptr_t mappingOf( uintptr_t addr, uintptr_t* start ) {
+  int fd = open( "/proc/self/maps", O_RDONLY | O_CLOEXEC );
+  if( fd < 0 )
+	return 0;
+  char buf[512];
+  uintptr_t lo = 0, hi = 0, result = 0;
+  int field = 0;	// 0: lo, 1: hi, 2: rest of line
+  ssize_t n;
+  while( !result && (n = read( fd, buf, sizeof buf )) > 0 ) {
+	for( ssize_t i = 0; i < n && !result; i++ ) {
+	  char c = buf[i];
+	  if( c == '\n' ) {
+		lo = hi = 0;
+		field = 0;
+	  } else if( field == 2 )
+		continue;
+	  else if( c == '-' )
+		field = 1;
+	  else if( c == ' ' ) {
+		field = 2;
+		if( addr < hi ) {
+		  *start = lo;
+		  result = hi;
+		}
+	  } else {
+		uintptr_t nibble = (uintptr_t)(c <= '9' ? c - '0' : c - 'a' + 10);
+		if( field == 0 )
+		  lo = (lo << 4) | nibble;
+		else
+		  hi = (hi << 4) | nibble;
+	  }
+	}
+  }
+  close( fd );
+  return result;
+}
+
+/*
+  As faultHandling.c's searchCallStack: every stack word, from sp up,
+  which lies in the text range is deemed a pushed return address.  A
+  word is a host word, aligned; on arm, Thumb code, it must also be
+  odd.  The search ends at the top of sp's mapping (or mspTop), and
+  where the high word of the address changes, as the rows have no
+  room for it: h.sp is the high word of every row address.
+*/
+static int searchCallStack( uintptr_t sp, uint32_t* addrs, uint32_t* vals,
+							int max ) {
+  if( endText == 0 )
+	return 0;
+  uintptr_t bottom = 0;
+  uintptr_t top = mappingOf( sp, &bottom );
+  if( mspTop && (top == 0 || mspTop < top) )
+	top = mspTop;
+  if( bottom > sp )
+	sp = bottom;
+
+  int found = 0;
+  uintptr_t* limit = (uintptr_t*)top;
+  for( uintptr_t* p = (uintptr_t*)(sp & ~(sizeof(uintptr_t)-1));
+	   p < limit && found < max; p++ ) {
+	if( ((uint64_t)(uintptr_t)p >> 32) != ((uint64_t)sp >> 32) )
+	  break;
+	uintptr_t val = *p;
+	if( val < startText || val > endText )
+	  continue;
+#if defined(__arm__)
+	if( (val & 1) == 0 )
+	  continue;
+#endif
+	addrs[found] = (uint32_t)(uintptr_t)p;
+	vals[found] = (uint32_t)val;
+	found++;
+  }
+  return found;
+}
+
+// Die of @p sig, as if we had never handled it
+static void die( int sig ) {
+  struct sigaction sa;
+  memset( &sa, 0, sizeof sa );
+  sa.sa_handler = SIG_DFL;
+  sigemptyset( &sa.sa_mask );
+  sigaction( sig, &sa, NULL );
+  raise( sig );
+}
+
+static void handler( int sig, siginfo_t* info, void* context ) {
+
+  if( handling || !dumpProcessor ) {
+	die( sig );
+	return;
+  }
+  handling = 1;
+
+  hostRegs r;
+  hostRegsOf( (const ucontext_t*)context, &r );
+
+  // si_addr means nothing for a signal sent, e.g. by abort
+  uintptr_t addr = sig == SIGABRT ? 0 : (uintptr_t)info->si_addr;
+
+  formatRegWide( R7, r.fp );
+  formatRegWide( SP, r.sp );
+  formatRegValue( SIGNO, (uint32_t)sig );
+  formatRegValue( SIGCODE, (uint32_t)info->si_code );
+  formatRegWide( SIGADDR, addr );
+  formatRegWide( STKR0, r.args[0] );
+  formatRegWide( STKR1, r.args[1] );
+  formatRegWide( STKR2, r.args[2] );
+  formatRegWide( STKR3, r.args[3] );
+  formatRegWide( STKLR, r.lr );
+  formatRegWide( STKPC, r.pc );
+  formatRegValue( HITEXT, (uint32_t)((uint64_t)startText >> 32) );
+  formatRegValue( ARCH, HOST_MACHINE );
+#ifdef FAULT_HANDLING_BUILD_ID
+  formatRegValue( BUILDID, faultHandlingBuildId() );
+#endif
+
+  // Rows not found are zeroed, a previous fault's may be there
+  uint32_t addrs[FAULT_HANDLING_CALLSTACK_ENTRIES] = { 0 };
+  uint32_t vals[FAULT_HANDLING_CALLSTACK_ENTRIES] = { 0 };
+  searchCallStack( r.sp, addrs, vals, FAULT_HANDLING_CALLSTACK_ENTRIES );
+  for( int i = 0; i < FAULT_HANDLING_CALLSTACK_ENTRIES; i++ )
+	formatCallStackPair( i, addrs[i], vals[i] );
+
+#if (FAULT_HANDLING_TRACE_DUMP_ENTRIES > 0)
+  faultHandlingTraceEvent events[FAULT_HANDLING_TRACE_DUMP_ENTRIES];
+  int traced = faultHandlingTraceLatest( events,
+										 FAULT_HANDLING_TRACE_DUMP_ENTRIES );
+  for( int i = 0; i < FAULT_HANDLING_TRACE_DUMP_ENTRIES; i++ ) {
+	int e = i - (FAULT_HANDLING_TRACE_DUMP_ENTRIES - traced);
+	if( e < 0 )
+	  formatTraceEvent( i, 0, 0 );
+	else
+	  formatTraceEvent( i, events[e].id, events[e].arg );
+  }
+#endif
+
+  dumpProcessor();
+
+  switch( postFaultAction ) {
+
+  case POSTHANDLER_RESET:
+  case POSTHANDLER_SAFEMODE:
+	die( sig );
+	break;
+
+  case POSTHANDLER_DEBUG:
+	handling = 0;
+	raise( SIGTRAP );
+	break;
+
+  case POSTHANDLER_RETURN:
+	handling = 0;
+	break;
+
+  case POSTHANDLER_RECOVER:
+	if( recoveryPoint ) {
+	  handling = 0;
+	  longjmp( *recoveryPoint, 1 );
+	}
+	// nowhere to recover to, so
+	// fall through
+  case POSTHANDLER_LOOP:
+  case POSTHANDLER_SLEEP:
+  default:
+	while(2)
+	  pause();
+  }
+}
+
+// eof
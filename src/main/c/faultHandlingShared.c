@@ -0,0 +1,147 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include "faultHandlingShared.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Multi-core fault dump log, see faultHandlingShared.h.
+ *
+ * Put runs in handleFault, perhaps on every core at once.  Only the
+ * slot state and the log sequence are contended, both by the gcc
+ * __atomic builtins, LDREX/STREX plus DMB on ARMv7-M.  The dump copy
+ * is a byte loop into a slot already ours.
+ */
+
+#define SHARED_MAGIC (0x5A4ED106)
+
+void faultHandlingSharedInit( faultHandlingSharedLog* log ) {
+  if( log->magic == SHARED_MAGIC )
+	return;
+  uint8_t* cp = (uint8_t*)log;
+  for( unsigned i = 0; i < sizeof(*log); i++ )
+	cp[i] = 0;
+  __atomic_store_n( &log->magic, SHARED_MAGIC, __ATOMIC_RELEASE );
+}
+
+static int claim( faultHandlingSharedSlot* s, int index, uint32_t core ) {
+
+#if FAULT_HANDLING_SHARED_PARTITIONED
+  if( (uint32_t)index % FAULT_HANDLING_SHARED_CORES !=
+	  core % FAULT_HANDLING_SHARED_CORES )
+	return 0;
+#else
+  (void)index;
+  (void)core;
+#endif
+
+#if defined(__ARM_ARCH_6M__)
+  /*
+	No exclusives, but partitioned: no other core ever writes our
+	slots until READY.  At fault priority, nothing on this core can
+	interrupt us either.
+  */
+  if( s->state != FAULT_HANDLING_SLOT_FREE )
+	return 0;
+  s->state = FAULT_HANDLING_SLOT_CLAIMED;
+  return 1;
+#else
+  uint32_t expected = FAULT_HANDLING_SLOT_FREE;
+  return __atomic_compare_exchange_n( &s->state, &expected,
+									  FAULT_HANDLING_SLOT_CLAIMED, 0,
+									  __ATOMIC_ACQUIRE, __ATOMIC_RELAXED );
+#endif
+}
+
+static uint32_t nextSequence( faultHandlingSharedLog* log ) {
+#if defined(__ARM_ARCH_6M__)
+  // Order only, a clash between cores just gives equal sequences
+  return log->sequence++;
+#else
+  return __atomic_fetch_add( &log->sequence, 1, __ATOMIC_RELAXED );
+#endif
+}
+
+int faultHandlingSharedPut( faultHandlingSharedLog* log, uint32_t core,
+							const char* dump ) {
+
+  // A truncated dump is a corrupt one, better none
+  int len = 0;
+  while( len < FAULT_HANDLING_SHARED_DUMP_SIZE && dump[len] )
+	len++;
+  if( len == FAULT_HANDLING_SHARED_DUMP_SIZE )
+	return -1;
+
+  for( int i = 0; i < FAULT_HANDLING_SHARED_SLOTS; i++ ) {
+	faultHandlingSharedSlot* s = log->slots + i;
+	if( !claim( s, i, core ) )
+	  continue;
+
+	// Ours now, no other core touches it until READY
+	for( int n = 0; n <= len; n++ )
+	  s->dump[n] = dump[n];
+	s->core = core;
+	s->sequence = nextSequence( log );
+
+	// Release: a reader seeing READY sees all of the above
+	__atomic_store_n( &s->state, FAULT_HANDLING_SLOT_READY, __ATOMIC_RELEASE );
+	return i;
+  }
+  return -1;
+}
+
+int faultHandlingSharedOldest( faultHandlingSharedLog* log ) {
+  int oldest = -1;
+  for( int i = 0; i < FAULT_HANDLING_SHARED_SLOTS; i++ ) {
+	faultHandlingSharedSlot* s = log->slots + i;
+	if( __atomic_load_n( &s->state, __ATOMIC_ACQUIRE ) !=
+		FAULT_HANDLING_SLOT_READY )
+	  continue;
+	// Sequence wraps, so compare by difference
+	if( oldest < 0 ||
+		(int32_t)(s->sequence - log->slots[oldest].sequence) < 0 )
+	  oldest = i;
+  }
+  return oldest;
+}
+
+void faultHandlingSharedRelease( faultHandlingSharedLog* log, int slot ) {
+  if( slot < 0 || slot >= FAULT_HANDLING_SHARED_SLOTS )
+	return;
+  __atomic_store_n( &log->slots[slot].state, FAULT_HANDLING_SLOT_FREE,
+					__ATOMIC_RELEASE );
+}
+
+// eof
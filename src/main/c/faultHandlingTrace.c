@@ -0,0 +1,72 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include "faultHandlingTrace.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * The flight recorder ring, see faultHandlingTrace.h. Logging itself
+ * is all inline, in the header.
+ */
+
+#define TRACE_MAGIC (0x7ACE7ACE)
+
+faultHandlingTraceRing faultHandlingTraceBuffer FAULT_HANDLING_NOINIT;
+
+void faultHandlingTraceInit(void) {
+  if( faultHandlingTraceBuffer.magic != TRACE_MAGIC )
+	faultHandlingTraceClear();
+}
+
+void faultHandlingTraceClear(void) {
+  uint8_t* cp = (uint8_t*)&faultHandlingTraceBuffer;
+  for( unsigned i = 0; i < sizeof(faultHandlingTraceBuffer); i++ )
+	cp[i] = 0;
+  faultHandlingTraceBuffer.magic = TRACE_MAGIC;
+}
+
+int faultHandlingTraceLatest( faultHandlingTraceEvent* events, int max ) {
+  uint32_t head = faultHandlingTraceBuffer.head;
+  uint32_t n = head < FAULT_HANDLING_TRACE_ENTRIES ?
+	head : FAULT_HANDLING_TRACE_ENTRIES;
+  if( n > (uint32_t)max )
+	n = max > 0 ? (uint32_t)max : 0;
+  for( uint32_t i = 0; i < n; i++ )
+	events[i] = faultHandlingTraceBuffer.events
+	  [(head - n + i) & (FAULT_HANDLING_TRACE_ENTRIES-1)];
+  return (int)n;
+}
+
+// eof
@@ -36,6 +36,7 @@
 #define CORTEXM_FAULT_HANDLING_H
 
 #include <stdint.h>
+#include <setjmp.h>
 
 /**
    Define CMSIS_device_header in your build tool/IDE. For example,
@@ -45,8 +46,18 @@
    
    We did not invent this approach.  ARM use it for their RTOS2/RTX
    builds.
+
+   The Linux host build (-DFAULT_HANDLING_HOST, see
+   faultHandlingHost.c) has no device, so needs no such header.
 */
+#ifndef FAULT_HANDLING_HOST
 #include CMSIS_device_header
+#endif
+
+#include "faultHandlingCompress.h"
+#include "faultHandlingHistory.h"
+#include "faultHandlingShared.h"
+#include "faultHandlingTrace.h"
 
 /**
  * @author Stuart Maclean
@@ -60,11 +71,24 @@
 /**
  * What to do after the fault dump is populated and sent to the dump
  * processor.
+ *
+ * POSTHANDLER_SAFEMODE resets, and at the next boot the application's
+ * safe-mode entry hook is called, see faultHandlingSetEscalationPolicy.
+ *
+ * POSTHANDLER_SLEEP is POSTHANDLER_LOOP, but in (deep) sleep, to save
+ * the battery of a unit that will be recovered/serviced later.
+ *
+ * POSTHANDLER_RECOVER longjmps to the current recovery point, see
+ * faultHandlingSetRecoveryPoint.  With no recovery point, or a fault
+ * that cannot be recovered from, it is POSTHANDLER_LOOP.
  */
 typedef enum { POSTHANDLER_LOOP,
 			   POSTHANDLER_RESET,
 			   POSTHANDLER_DEBUG,
-			   POSTHANDLER_RETURN } faultHandlingPostFaultAction;
+			   POSTHANDLER_RETURN,
+			   POSTHANDLER_SAFEMODE,
+			   POSTHANDLER_SLEEP,
+			   POSTHANDLER_RECOVER } faultHandlingPostFaultAction;
 
 
 /**
@@ -93,13 +117,78 @@ typedef struct {
   uint32_t stklr;
   uint32_t stkpc;
   uint32_t stkpsr;
+
+#ifdef FAULT_HANDLING_STACK_WATERMARK
+  uint32_t sfree;	// least free stack, bytes, see faultHandlingStackFree
+#endif
+
+#ifdef FAULT_HANDLING_FULL_REGS
+  /*
+	The rest of the register file, as at the fault. Build lib, asm and
+	application with FAULT_HANDLING_FULL_REGS (make FULL_REGS=1).
+  */
+  uint32_t r4;
+  uint32_t r5;
+  uint32_t r6;
+  uint32_t r8;
+  uint32_t r9;
+  uint32_t r10;
+  uint32_t r11;
+  uint32_t msp;
+  uint32_t psp;
+  uint32_t control;
+  uint32_t primask;
+#if (__CORTEX_M > 0)
+  uint32_t basepri;
+#endif
+#endif
+
+#ifdef FAULT_HANDLING_BUILD_ID
+  uint32_t build;	// see faultHandlingBuildId
+#endif
   
 } faultHandlingRegSet;
 
 /*
   An enum of the registers we are dumping. Note how the final element,
   FAULTHANDLING_CPUREG_COUNT, gives us the count we need in the processing.
+
+  The host build dumps a signal, not an exception: the host's frame
+  pointer, sp, signal number, si_code, si_addr, first four argument
+  registers, link register (0 on x86) and pc, then the ELF e_machine
+  of the host, the 'arch' row.  A host's registers may be 64-bit, so
+  each is a row of its low word then a 'h.' row of its high word.
+  h.txt is the high word of every call stack row value (code
+  addresses), h.sp that of their addresses.
 */
+#ifdef FAULT_HANDLING_HOST
+typedef enum { R7=0,
+			   HIR7,
+			   SP,
+			   HISP,
+			   SIGNO,
+			   SIGCODE,
+			   SIGADDR,
+			   HISIGADDR,
+			   STKR0,
+			   HIR0,
+			   STKR1,
+			   HIR1,
+			   STKR2,
+			   HIR2,
+			   STKR3,
+			   HIR3,
+			   STKLR,
+			   HILR,
+			   STKPC,
+			   HIPC,
+			   HITEXT,
+			   ARCH,
+#ifdef FAULT_HANDLING_BUILD_ID
+			   BUILDID,
+#endif
+			   FAULT_HANDLING_CPUREG_COUNT } faultHandlingRegIndex;
+#else
 typedef enum { R7=0,
 			   SP,
 			   EXCRT,
@@ -119,7 +208,30 @@ typedef enum { R7=0,
 			   STKLR,
 			   STKPC,
 			   STKPSR,
+#ifdef FAULT_HANDLING_STACK_WATERMARK
+			   SFREE,
+#endif
+#ifdef FAULT_HANDLING_FULL_REGS
+			   R4,
+			   R5,
+			   R6,
+			   R8,
+			   R9,
+			   R10,
+			   R11,
+			   MSP,
+			   PSP,
+			   CTRL,
+			   PMASK,
+#if (__CORTEX_M > 0)
+			   BPRI,
+#endif
+#endif
+#ifdef FAULT_HANDLING_BUILD_ID
+			   BUILDID,
+#endif
 			   FAULT_HANDLING_CPUREG_COUNT } faultHandlingRegIndex;
+#endif
 
 #define FAULT_HANDLING_CALLSTACK_ENTRIES (4)
 
@@ -151,13 +263,83 @@ typedef enum { R7=0,
 #define FAULT_HANDLING_CALLSTACK_ROWSIZE (18)
 
 /*
-  The complete fault dump is then the cpu reg rows and the pushed LR
-  rows, plus a trailing NULL byte (making the dump a valid C string).
+  Optionally, the latest trace events follow (see
+  faultHandlingTrace.h), oldest first, a 'row' each:
+
+  id/4 + space/1 + arg/8 + eol/1
+*/
+#define FAULT_HANDLING_TRACE_ROWSIZE     (14)
+
+/*
+  Optionally (build lib and application with
+  -DFAULT_HANDLING_MEMORY_WINDOWS), memory 'windows' follow, each 4
+  words of memory as found at fault time: first around the stacked
+  pc, from 2 words below it, so the host can disassemble the faulting
+  instruction without the .bin, then (CM3/4 only) around MMFAR and
+  BFAR, from 1 word below, if CFSR says they are valid.  A 'row' each:
+
+  base/8 + space/1 + mask/1 + 4 * (space/1 + word/8) + eol/1
+
+  mask bit N set means word N was read.  Words that could not be
+  read without a further fault are 0, as are windows not captured
+  (base and mask 0 too).
+*/
+#if defined(FAULT_HANDLING_MEMORY_WINDOWS) && !defined(FAULT_HANDLING_HOST)
+#if (__CORTEX_M > 0)
+#define FAULT_HANDLING_WINDOWS           (3)
+#else
+#define FAULT_HANDLING_WINDOWS           (1)
+#endif
+#else
+#define FAULT_HANDLING_WINDOWS           (0)
+#endif
+
+#define FAULT_HANDLING_WINDOW_WORDS      (4)
+#define FAULT_HANDLING_WINDOW_ROWSIZE    (47)
+
+/*
+  Optionally, snapshots of application-registered regions follow
+  (see faultHandlingSetRegions), in the same row format as the memory
+  windows, up to 4 words a row.  Rows to reserve, override via e.g.
+  CPPFLAGS += -DFAULT_HANDLING_REGION_ROWS=4, for BOTH lib and
+  application builds.
+*/
+#ifndef FAULT_HANDLING_REGION_ROWS
+#define FAULT_HANDLING_REGION_ROWS       (0)
+#endif
+
+/*
+  The complete fault dump is then the cpu reg rows, the pushed LR
+  rows, any trace rows, memory windows and region rows, plus a
+  trailing NULL byte (making the dump a valid C string).
 */
 #define FAULT_HANDLING_DUMP_SIZE (FAULT_HANDLING_CPUREG_COUNT*\
 								  FAULT_HANDLING_CPUREG_ROWSIZE+\
 								  FAULT_HANDLING_CALLSTACK_ENTRIES*\
-								  FAULT_HANDLING_CALLSTACK_ROWSIZE+1)
+								  FAULT_HANDLING_CALLSTACK_ROWSIZE+\
+								  FAULT_HANDLING_TRACE_DUMP_ENTRIES*\
+								  FAULT_HANDLING_TRACE_ROWSIZE+\
+								  (FAULT_HANDLING_WINDOWS+\
+								   FAULT_HANDLING_REGION_ROWS)*\
+								  FAULT_HANDLING_WINDOW_ROWSIZE+1)
+
+/*
+  Count of hex values in the dump: one per cpu reg row, two per call
+  stack (and trace) row, base, mask and words per memory window (and
+  region row).  A
+  dump compressed by faultHandlingCompressDump (below) will fit a
+  buffer of FAULT_HANDLING_COMPRESSED_DUMP_SIZE bytes, though is
+  typically 1/4 the size of the text dump.
+*/
+#define FAULT_HANDLING_DUMP_VALUES (FAULT_HANDLING_CPUREG_COUNT+\
+									2*FAULT_HANDLING_CALLSTACK_ENTRIES+\
+									2*FAULT_HANDLING_TRACE_DUMP_ENTRIES+\
+									(FAULT_HANDLING_WINDOWS+\
+									 FAULT_HANDLING_REGION_ROWS)*\
+									(2+FAULT_HANDLING_WINDOW_WORDS))
+
+#define FAULT_HANDLING_COMPRESSED_DUMP_SIZE \
+  FAULT_HANDLING_COMPRESS_SIZE(FAULT_HANDLING_DUMP_VALUES)
 
 typedef void(*faultHandlingDumpProcessor)(void);
 
@@ -211,6 +393,327 @@ void faultHandlingSetCallStackParameters( uint32_t* textLo,
  */
 void faultHandlingSetPostFaultAction( faultHandlingPostFaultAction );
 
+/**
+ * Set the recovery point for POSTHANDLER_RECOVER, a setjmp-like
+ * alternative to a reboot, e.g.
+ *
+ * static jmp_buf mainLoop;
+ *
+ * faultHandlingSetPostFaultAction( POSTHANDLER_RECOVER );
+ * faultHandlingSetRecoveryPoint( &mainLoop );
+ * while( 1 ) {
+ *   if( setjmp( mainLoop ) ) {
+ *     ... we faulted, dump already captured, re-init sensor, etc ...
+ *   }
+ *   pollSensors();
+ * }
+ *
+ * After the dump is processed, the stacked pc/xPSR are rewritten so
+ * that exception return lands, in Thread mode, in a routine which
+ * longjmps to @p env. Only Thread mode faults are recoverable, and
+ * not those that occurred while stacking/unstacking (i.e. a bad sp).
+ * The setjmp'ing function must still be active, as for any longjmp.
+ *
+ * Under an RTOS, keep one jmp_buf per thread and update the recovery
+ * point on each context switch.  Pass NULL to clear.
+ */
+void faultHandlingSetRecoveryPoint( jmp_buf* env );
+
+/**
+ * Multi-core parts: also publish each (non-repeat) dump into a log in
+ * RAM shared by all cores, tagged with @p core, see
+ * faultHandlingShared.h.  Each core calls this with its own id; one
+ * core calls faultHandlingSharedInit first.
+ *
+ * @param notify - optional, called after a fault (not a hang) is
+ * dumped, to interrupt the other core(s), e.g. via an IPC mailbox or
+ * SEV.  The other core's IPC handler can branch to HangHandler to
+ * capture its own state too.
+ *
+ * @return 0, or -1 if this build's FAULT_HANDLING_DUMP_SIZE exceeds
+ * FAULT_HANDLING_SHARED_DUMP_SIZE, when no log is used.  Raise the
+ * latter, for ALL cores, e.g. with full registers or memory windows.
+ */
+int faultHandlingSetSharedLog( faultHandlingSharedLog* log, uint32_t core,
+							   void (*notify)(void) );
+
+/**
+ * Safe memory probes: read/write a word at an address that may not
+ * exist (an optional peripheral, external memory not fitted), getting
+ * an error code back instead of a fault dump and a reboot.
+ *
+ * On CM3/4, the access is made with FAULTMASK set and SCB->CCR
+ * BFHFNMIGN set, so a bus error is ignored by the cpu and just
+ * recorded in the BFSR, no exception occurs at all.  On CM0/0+, the
+ * access faults as normal, but our FaultHandler sees a probe is in
+ * progress, skips the faulting instruction and returns, WITHOUT any
+ * dump being produced.
+ *
+ * Any stale BusFault status (BFSR) is cleared by a CM3/4 probe.  The
+ * MPU, if active in HardFault (HFNMIENA), is not applied to the
+ * probe's access.  On CM0/0+, interrupts are masked for the access.
+ * An @p addr not word-aligned is refused, with no access made.
+ *
+ * @return FAULT_HANDLING_PROBE_OK, with @p out filled in on a read,
+ * or FAULT_HANDLING_PROBE_FAULT.
+ */
+#define FAULT_HANDLING_PROBE_OK    (0)
+#define FAULT_HANDLING_PROBE_FAULT (-1)
+
+int faultHandlingProbeRead32( uint32_t addr, uint32_t* out );
+
+int faultHandlingProbeWrite32( uint32_t addr, uint32_t value );
+
+/**
+ * Peripheral (or any) register snapshots: the state of a DMA
+ * channel, a USART's error flags, as at the fault.  The application
+ * supplies a table of regions, which can (should) be const, so costs
+ * no RAM:
+ *
+ * static const faultHandlingRegion regions[] = {
+ *   { (uint32_t)&DMA->CHENS, 1 },
+ *   { (uint32_t)&USART1->STATUS, 4 },
+ * };
+ * faultHandlingSetRegions( regions, 2 );
+ *
+ * At fault time each region's words are copied into the dump's
+ * region rows, see FAULT_HANDLING_REGION_ROWS, a region taking
+ * words/4 rows, rounded up.  Rows not needed are zeros.
+ *
+ * Every word is probed (see faultHandlingProbeRead32) here, so a
+ * table with a bad address is refused at init, not at fault time.
+ * Beware registers with read side effects, e.g. a receive FIFO.  On
+ * CM3/4 each word is probed again at fault time.  On CM0/0+ a fault
+ * then is lockup, so the init-time probe is all we can do.  Region
+ * addresses must be word-aligned.
+ *
+ * @return 0, or -1 if a word is unreadable or the regions need more
+ * than FAULT_HANDLING_REGION_ROWS rows, when none are captured.
+ */
+typedef struct {
+  uint32_t addr;
+  uint32_t words;	// 32-bit reads, as peripheral registers expect
+} faultHandlingRegion;
+
+int faultHandlingSetRegions( const faultHandlingRegion* regions,
+							 int count );
+
+/**
+ * Stack high-water marks, so stacks can be sized from (fleet) data,
+ * not guesswork.  Register each stack, main and any thread stacks:
+ *
+ * extern uint32_t __StackLimit;
+ * faultHandlingStackRegister( &__StackLimit, NULL );
+ *
+ * static uint32_t radioStack[256];
+ * faultHandlingStackRegister( radioStack, radioStack + 256 );
+ *
+ * The region is painted with FAULT_HANDLING_STACK_PAINT, bar any part
+ * in use: if the current sp is within [bottom,top), only below sp is
+ * painted.  So register thread stacks BEFORE the RTOS initialises
+ * them, e.g. before osThreadNew.
+ *
+ * @param top - NULL for the main stack top, as given to
+ * faultHandlingSetCallStackParameters.
+ *
+ * @return stack id, for faultHandlingStackFree, or -1 if all
+ * FAULT_HANDLING_STACKS slots are taken.
+ *
+ * Build lib and application with -DFAULT_HANDLING_STACK_WATERMARK and
+ * the dump gains an 'sfree' row: the least free space of any
+ * registered stack, in bytes.
+ */
+#ifndef FAULT_HANDLING_STACKS
+#define FAULT_HANDLING_STACKS (4)
+#endif
+
+#define FAULT_HANDLING_STACK_PAINT (0x57AC57AC)
+
+int faultHandlingStackRegister( uint32_t* bottom, uint32_t* top );
+
+/**
+ * Bytes of stack @p id never used since registered, i.e. still
+ * painted.  A binary search over the painted region, so cheap enough
+ * for a fault handler or a periodic health report.  It assumes use is
+ * contiguous from the top: a large, never-written local array deep in
+ * the stack makes the figure optimistic.
+ *
+ * @return free bytes, or 0 for an unknown id.
+ */
+uint32_t faultHandlingStackFree( int id );
+
+/**
+ * Least free space, in bytes, over all registered stacks.  0xFFFFFFFF
+ * if none registered.
+ */
+uint32_t faultHandlingStackMinFree(void);
+
+/**
+ * Guard a registered stack (see faultHandlingStackRegister) with a
+ * no-access MPU region over its lowest (32-byte aligned) 32 bytes,
+ * so that an overflow traps at once, rather than silently corrupting
+ * whatever lies below.  The dump then says so directly: its sp row
+ * is labelled 'ovf.N', N being the stack id.  The guard is dropped
+ * once hit.
+ *
+ * faultHandlingStackRegister( &__StackLimit, NULL );	// id 0
+ * faultHandlingStackGuard( 0, 7 );
+ *
+ * The MPU is enabled if not already, with PRIVDEFENA (the default
+ * memory map applies outside any region) and WITHOUT HFNMIENA, so
+ * that the fault handler runs MPU-free, even on an overflowed main
+ * stack.  Keep the fault as a HardFault, i.e. no MemManage_Handler, if
+ * guarding the main stack.
+ *
+ * Under an RTOS, threads can share one region: call this from the
+ * context-switch hook, with the incoming thread's stack id, and the
+ * region moves to that stack.
+ *
+ * A single large local array may overflow straight past a guard.
+ *
+ * CM3/4 with MPU only.
+ *
+ * @return 0, or -1 if no MPU, bad id/region or stack too small.
+ */
+int faultHandlingStackGuard( int id, uint32_t region );
+
+/**
+ * Compress the current fault dump, see faultHandlingCompress.h.  For
+ * use by a dump processor when bandwidth is dear, e.g.
+ *
+ * static uint8_t packed[FAULT_HANDLING_COMPRESSED_DUMP_SIZE];
+ *
+ * void iridiumDumpProcessor(void) {
+ *   int len = faultHandlingCompressDump( packed, sizeof packed );
+ *   ...
+ * }
+ *
+ * Values are encoded relative to the text start and main stack top
+ * given to faultHandlingSetCallStackParameters, and the fault-time sp.
+ *
+ * @return length of the compressed dump, or -1 if @p len too small.
+ */
+int faultHandlingCompressDump( uint8_t* buf, int len );
+
+/**
+ * Install a fault history, see faultHandlingHistory.h.  Call once,
+ * early in main, since this also counts the boot.  With a history
+ * installed, a fault whose signature was seen before (this boot or
+ * an earlier one) is counted in the history and NOT passed to the
+ * dump processor. The post-fault action is taken as usual.
+ */
+void faultHandlingSetHistory( faultHandlingHistory* history );
+
+/**
+ * Replace the fixed post-fault action with an escalation policy,
+ * driven by the fault rate recorded in the history (so
+ * faultHandlingSetHistory is a pre-requisite), e.g.
+ *
+ * static const faultHandlingEscalation policy[] = {
+ *   { 1, POSTHANDLER_RESET },
+ *   { 3, POSTHANDLER_SAFEMODE },
+ *   { 6, POSTHANDLER_SLEEP } };
+ *
+ * faultHandlingSetEscalationPolicy( policy, 3, enterSafeMode );
+ *
+ * Below policy[0].faults, the faultHandlingSetPostFaultAction action
+ * applies.  If the previous boot ended in POSTHANDLER_SAFEMODE,
+ * @p safeModeEntry is called, once, from right here.
+ */
+void faultHandlingSetEscalationPolicy( const faultHandlingEscalation* policy,
+									   int levels,
+									   void (*safeModeEntry)(void) );
+
+/**
+ * Current escalation level: 0 for no fault storm, else N, meaning
+ * policy[N-1] was reached.  Valid from faultHandlingSetHistory onwards.
+ */
+uint32_t faultHandlingEscalationLevel(void);
+
+/**
+ * Build identity, so a dump says which firmware produced it.  Build
+ * lib and application with -DFAULT_HANDLING_BUILD_ID (make
+ * BUILD_ID=1) and the lib holds a faultHandlingBuildIdentity in
+ * flash, its id zero as compiled.  After linking, the Makefile's %.bin
+ * rule runs the host tool buildIdStamp, which hashes the .bin and
+ * writes the hash into the id, in both .bin and .axf.  Every dump then
+ * carries the low 32 bits, as its 'build' row, and faultGuru -E picks
+ * the matching .axf by that alone.
+ */
+#define FAULT_HANDLING_BUILD_ID_MAGIC "FHBUILD#"
+
+typedef struct {
+  char magic[8];	// FAULT_HANDLING_BUILD_ID_MAGIC, no NUL
+  uint32_t id[2];	// 64-bit hash of the .bin, low word first
+} faultHandlingBuildIdentity;
+
+/**
+ * @return low 32 bits of the stamped build id, 0 if the build was not
+ * stamped, or not built with FAULT_HANDLING_BUILD_ID.
+ */
+uint32_t faultHandlingBuildId(void);
+
+/**
+ * A statistical (sampling) profiler, built on the fault handler's
+ * frame location and call stack search.  A periodic interrupt, e.g.
+ * SysTick, vectors to our ProfileHandler (just as HardFault_Handler
+ * vectors to FaultHandler):
+ *
+ * __attribute__((naked))
+ * void SysTick_Handler(void) {
+ *   __asm__( "B ProfileHandler\n" );
+ * }
+ *
+ * static uint32_t samples[256*FAULT_HANDLING_PROFILE_RECORD];
+ *
+ * faultHandlingSetProfileBuffer( samples, 256 );
+ * SysTick_Config( SystemCoreClock / 1000 );
+ *
+ * Each sample is FAULT_HANDLING_PROFILE_RECORD words: interrupted pc,
+ * interrupted lr, then FAULT_HANDLING_PROFILE_DEPTH pushed LRs (0 if
+ * not found).  The buffer is a ring, holding the latest @p samples.
+ * Call stack parameters must be set, see
+ * faultHandlingSetCallStackParameters, else only pc, lr are recorded.
+ *
+ * See profileReport.c, which turns samples plus a .map file into flat
+ * and caller/callee profiles.
+ *
+ * Pass NULL to stop sampling.  The handler then just returns, so
+ * stop the SysTick too.  Stopping leaves the sample count and cycle
+ * total as they were, a new buffer resets them.
+ */
+#ifndef FAULT_HANDLING_PROFILE_DEPTH
+#define FAULT_HANDLING_PROFILE_DEPTH (2)
+#endif
+
+/*
+  Bound on the stack words searched for pushed LRs, per sample.
+  Keeps sample cost, so power, small and fixed.
+*/
+#ifndef FAULT_HANDLING_PROFILE_SCAN
+#define FAULT_HANDLING_PROFILE_SCAN (32)
+#endif
+
+#define FAULT_HANDLING_PROFILE_RECORD (2+FAULT_HANDLING_PROFILE_DEPTH)
+
+void faultHandlingSetProfileBuffer( uint32_t* buf, int samples );
+
+/**
+ * Samples taken since a buffer was last set.  Once beyond the
+ * buffer's capacity, the oldest have been overwritten.
+ */
+uint32_t faultHandlingProfileCount(void);
+
+/**
+ * Total cpu cycles spent in ProfileHandler_C (DWT CYCCNT), so
+ * overhead per sample is this over faultHandlingProfileCount.
+ * Excludes exception entry/exit, approx 24 cycles more. CM3/4 only,
+ * always 0 on CM0/0+.
+ */
+uint32_t faultHandlingProfileCycles(void);
+
+void ProfileHandler(void);
+
 /**
    Needed by application fault handlers (asm), e.g.
 
@@ -225,6 +728,39 @@ It MUST be a simple branch (B), i.e. a jump, and NOT a branch+link
 
 void FaultHandler(void);
 
+/**
+ * Hangs, as opposed to faults: any interrupt handler can vector to
+ * HangHandler, just as HardFault_Handler vectors to FaultHandler, and
+ * the interrupted context is captured, dumped and post-processed as
+ * for a fault.  The dump's psr row is labelled 'hang ', its IPSR
+ * being the interrupt that caught the hang, e.g. a watchdog early
+ * warning:
+
+__attribute__((naked))
+void WDOG_IRQHandler(void) {
+  __asm__( "B HangHandler\n" );
+}
+
+ * or a liveness check, branching only when a hang is detected (the
+ * check is a C function returning non-zero on hang):
+
+__attribute__((naked))
+void SysTick_Handler(void) {
+  __asm__( "PUSH {R0,LR}\n"
+		   "BL livenessCheck\n"
+		   "POP {R1,R2}\n"
+		   "MOV LR,R2\n"
+		   "CMP R0,#0\n"
+		   "BEQ 1f\n"
+		   "B HangHandler\n"
+		   "1: BX LR\n" );
+}
+
+ * As for faults, it MUST be a branch (B), so the handler's stack
+ * frame is the exception frame.
+ */
+void HangHandler(void);
+
 #endif
 
 // eof
@@ -0,0 +1,142 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#ifndef CORTEXM_FAULT_HANDLING_COMPRESS_H
+#define CORTEXM_FAULT_HANDLING_COMPRESS_H
+
+#include <stdint.h>
+
+/**
+ * @author Stuart Maclean
+ *
+ * Address-relative compression of a fault dump, for when even the
+ * 328-byte text dump is too dear (Iridium charges by the byte!).
+ *
+ * Most values in a dump sit close to one of a handful of known
+ * addresses: code addresses just above the start of .text, stack
+ * addresses just below the top of stack, SCB register addresses
+ * around E000ED00, or small integers near zero.  So we encode each
+ * value as a one-byte tag, naming the nearest such 'base', followed
+ * by the (zigzag) varint delta from that base. A value 2001FFD8,
+ * with stack top 20020000, then costs 3 bytes instead of 4 (binary)
+ * or 15 (text).
+ *
+ * The compressed form is:
+ *
+ * magic/1 count/varint textStart/varint stackTop/varint sp/zvarint
+ * kind/varint then count * ( tag/1 delta/zvarint ) then checksum/1
+ *
+ * where sp is itself encoded relative to stackTop, and the checksum
+ * makes the byte sum of the whole encoding zero (mod 256).  Labels
+ * are not values, so any that say something about the dump (a hang's
+ * 'hang ' in place of 'psr  ', a stack overflow's 'ovf.N' in place of
+ * 'sp   ') are kept as the kind, a value.
+ *
+ * The host decoders (dumpCompress, dumpParse, so faultGuru and
+ * dumpIngest) link the same faultHandlingCompress.c the target does,
+ * so cannot disagree with it over the format.
+ */
+
+#define FAULT_HANDLING_COMPRESS_MAGIC (0xFD)
+
+/*
+  The bases a value may be encoded against, the tag byte is one of
+  these.
+*/
+typedef enum { FAULT_HANDLING_BASE_ZERO = 0,
+			   FAULT_HANDLING_BASE_TEXT,
+			   FAULT_HANDLING_BASE_STACKTOP,
+			   FAULT_HANDLING_BASE_SP,
+			   FAULT_HANDLING_BASE_SCB,
+			   FAULT_HANDLING_BASE_COUNT } faultHandlingCompressBase;
+
+#define FAULT_HANDLING_SCB_BASE (0xE000ED00)
+
+/*
+  The kind of dump, as its labels say: a hang, see HangHandler_C,
+  and/or a stack overflow, into the guard region of stack N, bits
+  7..4, see faultHandlingStackGuard.
+*/
+#define FAULT_HANDLING_KIND_HANG     (1 << 0)
+#define FAULT_HANDLING_KIND_OVERFLOW (1 << 1)
+#define FAULT_HANDLING_KIND_STACK(kind) (((kind) >> 4) & 0xf)
+
+typedef struct {
+  uint32_t textStart;
+  uint32_t stackTop;
+  uint32_t sp;
+  /*
+	Not a base, and not read by faultHandlingCompress, which takes
+	the kind from the dump's labels. Set by faultHandlingDecompress.
+  */
+  uint32_t kind;
+} faultHandlingCompressBases;
+
+/*
+  Worst case size of a compressed dump of N values: every varint at
+  its 5-byte maximum.  Useful for sizing a buffer, e.g.
+
+  uint8_t buf[FAULT_HANDLING_COMPRESS_SIZE(FAULT_HANDLING_DUMP_VALUES)];
+*/
+#define FAULT_HANDLING_COMPRESS_SIZE(N) (1 + 5 + 4*5 + (N)*(1+5) + 1)
+
+/**
+ * Compress a text fault dump.  Every whitespace-separated token made
+ * up solely of (upper-case) hex digits is a value, so labels ('r7',
+ * 's.psr', etc) are skipped, bar setting the kind.  Values are
+ * encoded in dump order.
+ *
+ * @return length of the encoding in @p out, or -1 if @p outLen too small.
+ */
+int faultHandlingCompress( const char* dump,
+						   const faultHandlingCompressBases* bases,
+						   uint8_t* out, int outLen );
+
+/**
+ * Restore the values of a compressed dump, in dump order.
+ *
+ * @param bases - if non-NULL, receives the bases used by the encoder,
+ * and the dump's kind.
+ *
+ * @return count of values restored, or -1 if @p in is not a valid
+ * encoding (bad magic, truncated, checksum mismatch) or @p maxValues
+ * too small.
+ */
+int faultHandlingDecompress( const uint8_t* in, int inLen,
+							 faultHandlingCompressBases* bases,
+							 uint32_t* values, int maxValues );
+
+#endif
+
+// eof
@@ -0,0 +1,119 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#ifndef CORTEXM_FAULT_HANDLING_EXPORT_H
+#define CORTEXM_FAULT_HANDLING_EXPORT_H
+
+#include <stdint.h>
+
+#include CMSIS_device_header
+
+/**
+ * @author Stuart Maclean
+ *
+ * Ready-made, fast, fault dump exporters for bench/lab units with a
+ * debug probe attached: ITM stimulus ports (SWO) and a SEGGER-RTT
+ * compatible RAM ring.  Either gets a dump off the cpu in
+ * microseconds, against ~30ms for 328 bytes over a 115200 baud uart.
+ *
+ * A dump processor just hands them the dump buffer:
+ *
+ * void swoDumpProcessor(void) {
+ *   faultHandlingITMWrite( 0, faultDumpBuffer );
+ * }
+ *
+ * void rttDumpProcessor(void) {
+ *   faultHandlingRTTWrite( &rtt, faultDumpBuffer );
+ * }
+ *
+ * See swoTest.c, rttTest.c, and exportTest.c which tests both on the
+ * host, against mock ITM registers and a mock RTT probe.
+ */
+
+/**
+ * Write @p s to ITM stimulus port @p port, a word at a time where
+ * possible, waiting on the port FIFO.  ITM/SWO setup (TPIU, pins,
+ * trace clock) is the application's job.  CM3/4 only, there is no
+ * ITM on CM0/0+.
+ *
+ * @return 0, or -1 if the ITM or the port is not enabled (nothing
+ * listening), in which case nothing is written, rather than waiting
+ * forever.
+ */
+int faultHandlingITMWrite( uint32_t port, const char* s );
+
+/*
+  SEGGER RTT control block, the layout a J-Link (or OpenOCD, pyOCD,
+  probe-rs) searches target RAM for, with one up (target to host)
+  buffer and no down buffers.  Our own definition, NOT SEGGER's code,
+  kept to what a fault handler needs.
+*/
+#define FAULT_HANDLING_RTT_NO_BLOCK_SKIP (0)
+#define FAULT_HANDLING_RTT_NO_BLOCK_TRIM (1)
+#define FAULT_HANDLING_RTT_BLOCK         (2)
+
+typedef struct {
+  const char* name;
+  char* buffer;
+  uint32_t size;
+  volatile uint32_t wrOff;	// written by target
+  volatile uint32_t rdOff;	// written by host
+  uint32_t flags;
+} faultHandlingRTTBuffer;
+
+typedef struct {
+  char id[16];				// "SEGGER RTT", written LAST at init
+  int32_t maxUpBuffers;
+  int32_t maxDownBuffers;
+  faultHandlingRTTBuffer up[1];
+} faultHandlingRTT;
+
+/**
+ * Set up the control block, with @p buffer as up buffer 0, in mode
+ * @p flags, one of FAULT_HANDLING_RTT_*.  BLOCK waits for the host
+ * to drain the ring, so never loses data, but waits forever with no
+ * probe attached. NO_BLOCK_TRIM writes what fits.
+ */
+void faultHandlingRTTInit( faultHandlingRTT* rtt, char* buffer, uint32_t size,
+						   uint32_t flags );
+
+/**
+ * @return count of bytes written, which is strlen( s ) unless the
+ * ring filled in a non-blocking mode.
+ */
+int faultHandlingRTTWrite( faultHandlingRTT* rtt, const char* s );
+
+#endif
+
+// eof
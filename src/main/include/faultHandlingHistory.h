@@ -0,0 +1,180 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#ifndef CORTEXM_FAULT_HANDLING_HISTORY_H
+#define CORTEXM_FAULT_HANDLING_HISTORY_H
+
+#include <stdint.h>
+
+/**
+ * @author Stuart Maclean
+ *
+ * A fault history, surviving reboots, so that a unit stuck in a
+ * fault/reboot loop does not fill every storage slot, and every
+ * Iridium message, with the same dump over and over.
+ *
+ * Each fault is reduced to a small 'signature', a hash over stacked
+ * pc, stacked lr, cfsr (CM3/4) and the first pushed LRs of the call
+ * stack.  The history holds a table of signatures seen, with counts
+ * and first/last boot numbers.  A fault whose signature is already in
+ * the table just bumps its count: the dump processor is NOT called.
+ * The application can walk the table at any time, e.g. to send a
+ * summary of repeats home.
+ *
+ * The history also tracks the fault RATE, as faults per window of
+ * FAULT_HANDLING_STORM_WINDOW boots.  Given an escalation policy, a
+ * table of increasing fault counts and the post-fault action to take
+ * once each is reached, a fault storm (e.g. a deterministic
+ * early-boot fault with POSTHANDLER_RESET, rebooting thousands of
+ * times and draining the battery) escalates through that policy,
+ * e.g. reset, then reset into a safe mode, then sleep forever.  A
+ * full window of boots without a fault drops back to level 0.
+ *
+ * The history is application-supplied, like the dump buffer, and
+ * must live in RAM NOT zeroed by the startup code, e.g.
+ *
+ * static faultHandlingHistory history __attribute__((section(".noinit")));
+ *
+ * faultHandlingSetHistory( &history );
+ *
+ * Signatures are an FNV-1a hash of the key values, nothing
+ * target-specific, so a host tool holding a received dump can
+ * compute the same one, and stormSim and historyTest replay fault
+ * sequences against faultHandlingHistory.c itself.
+ */
+
+/*
+  Table size, override via e.g. CPPFLAGS += -DFAULT_HANDLING_SIGNATURES=8,
+  for BOTH lib and application builds.
+*/
+#ifndef FAULT_HANDLING_SIGNATURES
+#define FAULT_HANDLING_SIGNATURES (4)
+#endif
+
+// How many call stack entries (pushed LR values) go into a signature
+#define FAULT_HANDLING_SIGNATURE_FRAMES (2)
+
+// Fault rate is measured over this many boots, override as above
+#ifndef FAULT_HANDLING_STORM_WINDOW
+#define FAULT_HANDLING_STORM_WINDOW (10)
+#endif
+
+typedef struct {
+  uint32_t signature;
+  uint32_t count;
+  uint32_t firstBoot;
+  uint32_t lastBoot;
+} faultHandlingSignature;
+
+/*
+  One level of an escalation policy: once 'faults' faults occur within
+  the current window, take 'action' (a faultHandlingPostFaultAction,
+  see faultHandling.h).  Levels must be in increasing 'faults' order.
+*/
+typedef struct {
+  uint32_t faults;
+  uint32_t action;
+} faultHandlingEscalation;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t boots;
+  uint32_t bootsCheck;   // ~boots, a second opinion on validity
+  faultHandlingSignature signatures[FAULT_HANDLING_SIGNATURES];
+
+  // Fault storm tracking
+  uint32_t windowStart;  // boot number at which current window opened
+  uint32_t windowFaults;
+  uint32_t lastFault;    // boot number of most recent fault
+  uint32_t level;        // 0 = no storm, N = policy[N-1] reached
+  uint32_t safeMode;     // set if last fault asked for a safe-mode boot
+} faultHandlingHistory;
+
+/**
+ * Validate the history (after a power-on, RAM contents are junk, so
+ * the history is cleared) and count this boot.  Call ONCE per boot,
+ * faultHandlingSetHistory does this for you.  If more than a storm
+ * window of boots has passed since the last fault, the escalation
+ * level drops to 0.
+ */
+void faultHandlingHistoryBoot( faultHandlingHistory* h );
+
+/**
+ * FNV-1a hash over @p n values, never 0 (0 marks an unused table slot).
+ */
+uint32_t faultHandlingSignatureOf( const uint32_t* values, int n );
+
+/**
+ * Record an occurrence of @p signature in the current boot.
+ *
+ * A new signature takes an unused slot or, with the table full, the
+ * slot least recently seen (lowest lastBoot, then lowest count).
+ *
+ * @return occurrence count, so 1 means a new signature, >1 a repeat.
+ */
+uint32_t faultHandlingHistoryRecord( faultHandlingHistory* h,
+									 uint32_t signature );
+
+/**
+ * Count a fault against the current storm window, and re-evaluate
+ * the escalation level against @p policy.
+ *
+ * @return the new level, 0 if below policy[0].faults, else N, meaning
+ * policy[N-1].action is what to do now.
+ */
+uint32_t faultHandlingHistoryStorm( faultHandlingHistory* h,
+									const faultHandlingEscalation* policy,
+									int levels );
+
+/**
+ * The post-fault action for a fault just taken: count it against the
+ * storm window (see faultHandlingHistoryStorm) and, once at level N,
+ * return policy[N-1].action, else @p action, the configured one.
+ * With no @p policy, nothing is counted and @p action is returned.
+ * The fault handler uses this, and so stormSim, so a policy tried on
+ * the host behaves as it will on the target.
+ */
+uint32_t faultHandlingHistoryEscalate( faultHandlingHistory* h,
+									   const faultHandlingEscalation* policy,
+									   int levels, uint32_t action );
+
+/**
+ * Did the previous boot end in a safe-mode reset?  Clears the flag,
+ * so answers yes just once.
+ */
+int faultHandlingHistorySafeMode( faultHandlingHistory* h );
+
+#endif
+
+// eof
@@ -0,0 +1,150 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#ifndef CORTEXM_FAULT_HANDLING_SHARED_H
+#define CORTEXM_FAULT_HANDLING_SHARED_H
+
+#include <stdint.h>
+
+/**
+ * @author Stuart Maclean
+ *
+ * Fault dumps from several cores (dual-core M4+M0+, M7+M4 parts) into
+ * one log in RAM shared by all cores.  Each core runs its own image,
+ * with its own faultHandling config, and names itself with a core id
+ * (vendor-specific, e.g. from a CPUID/IPC register):
+ *
+ * faultHandlingSetSharedLog( &sharedLog, coreId, notifyOtherCore );
+ *
+ * The log is a table of slots. A faulting core claims a FREE slot
+ * without locks: a compare-and-swap on the slot state, which is
+ * LDREX/STREX on ARMv7-M (and any host).  ARMv6-M (CM0/0+) has no
+ * exclusives, so instead the log is 'partitioned': a core only ever
+ * claims its own slots, those whose index modulo
+ * FAULT_HANDLING_SHARED_CORES is its core id, needing no cross-core
+ * atomics at all.  A part with ANY ARMv6-M core must build ALL cores
+ * with -DFAULT_HANDLING_SHARED_PARTITIONED=1.  The dump, core id and a
+ * sequence number are written, then the slot is published as READY.
+ *
+ * Any core (typically after the reboot) walks the READY slots, oldest
+ * first, ships them home and releases them.
+ *
+ * The log must live in RAM shared by all cores, not zeroed by any
+ * core's startup code, and be the SAME layout for all, hence a fixed
+ * slot dump size, whatever each core's own FAULT_HANDLING_DUMP_SIZE.
+ *
+ * The core id is the slot's, the dump text does not hold it: a
+ * reader wanting it must take it from the slot, with the dump.
+ *
+ * Claim and publish use gcc __atomic builtins, not CMSIS intrinsics,
+ * so sharedStress.c runs this very code on the host, threads playing
+ * cores.
+ */
+
+#ifndef FAULT_HANDLING_SHARED_SLOTS
+#define FAULT_HANDLING_SHARED_SLOTS (4)
+#endif
+
+#ifndef FAULT_HANDLING_SHARED_CORES
+#define FAULT_HANDLING_SHARED_CORES (2)
+#endif
+
+#ifndef FAULT_HANDLING_SHARED_PARTITIONED
+#if defined(__ARM_ARCH_6M__)
+#define FAULT_HANDLING_SHARED_PARTITIONED (1)
+#else
+#define FAULT_HANDLING_SHARED_PARTITIONED (0)
+#endif
+#endif
+
+#if defined(__ARM_ARCH_6M__) && !FAULT_HANDLING_SHARED_PARTITIONED
+#error ARMv6-M has no exclusives, FAULT_HANDLING_SHARED_PARTITIONED needed
+#endif
+
+/*
+  Must hold the largest core's dump, e.g. CM4 with trace rows, see
+  faultHandlingSetSharedLog, which checks.  Same for ALL cores.
+*/
+#ifndef FAULT_HANDLING_SHARED_DUMP_SIZE
+#define FAULT_HANDLING_SHARED_DUMP_SIZE (512)
+#endif
+
+typedef enum { FAULT_HANDLING_SLOT_FREE = 0,
+			   FAULT_HANDLING_SLOT_CLAIMED,
+			   FAULT_HANDLING_SLOT_READY } faultHandlingSlotState;
+
+typedef struct {
+  volatile uint32_t state;
+  uint32_t core;
+  uint32_t sequence;
+  char dump[FAULT_HANDLING_SHARED_DUMP_SIZE];
+} faultHandlingSharedSlot;
+
+typedef struct {
+  uint32_t magic;
+  volatile uint32_t sequence;
+  faultHandlingSharedSlot slots[FAULT_HANDLING_SHARED_SLOTS];
+} faultHandlingSharedLog;
+
+/**
+ * Validate the log, clearing it if junk (power-on). Call from ONE
+ * core only, at boot, before the others start.
+ */
+void faultHandlingSharedInit( faultHandlingSharedLog* log );
+
+/**
+ * Claim a free slot and publish @p dump in it, tagged with @p core.
+ * Safe to call from all cores at once.
+ *
+ * @return slot index, or -1 if no free slot (for this core), or if
+ * @p dump, with its NUL, exceeds FAULT_HANDLING_SHARED_DUMP_SIZE.
+ */
+int faultHandlingSharedPut( faultHandlingSharedLog* log, uint32_t core,
+							const char* dump );
+
+/**
+ * @return index of the oldest READY slot, or -1 if none.  If cores
+ * are still publishing, a slot published mid-scan may be missed, so
+ * 'oldest' is only exact once all cores are quiet, e.g. after reboot.
+ */
+int faultHandlingSharedOldest( faultHandlingSharedLog* log );
+
+/**
+ * Free a slot, once its dump has been read/shipped.
+ */
+void faultHandlingSharedRelease( faultHandlingSharedLog* log, int slot );
+
+#endif
+
+// eof
@@ -0,0 +1,184 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#ifndef CORTEXM_FAULT_HANDLING_TRACE_H
+#define CORTEXM_FAULT_HANDLING_TRACE_H
+
+#include <stdint.h>
+
+#ifndef FAULT_HANDLING_HOST
+#include CMSIS_device_header
+#endif
+
+/**
+ * @author Stuart Maclean
+ *
+ * A 'flight recorder': a ring of small event records, logged by the
+ * application as it runs, the last few of which are appended to the
+ * fault dump.  A register snapshot tells us where we died, the trace
+ * tells us how we got there.
+ *
+ * FAULT_HANDLING_TRACE( EVT_RADIO_TX, length );
+ *
+ * An event is a 16-bit id plus a 32-bit argument (and optionally a
+ * DWT cycle count timestamp, CM3/4 only).  Logging is inline, safe
+ * from any context (thread, interrupt, fault), with no locks: the
+ * slot is claimed by an LDREX/STREX increment of the ring head on
+ * CM3/4, and with interrupts briefly masked on CM0/0+, which has no
+ * exclusive access instructions. Expect a handful of cycles per
+ * event, traceBench.c measures it.  On a Linux host
+ * (FAULT_HANDLING_HOST), an atomic increment, from any thread or
+ * signal handler, see traceBenchHost.c.  Ids are 16 bits, higher bits
+ * are dropped, as the dump row has room for just 4 hex digits.
+ *
+ * The ring lives in .noinit RAM, so survives a reset: after a
+ * watchdog reboot, the application can still read what happened
+ * before it.  faultHandlingTraceInit validates the ring, clearing it
+ * only if it is junk (power-on).  Logging before, or even without,
+ * faultHandlingTraceInit is harmless.
+ *
+ * All sizes are compile-time, override via e.g.
+ * CPPFLAGS += -DFAULT_HANDLING_TRACE_DUMP_ENTRIES=4, for BOTH lib and
+ * application builds.
+ */
+
+// Ring size, a power of 2
+#ifndef FAULT_HANDLING_TRACE_ENTRIES
+#define FAULT_HANDLING_TRACE_ENTRIES (64)
+#endif
+
+#if (FAULT_HANDLING_TRACE_ENTRIES & (FAULT_HANDLING_TRACE_ENTRIES-1))
+#error FAULT_HANDLING_TRACE_ENTRIES must be a power of 2
+#endif
+
+/*
+  Latest events appended to the fault dump. Default 0, the dump is
+  unchanged (an Iridium SBD message has no room to spare).
+*/
+#ifndef FAULT_HANDLING_TRACE_DUMP_ENTRIES
+#define FAULT_HANDLING_TRACE_DUMP_ENTRIES (0)
+#endif
+
+#if (FAULT_HANDLING_TRACE_DUMP_ENTRIES > FAULT_HANDLING_TRACE_ENTRIES)
+#error FAULT_HANDLING_TRACE_DUMP_ENTRIES exceeds FAULT_HANDLING_TRACE_ENTRIES
+#endif
+
+// Timestamp each event with DWT CYCCNT, costs one more load and store
+#ifndef FAULT_HANDLING_TRACE_TIMESTAMP
+#define FAULT_HANDLING_TRACE_TIMESTAMP (0)
+#endif
+
+#if (FAULT_HANDLING_TRACE_TIMESTAMP && \
+	 (defined(FAULT_HANDLING_HOST) || __CORTEX_M == 0))
+#error FAULT_HANDLING_TRACE_TIMESTAMP needs a DWT cycle counter, CM3/4 only
+#endif
+
+// Where the ring goes, your linker script must have this section
+#ifndef FAULT_HANDLING_NOINIT
+#ifdef FAULT_HANDLING_HOST
+#define FAULT_HANDLING_NOINIT
+#else
+#define FAULT_HANDLING_NOINIT __attribute__((section(".noinit")))
+#endif
+#endif
+
+typedef struct {
+  uint16_t id;
+  uint16_t spare;
+  uint32_t arg;
+#if FAULT_HANDLING_TRACE_TIMESTAMP
+  uint32_t time;
+#endif
+} faultHandlingTraceEvent;
+
+typedef struct {
+  uint32_t magic;
+  volatile uint32_t head;		// count of events logged, never wraps the index
+  faultHandlingTraceEvent events[FAULT_HANDLING_TRACE_ENTRIES];
+} faultHandlingTraceRing;
+
+extern faultHandlingTraceRing faultHandlingTraceBuffer;
+
+/**
+ * Validate the ring, clearing it if junk. Call once, early in main.
+ * If there is no need to keep the trace across resets, use
+ * faultHandlingTraceClear instead.
+ */
+void faultHandlingTraceInit(void);
+
+void faultHandlingTraceClear(void);
+
+/**
+ * Copy out up to @p max of the latest events, oldest first, e.g. to
+ * report the trace leading up to a watchdog reset.
+ *
+ * @return count copied.
+ */
+int faultHandlingTraceLatest( faultHandlingTraceEvent* events, int max );
+
+static inline __attribute__((always_inline))
+void faultHandlingTraceLog( uint16_t id, uint32_t arg ) {
+
+  uint32_t slot;
+#if defined(FAULT_HANDLING_HOST)
+  slot = __atomic_fetch_add( &faultHandlingTraceBuffer.head, 1,
+							 __ATOMIC_RELAXED );
+#elif (__CORTEX_M > 0)
+  do {
+	slot = __LDREXW( &faultHandlingTraceBuffer.head );
+  } while( __STREXW( slot + 1, &faultHandlingTraceBuffer.head ) );
+#else
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  slot = faultHandlingTraceBuffer.head;
+  faultHandlingTraceBuffer.head = slot + 1;
+  __set_PRIMASK( primask );
+#endif
+
+  faultHandlingTraceEvent* e = faultHandlingTraceBuffer.events +
+	(slot & (FAULT_HANDLING_TRACE_ENTRIES-1));
+  e->id = id;
+  e->arg = arg;
+#if FAULT_HANDLING_TRACE_TIMESTAMP
+  e->time = DWT->CYCCNT;
+#endif
+}
+
+// Only the low 16 bits of id are logged
+#define FAULT_HANDLING_TRACE( id, arg ) \
+  faultHandlingTraceLog( (uint16_t)(id), (uint32_t)(arg) )
+
+#endif
+
+// eof
@@ -0,0 +1,196 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: stamp a firmware build with its build id, see
+ * faultHandlingBuildId in faultHandling.h.  Run by the Makefile's
+ * %.bin rule when BUILD_ID is set, after objcopy:
+ *
+ * $ ./buildIdStamp [-s storeDir] app.axf app.bin
+ *
+ * The id is a 64-bit FNV-1a hash of the .bin, taken with the id
+ * itself zeroed, so restamping gives the same id.  It is written into
+ * the faultHandlingBuildIdentity record, found by its magic, in both
+ * the .bin (what gets flashed) and the .axf (what gets debugged and
+ * symbolized).
+ *
+ * With -s, the stamped .axf is also copied to storeDir/XXXXXXXX.axf,
+ * XXXXXXXX being the id's low 32 bits, as a dump's 'build' row shows
+ * them.  faultGuru -E storeDir then opens exactly that file.
+ */
+
+// As faultHandling.h, which needs CMSIS, so we cannot include it
+#define MAGIC "FHBUILD#"
+#define MAGIC_LEN 8
+#define ID_LEN    8
+
+static uint8_t* readFile( const char* path, size_t* size ) {
+  FILE* fp = fopen( path, "rb" );
+  if( !fp ) {
+	perror( path );
+	return NULL;
+  }
+  fseek( fp, 0, SEEK_END );
+  long n = ftell( fp );
+  fseek( fp, 0, SEEK_SET );
+  uint8_t* buf = malloc( n > 0 ? (size_t)n : 1 );
+  if( n < 0 || fread( buf, 1, (size_t)n, fp ) != (size_t)n ) {
+	fprintf( stderr, "%s: cannot read\n", path );
+	free( buf );
+	buf = NULL;
+  }
+  fclose( fp );
+  *size = (size_t)n;
+  return buf;
+}
+
+static int writeFile( const char* path, const uint8_t* buf, size_t size ) {
+  FILE* fp = fopen( path, "wb" );
+  if( !fp || fwrite( buf, 1, size, fp ) != size || fclose( fp ) ) {
+	perror( path );
+	return -1;
+  }
+  return 0;
+}
+
+// Offset of the one and only record, else -1
+static long findRecord( const char* path, const uint8_t* buf, size_t size ) {
+  long found = -1;
+  for( size_t i = 0; i + MAGIC_LEN + ID_LEN <= size; i++ ) {
+	if( buf[i] != MAGIC[0] || memcmp( buf + i, MAGIC, MAGIC_LEN ) )
+	  continue;
+	if( found >= 0 ) {
+	  fprintf( stderr, "%s: build id record found twice\n", path );
+	  return -1;
+	}
+	found = (long)i;
+  }
+  if( found < 0 )
+	fprintf( stderr, "%s: no build id record, lib not built with "
+			 "FAULT_HANDLING_BUILD_ID?\n", path );
+  return found;
+}
+
+static uint64_t fnv1a64( const uint8_t* buf, size_t size ) {
+  uint64_t hash = 14695981039346656037ull;
+  for( size_t i = 0; i < size; i++ ) {
+	hash ^= buf[i];
+	hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+int main( int argc, char* argv[] ) {
+
+  const char* store = NULL;
+  int i = 1;
+  if( i+1 < argc && strcmp( argv[i], "-s" ) == 0 ) {
+	store = argv[i+1];
+	i += 2;
+  }
+  if( i != argc-2 ) {
+	fprintf( stderr, "Usage: %s [-s storeDir] app.axf app.bin\n",
+			 argv[0] );
+	return 1;
+  }
+  const char* axfPath = argv[i];
+  const char* binPath = argv[i+1];
+
+  size_t axfSize, binSize;
+  uint8_t* axf = readFile( axfPath, &axfSize );
+  uint8_t* bin = readFile( binPath, &binSize );
+  if( !axf || !bin )
+	return 1;
+  long axfAt = findRecord( axfPath, axf, axfSize );
+  long binAt = findRecord( binPath, bin, binSize );
+  if( axfAt < 0 || binAt < 0 )
+	return 1;
+
+  memset( bin + binAt + MAGIC_LEN, 0, ID_LEN );
+  uint64_t id = fnv1a64( bin, binSize );
+
+  // Little-endian, as the target reads it, low word first
+  int axfStamped = 1;
+  for( int b = 0; b < ID_LEN; b++ ) {
+	uint8_t byte = (uint8_t)(id >> (8*b));
+	bin[binAt + MAGIC_LEN + b] = byte;
+	if( axf[axfAt + MAGIC_LEN + b] != byte )
+	  axfStamped = 0;
+	axf[axfAt + MAGIC_LEN + b] = byte;
+  }
+
+  /*
+	An .axf already carrying this id is left alone, keeping its mtime,
+	so faultGuru's index of it (app.axf.guru) stays valid.
+  */
+  if( writeFile( binPath, bin, binSize ) ||
+	  (!axfStamped && writeFile( axfPath, axf, axfSize )) )
+	return 1;
+
+  /*
+	The .axf is the .bin's prerequisite, so must not end up newer, else
+	every make redoes the objcopy and stamp.  Give the .bin its mtime.
+  */
+  struct stat st;
+  if( stat( axfPath, &st ) == 0 ) {
+	struct timespec times[2] = { st.st_mtim, st.st_mtim };
+	if( utimensat( AT_FDCWD, binPath, times, 0 ) )
+	  perror( binPath );
+  }
+
+  printf( "%s: build %08X (%016llX)\n", axfPath, (unsigned)id,
+		  (unsigned long long)id );
+
+  if( store ) {
+	char path[4096];
+	snprintf( path, sizeof path, "%s/%08X.axf", store, (unsigned)id );
+	if( writeFile( path, axf, axfSize ) )
+	  return 1;
+  }
+
+  free( axf );
+  free( bin );
+  return 0;
+}
+
+// eof
@@ -0,0 +1,364 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "faultHandlingCompress.h"
+#include "testCheck.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: test dumpCore.c, by running it on dumps, text and
+ * compressed, and reading back the ELF core files it writes.  For
+ * each, checks:
+ *
+ * the ELF header: 32-bit, little-endian, ET_CORE, EM_ARM
+ *
+ * the PT_NOTE's prstatus registers: r0-r3, r12, lr, pc and xpsr as
+ * stacked, r7, and sp = the frame (the dump's sp row) + 32, + 4 more
+ * if the stacked psr's bit 9 says the frame was padded to 8 bytes
+ *
+ * the PT_LOAD segments: every word of the exception frame and of the
+ * call stack rows is loaded at its address, with its value, and no
+ * other word is
+ *
+ * Expectations are read from the dump text here, NOT via dumpParse.c,
+ * which dumpCore itself uses.  Besides each dump given, a copy with
+ * the stacked psr's bit 9 set tests the padded frame.
+ *
+ * $ make dumpCore coreTest
+ * $ ./coreTest [-d ./dumpCore] [dumpFile...]
+ *
+ * Dumps default to src/test/resources/dumps/quizA-E, so run from the
+ * top directory.
+ */
+
+#define MAX_TEXT  4096
+#define MAX_CORE  (1 << 16)
+#define MAX_WORDS 64
+
+#define ET_CORE     4
+#define EM_ARM      40
+#define PT_LOAD     1
+#define PT_NOTE     4
+#define NT_PRSTATUS 1
+
+// Offsets into ARM Linux's elf_prstatus, see dumpCore.c
+#define PRSTATUS_SIZE 148
+#define PRSTATUS_REG  72
+
+static const char* const defaultDumps[] = {
+  "src/test/resources/dumps/quizA.txt",
+  "src/test/resources/dumps/quizB.txt",
+  "src/test/resources/dumps/quizC.txt",
+  "src/test/resources/dumps/quizD.txt",
+  "src/test/resources/dumps/quizE.txt",
+};
+
+#define DEFAULT_DUMPS ((int)(sizeof(defaultDumps)/sizeof(defaultDumps[0])))
+
+static const char* dumpCore = "./dumpCore";
+/*
+  What the dump says, as read here: labelled registers, and address,
+  value words for the exception frame and call stack rows.
+*/
+typedef struct {
+  uint32_t r7, sp, frame[8];
+  uint32_t addrs[MAX_WORDS], values[MAX_WORDS];
+  int words;
+} expected;
+
+static const char* const frameLabels[8] = {
+  "s.r0", "s.r1", "s.r2", "s.r3", "s.r12", "s.lr", "s.pc", "s.psr"
+};
+
+static int isHex8( const char* s ) {
+  return strlen( s ) == 8 && strspn( s, "0123456789ABCDEF" ) == 8;
+}
+
+static int readExpected( const char* text, expected* e ) {
+  int have = 0;
+  memset( e, 0, sizeof *e );
+  const char* line = text;
+  while( *line ) {
+	// One line at a time, else sscanf reads on into the next
+	char row[128], a[32], b[32], extra[32];
+	size_t rowLen = strcspn( line, "\n" );
+	if( rowLen >= sizeof row )
+	  rowLen = sizeof row - 1;
+	memcpy( row, line, rowLen );
+	row[rowLen] = 0;
+	int n = sscanf( row, "%31s %31s %31s", a, b, extra );
+	if( n == 2 && isHex8( b ) ) {
+	  uint32_t v = (uint32_t)strtoul( b, NULL, 16 );
+	  if( isHex8( a ) ) {
+		// A call stack row, 0 0 when unused
+		uint32_t addr = (uint32_t)strtoul( a, NULL, 16 );
+		if( addr && e->words < MAX_WORDS ) {
+		  e->addrs[e->words] = addr;
+		  e->values[e->words++] = v;
+		}
+	  } else if( strcmp( a, "r7" ) == 0 ) {
+		e->r7 = v;
+		have |= 1;
+	  } else if( strcmp( a, "sp" ) == 0 ) {
+		e->sp = v;
+		have |= 2;
+	  } else
+		for( int k = 0; k < 8; k++ )
+		  if( strcmp( a, frameLabels[k] ) == 0 ) {
+			e->frame[k] = v;
+			have |= 4 << k;
+		  }
+	}
+	const char* nl = strchr( line, '\n' );
+	line = nl ? nl + 1 : line + strlen( line );
+  }
+  if( have != 0x3ff )
+	return -1;
+
+  // The frame's words, then the call stack's, later rows winning
+  uint32_t addrs[MAX_WORDS], values[MAX_WORDS];
+  int n = 0;
+  for( int k = 0; k < 8; k++ ) {
+	addrs[n] = e->sp + 4*(uint32_t)k;
+	values[n++] = e->frame[k];
+  }
+  for( int k = 0; k < e->words && n < MAX_WORDS; k++ ) {
+	int dup = 0;
+	for( int j = 0; j < n; j++ )
+	  if( addrs[j] == e->addrs[k] ) {
+		values[j] = e->values[k];
+		dup = 1;
+	  }
+	if( !dup ) {
+	  addrs[n] = e->addrs[k];
+	  values[n++] = e->values[k];
+	}
+  }
+  memcpy( e->addrs, addrs, sizeof addrs );
+  memcpy( e->values, values, sizeof values );
+  e->words = n;
+  return 0;
+}
+
+static int writeFile( const char* path, const void* buf, size_t len ) {
+  FILE* fp = fopen( path, "wb" );
+  if( !fp || fwrite( buf, 1, len, fp ) != len || fclose( fp ) ) {
+	perror( path );
+	return -1;
+  }
+  return 0;
+}
+
+static int run( const char* in, const char* out ) {
+  pid_t pid = fork();
+  if( pid == 0 ) {
+	execl( dumpCore, dumpCore, "-o", out, in, (char*)NULL );
+	perror( dumpCore );
+	_exit( 127 );
+  }
+  int status;
+  if( pid < 0 || waitpid( pid, &status, 0 ) != pid )
+	return -1;
+  return WIFEXITED( status ) ? WEXITSTATUS( status ) : -1;
+}
+
+static uint32_t get16( const uint8_t* p ) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8;
+}
+
+static uint32_t get32( const uint8_t* p ) {
+  return get16( p ) | get16( p + 2 ) << 16;
+}
+
+static void checkCore( const char* name, const char* corePath,
+					   const expected* e ) {
+  static uint8_t core[MAX_CORE];
+  FILE* fp = fopen( corePath, "rb" );
+  size_t len = fp ? fread( core, 1, sizeof core, fp ) : 0;
+  if( fp )
+	fclose( fp );
+
+  int ok = len >= 52 && memcmp( core, "\177ELF\1\1\1", 7 ) == 0 &&
+	get16( core + 16 ) == ET_CORE && get16( core + 18 ) == EM_ARM &&
+	get16( core + 42 ) == 32;
+  checkOf( ok, name, "ELF core header" );
+  if( !ok )
+	return;
+
+  uint32_t phoff = get32( core + 28 );
+  uint32_t phnum = get16( core + 44 );
+  if( phoff + 32 * phnum > len ) {
+	checkOf( 0, name, "program headers within file" );
+	return;
+  }
+
+  // Registers, from the first note, which must be the prstatus
+  const uint8_t* regs = NULL;
+  int loaded = 0, matched = 0, segmentsOk = 1;
+  for( uint32_t p = 0; p < phnum; p++ ) {
+	const uint8_t* ph = core + phoff + 32*p;
+	uint32_t offset = get32( ph + 4 ), vaddr = get32( ph + 8 );
+	uint32_t filesz = get32( ph + 16 );
+	if( offset + filesz > len ) {
+	  segmentsOk = 0;
+	  continue;
+	}
+	if( get32( ph ) == PT_NOTE ) {
+	  const uint8_t* note = core + offset;
+	  if( filesz >= 20 + PRSTATUS_SIZE && get32( note ) == 5 &&
+		  get32( note + 4 ) == PRSTATUS_SIZE &&
+		  get32( note + 8 ) == NT_PRSTATUS &&
+		  memcmp( note + 12, "CORE", 5 ) == 0 )
+		regs = note + 20 + PRSTATUS_REG;
+	} else if( get32( ph ) == PT_LOAD ) {
+	  if( (vaddr & 3) || (filesz & 3) || get32( ph + 20 ) != filesz )
+		segmentsOk = 0;
+	  for( uint32_t w = 0; w < filesz; w += 4 ) {
+		loaded++;
+		uint32_t value = get32( core + offset + w );
+		for( int k = 0; k < e->words; k++ )
+		  if( e->addrs[k] == vaddr + w && e->values[k] == value )
+			matched++;
+	  }
+	}
+  }
+
+  checkOf( regs != NULL, name, "PT_NOTE prstatus" );
+  if( regs ) {
+	uint32_t padded = (e->frame[7] & (1 << 9)) ? 4 : 0;
+	checkOf( get32( regs + 4*0 ) == e->frame[0] &&
+			 get32( regs + 4*1 ) == e->frame[1] &&
+			 get32( regs + 4*2 ) == e->frame[2] &&
+			 get32( regs + 4*3 ) == e->frame[3] &&
+			 get32( regs + 4*12 ) == e->frame[4], name,
+			 "prstatus r0-r3, r12 as stacked" );
+	checkOf( get32( regs + 4*7 ) == e->r7, name, "prstatus r7" );
+	checkOf( get32( regs + 4*15 ) == e->frame[6], name, "prstatus pc" );
+	checkOf( get32( regs + 4*14 ) == e->frame[5], name, "prstatus lr" );
+	checkOf( get32( regs + 4*13 ) == e->sp + 32 + padded, name,
+			 padded ? "prstatus sp = frame + 32 + 4, padded" :
+			 "prstatus sp = frame + 32" );
+	checkOf( get32( regs + 4*16 ) == e->frame[7], name,
+			 "prstatus xpsr as stacked" );
+  }
+  checkOf( segmentsOk && loaded == e->words && matched == e->words, name,
+		   "PT_LOAD segments hold the frame and call stack words, only" );
+}
+
+static void testDump( const char* path, const char* text ) {
+  expected e;
+  if( readExpected( text, &e ) ) {
+	checkOf( 0, path, "dump has r7, sp and the stacked frame" );
+	return;
+  }
+
+  char in[64], out[64];
+  snprintf( in, sizeof in, "/tmp/coreTest%d.dump", (int)getpid() );
+  snprintf( out, sizeof out, "/tmp/coreTest%d.core", (int)getpid() );
+
+  // Text, as the lib formats it
+  char name[512];
+  snprintf( name, sizeof name, "%s (text)", path );
+  if( writeFile( in, text, strlen( text ) ) == 0 ) {
+	checkOf( run( in, out ) == 0, name, "dumpCore ran" );
+	checkCore( name, out, &e );
+  }
+
+  // Compressed, as faultHandlingCompressDump would, STK3700 bases
+  faultHandlingCompressBases bases = { 0, 0x20020000, e.sp };
+  uint8_t bin[FAULT_HANDLING_COMPRESS_SIZE(64)];
+  int len = faultHandlingCompress( text, &bases, bin, sizeof bin );
+  snprintf( name, sizeof name, "%s (compressed)", path );
+  if( len > 0 && writeFile( in, bin, (size_t)len ) == 0 ) {
+	checkOf( run( in, out ) == 0, name, "dumpCore ran" );
+	checkCore( name, out, &e );
+  }
+  unlink( in );
+  unlink( out );
+}
+
+int main( int argc, char* argv[] ) {
+
+  int i = 1;
+  if( i+1 < argc && strcmp( argv[i], "-d" ) == 0 ) {
+	dumpCore = argv[i+1];
+	i += 2;
+  }
+  const char* const* dumps = defaultDumps;
+  int dumpCount = DEFAULT_DUMPS;
+  if( i < argc ) {
+	dumps = (const char* const*)argv + i;
+	dumpCount = argc - i;
+  }
+
+  for( int d = 0; d < dumpCount; d++ ) {
+	static char text[MAX_TEXT];
+	FILE* fp = fopen( dumps[d], "r" );
+	if( !fp ) {
+	  perror( dumps[d] );
+	  failures++;
+	  continue;
+	}
+	size_t n = fread( text, 1, sizeof text - 1, fp );
+	fclose( fp );
+	text[n] = 0;
+	testDump( dumps[d], text );
+
+	// Again, the frame now padded: stacked psr bit 9 set
+	char* psr = strstr( text, "s.psr " );
+	if( psr ) {
+	  psr += 6;
+	  while( *psr == ' ' )
+		psr++;
+	  uint32_t v = (uint32_t)strtoul( psr, NULL, 16 ) | (1 << 9);
+	  char hex[9];
+	  snprintf( hex, sizeof hex, "%08X", (unsigned)v );
+	  memcpy( psr, hex, 8 );
+	  char name[512];
+	  snprintf( name, sizeof name, "%s, psr bit 9", dumps[d] );
+	  testDump( name, text );
+	}
+  }
+
+  return checkSummary();
+}
+
+// eof
@@ -0,0 +1,186 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "faultHandlingCompress.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: apply the target's address-relative dump compression
+ * (faultHandlingCompress.c) to fault dump text files, restore the
+ * values (and the kind, a hang or overflow) again, check the round trip and
+ * report compression ratios.
+ *
+ * $ make tools
+ * $ ./dumpCompress -s 20020000 src/test/resources/dumps/quizA.txt
+ *
+ * Options:
+ *
+ * -t HEX  start of .text, as passed to faultHandlingSetCallStackParameters
+ * -s HEX  top of main stack, ditto (default 20020000, the STK3700)
+ * -x      also print the compressed bytes, in hex
+ *
+ * The sp base is taken from the dump's own 'sp' row.
+ */
+
+#define MAX_DUMP   4096
+#define MAX_VALUES 512
+
+static int readFile( const char* path, char* buf, int len ) {
+  FILE* fp = fopen( path, "r" );
+  if( !fp ) {
+	perror( path );
+	return -1;
+  }
+  int n = (int)fread( buf, 1, len-1, fp );
+  fclose( fp );
+  buf[n] = 0;
+  return n;
+}
+
+/*
+  Independent of the compressor's own tokenizer, pull the hex values
+  from a dump, and its kind, so the round trip check means something.
+*/
+static int parseValues( char* dump, uint32_t* values, int max,
+						uint32_t* sp, uint32_t* kind ) {
+  int count = 0;
+  *sp = 0;
+  *kind = 0;
+  char* save;
+  char* prev = NULL;
+  for( char* tok = strtok_r( dump, " \t\r\n", &save ); tok;
+	   tok = strtok_r( NULL, " \t\r\n", &save ) ) {
+	size_t len = strlen( tok );
+	if( len > 8 || strspn( tok, "0123456789ABCDEF" ) != len ) {
+	  if( strcmp( tok, "hang" ) == 0 )
+		*kind |= FAULT_HANDLING_KIND_HANG;
+	  if( strncmp( tok, "ovf.", 4 ) == 0 && len == 5 )
+		*kind |= FAULT_HANDLING_KIND_OVERFLOW |
+		  (uint32_t)strtoul( tok + 4, NULL, 16 ) << 4;
+	  prev = tok;
+	  continue;
+	}
+	if( count == max )
+	  return -1;
+	values[count] = (uint32_t)strtoul( tok, NULL, 16 );
+	if( prev && strcmp( prev, "sp" ) == 0 )
+	  *sp = values[count];
+	count++;
+	prev = tok;
+  }
+  return count;
+}
+
+int main( int argc, char* argv[] ) {
+
+  faultHandlingCompressBases bases = { 0, 0x20020000, 0 };
+  int showBytes = 0;
+
+  int i;
+  for( i = 1; i < argc && argv[i][0] == '-'; i++ ) {
+	if( strcmp( argv[i], "-t" ) == 0 && i+1 < argc )
+	  bases.textStart = (uint32_t)strtoul( argv[++i], NULL, 16 );
+	else if( strcmp( argv[i], "-s" ) == 0 && i+1 < argc )
+	  bases.stackTop = (uint32_t)strtoul( argv[++i], NULL, 16 );
+	else if( strcmp( argv[i], "-x" ) == 0 )
+	  showBytes = 1;
+	else {
+	  fprintf( stderr, "Usage: %s [-t textStart] [-s stackTop] [-x] "
+			   "dumpFile...\n", argv[0] );
+	  return 1;
+	}
+  }
+
+  long totalText = 0, totalRaw = 0, totalPacked = 0;
+  int failures = 0;
+
+  printf( "%-40s %5s %5s %5s %6s %6s\n",
+		  "dump", "text", "raw", "comp", "c/text", "c/raw" );
+
+  for( ; i < argc; i++ ) {
+	static char dump[MAX_DUMP], copy[MAX_DUMP];
+	uint32_t expected[MAX_VALUES], restored[MAX_VALUES];
+	uint8_t packed[FAULT_HANDLING_COMPRESS_SIZE(MAX_VALUES)];
+
+	int textLen = readFile( argv[i], dump, sizeof dump );
+	if( textLen < 0 ) {
+	  failures++;
+	  continue;
+	}
+	strcpy( copy, dump );
+	uint32_t kind;
+	int count = parseValues( copy, expected, MAX_VALUES, &bases.sp, &kind );
+
+	faultHandlingCompressBases back;
+	int packedLen = faultHandlingCompress( dump, &bases,
+										   packed, sizeof packed );
+	int n = faultHandlingDecompress( packed, packedLen, &back,
+									 restored, MAX_VALUES );
+	if( count < 0 || packedLen < 0 || n != count || back.kind != kind ||
+		memcmp( expected, restored, count * sizeof(uint32_t) ) ) {
+	  printf( "%-40s ROUND TRIP FAILED\n", argv[i] );
+	  failures++;
+	  continue;
+	}
+
+	// The target's dump is a C string, so its true size includes the NULL
+	int raw = 4 * count;
+	printf( "%-40s %5d %5d %5d %6.3f %6.3f\n", argv[i], textLen + 1,
+			raw, packedLen, packedLen / (double)(textLen + 1),
+			packedLen / (double)raw );
+	if( showBytes ) {
+	  for( int b = 0; b < packedLen; b++ )
+		printf( "%02X%s", packed[b], (b % 24 == 23) ? "\n" : " " );
+	  printf( "\n" );
+	}
+	totalText += textLen + 1;
+	totalRaw += raw;
+	totalPacked += packedLen;
+  }
+
+  if( totalText )
+	printf( "%-40s %5ld %5ld %5ld %6.3f %6.3f\n", "TOTAL", totalText,
+			totalRaw, totalPacked, totalPacked / (double)totalText,
+			totalPacked / (double)totalRaw );
+
+  return failures ? 2 : 0;
+}
+
+// eof
@@ -0,0 +1,394 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "faultHandlingCompress.h"
+#include "dumpParse.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: turn a fault dump into an ELF core file, so that gdb
+ * can be pointed at it as if at a crashed process:
+ *
+ * $ make dumpCore
+ * $ ./dumpCore -o core src/test/resources/dumps/quizA.txt
+ * $ arm-none-eabi-gdb app.axf core
+ * (gdb) info registers
+ * (gdb) bt
+ *
+ * The core holds a prstatus note, giving the registers at the fault
+ * (the stacked r0-r3, r12, lr, pc, xpsr, plus r7, and r4-r11 if a
+ * FULL_REGS dump), with sp as it was before the exception frame was
+ * pushed, and a signal as the fault class suggests.  Its memory is
+ * all the dump knows of: the exception frame itself, the call stack
+ * rows, and any memory window and region rows.  gdb reads code from
+ * app.axf, so bt gets as far as the captured stack allows, locals as
+ * far as they live in registers or captured words.
+ *
+ * For more, give a raw image of (some of) RAM as read off the target
+ * some other way, e.g. J-Link's savebin, with -m base file.
+ * The dump's own words take precedence over any image's.
+ *
+ * Options:
+ *
+ * -o FILE       core file to write (default core)
+ * -m HEX FILE   a raw memory image, loaded at HEX (repeatable)
+ * -v            list the registers and memory segments written
+ *
+ * The dump may be text, as the lib formats it, or compressed (see
+ * faultHandlingCompressDump), in which case it must be from a
+ * default CM0 or CM3/4 build.
+ */
+
+#define MAX_DUMP   (1 << 16)
+#define MAX_IMAGES 8
+#define MAX_WORDS  (1 << 20)
+
+// The ELF32 bits we need, as <elf.h> has them, which not every host does
+#define ET_CORE    4
+#define EM_ARM     40
+#define PT_LOAD    1
+#define PT_NOTE    4
+#define PF_W       2
+#define PF_R       4
+#define NT_PRSTATUS 1
+#define NT_PRPSINFO 3
+
+#define EF_ARM_EABI_VER5 0x05000000
+
+// ARM Linux's elf_prstatus and elf_prpsinfo, as bfd's elf32-arm expects
+#define PRSTATUS_SIZE   148
+#define PRSTATUS_CURSIG 12
+#define PRSTATUS_PID    24
+#define PRSTATUS_REG    72
+#define PRPSINFO_SIZE   124
+#define PRPSINFO_FNAME  28
+#define PRPSINFO_ARGS   44
+
+// gdb's ARM gregset: r0-r12, sp, lr, pc, cpsr, orig_r0
+#define GREGS 18
+#define REG_SP   13
+#define REG_LR   14
+#define REG_PC   15
+#define REG_CPSR 16
+
+#define SIGILL  4
+#define SIGBUS  7
+#define SIGFPE  8
+#define SIGSEGV 11
+#define SIGALRM 14
+
+typedef struct {
+  uint32_t addr;
+  uint32_t value;
+} memWord;
+
+static memWord* words;
+static size_t wordCount = 0;
+
+static void addWord( uint32_t addr, uint32_t value ) {
+  if( wordCount < MAX_WORDS && !(addr & 3) ) {
+	words[wordCount].addr = addr;
+	words[wordCount++].value = value;
+  }
+}
+
+// By address, and for equal addresses, the later added first
+static int byAddr( const void* a, const void* b ) {
+  const memWord* wa = a;
+  const memWord* wb = b;
+  if( wa->addr != wb->addr )
+	return wa->addr < wb->addr ? -1 : 1;
+  return wa < wb ? 1 : -1;
+}
+
+static uint32_t regValue( const dumpParsed* d, const char* label ) {
+  const dumpParseReg* r = dumpParseFind( d, label );
+  return r ? r->value : 0;
+}
+
+/*
+  The signal a Linux process would have died of, near enough: so gdb
+  says 'Program terminated with signal SIGBUS', say.
+*/
+static int signalOf( const dumpParsed* d ) {
+  if( d->kind & FAULT_HANDLING_KIND_HANG )
+	return SIGALRM;
+  uint32_t cfsr = regValue( d, "cfsr" );
+  if( cfsr & 0x000000ff )
+	return SIGSEGV;
+  if( cfsr & 0x0000ff00 )
+	return SIGBUS;
+  if( cfsr & (1 << 25) )
+	return SIGFPE;
+  if( cfsr & 0xffff0000 )
+	return SIGILL;
+  return SIGSEGV;
+}
+
+static void put16( uint8_t* p, uint32_t v ) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32( uint8_t* p, uint32_t v ) {
+  put16( p, v );
+  put16( p + 2, v >> 16 );
+}
+
+// A note: namesz, descsz, type, name, desc, each 4-aligned
+static size_t putNote( uint8_t* p, uint32_t type, const uint8_t* desc,
+					   size_t descLen ) {
+  put32( p, 5 );
+  put32( p + 4, (uint32_t)descLen );
+  put32( p + 8, type );
+  memcpy( p + 12, "CORE\0\0\0", 8 );
+  memcpy( p + 20, desc, descLen );
+  return 20 + ((descLen + 3) & ~(size_t)3);
+}
+
+static int loadImage( uint32_t base, const char* path ) {
+  FILE* fp = fopen( path, "rb" );
+  if( !fp ) {
+	perror( path );
+	return -1;
+  }
+  uint8_t w[4];
+  for( uint32_t addr = base & ~3u; fread( w, 1, 4, fp ) == 4; addr += 4 )
+	addWord( addr, (uint32_t)w[0] | (uint32_t)w[1] << 8 |
+			 (uint32_t)w[2] << 16 | (uint32_t)w[3] << 24 );
+  fclose( fp );
+  return 0;
+}
+
+static int parseDump( const char* path, dumpParsed* d ) {
+  static char text[MAX_DUMP];
+  FILE* fp = fopen( path, "rb" );
+  if( !fp ) {
+	perror( path );
+	return -1;
+  }
+  size_t length = fread( text, 1, sizeof text - 1, fp );
+  fclose( fp );
+  text[length] = 0;
+
+  int result;
+  if( length && (uint8_t)text[0] == 0xFD )
+	result = dumpParseBinary( (const uint8_t*)text, length, NULL, d );
+  else {
+	// The dump starts at its r7 row, whatever console chatter precedes it
+	const char* start = text;
+	while( start && strncmp( start, "r7   ", 5 ) != 0 ) {
+	  start = strchr( start, '\n' );
+	  if( start )
+		start++;
+	}
+	if( !start ) {
+	  fprintf( stderr, "%s: no fault dump found\n", path );
+	  return -1;
+	}
+	result = dumpParseText( start, length - (size_t)(start - text), d );
+  }
+  if( result ) {
+	fprintf( stderr, "%s: bad fault dump: %s\n", path,
+			 dumpParseError( result ) );
+	return -1;
+  }
+  if( d->layout.host ) {
+	fprintf( stderr, "%s: a host dump, not a Cortex-M one\n", path );
+	return -1;
+  }
+  return 0;
+}
+
+int main( int argc, char* argv[] ) {
+
+  const char* out = "core";
+  int verbose = 0;
+  struct {
+	uint32_t base;
+	const char* path;
+  } images[MAX_IMAGES];
+  int imageCount = 0;
+
+  int i;
+  for( i = 1; i < argc && argv[i][0] == '-'; i++ ) {
+	if( strcmp( argv[i], "-o" ) == 0 && i+1 < argc )
+	  out = argv[++i];
+	else if( strcmp( argv[i], "-m" ) == 0 && i+2 < argc &&
+			 imageCount < MAX_IMAGES ) {
+	  images[imageCount].base = (uint32_t)strtoul( argv[++i], NULL, 16 );
+	  images[imageCount++].path = argv[++i];
+	} else if( strcmp( argv[i], "-v" ) == 0 )
+	  verbose = 1;
+	else
+	  break;
+  }
+  if( i != argc-1 ) {
+	fprintf( stderr, "Usage: %s [-o core] [-m base image]... [-v] "
+			 "dumpFile\n", argv[0] );
+	return 1;
+  }
+  const char* dumpPath = argv[i];
+
+  static dumpParsed d;
+  if( parseDump( dumpPath, &d ) )
+	return 1;
+
+  // Registers as the faulting code had them, see dumpParseFaultRegs
+  uint32_t regs[GREGS] = { 0 };
+  dumpParseFaultRegs( &d, regs, regs + REG_CPSR );
+
+  // Memory: images first, so the dump's words, added later, win
+  words = malloc( MAX_WORDS * sizeof *words );
+  for( int m = 0; m < imageCount; m++ )
+	if( loadImage( images[m].base, images[m].path ) )
+	  return 1;
+  uint32_t addrs[DUMP_PARSE_MAX_VALUES], values[DUMP_PARSE_MAX_VALUES];
+  int n = dumpParseMemory( &d, addrs, values, DUMP_PARSE_MAX_VALUES );
+  for( int k = 0; k < n; k++ )
+	addWord( addrs[k], values[k] );
+
+  // Sort, drop the duplicates (keeping the latest), then runs = segments
+  qsort( words, wordCount, sizeof *words, byAddr );
+  size_t unique = 0;
+  for( size_t w = 0; w < wordCount; w++ )
+	if( !unique || words[unique-1].addr != words[w].addr )
+	  words[unique++] = words[w];
+  wordCount = unique;
+  int segments = 0;
+  for( size_t w = 0; w < wordCount; w++ )
+	if( !w || words[w].addr != words[w-1].addr + 4 )
+	  segments++;
+
+  // The notes
+  uint8_t prstatus[PRSTATUS_SIZE] = { 0 };
+  put16( prstatus + PRSTATUS_CURSIG, (uint32_t)signalOf( &d ) );
+  put32( prstatus + PRSTATUS_PID, 1 );
+  for( int r = 0; r < GREGS; r++ )
+	put32( prstatus + PRSTATUS_REG + 4*r, regs[r] );
+  uint8_t prpsinfo[PRPSINFO_SIZE] = { 0 };
+  const char* base = strrchr( dumpPath, '/' );
+  base = base ? base + 1 : dumpPath;
+  strncpy( (char*)prpsinfo + PRPSINFO_FNAME, base, 15 );
+  snprintf( (char*)prpsinfo + PRPSINFO_ARGS, 80, "faultHandling %s",
+			base );
+  static uint8_t notes[512];
+  size_t notesLen = putNote( notes, NT_PRSTATUS, prstatus,
+							 sizeof prstatus );
+  notesLen += putNote( notes + notesLen, NT_PRPSINFO, prpsinfo,
+					   sizeof prpsinfo );
+
+  // ELF header, program headers, notes, then the segments' contents
+  uint8_t ehdr[52] = { 0x7f, 'E', 'L', 'F', 1, 1, 1 };
+  int phnum = 1 + segments;
+  uint32_t offset = 52 + 32 * (uint32_t)phnum;
+  put16( ehdr + 16, ET_CORE );
+  put16( ehdr + 18, EM_ARM );
+  put32( ehdr + 20, 1 );
+  put32( ehdr + 28, 52 );
+  put32( ehdr + 36, EF_ARM_EABI_VER5 );
+  put16( ehdr + 40, 52 );
+  put16( ehdr + 42, 32 );
+  put16( ehdr + 44, (uint32_t)phnum );
+  put16( ehdr + 46, 40 );
+
+  FILE* fp = fopen( out, "wb" );
+  if( !fp ) {
+	perror( out );
+	return 1;
+  }
+  fwrite( ehdr, 1, sizeof ehdr, fp );
+
+  uint8_t phdr[32] = { 0 };
+  put32( phdr, PT_NOTE );
+  put32( phdr + 4, offset );
+  put32( phdr + 16, (uint32_t)notesLen );
+  put32( phdr + 28, 4 );
+  fwrite( phdr, 1, sizeof phdr, fp );
+  offset += (uint32_t)notesLen;
+
+  for( size_t w = 0; w < wordCount; ) {
+	size_t run = 1;
+	while( w + run < wordCount &&
+		   words[w+run].addr == words[w+run-1].addr + 4 )
+	  run++;
+	memset( phdr, 0, sizeof phdr );
+	put32( phdr, PT_LOAD );
+	put32( phdr + 4, offset );
+	put32( phdr + 8, words[w].addr );
+	put32( phdr + 12, words[w].addr );
+	put32( phdr + 16, 4 * (uint32_t)run );
+	put32( phdr + 20, 4 * (uint32_t)run );
+	put32( phdr + 24, PF_R | PF_W );
+	put32( phdr + 28, 4 );
+	fwrite( phdr, 1, sizeof phdr, fp );
+	offset += 4 * (uint32_t)run;
+	if( verbose )
+	  printf( "segment %08X-%08X %zu words\n", (unsigned)words[w].addr,
+			  (unsigned)(words[w].addr + 4 * run), run );
+	w += run;
+  }
+
+  fwrite( notes, 1, notesLen, fp );
+  for( size_t w = 0; w < wordCount; w++ ) {
+	uint8_t le[4];
+	put32( le, words[w].value );
+	fwrite( le, 1, 4, fp );
+  }
+  int failed = ferror( fp );
+  if( fclose( fp ) || failed ) {
+	perror( out );
+	return 1;
+  }
+
+  if( verbose ) {
+	static const char* const names[GREGS] = {
+	  "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10",
+	  "r11", "r12", "sp", "lr", "pc", "xpsr", NULL
+	};
+	for( int r = 0; r < REG_CPSR + 1; r++ )
+	  printf( "%-4s %08X%s", names[r], (unsigned)regs[r],
+			  (r % 4 == 3 || r == REG_CPSR) ? "\n" : "  " );
+	printf( "signal %d\n", signalOf( &d ) );
+  }
+  free( words );
+  return 0;
+}
+
+// eof
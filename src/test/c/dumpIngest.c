@@ -0,0 +1,347 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dumpStream.h"
+#include "faultGuru.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: the dump ingest daemon.  Bench soak tests run dozens of
+ * boards, each with its serial console on a USB tty.  dumpIngest
+ * watches them all, one thread, epoll, frames fault dumps, text and
+ * binary, out of each byte stream as they arrive (see dumpStream.c),
+ * and appends each to the dump store, a directory of one file per
+ * unit, as faultGuru's batch mode reads:
+ *
+ * $ ./dumpIngest -s soak/ stk3700-01=/dev/ttyACM0 stk3200-01=/dev/ttyACM1
+ * $ ./faultGuru -B soak/
+ *
+ * A unit is named by its device's basename, else by the name given.
+ * Every dump is stored as text, binary dumps decoded, so the store
+ * reads as one.  As each is stored, a line says where it came from and
+ * what faultGuru's rules make of it:
+ *
+ * 12:04:31 stk3700-01   #3 text null-fnptr (95) s.pc 00000000
+ *
+ * A text dump's end is known at the line after it, or after -q ms
+ * (default 250) of silence, once it has all the rows it must.  A
+ * device which goes away, a board reset or unplugged, is reopened
+ * every second until back.  Rejected dumps, cut short or corrupted,
+ * are counted and reported on stderr, never stored.  SIGINT/SIGTERM
+ * stop, after flushing, with a per unit summary.
+ *
+ * Devices are put in raw mode, at -b baud (default 115200).  Anything
+ * a read() will do, e.g. a pseudo-terminal, see ingestTest.c.
+ */
+
+#define MAX_DEVICES 64
+#define UNIT_LEN    32
+#define REOPEN_MS   1000
+#define TICK_MS     50
+
+typedef struct {
+  const char* path;
+  char unit[UNIT_LEN];
+  int fd;
+  long lastByte;		// ms, see now()
+  long reopenAt;
+  int lost;				// reported as gone, not yet back
+  dumpStream stream;
+} device;
+
+static device devices[MAX_DEVICES];
+static int deviceCount = 0;
+
+static const char* store = NULL;
+static long quietMs = 250;
+static speed_t baud = B115200;
+
+static volatile sig_atomic_t stopping = 0;
+
+static long now( void ) {
+  struct timespec t;
+  clock_gettime( CLOCK_MONOTONIC, &t );
+  return t.tv_sec * 1000L + t.tv_nsec / 1000000L;
+}
+
+static void stop( int sig ) {
+  (void)sig;
+  stopping = 1;
+}
+
+static const struct {
+  long rate;
+  speed_t speed;
+} bauds[] = {
+  { 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 },
+  { 57600, B57600 }, { 115200, B115200 }, { 230400, B230400 },
+  { 460800, B460800 }, { 921600, B921600 }
+};
+
+// Raw: no echo, no line editing, no cr/nl mapping, every byte as is
+static void makeRaw( int fd ) {
+  struct termios t;
+  if( tcgetattr( fd, &t ) )
+	return;
+  cfmakeraw( &t );
+  cfsetispeed( &t, baud );
+  cfsetospeed( &t, baud );
+  t.c_cflag |= CLOCAL | CREAD;
+  tcsetattr( fd, TCSANOW, &t );
+}
+
+static int openDevice( int epoll, device* dev ) {
+  dev->fd = open( dev->path, O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC );
+  if( dev->fd < 0 )
+	return -1;
+  makeRaw( dev->fd );
+  struct epoll_event e;
+  e.events = EPOLLIN;
+  e.data.ptr = dev;
+  if( epoll_ctl( epoll, EPOLL_CTL_ADD, dev->fd, &e ) ) {
+	close( dev->fd );
+	dev->fd = -1;
+	return -1;
+  }
+  if( dev->lost ) {
+	fprintf( stderr, "%s: %s back\n", dev->unit, dev->path );
+	dev->lost = 0;
+  }
+  return 0;
+}
+
+// Gone (EOF, EIO, hangup): finish any dump, then retry every second
+static void closeDevice( int epoll, device* dev ) {
+  dumpStreamFlush( &dev->stream );
+  epoll_ctl( epoll, EPOLL_CTL_DEL, dev->fd, NULL );
+  close( dev->fd );
+  dev->fd = -1;
+  dev->reopenAt = now() + REOPEN_MS;
+  if( !dev->lost ) {
+	fprintf( stderr, "%s: %s gone, reopening\n", dev->unit, dev->path );
+	dev->lost = 1;
+  }
+}
+
+// One write, O_APPEND, so a reader never sees two dumps interleaved
+static void storeDump( const device* dev, const dumpParsed* d ) {
+  char text[DUMP_STREAM_TEXT];
+  int length = dumpParseFormat( d, text, sizeof text );
+  char path[4096];
+  snprintf( path, sizeof path, "%s/%s.txt", store, dev->unit );
+  int fd = open( path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644 );
+  if( fd < 0 || length < 0 || write( fd, text, (size_t)length ) != length )
+	fprintf( stderr, "%s: %s\n", path, strerror( errno ) );
+  if( fd >= 0 )
+	close( fd );
+}
+
+static void onDump( void* context, int result, const dumpParsed* d,
+					const uint8_t* raw, size_t length ) {
+  device* dev = context;
+  if( result != DUMP_PARSE_OK ) {
+	fprintf( stderr, "%s: rejected %s dump, %zu bytes: %s\n", dev->unit,
+			 raw[0] == FAULT_HANDLING_COMPRESS_MAGIC ? "binary" : "text",
+			 length, dumpParseError( result ) );
+	return;
+  }
+  storeDump( dev, d );
+
+  faultGuruDiagnosis diagnosis;
+  int n = faultGuruDiagnose( d, &diagnosis, 1 );
+  const dumpParseReg* pc = dumpParseFind( d, "s.pc" );
+  time_t t = time( NULL );
+  char when[16];
+  strftime( when, sizeof when, "%H:%M:%S", localtime( &t ) );
+  printf( "%s %-12s #%lu %s %s (%d) s.pc %08X\n", when, dev->unit,
+		  dev->stream.dumps, raw[0] == FAULT_HANDLING_COMPRESS_MAGIC ?
+		  "binary" : "text", n ? diagnosis.name : "undiagnosed",
+		  n ? diagnosis.score : 0, pc ? (unsigned)pc->value : 0u );
+  fflush( stdout );
+}
+
+static int addDevice( const char* arg ) {
+  if( deviceCount == MAX_DEVICES ) {
+	fprintf( stderr, "At most %d devices\n", MAX_DEVICES );
+	return -1;
+  }
+  device* dev = devices + deviceCount++;
+  const char* eq = strchr( arg, '=' );
+  const char* name;
+  size_t n;
+  if( eq ) {
+	dev->path = eq + 1;
+	name = arg;
+	n = (size_t)(eq - arg);
+  } else {
+	dev->path = arg;
+	name = strrchr( arg, '/' ) ? strrchr( arg, '/' ) + 1 : arg;
+	n = strlen( name );
+  }
+  if( n == 0 || n >= UNIT_LEN || memchr( name, '/', n ) ) {
+	fprintf( stderr, "%s: bad unit name\n", arg );
+	return -1;
+  }
+  memcpy( dev->unit, name, n );
+  dev->unit[n] = 0;
+  dev->fd = -1;
+  dumpStreamInit( &dev->stream, onDump, dev );
+  return 0;
+}
+
+static void usage( const char* prog ) {
+  fprintf( stderr, "Usage: %s -s storeDir [-b baud] [-q quietMs] "
+		   "[unit=]device...\n", prog );
+}
+
+int main( int argc, char* argv[] ) {
+
+  int i;
+  for( i = 1; i < argc && argv[i][0] == '-'; i++ ) {
+	if( strcmp( argv[i], "-s" ) == 0 && i+1 < argc )
+	  store = argv[++i];
+	else if( strcmp( argv[i], "-q" ) == 0 && i+1 < argc )
+	  quietMs = atol( argv[++i] );
+	else if( strcmp( argv[i], "-b" ) == 0 && i+1 < argc ) {
+	  long rate = atol( argv[++i] );
+	  size_t b;
+	  for( b = 0; b < sizeof bauds / sizeof bauds[0]; b++ )
+		if( bauds[b].rate == rate )
+		  break;
+	  if( b == sizeof bauds / sizeof bauds[0] ) {
+		fprintf( stderr, "%ld: unsupported baud rate\n", rate );
+		return 1;
+	  }
+	  baud = bauds[b].speed;
+	} else {
+	  usage( argv[0] );
+	  return 1;
+	}
+  }
+  if( !store || i == argc ) {
+	usage( argv[0] );
+	return 1;
+  }
+  struct stat st;
+  if( stat( store, &st ) || !S_ISDIR( st.st_mode ) ) {
+	fprintf( stderr, "%s: not a directory\n", store );
+	return 1;
+  }
+  for( ; i < argc; i++ )
+	if( addDevice( argv[i] ) )
+	  return 1;
+
+  struct sigaction sa;
+  memset( &sa, 0, sizeof sa );
+  sa.sa_handler = stop;
+  sigemptyset( &sa.sa_mask );
+  sigaction( SIGINT, &sa, NULL );
+  sigaction( SIGTERM, &sa, NULL );
+
+  int epoll = epoll_create1( EPOLL_CLOEXEC );
+  if( epoll < 0 ) {
+	perror( "epoll_create1" );
+	return 1;
+  }
+  for( int d = 0; d < deviceCount; d++ )
+	if( openDevice( epoll, devices + d ) ) {
+	  perror( devices[d].path );
+	  devices[d].lost = 1;
+	  devices[d].reopenAt = now() + REOPEN_MS;
+	}
+
+  struct epoll_event events[MAX_DEVICES];
+  uint8_t buf[4096];
+  while( !stopping ) {
+	int n = epoll_wait( epoll, events, MAX_DEVICES, TICK_MS );
+	if( n < 0 && errno != EINTR ) {
+	  perror( "epoll_wait" );
+	  break;
+	}
+	long t = now();
+	for( int e = 0; e < n; e++ ) {
+	  device* dev = events[e].data.ptr;
+	  // Drain it: level triggered, but fewer wakeups
+	  ssize_t got;
+	  while( (got = read( dev->fd, buf, sizeof buf )) > 0 ) {
+		dumpStreamFeed( &dev->stream, buf, (size_t)got );
+		dev->lastByte = t;
+	  }
+	  if( got == 0 || (errno != EAGAIN && errno != EINTR) )
+		closeDevice( epoll, dev );
+	}
+
+	// Quiet devices end their text dumps, lost ones are retried
+	for( int d = 0; d < deviceCount; d++ ) {
+	  device* dev = devices + d;
+	  if( dev->fd >= 0 && dumpStreamWhole( &dev->stream ) &&
+		  t - dev->lastByte >= quietMs )
+		dumpStreamFlush( &dev->stream );
+	  else if( dev->fd < 0 && t >= dev->reopenAt &&
+			   openDevice( epoll, dev ) )
+		dev->reopenAt = t + REOPEN_MS;
+	}
+  }
+
+  unsigned long dumps = 0, rejected = 0;
+  for( int d = 0; d < deviceCount; d++ ) {
+	device* dev = devices + d;
+	dumpStreamFlush( &dev->stream );
+	fprintf( stderr, "%-12s %10lu bytes %6lu dumps %6lu rejected\n",
+			 dev->unit, dev->stream.bytes, dev->stream.dumps,
+			 dev->stream.rejected );
+	dumps += dev->stream.dumps;
+	rejected += dev->stream.rejected;
+  }
+  fprintf( stderr, "%lu dumps stored, %lu rejected\n", dumps, rejected );
+  close( epoll );
+  return 0;
+}
+
+// eof
@@ -0,0 +1,532 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "faultHandlingCompress.h"
+#include "dumpParse.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Fault dump parsing, text and binary, see dumpParse.h.
+ */
+
+#define REG_WIDTH       14	// FAULT_HANDLING_CPUREG_ROWSIZE less eol
+#define CALLSTACK_WIDTH 17	// FAULT_HANDLING_CALLSTACK_ROWSIZE less eol
+#define TRACE_WIDTH     13	// FAULT_HANDLING_TRACE_ROWSIZE less eol
+#define WINDOW_WIDTH    46	// FAULT_HANDLING_WINDOW_ROWSIZE less eol
+
+/*
+  Register labels in dump order, as cpuRegLabels in faultHandling.c.
+  Each entry says which variants include it.
+*/
+#define IN_ALL   0
+#define IN_CM3   1
+#define IN_SFREE 2
+#define IN_FULL  3
+#define IN_FULL3 4		// full regs, CM3/4 only
+#define IN_BUILD 5
+#define IN_HOST  6		// faultHandlingHost.c, and only it
+
+static const struct {
+  const char* label;
+  int in;
+} allLabels[] = {
+  { "r7   ", IN_ALL }, { "sp   ", IN_ALL }, { "excrt", IN_ALL },
+  { "psr  ", IN_ALL }, { "hfsr ", IN_CM3 }, { "cfsr ", IN_CM3 },
+  { "mmfar", IN_CM3 }, { "bfar ", IN_CM3 }, { "shcsr", IN_ALL },
+  { "s.r0 ", IN_ALL }, { "s.r1 ", IN_ALL }, { "s.r2 ", IN_ALL },
+  { "s.r3 ", IN_ALL }, { "s.r12", IN_ALL }, { "s.lr ", IN_ALL },
+  { "s.pc ", IN_ALL }, { "s.psr", IN_ALL }, { "sfree", IN_SFREE },
+  { "r4   ", IN_FULL }, { "r5   ", IN_FULL }, { "r6   ", IN_FULL },
+  { "r8   ", IN_FULL }, { "r9   ", IN_FULL }, { "r10  ", IN_FULL },
+  { "r11  ", IN_FULL }, { "msp  ", IN_FULL }, { "psp  ", IN_FULL },
+  { "ctrl ", IN_FULL }, { "pmask", IN_FULL }, { "bpri ", IN_FULL3 },
+  { "r7   ", IN_HOST }, { "h.r7 ", IN_HOST }, { "sp   ", IN_HOST },
+  { "h.sp ", IN_HOST }, { "sig  ", IN_HOST }, { "code ", IN_HOST },
+  { "addr ", IN_HOST }, { "h.adr", IN_HOST }, { "s.r0 ", IN_HOST },
+  { "h.r0 ", IN_HOST }, { "s.r1 ", IN_HOST }, { "h.r1 ", IN_HOST },
+  { "s.r2 ", IN_HOST }, { "h.r2 ", IN_HOST }, { "s.r3 ", IN_HOST },
+  { "h.r3 ", IN_HOST }, { "s.lr ", IN_HOST }, { "h.lr ", IN_HOST },
+  { "s.pc ", IN_HOST }, { "h.pc ", IN_HOST }, { "h.txt", IN_HOST },
+  { "arch ", IN_HOST },
+  { "build", IN_BUILD }
+};
+
+#define ALL_LABELS ((int)(sizeof(allLabels)/sizeof(allLabels[0])))
+
+static int includes( const dumpParseLayout* l, int in ) {
+  // A host dump has its own rows, and the build row
+  if( l->host )
+	return in == IN_HOST || (in == IN_BUILD && l->buildId);
+  switch( in ) {
+  case IN_CM3:
+	return l->cortexM > 0;
+  case IN_SFREE:
+	return l->stackWatermark;
+  case IN_FULL:
+	return l->fullRegs;
+  case IN_FULL3:
+	return l->fullRegs && l->cortexM > 0;
+  case IN_BUILD:
+	return l->buildId;
+  case IN_HOST:
+	return 0;
+  default:
+	return 1;
+  }
+}
+
+// The layout's labels, in order, returns the count
+static int labelsOf( const dumpParseLayout* l,
+					 const char* labels[DUMP_PARSE_MAX_REGS] ) {
+  int n = 0;
+  for( int i = 0; i < ALL_LABELS; i++ )
+	if( includes( l, allLabels[i].in ) )
+	  labels[n++] = allLabels[i].label;
+  return n;
+}
+
+int dumpParseValueCount( const dumpParseLayout* l ) {
+  const char* labels[DUMP_PARSE_MAX_REGS];
+  return labelsOf( l, labels ) + 2*DUMP_PARSE_CALLSTACK + 2*l->traceRows +
+	(2+DUMP_PARSE_WINDOW_WORDS)*l->windowRows;
+}
+
+/*
+  8 hex digits as one 64-bit word, first digit in the low byte.
+  Every byte is range checked, then turned into its nibble, then the
+  nibbles are gathered pairwise, all 8 lanes at once.
+*/
+#define ONES (0x0101010101010101ull)
+#define HIGH (0x8080808080808080ull)
+
+int dumpParseHex8( const char* s, uint32_t* value ) {
+  uint64_t x;
+  memcpy( &x, s, 8 );
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  x = __builtin_bswap64( x );
+#endif
+  if( x & HIGH )
+	return -1;
+
+  // High bit of each byte set iff that byte is >= the constant's char
+  uint64_t ge0 = x + (0x80 - '0') * ONES;
+  uint64_t gt9 = x + (0x80 - '9' - 1) * ONES;
+  uint64_t geA = x + (0x80 - 'A') * ONES;
+  uint64_t gtF = x + (0x80 - 'F' - 1) * ONES;
+  uint64_t digit = ge0 & ~gt9;
+  uint64_t letter = geA & ~gtF;
+  if( ((digit | letter) & HIGH) != HIGH )
+	return -1;
+
+  uint64_t nibbles = (x & 0x0f * ONES) + ((letter & HIGH) >> 7) * 9;
+  nibbles = ((nibbles << 4) | (nibbles >> 8)) & 0x00ff00ff00ff00ffull;
+  nibbles = (nibbles | (nibbles >> 8)) & 0x0000ffff0000ffffull;
+  nibbles = nibbles | (nibbles >> 16);
+  *value = __builtin_bswap32( (uint32_t)nibbles );
+  return 0;
+}
+
+// Short fields, the trace id and window mask, one char at a time
+static int hexN( const char* s, int n, uint32_t* value ) {
+  uint32_t v = 0;
+  for( int i = 0; i < n; i++ ) {
+	char c = s[i];
+	if( c >= '0' && c <= '9' )
+	  v = (v << 4) | (uint32_t)(c - '0');
+	else if( c >= 'A' && c <= 'F' )
+	  v = (v << 4) | (uint32_t)(c - 'A' + 10);
+	else
+	  return -1;
+  }
+  *value = v;
+  return 0;
+}
+
+/*
+  Bytes taken by a row of width (less eol) at p: width+1 for '\n',
+  +2 for '\r\n', just width at the very end of input, else 0, not
+  such a row.
+*/
+static size_t rowLength( const char* p, const char* end, size_t width ) {
+  size_t left = (size_t)(end - p);
+  if( left == width )
+	return width;
+  if( left > width && p[width] == '\n' )
+	return width + 1;
+  if( left > width + 1 && p[width] == '\r' && p[width+1] == '\n' )
+	return width + 2;
+  return 0;
+}
+
+// A short row, at the end of input, means truncation, not a bad row
+static int rowError( const char* p, const char* end, size_t width ) {
+  if( (size_t)(end - p) < width &&
+	  !memchr( p, '\n', (size_t)(end - p) ) )
+	return DUMP_PARSE_TRUNCATED;
+  return DUMP_PARSE_BAD_ROW;
+}
+
+static int isLabel( const char* p, const char* want ) {
+  return memcmp( p, want, 5 ) == 0;
+}
+
+int dumpParseText( const char* text, size_t len, dumpParsed* out ) {
+  const char* p = text;
+  const char* end = text + len;
+  size_t n;
+
+  out->kind = 0;
+  out->regCount = 0;
+  out->stackCount = 0;
+  out->traceCount = 0;
+  out->windowCount = 0;
+
+  // Register rows: 'label value', label 5 chars
+  while( p + 5 < end && p[5] == ' ' &&
+		 (n = rowLength( p, end, REG_WIDTH )) ) {
+	if( out->regCount == DUMP_PARSE_MAX_REGS )
+	  return DUMP_PARSE_BAD_LABEL;
+	dumpParseReg* r = out->regs + out->regCount++;
+	r->label = p;
+	if( dumpParseHex8( p + 6, &r->value ) )
+	  return DUMP_PARSE_BAD_HEX;
+	p += n;
+  }
+  if( out->regCount == 0 )
+	return p + REG_WIDTH > end ? DUMP_PARSE_TRUNCATED : DUMP_PARSE_BAD_ROW;
+
+  // The labels say the variant, which must then match them exactly
+  dumpParseLayout* l = &out->layout;
+  memset( l, 0, sizeof *l );
+  for( int i = 0; i < out->regCount; i++ ) {
+	const char* label = out->regs[i].label;
+	if( i == 4 && isLabel( label, "hfsr " ) )
+	  l->cortexM = 3;
+	l->stackWatermark |= isLabel( label, "sfree" );
+	l->fullRegs |= isLabel( label, "r4   " );
+	l->buildId |= isLabel( label, "build" );
+	// Said by its second row, so even a dump still arriving
+	if( i == 1 && isLabel( label, "h.r7 " ) )
+	  l->host = 1;
+  }
+  const char* labels[DUMP_PARSE_MAX_REGS];
+  int want = labelsOf( l, labels );
+  if( out->regCount != want )
+	return out->regCount < want && p >= end ? DUMP_PARSE_TRUNCATED :
+	  DUMP_PARSE_BAD_LABEL;
+  for( int i = 0; i < want; i++ ) {
+	const char* label = out->regs[i].label;
+	if( isLabel( label, labels[i] ) )
+	  continue;
+	// A stack overflow relabels sp, a hang psr, see faultHandling.c
+	uint32_t stack;
+	if( i == 1 && !l->host && memcmp( label, "ovf.", 4 ) == 0 &&
+		hexN( label + 4, 1, &stack ) == 0 ) {
+	  out->kind |= FAULT_HANDLING_KIND_OVERFLOW | stack << 4;
+	  continue;
+	}
+	if( i == 3 && !l->host && isLabel( label, "hang " ) ) {
+	  out->kind |= FAULT_HANDLING_KIND_HANG;
+	  continue;
+	}
+	return DUMP_PARSE_BAD_LABEL;
+  }
+
+  // Call stack rows, always all of them
+  for( int i = 0; i < DUMP_PARSE_CALLSTACK; i++ ) {
+	n = rowLength( p, end, CALLSTACK_WIDTH );
+	if( !n || p[8] != ' ' )
+	  return n ? DUMP_PARSE_BAD_ROW : rowError( p, end, CALLSTACK_WIDTH );
+	if( dumpParseHex8( p, out->stackAddrs + i ) ||
+		dumpParseHex8( p + 9, out->stackVals + i ) )
+	  return DUMP_PARSE_BAD_HEX;
+	out->stackCount++;
+	p += n;
+  }
+
+  // Trace rows, as many as there are
+  while( p + 4 < end && p[4] == ' ' &&
+		 (n = rowLength( p, end, TRACE_WIDTH )) ) {
+	if( out->traceCount == DUMP_PARSE_MAX_TRACE )
+	  return DUMP_PARSE_BAD_ROW;
+	int t = out->traceCount++;
+	if( hexN( p, 4, out->traceIds + t ) ||
+		dumpParseHex8( p + 5, out->traceArgs + t ) )
+	  return DUMP_PARSE_BAD_HEX;
+	p += n;
+  }
+
+  // Window (and region) rows, likewise
+  while( p + WINDOW_WIDTH <= end && p[8] == ' ' && p[10] == ' ' &&
+		 (n = rowLength( p, end, WINDOW_WIDTH )) ) {
+	if( out->windowCount == DUMP_PARSE_MAX_WINDOWS )
+	  return DUMP_PARSE_BAD_ROW;
+	dumpParseWindow* w = out->windows + out->windowCount++;
+	if( dumpParseHex8( p, &w->base ) || hexN( p + 9, 1, &w->mask ) )
+	  return DUMP_PARSE_BAD_HEX;
+	for( int k = 0; k < DUMP_PARSE_WINDOW_WORDS; k++ ) {
+	  if( k && p[10+9*k] != ' ' )
+		return DUMP_PARSE_BAD_ROW;
+	  if( dumpParseHex8( p + 11 + 9*k, w->words + k ) )
+		return DUMP_PARSE_BAD_HEX;
+	}
+	p += n;
+  }
+
+  l->traceRows = out->traceCount;
+  l->windowRows = out->windowCount;
+  out->length = (size_t)(p - text);
+  return DUMP_PARSE_OK;
+}
+
+// The sp row of a dump of FAULT_HANDLING_KIND_OVERFLOW, by stack id
+static const char* const overflowLabels[16] = {
+  "ovf.0", "ovf.1", "ovf.2", "ovf.3", "ovf.4", "ovf.5", "ovf.6", "ovf.7",
+  "ovf.8", "ovf.9", "ovf.A", "ovf.B", "ovf.C", "ovf.D", "ovf.E", "ovf.F"
+};
+
+int dumpParseBinary( const uint8_t* in, size_t len,
+					 const dumpParseLayout* layout, dumpParsed* out ) {
+  uint32_t values[DUMP_PARSE_MAX_VALUES];
+  faultHandlingCompressBases bases;
+  int count = faultHandlingDecompress( in, len > 0x7fffffff ?
+									   0x7fffffff : (int)len,
+									   &bases, values, DUMP_PARSE_MAX_VALUES );
+  if( count < 0 )
+	return DUMP_PARSE_BAD_ENCODING;
+  out->kind = bases.kind;
+
+  dumpParseLayout* l = &out->layout;
+  if( layout ) {
+	*l = *layout;
+	if( l->traceRows < 0 || l->traceRows > DUMP_PARSE_MAX_TRACE ||
+		l->windowRows < 0 || l->windowRows > DUMP_PARSE_MAX_WINDOWS ||
+		count != dumpParseValueCount( l ) )
+	  return DUMP_PARSE_BAD_COUNT;
+  } else {
+	// The defaults only, for anything else the caller must say
+	memset( l, 0, sizeof *l );
+	l->cortexM = 3;
+	if( count != dumpParseValueCount( l ) ) {
+	  l->cortexM = 0;
+	  if( count != dumpParseValueCount( l ) )
+		return DUMP_PARSE_BAD_COUNT;
+	}
+  }
+
+  const char* labels[DUMP_PARSE_MAX_REGS];
+  int v = 0;
+  out->regCount = labelsOf( l, labels );
+  for( int i = 0; i < out->regCount; i++ ) {
+	out->regs[i].label = labels[i];
+	out->regs[i].value = values[v++];
+  }
+  // The kind says how the text was labelled, see dumpParseText
+  if( out->kind && l->host )
+	return DUMP_PARSE_BAD_ENCODING;
+  if( out->kind & FAULT_HANDLING_KIND_HANG )
+	out->regs[3].label = "hang ";
+  if( out->kind & FAULT_HANDLING_KIND_OVERFLOW )
+	out->regs[1].label =
+	  overflowLabels[FAULT_HANDLING_KIND_STACK( out->kind )];
+  out->stackCount = DUMP_PARSE_CALLSTACK;
+  for( int i = 0; i < DUMP_PARSE_CALLSTACK; i++ ) {
+	out->stackAddrs[i] = values[v++];
+	out->stackVals[i] = values[v++];
+  }
+  // Values the text could not have held: not a dump of this layout
+  out->traceCount = l->traceRows;
+  for( int i = 0; i < l->traceRows; i++ ) {
+	out->traceIds[i] = values[v++];
+	out->traceArgs[i] = values[v++];
+	if( out->traceIds[i] > 0xffff )
+	  return DUMP_PARSE_BAD_ENCODING;
+  }
+  out->windowCount = l->windowRows;
+  for( int i = 0; i < l->windowRows; i++ ) {
+	dumpParseWindow* w = out->windows + i;
+	w->base = values[v++];
+	w->mask = values[v++];
+	if( w->mask > 0xf )
+	  return DUMP_PARSE_BAD_ENCODING;
+	for( int k = 0; k < DUMP_PARSE_WINDOW_WORDS; k++ )
+	  w->words[k] = values[v++];
+  }
+  out->length = len;
+  return DUMP_PARSE_OK;
+}
+
+const dumpParseReg* dumpParseFind( const dumpParsed* d, const char* label ) {
+  size_t n = strlen( label );
+  if( n > 5 )
+	return NULL;
+  for( int i = 0; i < d->regCount; i++ )
+	if( memcmp( d->regs[i].label, label, n ) == 0 &&
+		(n == 5 || d->regs[i].label[n] == ' ') )
+	  return d->regs + i;
+  return NULL;
+}
+
+static uint32_t valueOf( const dumpParsed* d, const char* label ) {
+  const dumpParseReg* r = dumpParseFind( d, label );
+  return r ? r->value : 0;
+}
+
+// In exception frame order, see p 278
+static const char* const frameLabels[8] = {
+  "s.r0", "s.r1", "s.r2", "s.r3", "s.r12", "s.lr", "s.pc", "s.psr"
+};
+
+uint32_t dumpParseFaultRegs( const dumpParsed* d, uint32_t regs[16],
+							 uint32_t* xpsr ) {
+  // A host's registers are not a Cortex-M's
+  if( d->layout.host ) {
+	memset( regs, 0, 16 * sizeof regs[0] );
+	if( xpsr )
+	  *xpsr = 0;
+	return 0;
+  }
+  static const char* const labels[16] = {
+	"s.r0", "s.r1", "s.r2", "s.r3", "r4", "r5", "r6", "r7", "r8", "r9",
+	"r10", "r11", "s.r12", NULL, "s.lr", "s.pc"
+  };
+  uint32_t known = 0;
+  for( int r = 0; r < 16; r++ ) {
+	const dumpParseReg* reg = labels[r] ? dumpParseFind( d, labels[r] ) :
+	  NULL;
+	regs[r] = reg ? reg->value : 0;
+	if( reg )
+	  known |= 1u << r;
+  }
+
+  /*
+	As faultHandling.c works out the faulting sp: the sp row (or
+	'ovf.N', which replaces it) is the exception frame, 8 words, 26 if
+	an FP context was stacked, plus a pad word if stacked psr bit 9
+	says so
+  */
+  uint32_t psr = valueOf( d, "s.psr" );
+  if( d->regCount > 1 ) {
+	regs[13] = d->regs[1].value +
+	  ((valueOf( d, "excrt" ) & 0x10) ? 32 : 104) +
+	  ((psr & (1 << 9)) ? 4 : 0);
+	known |= 1u << 13;
+  }
+  if( xpsr )
+	*xpsr = psr;
+  return known;
+}
+
+int dumpParseMemory( const dumpParsed* d, uint32_t* addrs,
+					 uint32_t* values, int max ) {
+  int n = 0;
+  // A host dump's s.* rows are registers, not a stacked frame
+  if( d->regCount > 1 && !d->layout.host )
+	for( int k = 0; k < 8 && n < max; k++, n++ ) {
+	  addrs[n] = d->regs[1].value + 4*(uint32_t)k;
+	  values[n] = valueOf( d, frameLabels[k] );
+	}
+  for( int k = 0; k < d->stackCount && n < max; k++ )
+	if( d->stackAddrs[k] ) {
+	  addrs[n] = d->stackAddrs[k];
+	  values[n++] = d->stackVals[k];
+	}
+  for( int k = 0; k < d->windowCount; k++ )
+	for( int w = 0; w < DUMP_PARSE_WINDOW_WORDS && n < max; w++ )
+	  if( d->windows[k].mask & (1u << w) ) {
+		addrs[n] = d->windows[k].base + 4*(uint32_t)w;
+		values[n++] = d->windows[k].words[w];
+	  }
+  return n;
+}
+
+int dumpParseFormat( const dumpParsed* d, char* buf, size_t len ) {
+  size_t n = 0;
+  int w;
+
+#define EMIT(...) do {									\
+	w = snprintf( buf + n, len - n, __VA_ARGS__ );		\
+	if( w < 0 || (size_t)w >= len - n )				\
+	  return -1;										\
+	n += (size_t)w;									\
+  } while( 0 )
+
+  if( len == 0 )
+	return -1;
+  buf[0] = 0;
+  for( int i = 0; i < d->regCount; i++ )
+	EMIT( "%.5s %08X\n", d->regs[i].label, (unsigned)d->regs[i].value );
+  for( int i = 0; i < d->stackCount; i++ )
+	EMIT( "%08X %08X\n", (unsigned)d->stackAddrs[i],
+		  (unsigned)d->stackVals[i] );
+  for( int i = 0; i < d->traceCount; i++ )
+	EMIT( "%04X %08X\n", (unsigned)(d->traceIds[i] & 0xffff),
+		  (unsigned)d->traceArgs[i] );
+  for( int i = 0; i < d->windowCount; i++ ) {
+	const dumpParseWindow* win = d->windows + i;
+	EMIT( "%08X %X", (unsigned)win->base, (unsigned)(win->mask & 0xf) );
+	for( int k = 0; k < DUMP_PARSE_WINDOW_WORDS; k++ )
+	  EMIT( " %08X", (unsigned)win->words[k] );
+	EMIT( "\n" );
+  }
+#undef EMIT
+  return (int)n;
+}
+
+const char* dumpParseError( int result ) {
+  switch( result ) {
+  case DUMP_PARSE_OK:
+	return "ok";
+  case DUMP_PARSE_TRUNCATED:
+	return "truncated";
+  case DUMP_PARSE_BAD_ROW:
+	return "bad row";
+  case DUMP_PARSE_BAD_HEX:
+	return "bad hex";
+  case DUMP_PARSE_BAD_LABEL:
+	return "bad label";
+  case DUMP_PARSE_BAD_ENCODING:
+	return "bad encoding";
+  case DUMP_PARSE_BAD_COUNT:
+	return "bad value count";
+  default:
+	return "unknown";
+  }
+}
+
+// eof
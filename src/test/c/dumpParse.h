@@ -0,0 +1,204 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#ifndef CORTEXM_FAULT_HANDLING_DUMP_PARSE_H
+#define CORTEXM_FAULT_HANDLING_DUMP_PARSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host side: one parser for fault dumps, text (as faultHandling.c
+ * formats them) or binary (as faultHandlingCompressDump packs them),
+ * for faultGuru and any other tool.
+ *
+ * No allocation: the caller supplies the dumpParsed, and text labels
+ * point into the caller's text, which must outlive it.  The text
+ * layout is fixed width (see the ROWSIZEs in faultHandling.h), so
+ * each row is checked in place at known offsets, and its hex fields
+ * decoded 8 digits at a time, as one 64-bit word (SWAR), rather than
+ * char by char.
+ *
+ * A text dump says which variant it is: its labels give CM0 or
+ * CM3/4, and which optional registers are present, its row shapes
+ * the trace and window row counts.  Every row is then validated
+ * against that variant: labels in the lib's order, exact row widths,
+ * upper-case hex.  A binary dump holds only values, so its variant is
+ * given by the caller, else inferred from the value count, for the
+ * default CM0 and CM3/4 builds only.  What the labels alone say, a
+ * hang or a stack overflow, a binary dump holds as its kind, so its
+ * labels are as the text's were.
+ *
+ * A host dump (faultHandlingHost.c), known by its h.r7 row, has
+ * rows of its own: signal number, code and address, 64-bit values as
+ * a low row and an 'h.' high row.
+ */
+
+#define DUMP_PARSE_MAX_REGS     32
+#define DUMP_PARSE_CALLSTACK    4		// FAULT_HANDLING_CALLSTACK_ENTRIES
+#define DUMP_PARSE_MAX_TRACE    64
+#define DUMP_PARSE_MAX_WINDOWS  32
+#define DUMP_PARSE_WINDOW_WORDS 4		// FAULT_HANDLING_WINDOW_WORDS
+
+// Most values any dump holds, see dumpParseValueCount
+#define DUMP_PARSE_MAX_VALUES (DUMP_PARSE_MAX_REGS + \
+							   2*DUMP_PARSE_CALLSTACK + \
+							   2*DUMP_PARSE_MAX_TRACE + \
+							   (2+DUMP_PARSE_WINDOW_WORDS)*\
+							   DUMP_PARSE_MAX_WINDOWS)
+
+// Which lib build produced the dump, see faultHandling.h
+typedef struct {
+  int cortexM;			// 0 for CM0/0+, 3 for CM3/4
+  int stackWatermark;	// FAULT_HANDLING_STACK_WATERMARK
+  int fullRegs;			// FAULT_HANDLING_FULL_REGS
+  int buildId;			// FAULT_HANDLING_BUILD_ID
+  int traceRows;		// FAULT_HANDLING_TRACE_DUMP_ENTRIES
+  int windowRows;		// FAULT_HANDLING_WINDOWS+FAULT_HANDLING_REGION_ROWS
+  int host;				// FAULT_HANDLING_HOST, faultHandlingHost.c
+} dumpParseLayout;
+
+typedef struct {
+  const char* label;	// 5 chars, space padded, NOT NUL terminated
+  uint32_t value;
+} dumpParseReg;
+
+typedef struct {
+  uint32_t base;
+  uint32_t mask;		// bit N set: word N was read
+  uint32_t words[DUMP_PARSE_WINDOW_WORDS];
+} dumpParseWindow;
+
+typedef struct {
+  dumpParseLayout layout;
+  size_t length;		// bytes of input the dump took
+  uint32_t kind;		// FAULT_HANDLING_KIND_*, see faultHandlingCompress.h
+  int regCount;
+  dumpParseReg regs[DUMP_PARSE_MAX_REGS];
+  int stackCount;
+  uint32_t stackAddrs[DUMP_PARSE_CALLSTACK];
+  uint32_t stackVals[DUMP_PARSE_CALLSTACK];
+  int traceCount;
+  uint32_t traceIds[DUMP_PARSE_MAX_TRACE];
+  uint32_t traceArgs[DUMP_PARSE_MAX_TRACE];
+  int windowCount;
+  dumpParseWindow windows[DUMP_PARSE_MAX_WINDOWS];
+} dumpParsed;
+
+typedef enum { DUMP_PARSE_OK = 0,
+			   DUMP_PARSE_TRUNCATED = -1,	// input ends mid dump
+			   DUMP_PARSE_BAD_ROW = -2,		// wrong width or separators
+			   DUMP_PARSE_BAD_HEX = -3,		// not 8 upper-case hex digits
+			   DUMP_PARSE_BAD_LABEL = -4,	// not the variant's next label
+			   DUMP_PARSE_BAD_ENCODING = -5,	// binary: failed to decompress
+			   DUMP_PARSE_BAD_COUNT = -6		// binary: wrong value count
+} dumpParseResult;
+
+/**
+ * Parse the text dump starting at @p text (its r7 row).  Rows end
+ * '\n' or '\r\n'.  The dump ends at the end of input, a NUL, or any
+ * line which is not a trace or window row, so a stream of dumps is
+ * parsed by repeated calls, advancing by out->length.
+ *
+ * @return DUMP_PARSE_OK, or a (negative) dumpParseResult.
+ */
+int dumpParseText( const char* text, size_t len, dumpParsed* out );
+
+/**
+ * Parse a binary dump.  @p layout may be NULL for a default CM0 or
+ * CM3/4 build.  Labels point at constant strings.
+ *
+ * @return DUMP_PARSE_OK, or a (negative) dumpParseResult.
+ */
+int dumpParseBinary( const uint8_t* in, size_t len,
+					 const dumpParseLayout* layout, dumpParsed* out );
+
+/**
+ * @return count of values, hence registers plus 2 per call stack and
+ * trace row, plus 6 per window row, in a dump of @p layout.
+ */
+int dumpParseValueCount( const dumpParseLayout* layout );
+
+/**
+ * @return the register labelled @p label (without its space padding),
+ * or NULL.
+ */
+const dumpParseReg* dumpParseFind( const dumpParsed* d, const char* label );
+
+/**
+ * The core registers as the faulting code had them, r0 to r15 (as
+ * DWARF, and gdb, number them): the stacked r0-r3, r12, lr and pc,
+ * r7, r4-r11 from a full registers dump, and sp as it was before the
+ * exception frame was pushed.  The rest are 0.  None at all for a
+ * host dump.
+ *
+ * @param xpsr - if non-NULL, receives the stacked xPSR.
+ *
+ * @return mask of the registers known, bit N for rN.
+ */
+uint32_t dumpParseFaultRegs( const dumpParsed* d, uint32_t regs[16],
+							 uint32_t* xpsr );
+
+/**
+ * Every word of memory the dump holds: the exception frame, the call
+ * stack rows (bar unused, zero, ones) and the words read of each
+ * window and region row.
+ *
+ * @return count of words, at most @p max, in dump order, so an
+ * address may repeat.
+ */
+int dumpParseMemory( const dumpParsed* d, uint32_t* addrs,
+					 uint32_t* values, int max );
+
+/**
+ * Format @p d back to text, exactly as the lib would, into @p buf.
+ *
+ * @return length, or -1 if @p len is too small.
+ */
+int dumpParseFormat( const dumpParsed* d, char* buf, size_t len );
+
+/**
+ * Decode exactly 8 upper-case hex digits at @p s.
+ *
+ * @return 0, or -1 if any is not one.
+ */
+int dumpParseHex8( const char* s, uint32_t* value );
+
+const char* dumpParseError( int result );
+
+#endif
+
+// eof
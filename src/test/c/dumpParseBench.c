@@ -0,0 +1,245 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "faultHandlingCompress.h"
+#include "dumpParse.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: how fast dumpParse.c is.  A synthetic stream of CM3
+ * dumps, some with trace and window rows, is parsed end to end,
+ * as faultGuru's batch mode does, then the same dumps compressed and
+ * parsed as binary.  The hex decoding itself is timed SWAR
+ * (dumpParseHex8) against char by char.
+ *
+ * $ make dumpParseBench
+ * $ ./dumpParseBench -n 200000
+ *
+ * Options:
+ *
+ * -n N   dumps (default 100000)
+ * -r N   repeat each timing N times, report the best (default 5)
+ */
+
+static double now( void ) {
+  struct timespec t;
+  clock_gettime( CLOCK_MONOTONIC, &t );
+  return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+static int scalarHex8( const char* s, uint32_t* value ) {
+  uint32_t v = 0;
+  for( int i = 0; i < 8; i++ ) {
+	char c = s[i];
+	if( c >= '0' && c <= '9' )
+	  v = (v << 4) | (uint32_t)(c - '0');
+	else if( c >= 'A' && c <= 'F' )
+	  v = (v << 4) | (uint32_t)(c - 'A' + 10);
+	else
+	  return -1;
+  }
+  *value = v;
+  return 0;
+}
+
+static const char* const labels[] = {
+  "r7   ", "sp   ", "excrt", "psr  ", "hfsr ", "cfsr ", "mmfar", "bfar ",
+  "shcsr", "s.r0 ", "s.r1 ", "s.r2 ", "s.r3 ", "s.r12", "s.lr ", "s.pc ",
+  "s.psr"
+};
+
+// One in four dumps has trace and window rows too
+static void synthesize( dumpParsed* d, long i ) {
+  d->regCount = (int)(sizeof labels / sizeof labels[0]);
+  for( int r = 0; r < d->regCount; r++ ) {
+	d->regs[r].label = labels[r];
+	d->regs[r].value = (uint32_t)rand() * 2654435761u;
+  }
+  d->regs[1].value = 0x2001FF00 + 8 * (uint32_t)(rand() % 16);
+  d->stackCount = DUMP_PARSE_CALLSTACK;
+  for( int k = 0; k < DUMP_PARSE_CALLSTACK; k++ ) {
+	d->stackAddrs[k] = d->regs[1].value + 0x20 + 4 * (uint32_t)k;
+	d->stackVals[k] = 0x1000 + (uint32_t)(rand() % 0x10000);
+  }
+  int extra = (i % 4) == 3;
+  d->traceCount = extra ? 8 : 0;
+  for( int k = 0; k < d->traceCount; k++ ) {
+	d->traceIds[k] = (uint32_t)(rand() & 0xffff);
+	d->traceArgs[k] = (uint32_t)rand();
+  }
+  d->windowCount = extra ? 2 : 0;
+  for( int k = 0; k < d->windowCount; k++ ) {
+	d->windows[k].base = 0x20000000 + 0x10 * (uint32_t)(rand() % 0x1000);
+	d->windows[k].mask = 0xf;
+	for( int w = 0; w < DUMP_PARSE_WINDOW_WORDS; w++ )
+	  d->windows[k].words[w] = (uint32_t)rand();
+  }
+  d->layout.traceRows = d->traceCount;
+  d->layout.windowRows = d->windowCount;
+}
+
+int main( int argc, char* argv[] ) {
+
+  long count = 100000;
+  int repeats = 5;
+
+  for( int i = 1; i < argc; i++ ) {
+	if( strcmp( argv[i], "-n" ) == 0 && i+1 < argc )
+	  count = atol( argv[++i] );
+	else if( strcmp( argv[i], "-r" ) == 0 && i+1 < argc )
+	  repeats = atoi( argv[++i] );
+	else {
+	  fprintf( stderr, "Usage: %s [-n dumps] [-r repeats]\n", argv[0] );
+	  return 1;
+	}
+  }
+  if( count < 1 || repeats < 1 )
+	return 1;
+
+  // The text stream, and the binary dumps, each with its layout
+  size_t capacity = (size_t)count * 1024;
+  char* text = malloc( capacity );
+  uint8_t* packed = malloc( (size_t)count * 512 );
+  size_t* packedAt = malloc( ((size_t)count + 1) * sizeof(size_t) );
+  dumpParseLayout* layouts = malloc( (size_t)count * sizeof *layouts );
+  size_t length = 0, packedLength = 0;
+  long values = 0;
+  static dumpParsed d;
+  memset( &d, 0, sizeof d );
+  d.layout.cortexM = 3;
+  srand( 1 );
+  for( long i = 0; i < count; i++ ) {
+	synthesize( &d, i );
+	int n = dumpParseFormat( &d, text + length, capacity - length );
+	faultHandlingCompressBases bases = { 0x1000, 0x20020000,
+										 d.regs[1].value };
+	packedAt[i] = packedLength;
+	int p = faultHandlingCompress( text + length, &bases,
+								   packed + packedLength, 512 );
+	if( n < 0 || p < 0 )
+	  return 2;
+	length += (size_t)n;
+	packedLength += (size_t)p;
+	layouts[i] = d.layout;
+	values += dumpParseValueCount( &d.layout );
+  }
+  packedAt[count] = packedLength;
+
+  double best = 1e9;
+  long parsed = 0;
+  for( int r = 0; r < repeats; r++ ) {
+	double t0 = now();
+	parsed = 0;
+	for( size_t at = 0; at < length; parsed++ ) {
+	  if( dumpParseText( text + at, length - at, &d ) ) {
+		fprintf( stderr, "Parse failed at %zu\n", at );
+		return 2;
+	  }
+	  at += d.length;
+	}
+	double t = now() - t0;
+	if( t < best )
+	  best = t;
+  }
+  printf( "text:    %ld dumps, %.1f MB in %.1f ms: %.0f MB/s, %.0f dumps/s\n",
+		  parsed, (double)length / 1e6, best * 1e3,
+		  (double)length / 1e6 / best, (double)parsed / best );
+
+  best = 1e9;
+  for( int r = 0; r < repeats; r++ ) {
+	double t0 = now();
+	for( long i = 0; i < count; i++ )
+	  if( dumpParseBinary( packed + packedAt[i],
+						   packedAt[i+1] - packedAt[i], layouts + i, &d ) ) {
+		fprintf( stderr, "Binary parse failed, dump %ld\n", i );
+		return 2;
+	  }
+	double t = now() - t0;
+	if( t < best )
+	  best = t;
+  }
+  printf( "binary:  %ld dumps, %.1f MB in %.1f ms: %.0f MB/s, %.0f dumps/s\n",
+		  count, (double)packedLength / 1e6, best * 1e3,
+		  (double)packedLength / 1e6 / best, (double)count / best );
+
+  // Hex alone: every 8 digit field of the stream, in place
+  size_t fields = 0;
+  const char** at = malloc( (size_t)values * sizeof *at );
+  for( size_t i = 0; i + 8 <= length && fields < (size_t)values; i++ )
+	if( (i == 0 || text[i-1] == ' ') && text[i+8] <= ' ' )
+	  at[fields++] = text + i;
+
+  double simd = 1e9, scalar = 1e9;
+  uint32_t sum = 0, check = 0;
+  for( int r = 0; r < repeats; r++ ) {
+	uint32_t v = 0;
+	double t0 = now();
+	for( size_t i = 0; i < fields; i++ ) {
+	  dumpParseHex8( at[i], &v );
+	  sum += v;
+	}
+	double t1 = now();
+	for( size_t i = 0; i < fields; i++ ) {
+	  scalarHex8( at[i], &v );
+	  check += v;
+	}
+	double t2 = now();
+	if( t1 - t0 < simd )
+	  simd = t1 - t0;
+	if( t2 - t1 < scalar )
+	  scalar = t2 - t1;
+  }
+  if( sum != check ) {
+	fprintf( stderr, "SWAR and scalar hex disagree\n" );
+	return 2;
+  }
+  printf( "hex8:    %zu fields: SWAR %.2f ns, scalar %.2f ns per field, "
+		  "%.1fx\n", fields, simd * 1e9 / (double)fields,
+		  scalar * 1e9 / (double)fields, scalar / simd );
+
+  free( at );
+  free( layouts );
+  free( packedAt );
+  free( packed );
+  free( text );
+  return 0;
+}
+
+// eof
@@ -0,0 +1,380 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "faultHandlingCompress.h"
+#include "dumpParse.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: fuzz dumpParse.c.  Seed dumps, from files and built in
+ * (every layout variant, text and compressed), are mutated at random
+ * and parsed.  Whatever the input, the parser must not read outside
+ * it (build with ASan, as the Makefile does), and anything it accepts
+ * must survive format then reparse unchanged.  dumpParseHex8 is also
+ * checked against a char-by-char decode of random 8 byte strings.
+ *
+ * $ make dumpParseFuzz
+ * $ ./dumpParseFuzz -n 1000000 src/test/resources/dumps/quiz*.txt
+ *
+ * Options:
+ *
+ * -n N   iterations (default 100000)
+ * -s N   random seed (default 1)
+ *
+ * Built with -DDUMP_PARSE_LIBFUZZER, and -fsanitize=fuzzer (clang),
+ * the same checks run under libFuzzer instead, via
+ * LLVMFuzzerTestOneInput.
+ */
+
+#define MAX_SEEDS 128
+#define MAX_INPUT 8192
+
+static struct {
+  uint8_t* bytes;
+  size_t length;
+  int binary;
+  dumpParseLayout layout;		// binary seeds only
+} seeds[MAX_SEEDS];
+static int seedCount = 0;
+
+static void fail( const char* what, const uint8_t* in, size_t len ) {
+  fprintf( stderr, "FAIL: %s, input (%zu bytes):\n", what, len );
+  fwrite( in, 1, len, stderr );
+  fprintf( stderr, "\n" );
+  abort();
+}
+
+static int sameDump( const dumpParsed* a, const dumpParsed* b ) {
+  if( a->regCount != b->regCount || a->stackCount != b->stackCount ||
+	  a->traceCount != b->traceCount || a->windowCount != b->windowCount )
+	return 0;
+  for( int i = 0; i < a->regCount; i++ )
+	if( memcmp( a->regs[i].label, b->regs[i].label, 5 ) ||
+		a->regs[i].value != b->regs[i].value )
+	  return 0;
+  return !memcmp( a->stackAddrs, b->stackAddrs,
+				  a->stackCount * sizeof(uint32_t) ) &&
+	!memcmp( a->stackVals, b->stackVals,
+			 a->stackCount * sizeof(uint32_t) ) &&
+	!memcmp( a->traceIds, b->traceIds, a->traceCount * sizeof(uint32_t) ) &&
+	!memcmp( a->traceArgs, b->traceArgs,
+			 a->traceCount * sizeof(uint32_t) ) &&
+	!memcmp( a->windows, b->windows,
+			 a->windowCount * sizeof(dumpParseWindow) );
+}
+
+// Accepted, so must round trip: format, reparse, same again
+static void roundTrip( const dumpParsed* d, const uint8_t* in, size_t len ) {
+  static char text[MAX_INPUT * 2];
+  static dumpParsed again;
+  int n = dumpParseFormat( d, text, sizeof text );
+  if( n < 0 )
+	fail( "format", in, len );
+  if( dumpParseText( text, (size_t)n, &again ) != DUMP_PARSE_OK )
+	fail( "reparse", in, len );
+  if( (size_t)n != again.length || !sameDump( d, &again ) )
+	fail( "round trip", in, len );
+}
+
+/*
+  As text, and as binary, of the given layout, else of a default one.
+*/
+static void checkOne( const uint8_t* data, size_t len,
+					  const dumpParseLayout* layout ) {
+  static dumpParsed d;
+
+  // An exact size copy, so ASan sees any read past the end
+  uint8_t* in = malloc( len ? len : 1 );
+  memcpy( in, data, len );
+
+  if( dumpParseText( (const char*)in, len, &d ) == DUMP_PARSE_OK ) {
+	if( d.length > len )
+	  fail( "length", in, len );
+	roundTrip( &d, in, len );
+  }
+  if( dumpParseBinary( in, len, layout, &d ) == DUMP_PARSE_OK )
+	roundTrip( &d, in, len );
+
+  free( in );
+}
+
+#ifdef DUMP_PARSE_LIBFUZZER
+
+int LLVMFuzzerTestOneInput( const uint8_t* data, size_t len ) {
+  checkOne( data, len, NULL );
+  return 0;
+}
+
+#else
+
+static uint32_t rng = 1;
+
+// xorshift32, so runs repeat for a given -s on any host
+static uint32_t next( void ) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static int scalarHex8( const char* s, uint32_t* value ) {
+  uint32_t v = 0;
+  for( int i = 0; i < 8; i++ ) {
+	char c = s[i];
+	if( c >= '0' && c <= '9' )
+	  v = (v << 4) | (uint32_t)(c - '0');
+	else if( c >= 'A' && c <= 'F' )
+	  v = (v << 4) | (uint32_t)(c - 'A' + 10);
+	else
+	  return -1;
+  }
+  *value = v;
+  return 0;
+}
+
+static void checkHex8( void ) {
+  static const char near[] = "0123456789ABCDEF/:@G`afg \n\x7f\x80\xff";
+  char s[8];
+  for( int i = 0; i < 8; i++ )
+	s[i] = (next() & 1) ? (char)next() : near[next() % (sizeof near - 1)];
+  uint32_t a = 0, b = 0;
+  int ra = dumpParseHex8( s, &a );
+  int rb = scalarHex8( s, &b );
+  if( ra != rb || (ra == 0 && a != b) )
+	fail( "hex8", (const uint8_t*)s, 8 );
+}
+
+static void addSeed( const void* bytes, size_t length, int binary,
+					 const dumpParseLayout* layout ) {
+  if( seedCount == MAX_SEEDS || length > MAX_INPUT )
+	return;
+  seeds[seedCount].bytes = malloc( length );
+  memcpy( seeds[seedCount].bytes, bytes, length );
+  seeds[seedCount].length = length;
+  seeds[seedCount].binary = binary;
+  if( layout )
+	seeds[seedCount].layout = *layout;
+  seedCount++;
+}
+
+// The text, and its compressed form, as the target would send either
+static void addDump( const dumpParsed* d ) {
+  static char text[MAX_INPUT];
+  uint8_t packed[MAX_INPUT];
+  int n = dumpParseFormat( d, text, sizeof text );
+  if( n < 0 )
+	return;
+  addSeed( text, (size_t)n, 0, NULL );
+  faultHandlingCompressBases bases = { 0x100, 0x20020000, d->regs[1].value };
+  int p = faultHandlingCompress( text, &bases, packed, sizeof packed );
+  if( p > 0 )
+	addSeed( packed, (size_t)p, 1, &d->layout );
+}
+
+// One dump per layout variant, values random
+static void builtInSeeds( void ) {
+  static const char* const labels[] = {
+	"r7   ", "sp   ", "excrt", "psr  ", "hfsr ", "cfsr ", "mmfar",
+	"bfar ", "shcsr", "s.r0 ", "s.r1 ", "s.r2 ", "s.r3 ", "s.r12",
+	"s.lr ", "s.pc ", "s.psr", "sfree", "r4   ", "r5   ", "r6   ",
+	"r8   ", "r9   ", "r10  ", "r11  ", "msp  ", "psp  ", "ctrl ",
+	"pmask", "bpri ", "build"
+  };
+  static dumpParsed d;
+  for( int variant = 0; variant < 32; variant++ ) {
+	dumpParseLayout l = { (variant & 1) ? 3 : 0, (variant >> 1) & 1,
+						  (variant >> 2) & 1, (variant >> 3) & 1,
+						  (variant >> 4) & 1 ? 3 : 0,
+						  (variant >> 4) & 1 ? 2 : 0, 0 };
+	d.layout = l;
+	d.regCount = 0;
+	for( int i = 0; i < (int)(sizeof labels / sizeof labels[0]); i++ ) {
+	  int cm3 = i >= 4 && i <= 7;
+	  if( (cm3 && !l.cortexM) || (i == 17 && !l.stackWatermark) ||
+		  (i >= 18 && i <= 28 && !l.fullRegs) ||
+		  (i == 29 && !(l.fullRegs && l.cortexM)) ||
+		  (i == 30 && !l.buildId) )
+		continue;
+	  d.regs[d.regCount].label = labels[i];
+	  d.regs[d.regCount++].value = next();
+	}
+	d.stackCount = DUMP_PARSE_CALLSTACK;
+	for( int i = 0; i < DUMP_PARSE_CALLSTACK; i++ ) {
+	  d.stackAddrs[i] = 0x2001FFE0 + 4*(uint32_t)i;
+	  d.stackVals[i] = next();
+	}
+	d.traceCount = l.traceRows;
+	for( int i = 0; i < l.traceRows; i++ ) {
+	  d.traceIds[i] = next() & 0xffff;
+	  d.traceArgs[i] = next();
+	}
+	d.windowCount = l.windowRows;
+	for( int i = 0; i < l.windowRows; i++ ) {
+	  d.windows[i].base = next() & ~3u;
+	  d.windows[i].mask = next() & 0xf;
+	  for( int k = 0; k < DUMP_PARSE_WINDOW_WORDS; k++ )
+		d.windows[i].words[k] = next();
+	}
+	addDump( &d );
+  }
+}
+
+static int fileSeed( const char* path ) {
+  static uint8_t buf[MAX_INPUT];
+  FILE* fp = fopen( path, "rb" );
+  if( !fp ) {
+	perror( path );
+	return -1;
+  }
+  size_t n = fread( buf, 1, sizeof buf, fp );
+  fclose( fp );
+  addSeed( buf, n, 0, NULL );
+  return 0;
+}
+
+// Mostly small edits, so most mutants still look like dumps
+static size_t mutate( uint8_t* buf, size_t len, size_t max ) {
+  static const char chars[] = "0123456789ABCDEF \n\r.:aG";
+  int edits = 1 + (int)(next() % 4);
+  for( int e = 0; e < edits; e++ ) {
+	size_t at = len ? next() % len : 0;
+	switch( next() % 7 ) {
+	case 0:
+	  if( len )
+		buf[at] ^= (uint8_t)(1 << (next() % 8));
+	  break;
+	case 1:
+	  if( len )
+		buf[at] = (uint8_t)chars[next() % (sizeof chars - 1)];
+	  break;
+	case 2:
+	  if( len < max ) {
+		memmove( buf + at + 1, buf + at, len - at );
+		buf[at] = (uint8_t)chars[next() % (sizeof chars - 1)];
+		len++;
+	  }
+	  break;
+	case 3:
+	  if( len ) {
+		memmove( buf + at, buf + at + 1, len - at - 1 );
+		len--;
+	  }
+	  break;
+	case 4:
+	  len = at;
+	  break;
+	case 5: {
+	  // Repeat a chunk, e.g. a row, or a whole dump
+	  size_t n = next() % 64;
+	  if( at + n <= len && len + n <= max ) {
+		memmove( buf + at + n, buf + at, len - at );
+		len += n;
+	  }
+	  break;
+	}
+	default:
+	  if( len )
+		buf[at] = (uint8_t)next();
+	}
+  }
+  return len;
+}
+
+int main( int argc, char* argv[] ) {
+
+  long iterations = 100000;
+
+  int i;
+  for( i = 1; i < argc && argv[i][0] == '-'; i++ ) {
+	if( strcmp( argv[i], "-n" ) == 0 && i+1 < argc )
+	  iterations = atol( argv[++i] );
+	else if( strcmp( argv[i], "-s" ) == 0 && i+1 < argc )
+	  rng = (uint32_t)strtoul( argv[++i], NULL, 0 ) | 1;
+	else {
+	  fprintf( stderr, "Usage: %s [-n iterations] [-s seed] "
+			   "[dumpFile...]\n", argv[0] );
+	  return 1;
+	}
+  }
+  for( ; i < argc; i++ )
+	if( fileSeed( argv[i] ) )
+	  return 1;
+  builtInSeeds();
+
+  // Every seed must parse as is
+  for( int s = 0; s < seedCount; s++ ) {
+	static dumpParsed d;
+	int r = seeds[s].binary ?
+	  dumpParseBinary( seeds[s].bytes, seeds[s].length, &seeds[s].layout,
+					   &d ) :
+	  dumpParseText( (const char*)seeds[s].bytes, seeds[s].length, &d );
+	if( r != DUMP_PARSE_OK )
+	  fail( dumpParseError( r ), seeds[s].bytes, seeds[s].length );
+	checkOne( seeds[s].bytes, seeds[s].length, &seeds[s].layout );
+  }
+
+  static uint8_t buf[MAX_INPUT * 2];
+  long results[8] = { 0 };
+  for( long n = 0; n < iterations; n++ ) {
+	int s = (int)(next() % (uint32_t)seedCount);
+	memcpy( buf, seeds[s].bytes, seeds[s].length );
+	size_t len = mutate( buf, seeds[s].length, sizeof buf );
+	const dumpParseLayout* layout = seeds[s].binary ?
+	  &seeds[s].layout : NULL;
+	checkOne( buf, len, layout );
+
+	static dumpParsed d;
+	int r = seeds[s].binary ? dumpParseBinary( buf, len, layout, &d ) :
+	  dumpParseText( (const char*)buf, len, &d );
+	results[-r]++;
+	checkHex8();
+  }
+
+  printf( "%d seeds\n", seedCount );
+  printf( "%ld mutants, %ld hex8 checks, no failures\n", iterations,
+		  iterations );
+  for( int r = 0; r < 7; r++ )
+	if( results[r] )
+	  printf( "%10ld %s\n", results[r], dumpParseError( -r ) );
+  return 0;
+}
+
+#endif
+
+// eof
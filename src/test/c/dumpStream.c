@@ -0,0 +1,301 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <string.h>
+
+#include "dumpStream.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Fault dump framing over a byte stream, see dumpStream.h.
+ */
+
+enum { IDLE, TEXT, BINARY };
+
+// Through a binary dump, see faultHandlingCompress.h
+enum { COUNT, BASES, VALUES, CHECKSUM };
+
+#define VARINT_MAX 5
+
+static int startsDump( const char* line, size_t length ) {
+  return length >= 5 && memcmp( line, "r7   ", 5 ) == 0;
+}
+
+void dumpStreamInit( dumpStream* s, dumpStreamHandler handler,
+					 void* context ) {
+  memset( s, 0, sizeof *s );
+  s->handler = handler;
+  s->context = context;
+  s->state = IDLE;
+}
+
+int dumpStreamWhole( const dumpStream* s ) {
+  return s->state == TEXT && s->whole;
+}
+
+static void emit( dumpStream* s, int result, const void* raw,
+				  size_t length ) {
+  if( result == DUMP_PARSE_OK )
+	s->dumps++;
+  else
+	s->rejected++;
+  s->handler( s->context, result, &s->parsed, (const uint8_t*)raw,
+			  length );
+}
+
+/*
+  The text dump so far is a whole dump, or the start of one, or
+  neither: TRUNCATED means rows still to come, OK that it is a dump,
+  though trace or window rows may yet follow.
+*/
+static int parseText( dumpStream* s ) {
+  return dumpParseText( s->text, s->textLength, &s->parsed );
+}
+
+static void endText( dumpStream* s ) {
+  int result = parseText( s );
+  if( result == DUMP_PARSE_OK )
+	emit( s, result, s->text, s->parsed.length );
+  else
+	emit( s, result, s->text, s->textLength );
+  s->state = IDLE;
+}
+
+static void lineDone( dumpStream* s ) {
+  size_t length = s->lineLength;
+  s->lineLength = 0;
+  // Too long for a row: noise, which ends any text dump
+  if( length > sizeof s->line ) {
+	if( s->state == TEXT )
+	  endText( s );
+	return;
+  }
+
+  if( s->state == IDLE ) {
+	if( !startsDump( s->line, length ) )
+	  return;
+	s->state = TEXT;
+	s->textLength = 0;
+	s->whole = 0;
+  }
+
+  if( s->textLength + length > sizeof s->text ) {
+	endText( s );
+	return;
+  }
+  memcpy( s->text + s->textLength, s->line, length );
+  s->textLength += length;
+
+  int result = parseText( s );
+  s->whole = result == DUMP_PARSE_OK;
+  if( result == DUMP_PARSE_TRUNCATED ||
+	  (result == DUMP_PARSE_OK && s->parsed.length == s->textLength) )
+	return;
+
+  if( result == DUMP_PARSE_OK ) {
+	// Complete, and this line is not of it, but may start the next
+	emit( s, result, s->text, s->parsed.length );
+	s->state = IDLE;
+	if( startsDump( s->line, length ) ) {
+	  s->state = TEXT;
+	  memcpy( s->text, s->line, length );
+	  s->textLength = length;
+	  s->whole = 0;
+	}
+	return;
+  }
+
+  // Cut short, e.g. by a reset, so this line may start a new dump
+  size_t before = s->textLength - length;
+  if( before && startsDump( s->line, length ) ) {
+	s->textLength = before;
+	emit( s, result, s->text, before );
+	memcpy( s->text, s->line, length );
+	s->textLength = length;
+	s->whole = 0;
+	return;
+  }
+  emit( s, result, s->text, s->textLength );
+  s->state = IDLE;
+}
+
+static void feedText( dumpStream* s, uint8_t c ) {
+  if( s->lineLength < sizeof s->line )
+	s->line[s->lineLength] = (char)c;
+  // Count on, so an overlong line is known, without wrapping
+  if( s->lineLength <= sizeof s->line )
+	s->lineLength++;
+  if( c == '\n' )
+	lineDone( s );
+}
+
+static void startBinary( dumpStream* s ) {
+  if( s->state == TEXT )
+	endText( s );
+  s->lineLength = 0;
+  s->state = BINARY;
+  s->binary[0] = FAULT_HANDLING_COMPRESS_MAGIC;
+  s->binaryLength = 1;
+  s->phase = COUNT;
+  s->varint = 0;
+  s->varintBytes = 0;
+}
+
+/*
+  The binary dump's next byte: 1 when it completes the dump, -1 if it
+  cannot be one, else 0.
+*/
+static int binaryStep( dumpStream* s, uint8_t b ) {
+  if( s->binaryLength == sizeof s->binary )
+	return -1;
+  s->binary[s->binaryLength++] = b;
+
+  if( s->phase == CHECKSUM )
+	return 1;
+  if( s->phase == VALUES && s->tagNext ) {
+	if( b >= FAULT_HANDLING_BASE_COUNT )
+	  return -1;
+	s->tagNext = 0;
+	return 0;
+  }
+
+  // Otherwise a varint byte
+  if( ++s->varintBytes > VARINT_MAX )
+	return -1;
+  s->varint |= (uint32_t)(b & 0x7f) << (7 * (s->varintBytes - 1));
+  if( b & 0x80 )
+	return 0;
+  uint32_t v = s->varint;
+  s->varint = 0;
+  s->varintBytes = 0;
+
+  switch( s->phase ) {
+  case COUNT:
+	if( v > DUMP_PARSE_MAX_VALUES )
+	  return -1;
+	s->count = v;
+	s->items = 4;				// textStart, stackTop, sp, kind
+	s->phase = BASES;
+	break;
+  case BASES:
+	if( --s->items == 0 ) {
+	  s->items = s->count;
+	  s->phase = s->items ? VALUES : CHECKSUM;
+	  s->tagNext = 1;
+	}
+	break;
+  case VALUES:
+	s->tagNext = 1;
+	if( --s->items == 0 )
+	  s->phase = CHECKSUM;
+	break;
+  }
+  return 0;
+}
+
+/*
+  @p step 1: the binary dump is complete, -1: it cannot be one, 0: the
+  stream ended mid dump.  If not a dump after all, a stray 0xFD or a
+  dump corrupted, what followed the magic may be text, even a dump,
+  so is rescanned, before any bytes still to be rescanned.
+*/
+static void endBinary( dumpStream* s, int step ) {
+  s->state = IDLE;
+  int result = step ? DUMP_PARSE_BAD_ENCODING : DUMP_PARSE_TRUNCATED;
+  if( step > 0 ) {
+	result = dumpParseBinary( s->binary, s->binaryLength, NULL,
+							  &s->parsed );
+	if( result == DUMP_PARSE_OK ) {
+	  emit( s, result, s->binary, s->binaryLength );
+	  return;
+	}
+  }
+  emit( s, result, s->binary, s->binaryLength );
+
+  /*
+	A binary dump starting in the outer input starts with nothing left
+	to rescan, else it is all rescan bytes, so the two together fit
+  */
+  size_t rest = s->binaryLength - 1;
+  size_t remain = s->rescanLength - s->rescanAt;
+  if( rest + remain > sizeof s->rescan )
+	remain = sizeof s->rescan - rest;
+  memmove( s->rescan + rest, s->rescan + s->rescanAt, remain );
+  memcpy( s->rescan, s->binary + 1, rest );
+  s->rescanAt = 0;
+  s->rescanLength = rest + remain;
+}
+
+static void feedByte( dumpStream* s, uint8_t c ) {
+  if( s->state == BINARY ) {
+	int step = binaryStep( s, c );
+	if( step )
+	  endBinary( s, step );
+  } else if( c == FAULT_HANDLING_COMPRESS_MAGIC )
+	startBinary( s );
+  else
+	feedText( s, c );
+}
+
+static void drain( dumpStream* s ) {
+  while( s->rescanAt < s->rescanLength )
+	feedByte( s, s->rescan[s->rescanAt++] );
+}
+
+void dumpStreamFeed( dumpStream* s, const uint8_t* data, size_t length ) {
+  s->bytes += length;
+  for( size_t i = 0; i < length; i++ ) {
+	feedByte( s, data[i] );
+	drain( s );
+  }
+}
+
+void dumpStreamFlush( dumpStream* s ) {
+  // Unfinished, so perhaps not binary at all
+  while( s->state == BINARY ) {
+	endBinary( s, 0 );
+	drain( s );
+  }
+  if( s->state == TEXT ) {
+	// A last row with no line end is still a row
+	if( s->lineLength )
+	  feedText( s, '\n' );
+	if( s->state == TEXT )
+	  endText( s );
+  }
+  s->lineLength = 0;
+}
+
+// eof
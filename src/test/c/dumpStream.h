@@ -0,0 +1,136 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#ifndef CORTEXM_FAULT_HANDLING_DUMP_STREAM_H
+#define CORTEXM_FAULT_HANDLING_DUMP_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "faultHandlingCompress.h"
+#include "dumpParse.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host side: frame fault dumps out of a raw byte stream, e.g. a
+ * board's serial console, where dumps arrive amid boot banners, debug
+ * prints and line noise, in pieces of any size.  Bytes are fed in as
+ * read, each dump is handed to a callback as soon as it is complete,
+ * parsed by dumpParse.c.
+ *
+ * A text dump starts at an r7 row.  Each row is checked as it arrives
+ * (the dump so far is reparsed, a few dozen rows at most), so a dump
+ * cut short, by a reset mid-dump say, is known at its first bad row.
+ * Trace and window rows are optional, so a dump is known complete
+ * only at the next line which is not one, or by dumpStreamFlush,
+ * which the caller calls when the stream goes away, or quiet with
+ * dumpStreamWhole true.
+ *
+ * A binary (compressed) dump starts at the 0xFD magic, which no
+ * console text holds.  Its length is known from its own varints as
+ * they arrive, see faultHandlingCompress.h, and it must decompress,
+ * checksum and all, else the bytes after the magic are rescanned as
+ * text, so a stray 0xFD loses nothing.  Binary dumps must be of the
+ * default CM0 or CM3/4 layouts, see dumpParseBinary.
+ *
+ * No allocation, no I/O: one dumpStream per byte stream.
+ */
+
+#define DUMP_STREAM_LINE   128		// longer lines are noise, not rows
+#define DUMP_STREAM_TEXT   4096		// biggest text dump, with '\r\n's
+#define DUMP_STREAM_BINARY FAULT_HANDLING_COMPRESS_SIZE(DUMP_PARSE_MAX_VALUES)
+
+/**
+ * A dump framed: @p result is DUMP_PARSE_OK and @p d the dump, or a
+ * (negative) dumpParseResult, the dump rejected.  @p raw is the
+ * dump's bytes as received.  All valid during the call only.
+ */
+typedef void (*dumpStreamHandler)( void* context, int result,
+								   const dumpParsed* d,
+								   const uint8_t* raw, size_t length );
+
+typedef struct {
+  dumpStreamHandler handler;
+  void* context;
+  int state;						// see dumpStream.c
+  char line[DUMP_STREAM_LINE];		// the line being received
+  size_t lineLength;				// beyond the buffer if too long
+  char text[DUMP_STREAM_TEXT];		// the text dump being received
+  size_t textLength;
+  int whole;						// as far as it must go, see below
+  uint8_t binary[DUMP_STREAM_BINARY];	// the binary dump...
+  size_t binaryLength;
+  int phase;						// ...and how far through it
+  uint32_t count;
+  uint32_t items;
+  int tagNext;
+  int varintBytes;
+  uint32_t varint;
+  uint8_t rescan[DUMP_STREAM_BINARY];	// bytes of a failed binary dump
+  size_t rescanLength;
+  size_t rescanAt;
+  dumpParsed parsed;
+  // Statistics
+  unsigned long bytes;
+  unsigned long dumps;
+  unsigned long rejected;
+} dumpStream;
+
+void dumpStreamInit( dumpStream* s, dumpStreamHandler handler,
+					 void* context );
+
+/**
+ * Feed the next @p length bytes of the stream, the handler is called
+ * for each dump they complete.
+ */
+void dumpStreamFeed( dumpStream* s, const uint8_t* data, size_t length );
+
+/**
+ * The stream is quiet, or gone: a dump in progress is complete, as
+ * far as it goes.
+ */
+void dumpStreamFlush( dumpStream* s );
+
+/**
+ * @return 1 if a text dump in progress has every row it must, so only
+ * trace or window rows, if any, may follow.  A stream going quiet then
+ * means the dump is done, else a board slow to send its rows, which
+ * a flush would cut short.
+ */
+int dumpStreamWhole( const dumpStream* s );
+
+#endif
+
+// eof
@@ -0,0 +1,395 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dumpParse.h"
+#include "elfSymbols.h"
+#include "dwarfUnwind.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: the exact backtrace of a fault dump, by the .axf's DWARF
+ * call frame information (see dwarfUnwind.c), and a verdict on each
+ * of the dump's call stack rows, the candidate LRs of the on-target
+ * pushed-LR search: a real return address, or just an odd word in
+ * the code range (a function pointer, a small int, a stale LR).
+ *
+ * $ make dumpUnwind
+ * $ ./dumpUnwind -e unwindDemo.o src/test/resources/guru/unwindDemo.txt
+ *
+ * Options:
+ *
+ * -e FILE       the .axf (required)
+ * -m HEX FILE   a raw memory image, loaded at HEX (repeatable)
+ * -s HEX        top of the stack, for the search replay (default: the
+ *               end of the memory captured contiguously above sp)
+ * -b N          benchmark: N unwinds, and N replays of the search
+ *
+ * Unwinding needs the stack words holding saved registers, so a dump
+ * whose app registered its stack (faultHandlingSetRegions) as region
+ * rows, or a RAM image.  Given several dumps, totals are reported
+ * too.
+ *
+ * The on-target search is also replayed on the host, over the same
+ * memory and the .axf's code range, with no row limit, so its every
+ * candidate can be judged, not just the first 4.
+ */
+
+#define MAX_FRAMES 64
+#define MAX_IMAGES 8
+#define MAX_WORDS  (1 << 20)
+#define MAX_SCAN   1024
+
+typedef struct {
+  uint32_t addr;
+  uint32_t value;
+} memWord;
+
+typedef struct {
+  memWord* words;
+  size_t count;
+} memory;
+
+static int byAddr( const void* a, const void* b ) {
+  const memWord* wa = a;
+  const memWord* wb = b;
+  if( wa->addr != wb->addr )
+	return wa->addr < wb->addr ? -1 : 1;
+  // Equal addresses: the later added first, it wins
+  return wa < wb ? 1 : -1;
+}
+
+static int readWord( void* context, uint32_t addr, uint32_t* value ) {
+  const memory* m = context;
+  size_t lo = 0, hi = m->count;
+  while( lo < hi ) {
+	size_t mid = lo + (hi - lo) / 2;
+	if( m->words[mid].addr < addr )
+	  lo = mid + 1;
+	else
+	  hi = mid;
+  }
+  if( lo == m->count || m->words[lo].addr != addr )
+	return -1;
+  *value = m->words[lo].value;
+  return 0;
+}
+
+static void addWord( memory* m, uint32_t addr, uint32_t value ) {
+  if( m->count < MAX_WORDS && !(addr & 3) ) {
+	m->words[m->count].addr = addr;
+	m->words[m->count++].value = value;
+  }
+}
+
+static int loadImage( memory* m, uint32_t base, const char* path ) {
+  FILE* fp = fopen( path, "rb" );
+  if( !fp ) {
+	perror( path );
+	return -1;
+  }
+  uint8_t w[4];
+  for( uint32_t addr = base & ~3u; fread( w, 1, 4, fp ) == 4; addr += 4 )
+	addWord( m, addr, (uint32_t)w[0] | (uint32_t)w[1] << 8 |
+			 (uint32_t)w[2] << 16 | (uint32_t)w[3] << 24 );
+  fclose( fp );
+  return 0;
+}
+
+static int parseDump( const char* path, dumpParsed* d ) {
+  static char text[1 << 16];
+  FILE* fp = fopen( path, "rb" );
+  if( !fp ) {
+	perror( path );
+	return -1;
+  }
+  size_t length = fread( text, 1, sizeof text - 1, fp );
+  fclose( fp );
+  text[length] = 0;
+
+  int result;
+  if( length && (uint8_t)text[0] == 0xFD )
+	result = dumpParseBinary( (const uint8_t*)text, length, NULL, d );
+  else {
+	const char* start = text;
+	while( start && strncmp( start, "r7   ", 5 ) != 0 ) {
+	  start = strchr( start, '\n' );
+	  if( start )
+		start++;
+	}
+	if( !start ) {
+	  fprintf( stderr, "%s: no fault dump found\n", path );
+	  return -1;
+	}
+	result = dumpParseText( start, length - (size_t)(start - text), d );
+  }
+  if( result ) {
+	fprintf( stderr, "%s: bad fault dump: %s\n", path,
+			 dumpParseError( result ) );
+	return -1;
+  }
+  if( d->layout.host ) {
+	fprintf( stderr, "%s: a host dump, not a Cortex-M one\n", path );
+	return -1;
+  }
+  return 0;
+}
+
+/*
+  searchCallStack of faultHandling.c, over host memory: every odd
+  word in the code range, from just above the exception frame to the
+  stack top.
+*/
+static int searchCallStack( const memory* m, uint32_t frame, uint32_t top,
+							uint32_t startText, uint32_t endText,
+							uint32_t* addrs, uint32_t* vals, int max ) {
+  int found = 0;
+  for( uint32_t a = frame + 32; a < top && found < max; a += 4 ) {
+	uint32_t val;
+	if( readWord( (void*)m, a, &val ) )
+	  break;
+	if( val < startText || val > endText || !(val & 1) )
+	  continue;
+	addrs[found] = a;
+	vals[found++] = val;
+  }
+  return found;
+}
+
+// The frame whose return address was read from addr, or -1
+static int frameAt( const dwarfUnwindFrame* frames, int count,
+					uint32_t addr, uint32_t val ) {
+  for( int i = 1; i < count; i++ )
+	if( frames[i].raAddr == addr && frames[i].pc == val )
+	  return i;
+  return -1;
+}
+
+static double now( void ) {
+  struct timespec t;
+  clock_gettime( CLOCK_MONOTONIC, &t );
+  return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+typedef struct {
+  long rows, rowsReal;
+  long candidates, candidatesReal;
+  long frames, framesMissed;
+  long complete;
+} totals;
+
+static int unwindOne( const char* path, const dwarfUnwind* u,
+					  const elfSymbols* es, memory* m, size_t imageWords,
+					  uint32_t top, long benchCount, totals* t ) {
+  static dumpParsed d;
+  if( parseDump( path, &d ) )
+	return -1;
+
+  // The images' words, then the dump's, which win
+  m->count = imageWords;
+  uint32_t addrs[DUMP_PARSE_MAX_VALUES], values[DUMP_PARSE_MAX_VALUES];
+  int n = dumpParseMemory( &d, addrs, values, DUMP_PARSE_MAX_VALUES );
+  for( int k = 0; k < n; k++ )
+	addWord( m, addrs[k], values[k] );
+  qsort( m->words, m->count, sizeof(memWord), byAddr );
+  size_t unique = 0;
+  for( size_t w = 0; w < m->count; w++ )
+	if( !unique || m->words[unique-1].addr != m->words[w].addr )
+	  m->words[unique++] = m->words[w];
+  m->count = unique;
+
+  uint32_t regs[16];
+  uint32_t known = dumpParseFaultRegs( &d, regs, NULL );
+  dwarfUnwindFrame frames[MAX_FRAMES];
+  int count;
+  int result = dwarfUnwindStack( u, regs, known, readWord, m, frames,
+								 MAX_FRAMES, &count );
+
+  char buf[256];
+  printf( "%s\n\nBacktrace, by .debug_frame:\n", path );
+  for( int i = 0; i < count; i++ ) {
+	char from[32] = "";
+	if( frames[i].exception )
+	  snprintf( from, sizeof from, "  exception frame" );
+	else if( i && frames[i].raAddr )
+	  snprintf( from, sizeof from, "  from %08X",
+				(unsigned)frames[i].raAddr );
+	else if( i )
+	  snprintf( from, sizeof from, "  from lr" );
+	printf( "#%-2d %08X %-40s sp %08X%s\n", i, (unsigned)frames[i].pc,
+			elfSymbolsDescribe( es, frames[i].pc, i > 0, buf,
+								sizeof buf ),
+			(unsigned)frames[i].sp, from );
+  }
+  printf( "(%s)\n", dwarfUnwindError( result ) );
+
+  printf( "\nCall stack rows, the on-target pushed-LR search:\n" );
+  for( int k = 0; k < d.stackCount; k++ ) {
+	if( !d.stackAddrs[k] )
+	  continue;
+	int f = frameAt( frames, count, d.stackAddrs[k], d.stackVals[k] );
+	printf( "%08X %08X : %-32s : ", (unsigned)d.stackAddrs[k],
+			(unsigned)d.stackVals[k],
+			elfSymbolsDescribe( es, d.stackVals[k], 1, buf, sizeof buf ) );
+	if( f > 0 )
+	  printf( "real, frame #%d\n", f );
+	else
+	  printf( "%s\n", result == DWARF_UNWIND_END ?
+			  "NOT a return address" : "unknown, unwind incomplete" );
+	t->rows++;
+	t->rowsReal += f > 0;
+  }
+
+  /*
+	The search again, here, unlimited: which candidates were real,
+	and which frames it missed altogether
+  */
+  uint32_t startText = 0, endText = 0;
+  if( es->functionCount ) {
+	startText = (uint32_t)es->functions[0].lo;
+	endText = (uint32_t)es->functions[es->functionCount-1].hi;
+  }
+  uint32_t frame = d.regs[1].value;
+  uint32_t stackTop = top;
+  if( !stackTop ) {
+	uint32_t v;
+	for( stackTop = frame; !readWord( m, stackTop, &v ); stackTop += 4 )
+	  ;
+  }
+  static uint32_t scanAddrs[MAX_SCAN], scanVals[MAX_SCAN];
+  int found = searchCallStack( m, frame, stackTop, startText, endText,
+							   scanAddrs, scanVals, MAX_SCAN );
+  int real = 0;
+  for( int k = 0; k < found; k++ )
+	real += frameAt( frames, count, scanAddrs[k], scanVals[k] ) > 0;
+  int missed = 0, stacked = 0;
+  for( int i = 1; i < count; i++ ) {
+	if( !frames[i].raAddr || frames[i].exception )
+	  continue;
+	stacked++;
+	int hit = 0;
+	for( int k = 0; k < found && !hit; k++ )
+	  hit = scanAddrs[k] == frames[i].raAddr;
+	missed += !hit;
+  }
+  printf( "\nSearch replayed to %08X: %d candidates, %d real, %d stale\n"
+		  "%d of %d stacked return addresses missed\n", (unsigned)stackTop,
+		  found, real, found - real, missed, stacked );
+  t->candidates += found;
+  t->candidatesReal += real;
+  t->frames += count;
+  t->framesMissed += missed;
+  t->complete += result == DWARF_UNWIND_END;
+
+  if( benchCount > 0 ) {
+	double t0 = now();
+	for( long i = 0; i < benchCount; i++ )
+	  dwarfUnwindStack( u, regs, known, readWord, m, frames, MAX_FRAMES,
+						&count );
+	double t1 = now();
+	for( long i = 0; i < benchCount; i++ )
+	  searchCallStack( m, frame, stackTop, startText, endText,
+					   scanAddrs, scanVals, MAX_SCAN );
+	double t2 = now();
+	printf( "\n%ld unwinds: %.0f ns each, %d frames\n"
+			"%ld searches: %.0f ns each, %d candidates\n", benchCount,
+			(t1 - t0) * 1e9 / (double)benchCount, count, benchCount,
+			(t2 - t1) * 1e9 / (double)benchCount, found );
+  }
+  printf( "\n" );
+  return 0;
+}
+
+int main( int argc, char* argv[] ) {
+
+  const char* elf = NULL;
+  uint32_t top = 0;
+  long benchCount = 0;
+  static memory m;
+  m.words = malloc( MAX_WORDS * sizeof(memWord) );
+
+  int i;
+  for( i = 1; i < argc && argv[i][0] == '-'; i++ ) {
+	if( strcmp( argv[i], "-e" ) == 0 && i+1 < argc )
+	  elf = argv[++i];
+	else if( strcmp( argv[i], "-m" ) == 0 && i+2 < argc ) {
+	  uint32_t base = (uint32_t)strtoul( argv[++i], NULL, 16 );
+	  if( loadImage( &m, base, argv[++i] ) )
+		return 1;
+	} else if( strcmp( argv[i], "-s" ) == 0 && i+1 < argc )
+	  top = (uint32_t)strtoul( argv[++i], NULL, 16 );
+	else if( strcmp( argv[i], "-b" ) == 0 && i+1 < argc )
+	  benchCount = atol( argv[++i] );
+	else
+	  break;
+  }
+  if( !elf || i == argc ) {
+	fprintf( stderr, "Usage: %s -e app.axf [-m base image]... [-s top] "
+			 "[-b N] dumpFile...\n", argv[0] );
+	return 1;
+  }
+
+  elfSymbols es;
+  dwarfUnwind u;
+  if( elfSymbolsLoad( &es, elf ) || dwarfUnwindLoad( &u, elf ) )
+	return 1;
+
+  // The images are common to all dumps, each dump's words go after
+  size_t imageWords = m.count;
+  totals t = { 0 };
+  int dumps = 0;
+  for( ; i < argc; i++ )
+	if( unwindOne( argv[i], &u, &es, &m, imageWords, top, benchCount,
+				   &t ) == 0 )
+	  dumps++;
+
+  if( dumps > 1 )
+	printf( "%d dumps, %ld unwound completely, %ld frames\n"
+			"call stack rows: %ld, %ld real\n"
+			"search candidates: %ld, %ld real; %ld stacked return "
+			"addresses missed\n", dumps, t.complete, t.frames, t.rows,
+			t.rowsReal, t.candidates, t.candidatesReal, t.framesMissed );
+
+  dwarfUnwindFree( &u );
+  elfSymbolsFree( &es );
+  free( m.words );
+  return dumps ? 0 : 1;
+}
+
+// eof
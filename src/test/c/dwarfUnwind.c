@@ -0,0 +1,571 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elfSymbols.h"
+#include "dwarfUnwind.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * DWARF call frame information, interpreted, see dwarfUnwind.h, and
+ * the DWARF 4 spec, section 6.4.
+ */
+
+#define REGS 16
+#define SP   13
+#define LR   14
+#define PC   15
+
+#define CIE_ID 0xffffffffu		// .debug_frame's, .eh_frame's is 0
+
+// Register rules, 6.4.1
+#define RULE_SAME       0
+#define RULE_UNDEFINED  1
+#define RULE_OFFSET     2		// saved at CFA+offset
+#define RULE_VAL_OFFSET 3		// is CFA+offset
+#define RULE_REGISTER   4		// is in another register
+
+#define DW_CFA_advance_loc        0x40
+#define DW_CFA_offset             0x80
+#define DW_CFA_restore            0xc0
+#define DW_CFA_nop                0x00
+#define DW_CFA_set_loc            0x01
+#define DW_CFA_advance_loc1       0x02
+#define DW_CFA_advance_loc2       0x03
+#define DW_CFA_advance_loc4       0x04
+#define DW_CFA_offset_extended    0x05
+#define DW_CFA_restore_extended   0x06
+#define DW_CFA_undefined          0x07
+#define DW_CFA_same_value         0x08
+#define DW_CFA_register           0x09
+#define DW_CFA_remember_state     0x0a
+#define DW_CFA_restore_state      0x0b
+#define DW_CFA_def_cfa            0x0c
+#define DW_CFA_def_cfa_register   0x0d
+#define DW_CFA_def_cfa_offset     0x0e
+#define DW_CFA_offset_extended_sf 0x11
+#define DW_CFA_def_cfa_sf         0x12
+#define DW_CFA_def_cfa_offset_sf  0x13
+#define DW_CFA_val_offset         0x14
+#define DW_CFA_val_offset_sf      0x15
+#define DW_CFA_GNU_args_size      0x2e
+#define DW_CFA_GNU_negative_offset_extended 0x2f
+
+#define MAX_REMEMBERED 8
+
+// A bounds-checked cursor, as elfSymbols.c's
+typedef struct {
+  const uint8_t* p;
+  const uint8_t* end;
+  int bad;
+} reader;
+
+static uint64_t readN( reader* r, int n ) {
+  if( r->bad || r->end - r->p < n ) {
+	r->bad = 1;
+	r->p = r->end;
+	return 0;
+  }
+  uint64_t v = 0;
+  for( int i = 0; i < n; i++ )
+	v |= (uint64_t)r->p[i] << (8*i);
+  r->p += n;
+  return v;
+}
+
+static uint64_t readUleb( reader* r ) {
+  uint64_t v = 0;
+  for( int shift = 0; ; shift += 7 ) {
+	uint8_t b = (uint8_t)readN( r, 1 );
+	if( r->bad )
+	  return 0;
+	if( shift < 64 )
+	  v |= (uint64_t)(b & 0x7f) << shift;
+	if( !(b & 0x80) )
+	  return v;
+  }
+}
+
+static int64_t readSleb( reader* r ) {
+  int64_t v = 0;
+  int shift = 0;
+  uint8_t b;
+  do {
+	b = (uint8_t)readN( r, 1 );
+	if( r->bad )
+	  return 0;
+	if( shift < 64 )
+	  v |= (int64_t)(b & 0x7f) << shift;
+	shift += 7;
+  } while( b & 0x80 );
+  if( shift < 64 && (b & 0x40) )
+	v |= -((int64_t)1 << shift);
+  return v;
+}
+
+typedef struct {
+  uint64_t codeAlign;
+  int64_t dataAlign;
+  unsigned raReg;
+  int addressSize;
+  reader initial;			// the CIE's initial instructions
+} cieInfo;
+
+static int readCie( const dwarfUnwind* u, uint32_t offset, cieInfo* c ) {
+  reader r = { u->frames + offset, u->frames + u->framesSize, 0 };
+  uint32_t length = (uint32_t)readN( &r, 4 );
+  if( r.bad || length == 0xffffffffu || length > (size_t)(r.end - r.p) )
+	return -1;
+  r.end = r.p + length;
+  if( readN( &r, 4 ) != CIE_ID )
+	return -1;
+  int version = (int)readN( &r, 1 );
+  if( version != 1 && version != 3 && version != 4 )
+	return -1;
+  // Augmentations change the layout, and debug_frame has none
+  if( readN( &r, 1 ) != 0 )
+	return -1;
+  c->addressSize = 4;
+  if( version == 4 ) {
+	c->addressSize = (int)readN( &r, 1 );
+	if( readN( &r, 1 ) != 0 )	// segment selector size
+	  return -1;
+  }
+  c->codeAlign = readUleb( &r );
+  c->dataAlign = readSleb( &r );
+  c->raReg = (unsigned)(version == 1 ? readN( &r, 1 ) : readUleb( &r ));
+  c->initial = r;
+  return r.bad || c->raReg >= REGS ? -1 : 0;
+}
+
+static int byLo( const void* a, const void* b ) {
+  const dwarfFde* fa = a;
+  const dwarfFde* fb = b;
+  return fa->lo < fb->lo ? -1 : fa->lo > fb->lo;
+}
+
+int dwarfUnwindLoad( dwarfUnwind* u, const char* path ) {
+  memset( u, 0, sizeof *u );
+  u->frames = elfSymbolsSection( path, ".debug_frame", &u->framesSize,
+								 NULL );
+  if( !u->frames ) {
+	fprintf( stderr, "%s: no .debug_frame\n", path );
+	return -1;
+  }
+
+  size_t cap = 0;
+  reader r = { u->frames, u->frames + u->framesSize, 0 };
+  while( r.p < r.end ) {
+	uint32_t length = (uint32_t)readN( &r, 4 );
+	// 64-bit DWARF, or a bad length: nothing more we can follow
+	if( r.bad || length == 0xffffffffu || length > (size_t)(r.end - r.p) )
+	  break;
+	const uint8_t* next = r.p + length;
+	uint32_t cie = (uint32_t)readN( &r, 4 );
+	cieInfo c;
+	if( cie != CIE_ID && readCie( u, cie, &c ) == 0 ) {
+	  reader f = { r.p, next, 0 };
+	  uint64_t lo = readN( &f, c.addressSize );
+	  uint64_t range = readN( &f, c.addressSize );
+	  if( !f.bad ) {
+		if( u->fdeCount == cap ) {
+		  cap = cap ? 2 * cap : 256;
+		  u->fdes = realloc( u->fdes, cap * sizeof(dwarfFde) );
+		}
+		dwarfFde* fde = u->fdes + u->fdeCount++;
+		// Thumb bit, if a function symbol was used
+		fde->lo = lo & ~(uint64_t)1;
+		fde->hi = fde->lo + range;
+		fde->cie = cie;
+		fde->instructions = (uint32_t)(f.p - u->frames);
+		fde->instructionsLength = (uint32_t)(next - f.p);
+	  }
+	}
+	r.p = next;
+  }
+  if( u->fdeCount )
+	qsort( u->fdes, u->fdeCount, sizeof(dwarfFde), byLo );
+  return 0;
+}
+
+void dwarfUnwindFree( dwarfUnwind* u ) {
+  free( u->fdes );
+  free( u->frames );
+  memset( u, 0, sizeof *u );
+}
+
+const dwarfFde* dwarfUnwindFind( const dwarfUnwind* u, uint64_t pc ) {
+  size_t lo = 0, hi = u->fdeCount;
+  while( lo < hi ) {
+	size_t mid = lo + (hi - lo) / 2;
+	if( u->fdes[mid].lo <= pc )
+	  lo = mid + 1;
+	else
+	  hi = mid;
+  }
+  if( lo == 0 )
+	return NULL;
+  const dwarfFde* f = u->fdes + lo - 1;
+  return pc < f->hi ? f : NULL;
+}
+
+typedef struct {
+  unsigned cfaReg;
+  int64_t cfaOffset;
+  uint8_t rule[REGS];
+  int64_t offset[REGS];			// or register, for RULE_REGISTER
+} cfaRow;
+
+/*
+  Run instructions until the location passes @p target, so row is
+  then the rule set at target.  initial is the CIE's row, for the
+  restore ops, NULL when running the CIE itself.
+*/
+static int execute( reader r, const cieInfo* c, uint64_t loc,
+					uint64_t target, cfaRow* row, const cfaRow* initial ) {
+  cfaRow remembered[MAX_REMEMBERED];
+  int depth = 0;
+
+  while( r.p < r.end ) {
+	uint8_t op = (uint8_t)readN( &r, 1 );
+	uint8_t low = op & 0x3f;
+	uint64_t reg = 0, delta = 0;
+	int64_t off = 0;
+
+	switch( op & 0xc0 ) {
+	case DW_CFA_advance_loc:
+	  delta = low;
+	  goto advance;
+	case DW_CFA_offset:
+	  reg = low;
+	  off = (int64_t)readUleb( &r ) * c->dataAlign;
+	  goto offset;
+	case DW_CFA_restore:
+	  reg = low;
+	  goto restore;
+	}
+
+	switch( op ) {
+	case DW_CFA_nop:
+	case DW_CFA_GNU_args_size:
+	  if( op == DW_CFA_GNU_args_size )
+		readUleb( &r );
+	  break;
+	case DW_CFA_set_loc:
+	  loc = readN( &r, c->addressSize ) & ~(uint64_t)1;
+	  if( loc > target )
+		return 0;
+	  break;
+	case DW_CFA_advance_loc1:
+	  delta = readN( &r, 1 );
+	  goto advance;
+	case DW_CFA_advance_loc2:
+	  delta = readN( &r, 2 );
+	  goto advance;
+	case DW_CFA_advance_loc4:
+	  delta = readN( &r, 4 );
+	  goto advance;
+	case DW_CFA_offset_extended:
+	  reg = readUleb( &r );
+	  off = (int64_t)readUleb( &r ) * c->dataAlign;
+	  goto offset;
+	case DW_CFA_offset_extended_sf:
+	  reg = readUleb( &r );
+	  off = readSleb( &r ) * c->dataAlign;
+	  goto offset;
+	case DW_CFA_GNU_negative_offset_extended:
+	  reg = readUleb( &r );
+	  off = -(int64_t)readUleb( &r ) * c->dataAlign;
+	  goto offset;
+	case DW_CFA_val_offset:
+	case DW_CFA_val_offset_sf:
+	  reg = readUleb( &r );
+	  off = (op == DW_CFA_val_offset ? (int64_t)readUleb( &r ) :
+			 readSleb( &r )) * c->dataAlign;
+	  if( reg < REGS ) {
+		row->rule[reg] = RULE_VAL_OFFSET;
+		row->offset[reg] = off;
+	  }
+	  break;
+	case DW_CFA_restore_extended:
+	  reg = readUleb( &r );
+	  goto restore;
+	case DW_CFA_undefined:
+	case DW_CFA_same_value:
+	  reg = readUleb( &r );
+	  if( reg < REGS )
+		row->rule[reg] = op == DW_CFA_undefined ? RULE_UNDEFINED :
+		  RULE_SAME;
+	  break;
+	case DW_CFA_register:
+	  reg = readUleb( &r );
+	  off = (int64_t)readUleb( &r );
+	  if( reg < REGS && off < REGS ) {
+		row->rule[reg] = RULE_REGISTER;
+		row->offset[reg] = off;
+	  }
+	  break;
+	case DW_CFA_remember_state:
+	  if( depth == MAX_REMEMBERED )
+		return -1;
+	  remembered[depth++] = *row;
+	  break;
+	case DW_CFA_restore_state:
+	  if( depth == 0 )
+		return -1;
+	  *row = remembered[--depth];
+	  break;
+	case DW_CFA_def_cfa:
+	  row->cfaReg = (unsigned)readUleb( &r );
+	  row->cfaOffset = (int64_t)readUleb( &r );
+	  break;
+	case DW_CFA_def_cfa_sf:
+	  row->cfaReg = (unsigned)readUleb( &r );
+	  row->cfaOffset = readSleb( &r ) * c->dataAlign;
+	  break;
+	case DW_CFA_def_cfa_register:
+	  row->cfaReg = (unsigned)readUleb( &r );
+	  break;
+	case DW_CFA_def_cfa_offset:
+	  row->cfaOffset = (int64_t)readUleb( &r );
+	  break;
+	case DW_CFA_def_cfa_offset_sf:
+	  row->cfaOffset = readSleb( &r ) * c->dataAlign;
+	  break;
+	default:
+	  // CFA and register expressions, vendor extensions
+	  return -1;
+	}
+	continue;
+
+  advance:
+	loc += delta * c->codeAlign;
+	if( loc > target )
+	  return 0;
+	continue;
+  offset:
+	if( reg < REGS ) {
+	  row->rule[reg] = RULE_OFFSET;
+	  row->offset[reg] = off;
+	}
+	continue;
+  restore:
+	if( !initial )
+	  return -1;
+	if( reg < REGS ) {
+	  row->rule[reg] = initial->rule[reg];
+	  row->offset[reg] = initial->offset[reg];
+	}
+  }
+  return r.bad ? -1 : 0;
+}
+
+/*
+  The rules at @p pc, by the CIE's initial instructions then the
+  FDE's.
+*/
+static int rowAt( const dwarfUnwind* u, const dwarfFde* f, uint64_t pc,
+				  cfaRow* row, unsigned* raReg ) {
+  cieInfo c;
+  if( readCie( u, f->cie, &c ) )
+	return -1;
+  memset( row, 0, sizeof *row );
+  if( execute( c.initial, &c, 0, UINT64_MAX, row, NULL ) )
+	return -1;
+  cfaRow initial = *row;
+  reader r = { u->frames + f->instructions,
+			   u->frames + f->instructions + f->instructionsLength, 0 };
+  *raReg = c.raReg;
+  return execute( r, &c, f->lo, pc, row, &initial );
+}
+
+// EXC_RETURN values, see p 279
+#define IS_EXC_RETURN(v) (((v) & 0xffffffe0u) == 0xffffffe0u)
+
+int dwarfUnwindStack( const dwarfUnwind* u, const uint32_t regs[16],
+					  uint32_t known, dwarfUnwindRead read, void* context,
+					  dwarfUnwindFrame* frames, int max, int* count ) {
+  uint32_t r[REGS];
+  memcpy( r, regs, sizeof r );
+  int n = 0;
+  *count = 0;
+  if( max < 1 || !(known & (1u << PC)) )
+	return DWARF_UNWIND_NO_CFI;
+  frames[n].pc = r[PC];
+  frames[n].sp = r[SP];
+  frames[n].raAddr = 0;
+  frames[n].exception = 0;
+  n++;
+
+  while( 1 ) {
+	*count = n;
+	dwarfUnwindFrame* this = frames + n - 1;
+
+	uint32_t next[REGS];
+	uint32_t nextKnown;
+	uint32_t raAddr = 0;
+	int exception = 0;
+
+	if( IS_EXC_RETURN( this->pc ) ) {
+	  /*
+		A nested exception: this 'frame' is the exception frame,
+		popped as the core would on return.  Bit 2 picks PSP or MSP,
+		we only know the one stack we are on.
+	  */
+	  uint32_t sp = r[SP], psr;
+	  uint32_t frame[8];
+	  for( int k = 0; k < 8; k++ )
+		if( read( context, sp + 4*(uint32_t)k, frame + k ) )
+		  return DWARF_UNWIND_NO_MEMORY;
+	  memcpy( next, r, sizeof next );
+	  next[0] = frame[0];
+	  next[1] = frame[1];
+	  next[2] = frame[2];
+	  next[3] = frame[3];
+	  next[12] = frame[4];
+	  next[LR] = frame[5];
+	  next[PC] = frame[6];
+	  psr = frame[7];
+	  next[SP] = sp + ((this->pc & 0x10) ? 32 : 104) +
+		((psr & (1 << 9)) ? 4 : 0);
+	  nextKnown = known | 0x0000d00f | (1u << SP);
+	  raAddr = sp + 24;
+	  exception = 1;
+	} else {
+	  /*
+		A caller's pc is a return address, just after its call, which
+		may be the last instruction of a function: look up the call
+		itself.  Frame 0's, and that after an exception, are where the
+		core stopped, so are looked up as is.
+	  */
+	  uint64_t pc = this->pc & ~1u;
+	  uint64_t lookup = (n == 1 || this->exception) ? pc : pc - 1;
+	  const dwarfFde* f = dwarfUnwindFind( u, lookup );
+	  if( !f )
+		return DWARF_UNWIND_NO_CFI;
+	  cfaRow row;
+	  unsigned raReg;
+	  if( rowAt( u, f, lookup, &row, &raReg ) || row.cfaReg >= REGS )
+		return DWARF_UNWIND_BAD_CFI;
+	  if( !(known & (1u << row.cfaReg)) )
+		return DWARF_UNWIND_NO_MEMORY;
+	  uint32_t cfa = r[row.cfaReg] + (uint32_t)row.cfaOffset;
+
+	  if( row.rule[raReg] == RULE_UNDEFINED )
+		return DWARF_UNWIND_END;
+
+	  nextKnown = known;
+	  for( int k = 0; k < REGS; k++ ) {
+		uint32_t addr = cfa + (uint32_t)row.offset[k];
+		switch( row.rule[k] ) {
+		case RULE_OFFSET:
+		  if( read( context, addr, next + k ) ) {
+			if( (unsigned)k == raReg )
+			  return DWARF_UNWIND_NO_MEMORY;
+			nextKnown &= ~(1u << k);
+		  } else
+			nextKnown |= 1u << k;
+		  if( (unsigned)k == raReg )
+			raAddr = addr;
+		  break;
+		case RULE_VAL_OFFSET:
+		  next[k] = addr;
+		  nextKnown |= 1u << k;
+		  break;
+		case RULE_REGISTER:
+		  next[k] = r[row.offset[k]];
+		  if( known & (1u << row.offset[k]) )
+			nextKnown |= 1u << k;
+		  else
+			nextKnown &= ~(1u << k);
+		  break;
+		case RULE_UNDEFINED:
+		  next[k] = 0;
+		  nextKnown &= ~(1u << k);
+		  break;
+		default:
+		  next[k] = r[k];
+		}
+	  }
+	  if( !(nextKnown & (1u << raReg)) )
+		return DWARF_UNWIND_NO_MEMORY;
+	  next[PC] = next[raReg];
+	  next[SP] = cfa;
+	  nextKnown |= (1u << PC) | (1u << SP);
+	  // The AAPCS caller-saved registers are anyone's guess now
+	  nextKnown &= ~0x0000100fu;
+
+	  if( next[SP] == r[SP] && next[PC] == r[PC] )
+		return DWARF_UNWIND_LOOP;
+	}
+
+	// Returning to pc 0, or to reset's lr: nothing called this frame
+	if( next[PC] == 0 || next[PC] == 0xffffffffu )
+	  return DWARF_UNWIND_END;
+	if( n == max )
+	  return DWARF_UNWIND_DEPTH;
+	memcpy( r, next, sizeof r );
+	known = nextKnown;
+	frames[n].pc = r[PC];
+	frames[n].sp = r[SP];
+	frames[n].raAddr = raAddr;
+	frames[n].exception = exception;
+	n++;
+  }
+}
+
+const char* dwarfUnwindError( int result ) {
+  switch( result ) {
+  case DWARF_UNWIND_END:
+	return "outermost frame";
+  case DWARF_UNWIND_NO_CFI:
+	return "no CFI for pc";
+  case DWARF_UNWIND_NO_MEMORY:
+	return "saved register not captured";
+  case DWARF_UNWIND_BAD_CFI:
+	return "bad or unsupported CFI";
+  case DWARF_UNWIND_LOOP:
+	return "no progress, stack corrupt?";
+  case DWARF_UNWIND_DEPTH:
+	return "too many frames";
+  default:
+	return "unknown";
+  }
+}
+
+// eof
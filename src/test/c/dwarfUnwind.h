@@ -0,0 +1,126 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#ifndef CORTEXM_FAULT_HANDLING_DWARF_UNWIND_H
+#define CORTEXM_FAULT_HANDLING_DWARF_UNWIND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host side: unwind a fault dump's stack by the DWARF call frame
+ * information (.debug_frame) of the .axf which produced it, as gdb
+ * does, so exactly, where the lib's on-target pushed-LR search
+ * (searchCallStack in faultHandling.c) can only guess: any odd word
+ * in the code range is a candidate LR to it, stale or not.
+ *
+ * Registers are numbered as DWARF does for ARM: r0-r15, 13 sp, 14
+ * lr, 15 pc.  Memory is read through a callback, so any mix of dump
+ * rows and RAM images will do.  A frame whose return address is an
+ * EXC_RETURN value is a nested exception, its caller's registers are
+ * then popped from the exception frame, as the core would.
+ *
+ * .debug_frame only (not .eh_frame, ARM EHABI uses .ARM.exidx
+ * instead), versions 1, 3 and 4, 32-bit DWARF, no CFA expressions.
+ */
+
+typedef struct {
+  uint64_t lo, hi;				// [lo,hi)
+  uint32_t cie;					// offset in frames of its CIE
+  uint32_t instructions;		// offset in frames
+  uint32_t instructionsLength;
+} dwarfFde;
+
+typedef struct {
+  uint8_t* frames;				// the .debug_frame section
+  size_t framesSize;
+  dwarfFde* fdes;				// sorted by lo
+  size_t fdeCount;
+} dwarfUnwind;
+
+/**
+ * @return 0, or -1 if @p path has no (usable) .debug_frame.
+ */
+int dwarfUnwindLoad( dwarfUnwind* u, const char* path );
+
+void dwarfUnwindFree( dwarfUnwind* u );
+
+/**
+ * @return the FDE covering @p pc, or NULL.
+ */
+const dwarfFde* dwarfUnwindFind( const dwarfUnwind* u, uint64_t pc );
+
+/**
+ * Read the word at @p addr into @p value.
+ *
+ * @return 0, or -1 if that word was not captured.
+ */
+typedef int (*dwarfUnwindRead)( void* context, uint32_t addr,
+								uint32_t* value );
+
+typedef struct {
+  uint32_t pc;			// fault pc for frame 0, a return address after
+  uint32_t sp;			// sp on entry to the frame, i.e. caller's CFA
+  uint32_t raAddr;		// where pc was read from, 0 if from a register
+  int exception;		// pc popped from a nested exception frame
+} dwarfUnwindFrame;
+
+typedef enum { DWARF_UNWIND_END = 0,		// the outermost frame reached
+			   DWARF_UNWIND_NO_CFI = -1,	// pc not covered by any FDE
+			   DWARF_UNWIND_NO_MEMORY = -2,	// a saved register not captured
+			   DWARF_UNWIND_BAD_CFI = -3,	// malformed, or unsupported
+			   DWARF_UNWIND_LOOP = -4,		// no progress, corrupt stack
+			   DWARF_UNWIND_DEPTH = -5		// more than max frames
+} dwarfUnwindResult;
+
+/**
+ * Unwind from registers @p regs (those in mask @p known), frame 0
+ * being the faulting function, into @p frames.
+ *
+ * @param count - receives the frames found, however unwinding ended.
+ *
+ * @return why unwinding stopped, DWARF_UNWIND_END if it went all the
+ * way, else a (negative) dwarfUnwindResult.
+ */
+int dwarfUnwindStack( const dwarfUnwind* u, const uint32_t regs[16],
+					  uint32_t known, dwarfUnwindRead read, void* context,
+					  dwarfUnwindFrame* frames, int max, int* count );
+
+const char* dwarfUnwindError( int result );
+
+#endif
+
+// eof
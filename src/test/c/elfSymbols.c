@@ -0,0 +1,995 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "elfSymbols.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * ELF .symtab and DWARF .debug_line reading, see elfSymbols.h.
+ *
+ * Only what faultGuru needs: no relocation processing (relocatable
+ * objects work if, as on ARM, addends are in place and .text is at
+ * 0), no .debug_info, so v2-4 line tables' directory 0 (the
+ * compilation directory) is left out of paths.
+ */
+
+#define EM_ARM 40
+
+#define SHT_PROGBITS 1
+#define SHT_SYMTAB   2
+#define SHF_ALLOC     2
+#define SHF_EXECINSTR 4
+#define STT_FUNC   2
+#define SHN_UNDEF  0
+#define ET_REL     1
+
+// A bounds-checked cursor over a section
+typedef struct {
+  const uint8_t* p;
+  const uint8_t* end;
+  int bad;
+} reader;
+
+static uint64_t readN( reader* r, int n ) {
+  if( r->bad || r->end - r->p < n ) {
+	r->bad = 1;
+	r->p = r->end;
+	return 0;
+  }
+  uint64_t v = 0;
+  for( int i = 0; i < n; i++ )
+	v |= (uint64_t)r->p[i] << (8*i);
+  r->p += n;
+  return v;
+}
+
+static uint64_t readUleb( reader* r ) {
+  uint64_t v = 0;
+  for( int shift = 0; ; shift += 7 ) {
+	uint8_t b = (uint8_t)readN( r, 1 );
+	if( r->bad )
+	  return 0;
+	if( shift < 64 )
+	  v |= (uint64_t)(b & 0x7f) << shift;
+	if( !(b & 0x80) )
+	  return v;
+  }
+}
+
+static int64_t readSleb( reader* r ) {
+  int64_t v = 0;
+  int shift = 0;
+  uint8_t b;
+  do {
+	b = (uint8_t)readN( r, 1 );
+	if( r->bad )
+	  return 0;
+	if( shift < 64 )
+	  v |= (int64_t)(b & 0x7f) << shift;
+	shift += 7;
+  } while( b & 0x80 );
+  if( shift < 64 && (b & 0x40) )
+	v |= -((int64_t)1 << shift);
+  return v;
+}
+
+static const char* readString( reader* r ) {
+  const char* s = (const char*)r->p;
+  const uint8_t* nul = r->bad ? NULL : memchr( r->p, 0, r->end - r->p );
+  if( !nul ) {
+	r->bad = 1;
+	r->p = r->end;
+	return "";
+  }
+  r->p = nul + 1;
+  return s;
+}
+
+/*
+  The string pool.  Offset 0 is always "", so a 0 offset means no
+  name.
+*/
+static uint32_t addString( elfSymbols* es, size_t* cap, const char* s,
+						   const char* s2 ) {
+  size_t n = strlen( s ), n2 = s2 ? strlen( s2 ) + 1 : 0;
+  if( es->stringsSize + n + n2 + 1 > *cap ) {
+	size_t want = es->stringsSize + n + n2 + 1;
+	*cap = *cap * 2 > want ? *cap * 2 : want;
+	es->strings = realloc( es->strings, *cap );
+  }
+  uint32_t offset = (uint32_t)es->stringsSize;
+  char* cp = es->strings + offset;
+  memcpy( cp, s, n );
+  if( s2 ) {
+	cp[n] = '/';
+	memcpy( cp + n + 1, s2, n2 - 1 );
+  }
+  cp[n+n2] = 0;
+  es->stringsSize += n + n2 + 1;
+  return offset;
+}
+
+typedef struct {
+  const uint8_t* data;
+  uint64_t size;
+} section;
+
+#define MAX_CODE_SECTIONS 16
+
+typedef struct {
+  const uint8_t* image;
+  int elf64;
+  int type;
+  section symtab, strtab, debugLine, debugLineStr, debugStr;
+  // Any one other section, by name, see elfSymbolsSection
+  section wanted;
+  uint64_t wantedAddr;
+  // Code, for the return sites
+  section code[MAX_CODE_SECTIONS];
+  uint64_t codeAddr[MAX_CODE_SECTIONS];
+  int codeCount;
+} elfFile;
+
+static int openElf( elfFile* f, const uint8_t* image, size_t size,
+					uint16_t* machine, const char* want ) {
+  memset( f, 0, sizeof *f );
+  f->image = image;
+  if( size < 52 || memcmp( image, "\177ELF", 4 ) != 0 || image[5] != 1 )
+	return -1;
+  f->elf64 = image[4] == 2;
+  reader r = { image + 16, image + size, 0 };
+  f->type = (int)readN( &r, 2 );
+  *machine = (uint16_t)readN( &r, 2 );
+  readN( &r, 4 );
+  int w = f->elf64 ? 8 : 4;
+  readN( &r, w );						// entry
+  readN( &r, w );						// phoff
+  uint64_t shoff = readN( &r, w );
+  readN( &r, 4 );						// flags
+  readN( &r, 2 );						// ehsize
+  readN( &r, 2 );						// phentsize
+  readN( &r, 2 );						// phnum
+  uint64_t shentsize = readN( &r, 2 );
+  uint64_t shnum = readN( &r, 2 );
+  uint64_t shstrndx = readN( &r, 2 );
+  if( r.bad || shoff == 0 || shoff > size ||
+	  shnum * shentsize > size - shoff || shstrndx >= shnum )
+	return -1;
+
+  // shstrtab first, so we can name the rest
+  reader h = { image + shoff + shstrndx * shentsize, image + size, 0 };
+  readN( &h, 4 );
+  readN( &h, 4 );
+  readN( &h, w );
+  readN( &h, w );
+  uint64_t strBase = readN( &h, w );
+  uint64_t strSize = readN( &h, w );
+  if( h.bad || strBase > size || strSize > size - strBase )
+	return -1;
+
+  for( uint64_t i = 0; i < shnum; i++ ) {
+	reader h = { image + shoff + i * shentsize, image + size, 0 };
+	uint64_t name = readN( &h, 4 );
+	uint64_t type = readN( &h, 4 );
+	uint64_t flags = readN( &h, w );
+	uint64_t addr = readN( &h, w );
+	uint64_t offset = readN( &h, w );
+	uint64_t length = readN( &h, w );
+	if( h.bad || name >= strSize || type == 8 ||	// SHT_NOBITS
+		offset > size || length > size - offset )
+	  continue;
+	const char* sname = (const char*)image + strBase + name;
+	if( !memchr( sname, 0, strSize - name ) )
+	  continue;
+	section s = { image + offset, length };
+	if( want && strcmp( sname, want ) == 0 ) {
+	  f->wanted = s;
+	  f->wantedAddr = addr;
+	}
+	if( type == SHT_SYMTAB )
+	  f->symtab = s;
+	else if( strcmp( sname, ".strtab" ) == 0 )
+	  f->strtab = s;
+	else if( strcmp( sname, ".debug_line" ) == 0 )
+	  f->debugLine = s;
+	else if( strcmp( sname, ".debug_line_str" ) == 0 )
+	  f->debugLineStr = s;
+	else if( strcmp( sname, ".debug_str" ) == 0 )
+	  f->debugStr = s;
+	else if( type == SHT_PROGBITS &&
+			 (flags & (SHF_ALLOC|SHF_EXECINSTR)) ==
+			 (SHF_ALLOC|SHF_EXECINSTR) &&
+			 f->codeCount < MAX_CODE_SECTIONS ) {
+	  f->code[f->codeCount] = s;
+	  f->codeAddr[f->codeCount++] = addr;
+	}
+  }
+  return 0;
+}
+
+static int byLo( const void* a, const void* b ) {
+  const elfFunction* fa = a;
+  const elfFunction* fb = b;
+  if( fa->lo != fb->lo )
+	return fa->lo < fb->lo ? -1 : 1;
+  // Sized before unsized, so an alias with no size loses
+  return (fa->hi == fa->lo) - (fb->hi == fb->lo);
+}
+
+static void loadFunctions( elfSymbols* es, const elfFile* f, size_t* cap ) {
+  int entSize = f->elf64 ? 24 : 16;
+  size_t n = f->symtab.size / entSize;
+  es->functions = malloc( (n ? n : 1) * sizeof(elfFunction) );
+  es->functionCount = 0;
+
+  for( size_t i = 0; i < n; i++ ) {
+	reader r = { f->symtab.data + i * entSize, f->symtab.data +
+				 f->symtab.size, 0 };
+	uint64_t nameOff, value, size;
+	int info, shndx;
+	if( f->elf64 ) {
+	  nameOff = readN( &r, 4 );
+	  info = (int)readN( &r, 1 );
+	  readN( &r, 1 );
+	  shndx = (int)readN( &r, 2 );
+	  value = readN( &r, 8 );
+	  size = readN( &r, 8 );
+	} else {
+	  nameOff = readN( &r, 4 );
+	  value = readN( &r, 4 );
+	  size = readN( &r, 4 );
+	  info = (int)readN( &r, 1 );
+	  readN( &r, 1 );
+	  shndx = (int)readN( &r, 2 );
+	}
+	if( r.bad || (info & 0xf) != STT_FUNC || shndx == SHN_UNDEF ||
+		nameOff >= f->strtab.size )
+	  continue;
+	const char* name = (const char*)f->strtab.data + nameOff;
+	if( !memchr( name, 0, f->strtab.size - nameOff ) )
+	  continue;
+	if( es->machine == EM_ARM )
+	  value &= ~(uint64_t)1;
+	elfFunction* fn = es->functions + es->functionCount++;
+	fn->lo = value;
+	fn->hi = value + size;
+	fn->name = addString( es, cap, name, NULL );
+	fn->pad = 0;
+  }
+
+  qsort( es->functions, es->functionCount, sizeof(elfFunction), byLo );
+
+  // Drop aliases (same start), give unsized symbols the gap to the next
+  size_t out = 0;
+  for( size_t i = 0; i < es->functionCount; i++ ) {
+	if( out && es->functions[out-1].lo == es->functions[i].lo )
+	  continue;
+	es->functions[out++] = es->functions[i];
+  }
+  es->functionCount = out;
+  for( size_t i = 0; i < out; i++ )
+	if( es->functions[i].hi == es->functions[i].lo )
+	  es->functions[i].hi = i+1 < out ? es->functions[i+1].lo :
+		es->functions[i].lo + 1;
+}
+
+/*
+  Growable line table, rows appended by the line program state
+  machine.
+*/
+typedef struct {
+  elfSymbols* es;
+  size_t* stringsCap;
+  size_t cap;
+} lineSink;
+
+static void addLine( lineSink* s, uint64_t addr, uint32_t file,
+					 uint32_t line ) {
+  elfSymbols* es = s->es;
+  if( es->lineCount == s->cap ) {
+	s->cap = s->cap ? 2 * s->cap : 1024;
+	es->lines = realloc( es->lines, s->cap * sizeof(elfLine) );
+  }
+  elfLine* l = es->lines + es->lineCount++;
+  l->addr = addr;
+  l->file = file;
+  l->line = line;
+}
+
+// A DWARF 5 entry format, (content type, form) pairs
+#define MAX_FORMATS 8
+
+typedef struct {
+  int count;
+  uint64_t type[MAX_FORMATS], form[MAX_FORMATS];
+} entryFormat;
+
+#define DW_LNCT_path            1
+#define DW_LNCT_directory_index 2
+
+#define DW_FORM_block    0x09
+#define DW_FORM_block1   0x0a
+#define DW_FORM_data1    0x0b
+#define DW_FORM_data2    0x05
+#define DW_FORM_data4    0x06
+#define DW_FORM_data8    0x07
+#define DW_FORM_data16   0x1e
+#define DW_FORM_string   0x08
+#define DW_FORM_strp     0x0e
+#define DW_FORM_udata    0x0f
+#define DW_FORM_line_strp 0x1f
+
+/*
+  One attribute of a v5 directory/file entry.  Strings come back via
+  *str, numbers via the return value.
+*/
+static uint64_t readForm( reader* r, uint64_t form, int offset64,
+						  const elfFile* f, const char** str ) {
+  uint64_t v = 0;
+  const section* strs = NULL;
+  switch( form ) {
+  case DW_FORM_string:
+	*str = readString( r );
+	return 0;
+  case DW_FORM_line_strp:
+	strs = &f->debugLineStr;
+	break;
+  case DW_FORM_strp:
+	strs = &f->debugStr;
+	break;
+  case DW_FORM_udata:
+	return readUleb( r );
+  case DW_FORM_data1:
+	return readN( r, 1 );
+  case DW_FORM_data2:
+	return readN( r, 2 );
+  case DW_FORM_data4:
+	return readN( r, 4 );
+  case DW_FORM_data8:
+	return readN( r, 8 );
+  case DW_FORM_data16:
+	readN( r, 8 );
+	readN( r, 8 );
+	return 0;
+  case DW_FORM_block:
+	v = readUleb( r );
+	break;
+  case DW_FORM_block1:
+	v = readN( r, 1 );
+	break;
+  default:
+	r->bad = 1;
+	return 0;
+  }
+  if( strs ) {
+	v = readN( r, offset64 ? 8 : 4 );
+	if( v < strs->size && memchr( strs->data + v, 0, strs->size - v ) )
+	  *str = (const char*)strs->data + v;
+	return 0;
+  }
+  // A block, skipped
+  if( (uint64_t)(r->end - r->p) < v )
+	r->bad = 1;
+  else
+	r->p += v;
+  return 0;
+}
+
+static int readEntryFormat( reader* r, entryFormat* ef ) {
+  ef->count = (int)readN( r, 1 );
+  if( ef->count > MAX_FORMATS )
+	return -1;
+  for( int i = 0; i < ef->count; i++ ) {
+	ef->type[i] = readUleb( r );
+	ef->form[i] = readUleb( r );
+  }
+  return r->bad ? -1 : 0;
+}
+
+#define MAX_FILES 1024
+#define MAX_DIRS  256
+
+/*
+  One line number program: header, then the state machine, see DWARF
+  5 section 6.2.  Returns the reader positioned past this unit.
+*/
+static int loadLineUnit( reader* unit, const elfFile* f, lineSink* sink,
+						 int isExec ) {
+  uint64_t length = readN( unit, 4 );
+  int offset64 = 0;
+  if( length == 0xffffffff ) {
+	offset64 = 1;
+	length = readN( unit, 8 );
+  }
+  if( unit->bad || length > (uint64_t)(unit->end - unit->p) )
+	return -1;
+  reader r = { unit->p, unit->p + length, 0 };
+  unit->p += length;
+
+  int version = (int)readN( &r, 2 );
+  if( version < 2 || version > 5 )
+	return 0;
+  if( version >= 5 ) {
+	readN( &r, 1 );						// address size
+	readN( &r, 1 );						// segment selector size
+  }
+  uint64_t headerLength = readN( &r, offset64 ? 8 : 4 );
+  if( r.bad || headerLength > (uint64_t)(r.end - r.p) )
+	return -1;
+  const uint8_t* program = r.p + headerLength;
+  int minInst = (int)readN( &r, 1 );
+  if( version >= 4 )
+	readN( &r, 1 );						// max ops per instruction
+  int defaultIsStmt = (int)readN( &r, 1 );
+  int lineBase = (int8_t)readN( &r, 1 );
+  int lineRange = (int)readN( &r, 1 );
+  int opcodeBase = (int)readN( &r, 1 );
+  uint8_t opLengths[256] = { 0 };
+  for( int i = 1; i < opcodeBase; i++ )
+	opLengths[i] = (uint8_t)readN( &r, 1 );
+  if( r.bad || lineRange == 0 )
+	return -1;
+  (void)defaultIsStmt;
+
+  static const char* dirs[MAX_DIRS];
+  static uint32_t files[MAX_FILES];
+  int dirCount = 0, fileCount = 0, fileBase;
+
+  if( version >= 5 ) {
+	entryFormat ef;
+	if( readEntryFormat( &r, &ef ) )
+	  return -1;
+	uint64_t n = readUleb( &r );
+	for( uint64_t i = 0; i < n && !r.bad; i++ ) {
+	  const char* path = "";
+	  for( int k = 0; k < ef.count; k++ ) {
+		const char* s = NULL;
+		readForm( &r, ef.form[k], offset64, f, &s );
+		if( ef.type[k] == DW_LNCT_path && s )
+		  path = s;
+	  }
+	  if( dirCount < MAX_DIRS )
+		dirs[dirCount++] = path;
+	}
+	if( readEntryFormat( &r, &ef ) )
+	  return -1;
+	n = readUleb( &r );
+	for( uint64_t i = 0; i < n && !r.bad; i++ ) {
+	  const char* path = "";
+	  uint64_t dir = 0;
+	  for( int k = 0; k < ef.count; k++ ) {
+		const char* s = NULL;
+		uint64_t v = readForm( &r, ef.form[k], offset64, f, &s );
+		if( ef.type[k] == DW_LNCT_path && s )
+		  path = s;
+		else if( ef.type[k] == DW_LNCT_directory_index )
+		  dir = v;
+	  }
+	  if( fileCount < MAX_FILES )
+		files[fileCount++] = addString( sink->es, sink->stringsCap,
+										dir < (uint64_t)dirCount &&
+										path[0] != '/' ? dirs[dir] : path,
+										dir < (uint64_t)dirCount &&
+										path[0] != '/' ? path : NULL );
+	}
+	fileBase = 0;
+  } else {
+	// Directory 0 is the compilation dir, not in this table
+	dirs[dirCount++] = NULL;
+	while( !r.bad ) {
+	  const char* d = readString( &r );
+	  if( !*d )
+		break;
+	  if( dirCount < MAX_DIRS )
+		dirs[dirCount++] = d;
+	}
+	while( !r.bad ) {
+	  const char* name = readString( &r );
+	  if( !*name )
+		break;
+	  uint64_t dir = readUleb( &r );
+	  readUleb( &r );
+	  readUleb( &r );
+	  const char* d = dir < (uint64_t)dirCount ? dirs[dir] : NULL;
+	  if( fileCount < MAX_FILES )
+		files[fileCount++] = addString( sink->es, sink->stringsCap,
+										d && name[0] != '/' ? d : name,
+										d && name[0] != '/' ? name : NULL );
+	}
+	fileBase = 1;
+  }
+  if( r.bad || program > r.end )
+	return -1;
+
+  // The state machine
+  r.p = program;
+  uint64_t address = 0;
+  int64_t line = 1;
+  uint64_t file = 1;
+  size_t sequenceStart = sink->es->lineCount;
+
+#define FILE_OF(n) ((n) >= (uint64_t)fileBase && \
+					(n) - fileBase < (uint64_t)fileCount ? \
+					files[(n) - fileBase] : 0)
+
+  while( r.p < r.end && !r.bad ) {
+	int op = (int)readN( &r, 1 );
+	if( op >= opcodeBase ) {
+	  int adj = op - opcodeBase;
+	  address += (uint64_t)(adj / lineRange) * minInst;
+	  line += lineBase + adj % lineRange;
+	  addLine( sink, address, FILE_OF(file), (uint32_t)line );
+	  continue;
+	}
+	switch( op ) {
+	case 0: {
+	  uint64_t len = readUleb( &r );
+	  if( len == 0 || len > (uint64_t)(r.end - r.p) ) {
+		r.bad = 1;
+		break;
+	  }
+	  const uint8_t* next = r.p + len;
+	  int sub = (int)readN( &r, 1 );
+	  if( sub == 1 ) {
+		// End of sequence. Linkers leave discarded code's at 0, drop those
+		addLine( sink, address, 0, 0 );
+		if( isExec && sink->es->lines[sequenceStart].addr == 0 )
+		  sink->es->lineCount = sequenceStart;
+		sequenceStart = sink->es->lineCount;
+		address = 0;
+		line = 1;
+		file = 1;
+	  } else if( sub == 2 )
+		address = readN( &r, (int)(len - 1 < 8 ? len - 1 : 8) );
+	  r.p = next;
+	  break;
+	}
+	case 1:
+	  addLine( sink, address, FILE_OF(file), (uint32_t)line );
+	  break;
+	case 2:
+	  address += readUleb( &r ) * minInst;
+	  break;
+	case 3:
+	  line += readSleb( &r );
+	  break;
+	case 4:
+	  file = readUleb( &r );
+	  break;
+	case 8:
+	  address += (uint64_t)((255 - opcodeBase) / lineRange) * minInst;
+	  break;
+	case 9:
+	  address += readN( &r, 2 );
+	  break;
+	default:
+	  // set_column, negate_stmt, etc: no use to us, skip any operands
+	  for( int i = 0; i < opLengths[op]; i++ )
+		readUleb( &r );
+	}
+  }
+#undef FILE_OF
+
+  // An unterminated sequence (a truncated unit) is dropped
+  sink->es->lineCount = sequenceStart;
+  return r.bad ? -1 : 0;
+}
+
+/*
+  Thumb return sites: walk each function's instructions from its
+  start, noting the address after each BL, BLX (immediate) and BLX
+  (register).  Literal pools inside functions can decode as anything,
+  so the odd false return site is possible, but rare.
+*/
+static void loadReturnSites( elfSymbols* es, const elfFile* f ) {
+  size_t cap = 0;
+  if( es->machine != EM_ARM )
+	return;
+
+  for( size_t i = 0; i < es->functionCount; i++ ) {
+	const elfFunction* fn = es->functions + i;
+	const section* code = NULL;
+	uint64_t base = 0;
+	for( int c = 0; c < f->codeCount; c++ )
+	  if( fn->lo >= f->codeAddr[c] &&
+		  fn->hi <= f->codeAddr[c] + f->code[c].size ) {
+		code = f->code + c;
+		base = f->codeAddr[c];
+		break;
+	  }
+	if( !code )
+	  continue;
+
+	for( uint64_t pc = fn->lo; pc + 2 <= fn->hi; ) {
+	  const uint8_t* p = code->data + (pc - base);
+	  uint16_t hw = (uint16_t)(p[0] | p[1] << 8);
+	  uint64_t site = 0;
+	  int size = 2;
+	  if( (hw >> 11) >= 0x1d ) {
+		// A 32-bit instruction
+		size = 4;
+		if( pc + 4 > fn->hi )
+		  break;
+		uint16_t hw2 = (uint16_t)(p[2] | p[3] << 8);
+		if( (hw >> 11) == 0x1e && ((hw2 & 0xd000) == 0xd000 ||
+								   (hw2 & 0xd001) == 0xc000) )
+		  site = pc + 4;
+	  } else if( (hw & 0xff87) == 0x4780 )
+		site = pc + 2;
+	  if( site ) {
+		if( es->returnSiteCount == cap ) {
+		  cap = cap ? 2 * cap : 1024;
+		  es->returnSites = realloc( es->returnSites,
+									 cap * sizeof(uint64_t) );
+		}
+		es->returnSites[es->returnSiteCount++] = site;
+	  }
+	  pc += size;
+	}
+  }
+  // Functions are sorted and disjoint, so the sites already are
+}
+
+static int byAddr( const void* a, const void* b ) {
+  const elfLine* la = a;
+  const elfLine* lb = b;
+  if( la->addr != lb->addr )
+	return la->addr < lb->addr ? -1 : 1;
+  // A sequence end before another sequence's start at the same address
+  return (la->line != 0) - (lb->line != 0);
+}
+
+/*
+  The index file: this header, then the function, line and return
+  site tables and the string pool, each as in memory.  All
+  elements are 8-byte multiples, so all tables are aligned.
+*/
+#define INDEX_MAGIC "FGURU01"
+
+typedef struct {
+  char magic[8];
+  uint32_t byteOrder;	// 0x01020304 as written
+  uint16_t machine;
+  uint16_t pad;
+  uint64_t elfSize;
+  uint64_t elfMtimeSec;
+  uint64_t elfMtimeNsec;
+  uint64_t elfIno;
+  uint64_t functionCount;
+  uint64_t lineCount;
+  uint64_t returnSiteCount;
+  uint64_t stringsSize;
+} indexHeader;
+
+static void indexPath( const char* path, char* buf, size_t len ) {
+  snprintf( buf, len, "%s.guru", path );
+}
+
+static void describeElf( const struct stat* st, indexHeader* h ) {
+  memset( h, 0, sizeof *h );
+  memcpy( h->magic, INDEX_MAGIC, sizeof h->magic );
+  h->byteOrder = 0x01020304;
+  h->elfSize = (uint64_t)st->st_size;
+  h->elfMtimeSec = (uint64_t)st->st_mtim.tv_sec;
+  h->elfMtimeNsec = (uint64_t)st->st_mtim.tv_nsec;
+  h->elfIno = (uint64_t)st->st_ino;
+}
+
+/*
+  Map in the index, if there is one and it describes the ELF as it
+  is now.  Every string offset is checked too, a bad index is just
+  rebuilt.
+*/
+static int mapIndex( elfSymbols* es, const char* path,
+					 const struct stat* st ) {
+  char ipath[4096];
+  indexPath( path, ipath, sizeof ipath );
+  int fd = open( ipath, O_RDONLY );
+  if( fd < 0 )
+	return -1;
+  struct stat ist;
+  if( fstat( fd, &ist ) || (size_t)ist.st_size < sizeof(indexHeader) ) {
+	close( fd );
+	return -1;
+  }
+  size_t size = (size_t)ist.st_size;
+  void* map = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  close( fd );
+  if( map == MAP_FAILED )
+	return -1;
+
+  const indexHeader* h = map;
+  indexHeader want;
+  describeElf( st, &want );
+  uint64_t tables = h->functionCount * sizeof(elfFunction) +
+	h->lineCount * sizeof(elfLine) + h->returnSiteCount * sizeof(uint64_t);
+  if( memcmp( h->magic, want.magic, sizeof want.magic ) ||
+	  h->byteOrder != want.byteOrder || h->elfSize != want.elfSize ||
+	  h->elfMtimeSec != want.elfMtimeSec ||
+	  h->elfMtimeNsec != want.elfMtimeNsec ||
+	  h->elfIno != want.elfIno ||
+	  h->functionCount > size || h->lineCount > size ||
+	  h->returnSiteCount > size || h->stringsSize == 0 ||
+	  sizeof(indexHeader) + tables + h->stringsSize != size ) {
+	munmap( map, size );
+	return -1;
+  }
+
+  uint8_t* cp = (uint8_t*)map + sizeof(indexHeader);
+  es->machine = h->machine;
+  es->functions = (elfFunction*)cp;
+  es->functionCount = h->functionCount;
+  cp += h->functionCount * sizeof(elfFunction);
+  es->lines = (elfLine*)cp;
+  es->lineCount = h->lineCount;
+  cp += h->lineCount * sizeof(elfLine);
+  es->returnSites = (uint64_t*)cp;
+  es->returnSiteCount = h->returnSiteCount;
+  cp += h->returnSiteCount * sizeof(uint64_t);
+  es->strings = (char*)cp;
+  es->stringsSize = h->stringsSize;
+
+  int ok = es->strings[es->stringsSize-1] == 0;
+  for( size_t i = 0; ok && i < es->functionCount; i++ )
+	ok = es->functions[i].name < es->stringsSize;
+  for( size_t i = 0; ok && i < es->lineCount; i++ )
+	ok = es->lines[i].file < es->stringsSize;
+  if( !ok ) {
+	munmap( map, size );
+	memset( es, 0, sizeof *es );
+	return -1;
+  }
+  es->mapping = map;
+  es->mappingSize = size;
+  return 0;
+}
+
+/*
+  Written to a temporary then renamed, so a concurrent faultGuru (batch
+  runs, say) never maps a half-written index.
+*/
+static void writeIndex( const elfSymbols* es, const char* path,
+						const struct stat* st ) {
+  char ipath[4096], tmp[4200];
+  indexPath( path, ipath, sizeof ipath );
+  snprintf( tmp, sizeof tmp, "%s.%ld", ipath, (long)getpid() );
+
+  indexHeader h;
+  describeElf( st, &h );
+  h.machine = es->machine;
+  h.functionCount = es->functionCount;
+  h.lineCount = es->lineCount;
+  h.returnSiteCount = es->returnSiteCount;
+  h.stringsSize = es->stringsSize;
+
+  FILE* fp = fopen( tmp, "wb" );
+  if( !fp )
+	return;
+  int ok = fwrite( &h, sizeof h, 1, fp ) == 1;
+  ok &= fwrite( es->functions, sizeof(elfFunction), es->functionCount,
+				fp ) == es->functionCount;
+  ok &= fwrite( es->lines, sizeof(elfLine), es->lineCount,
+				fp ) == es->lineCount;
+  ok &= fwrite( es->returnSites, sizeof(uint64_t), es->returnSiteCount,
+				fp ) == es->returnSiteCount;
+  ok &= fwrite( es->strings, 1, es->stringsSize, fp ) == es->stringsSize;
+  ok &= fclose( fp ) == 0;
+  if( !ok || rename( tmp, ipath ) )
+	unlink( tmp );
+}
+
+static uint8_t* readImage( const char* path, size_t* size ) {
+  FILE* fp = fopen( path, "rb" );
+  if( !fp ) {
+	perror( path );
+	return NULL;
+  }
+  fseek( fp, 0, SEEK_END );
+  long n = ftell( fp );
+  fseek( fp, 0, SEEK_SET );
+  uint8_t* image = malloc( n > 0 ? (size_t)n : 1 );
+  if( n <= 0 || fread( image, 1, (size_t)n, fp ) != (size_t)n ) {
+	fprintf( stderr, "%s: cannot read\n", path );
+	fclose( fp );
+	free( image );
+	return NULL;
+  }
+  fclose( fp );
+  *size = (size_t)n;
+  return image;
+}
+
+static int parseElf( elfSymbols* es, const char* path ) {
+  size_t size;
+  uint8_t* image = readImage( path, &size );
+  if( !image )
+	return -1;
+
+  elfFile f;
+  if( openElf( &f, image, size, &es->machine, NULL ) ) {
+	fprintf( stderr, "%s: not a little-endian ELF file\n", path );
+	free( image );
+	return -1;
+  }
+
+  size_t cap = 0;
+  addString( es, &cap, "", NULL );
+  loadFunctions( es, &f, &cap );
+  loadReturnSites( es, &f );
+
+  lineSink sink = { es, &cap, 0 };
+  reader r = { f.debugLine.data, f.debugLine.data + f.debugLine.size, 0 };
+  while( r.p < r.end )
+	if( loadLineUnit( &r, &f, &sink, f.type != ET_REL ) )
+	  break;
+  qsort( es->lines, es->lineCount, sizeof(elfLine), byAddr );
+
+  free( image );
+  return 0;
+}
+
+int elfSymbolsLoad( elfSymbols* es, const char* path ) {
+  memset( es, 0, sizeof *es );
+
+  struct stat st;
+  if( stat( path, &st ) ) {
+	perror( path );
+	return -1;
+  }
+  if( mapIndex( es, path, &st ) == 0 )
+	return 0;
+
+  if( parseElf( es, path ) ) {
+	elfSymbolsFree( es );
+	return -1;
+  }
+  writeIndex( es, path, &st );
+  return 0;
+}
+
+uint8_t* elfSymbolsSection( const char* path, const char* name,
+							size_t* size, uint64_t* addr ) {
+  size_t imageSize;
+  uint8_t* image = readImage( path, &imageSize );
+  if( !image )
+	return NULL;
+
+  elfFile f;
+  uint16_t machine;
+  uint8_t* copy = NULL;
+  if( openElf( &f, image, imageSize, &machine, name ) == 0 &&
+	  f.wanted.data ) {
+	copy = malloc( f.wanted.size ? f.wanted.size : 1 );
+	memcpy( copy, f.wanted.data, f.wanted.size );
+	*size = f.wanted.size;
+	if( addr )
+	  *addr = f.wantedAddr;
+  }
+  free( image );
+  return copy;
+}
+
+void elfSymbolsFree( elfSymbols* es ) {
+  if( es->mapping )
+	munmap( es->mapping, es->mappingSize );
+  else {
+	free( es->functions );
+	free( es->lines );
+	free( es->returnSites );
+	free( es->strings );
+  }
+  memset( es, 0, sizeof *es );
+}
+
+const elfFunction* elfSymbolsFunction( const elfSymbols* es,
+									   uint64_t addr ) {
+  if( es->machine == EM_ARM )
+	addr &= ~(uint64_t)1;
+  size_t lo = 0, hi = es->functionCount;
+  while( lo < hi ) {
+	size_t mid = lo + (hi - lo) / 2;
+	if( es->functions[mid].lo <= addr )
+	  lo = mid + 1;
+	else
+	  hi = mid;
+  }
+  if( lo == 0 || addr >= es->functions[lo-1].hi )
+	return NULL;
+  return es->functions + lo - 1;
+}
+
+const elfLine* elfSymbolsLine( const elfSymbols* es, uint64_t addr ) {
+  if( es->machine == EM_ARM )
+	addr &= ~(uint64_t)1;
+  size_t lo = 0, hi = es->lineCount;
+  while( lo < hi ) {
+	size_t mid = lo + (hi - lo) / 2;
+	if( es->lines[mid].addr <= addr )
+	  lo = mid + 1;
+	else
+	  hi = mid;
+  }
+  if( lo == 0 || es->lines[lo-1].line == 0 )
+	return NULL;
+  return es->lines + lo - 1;
+}
+
+int elfSymbolsIsReturnSite( const elfSymbols* es, uint64_t addr ) {
+  if( es->machine == EM_ARM )
+	addr &= ~(uint64_t)1;
+  size_t lo = 0, hi = es->returnSiteCount;
+  while( lo < hi ) {
+	size_t mid = lo + (hi - lo) / 2;
+	if( es->returnSites[mid] < addr )
+	  lo = mid + 1;
+	else
+	  hi = mid;
+  }
+  return lo < es->returnSiteCount && es->returnSites[lo] == addr;
+}
+
+char* elfSymbolsDescribe( const elfSymbols* es, uint64_t addr, int ret,
+						  char* buf, size_t len ) {
+  const elfFunction* fn = elfSymbolsFunction( es, addr );
+  // A return address: the call is the instruction before
+  const elfLine* line = elfSymbolsLine( es, ret ? addr - 2 : addr );
+  if( es->machine == EM_ARM )
+	addr &= ~(uint64_t)1;
+
+  int n = 0;
+  buf[0] = 0;
+  if( fn )
+	n = snprintf( buf, len, "%s+0x%llx", es->strings + fn->name,
+				  (unsigned long long)(addr - fn->lo) );
+  if( line && n >= 0 && (size_t)n < len ) {
+	const char* file = es->strings + line->file;
+	const char* slash = strrchr( file, '/' );
+	snprintf( buf + n, len - n, "%s(%s:%u)", n ? " " : "",
+			  slash ? slash + 1 : file, line->line );
+  }
+  if( !fn && !line )
+	snprintf( buf, len, "??" );
+  return buf;
+}
+
+// eof
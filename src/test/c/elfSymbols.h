@@ -0,0 +1,149 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#ifndef CORTEXM_FAULT_HANDLING_ELF_SYMBOLS_H
+#define CORTEXM_FAULT_HANDLING_ELF_SYMBOLS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host side: an address-to-source index over an ELF file (the .axf
+ * built by the Makefile's $(AXFS) rule), for faultGuru.  Functions
+ * come from .symtab, file:line from the DWARF .debug_line (versions
+ * 2 to 5).  Both become flat tables sorted by address, so a lookup is
+ * a binary search, and thousands of dump addresses resolve in well
+ * under a millisecond.
+ *
+ * ELF32 and ELF64, little-endian, executables and (single .text)
+ * relocatable objects.  On EM_ARM, the Thumb bit is cleared from
+ * function addresses.
+ *
+ * A third table lists return sites, the addresses just after each
+ * BL/BLX (Thumb only, so EM_ARM), so a call stack entry can be told
+ * from a code address which merely happened to be on the stack.
+ *
+ * The tables hold no pointers, just offsets into one string pool, so
+ * are written out as an index file, 'path.guru', beside the ELF, and
+ * mapped back in by later loads.  The index records the ELF's size,
+ * mtime and inode, and is rebuilt if any of those change.  If the
+ * index cannot be written (a read-only directory, say), each load
+ * just parses the ELF.
+ */
+
+typedef struct {
+  uint64_t lo, hi;	// [lo,hi)
+  uint32_t name;	// offset into strings
+  uint32_t pad;
+} elfFunction;
+
+typedef struct {
+  uint64_t addr;
+  uint32_t file;	// offset into strings, of the source file path
+  uint32_t line;	// 0 ends a sequence: no line info from addr on
+} elfLine;
+
+typedef struct {
+  uint16_t machine;	// e_machine, EM_ARM = 40
+  elfFunction* functions;
+  size_t functionCount;
+  elfLine* lines;
+  size_t lineCount;
+  uint64_t* returnSites;
+  size_t returnSiteCount;
+  char* strings;
+  size_t stringsSize;
+  void* mapping;	// the index file, if loaded from one, else NULL
+  size_t mappingSize;
+} elfSymbols;
+
+/**
+ * Map in the index for ELF file @p path, building (and saving) it
+ * first if there is none, or it is stale.
+ *
+ * @return 0, or -1 (with a message on stderr) if the file is not a
+ * (supported) ELF file.  A file with no symbols, or no line info,
+ * is not an error, lookups then just fail.
+ */
+int elfSymbolsLoad( elfSymbols* es, const char* path );
+
+void elfSymbolsFree( elfSymbols* es );
+
+/**
+ * Read the section named @p name (.debug_frame, say) of ELF file
+ * @p path, for DWARF beyond what the index holds.  Not indexed, not
+ * cached: each call reads the file.
+ *
+ * @param addr - if non-NULL, receives the section's address.
+ *
+ * @return a malloc'd copy of the section's contents, its length in
+ * @p size, or NULL if no such section (or no such ELF).
+ */
+uint8_t* elfSymbolsSection( const char* path, const char* name,
+							size_t* size, uint64_t* addr );
+
+/**
+ * @return the function containing @p addr, or NULL.
+ */
+const elfFunction* elfSymbolsFunction( const elfSymbols* es, uint64_t addr );
+
+/**
+ * @return the line table row covering @p addr, or NULL.
+ */
+const elfLine* elfSymbolsLine( const elfSymbols* es, uint64_t addr );
+
+/**
+ * @return 1 if @p addr is the return address of some call, else 0.
+ * Always 0 if the ELF is not ARM.
+ */
+int elfSymbolsIsReturnSite( const elfSymbols* es, uint64_t addr );
+
+/**
+ * Format @p addr as 'function+0xoff (file:line)', either part
+ * omitted if unknown, '??' if both are.  File names are shown
+ * without directories.
+ *
+ * @param ret - @p addr is a return address (an LR value): its file
+ * and line are taken from the call instruction before it.
+ *
+ * @return buf
+ */
+char* elfSymbolsDescribe( const elfSymbols* es, uint64_t addr, int ret,
+						  char* buf, size_t len );
+
+#endif
+
+// eof
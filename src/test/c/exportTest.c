@@ -0,0 +1,205 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "faultHandlingExport.h"
+#include "testCheck.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: test the ITM and RTT dump exporters (see
+ * faultHandlingExport.c) with no target and no probe.  The ITM is a
+ * mock (see mock/mockDevice.h) recording each stimulus port write,
+ * with a FIFO that is sometimes full.  The RTT 'probe' is a thread,
+ * finding the control block by its id in a RAM image, then draining
+ * the up buffer, as a J-Link would.
+ *
+ * $ make tools
+ * $ ./exportTest
+ */
+
+// A CM3 dump, from the README
+static const char dump[] =
+  "r7    2001FFF0\n"
+  "sp    2001FFD0\n"
+  "excrt FFFFFFF9\n"
+  "psr   20000003\n"
+  "hfsr  40000000\n"
+  "cfsr  00020000\n"
+  "mmfar E000ED34\n"
+  "bfar  E000ED38\n"
+  "shcsr 00000000\n"
+  "s.r0  00000002\n"
+  "s.r1  0000000A\n"
+  "s.r2  20000A3C\n"
+  "s.r3  00000000\n"
+  "s.r12 20000B38\n"
+  "s.lr  000001AF\n"
+  "s.pc  00000000\n"
+  "s.psr 40000000\n"
+  "20000FE4 00000317\n"
+  "20000FEC 000002ED\n"
+  "20000FF4 000002AF\n"
+  "20000FFC 00000127\n";
+
+/************************** ITM mock ******************************/
+
+ITM_Type mockITM;
+
+static char itmOut[1024];
+static int itmLen = 0, itmWrites = 0, itmBadPort = 0, itmPolls = 0;
+
+// FIFO full on every third poll, so the writer must wait
+int mockITMReady( uint32_t port ) {
+  (void)port;
+  return ++itmPolls % 3 != 0;
+}
+
+void mockITMWrite( uint32_t port, uint32_t value, int bytes ) {
+  if( port != 0 )
+	itmBadPort++;
+  for( int i = 0; i < bytes; i++ )
+	itmOut[itmLen++] = (char)(value >> (8*i));
+  itmWrites++;
+}
+
+static void testITM(void) {
+  mockITM.TCR = 0;
+  mockITM.TER = 0;
+  check( faultHandlingITMWrite( 0, dump ) == -1 && itmWrites == 0,
+		 "ITM disabled, nothing written" );
+
+  mockITM.TCR = ITM_TCR_ITMENA_Msk;
+  check( faultHandlingITMWrite( 0, dump ) == -1 && itmWrites == 0,
+		 "ITM port disabled, nothing written" );
+
+  mockITM.TER = 1;
+  int len = (int)strlen( dump );
+  check( faultHandlingITMWrite( 0, dump ) == 0 && itmLen == len &&
+		 memcmp( itmOut, dump, len ) == 0 && !itmBadPort,
+		 "ITM dump received intact" );
+  printf( "      %d bytes in %d port writes\n", len, itmWrites );
+  check( itmWrites == len/4 + len%4, "ITM word writes" );
+
+  itmLen = itmWrites = 0;
+  check( faultHandlingITMWrite( 0, "abcdefg" ) == 0 && itmLen == 7 &&
+		 memcmp( itmOut, "abcdefg", 7 ) == 0 && itmWrites == 4,
+		 "ITM tail bytes" );
+}
+
+/************************** RTT mock probe ******************************/
+
+// Target RAM, the control block somewhere in it, for the probe to find
+static union {
+  uint8_t bytes[4096];
+  uint32_t align;
+} ram;
+
+static char probeOut[1024];
+static volatile int probeLen = 0, probeStop = 0;
+
+static void* probeThread( void* arg ) {
+  (void)arg;
+
+  // As a J-Link does, search RAM for the control block id
+  faultHandlingRTT* rtt = NULL;
+  while( !rtt && !probeStop ) {
+	for( unsigned i = 0; i + sizeof(faultHandlingRTT) <= sizeof(ram); i += 4 ) {
+	  if( memcmp( ram.bytes + i, "SEGGER RTT", 11 ) == 0 ) {
+		rtt = (faultHandlingRTT*)(ram.bytes + i);
+		break;
+	  }
+	}
+	sched_yield();
+  }
+
+  while( rtt && !probeStop ) {
+	faultHandlingRTTBuffer* b = rtt->up;
+	uint32_t wr = __atomic_load_n( &b->wrOff, __ATOMIC_ACQUIRE );
+	uint32_t rd = b->rdOff;
+	while( rd != wr ) {
+	  probeOut[probeLen++] = b->buffer[rd];
+	  if( ++rd == b->size )
+		rd = 0;
+	}
+	__atomic_store_n( &b->rdOff, rd, __ATOMIC_RELEASE );
+	sched_yield();
+  }
+  return NULL;
+}
+
+static void testRTT(void) {
+  faultHandlingRTT* rtt = (faultHandlingRTT*)(ram.bytes + 1000);
+  static char ring[64];
+  int len = (int)strlen( dump );
+
+  faultHandlingRTTInit( rtt, ring, sizeof ring,
+						FAULT_HANDLING_RTT_NO_BLOCK_TRIM );
+  check( faultHandlingRTTWrite( rtt, dump ) == (int)sizeof ring - 1 &&
+		 memcmp( ring, dump, sizeof ring - 1 ) == 0,
+		 "RTT no probe, trim fills ring" );
+
+  faultHandlingRTTInit( rtt, ring, sizeof ring,
+						FAULT_HANDLING_RTT_NO_BLOCK_SKIP );
+  check( faultHandlingRTTWrite( rtt, dump ) == 0 &&
+		 faultHandlingRTTWrite( rtt, "short" ) == 5,
+		 "RTT no probe, skip drops what does not fit" );
+
+  // Wipe RAM, so the probe only finds a fresh, complete block
+  memset( ram.bytes, 0, sizeof ram );
+  pthread_t probe;
+  pthread_create( &probe, NULL, probeThread, NULL );
+  faultHandlingRTTInit( rtt, ring, sizeof ring, FAULT_HANDLING_RTT_BLOCK );
+  int written = faultHandlingRTTWrite( rtt, dump );
+  while( probeLen < written )
+	sched_yield();
+  probeStop = 1;
+  pthread_join( probe, NULL );
+  check( written == len && probeLen == len &&
+		 memcmp( probeOut, dump, len ) == 0,
+		 "RTT probe, block mode, dump received intact through small ring" );
+}
+
+int main(void) {
+  testITM();
+  testRTT();
+  return checkSummary();
+}
+
+// eof
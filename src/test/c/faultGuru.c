@@ -1,10 +1,766 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 
-int main(void) {
+#include "faultHandlingCompress.h"
+#include "faultGuru.h"
 
-  printf( "Your program crashed, oh how disappointing.\n" );
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: the fault guru.  Feed it a fault dump (as formatted by
+ * faultHandling.c, CM0 or CM3/4) and it decodes the status registers
+ * bit by bit, saying what each set bit means, then diagnoses the
+ * fault, by the rules of faultGuruRules.c.  Given the .axf of the
+ * faulting program, it also resolves stacked pc, stacked lr and the
+ * call stack entries to function+offset and file:line.
+ *
+ * $ make tools
+ * $ ./faultGuru src/test/resources/dumps/quizB.txt
+ * $ ./faultGuru -e stackSmashing.axf myFaultDump.txt
+ * $ ./faultGuru -e stackSmashing.axf -b 100000 myFaultDump.txt
+ *
+ * The dump is read from stdin if no file given.  -b N times N
+ * address lookups against the .axf's index, to show it is cheap
+ * enough to run over every dump received.
+ *
+ * With -E storeDir, the .axf is chosen by the dump's own 'build' row,
+ * see buildIdStamp.c, so needs no -e.
+ *
+ * With -B, batch mode, see faultGuruBatch.c: many dumps, clustered by
+ * crash signature.
+ *
+ * $ ./faultGuru -B -e app.axf dumps/
+ * $ ./faultGuru -S 100000 -e app.axf | ./faultGuru -B -e app.axf
+ *
+ * With -T, the rules are checked against a corpus of dumps of known
+ * cause:
+ *
+ * $ ./faultGuru -T src/test/resources/diagnosis/corpus.txt
+ *
+ * A host dump (faultHandlingHost.c) has no status registers, its
+ * findings are the host, the signal and what its si_code says.
+ */
 
+/*
+  The per-bit knowledge.  'set' says whether the finding is for the
+  bit set (1) or clear (0).
+*/
+typedef struct {
+  int bit;
+  int set;
+  const char* meaning;
+} bitMeaning;
+
+static const bitMeaning excrtBits[] = {
+  { 3, 1, "Fault occurred in Thread Mode" },
+  { 3, 0, "Fault occurred in Handler Mode, i.e. in an ISR" },
+  { 2, 1, "Fault occurred on Process Stack - RTOS likely present" },
+  { 2, 0, "Fault occurred on Main Stack" },
+  { 4, 0, "FPU context was stacked too (lazy stacking may apply)" },
+  { -1, 0, NULL }
+};
+
+static const bitMeaning hfsrBits[] = {
+  { 1, 1, "Bus fault reading the vector table, check VTOR" },
+  { 30, 1, "Fault escalated from Usage/Bus/MemManage, see cfsr" },
+  { 31, 1, "Debug event (BKPT with no debugger attached?)" },
+  { -1, 0, NULL }
+};
+
+static const bitMeaning cfsrBits[] = {
+  // MMFSR
+  { 0, 1, "IACCVIOL: instruction fetch from a no-execute region "
+	"(jump to XN memory, or to an MPU-protected address)" },
+  { 1, 1, "DACCVIOL: data access violated the MPU, see mmfar" },
+  { 3, 1, "MUNSTKERR: MPU fault unstacking on exception return" },
+  { 4, 1, "MSTKERR: MPU fault stacking on exception entry, "
+	"stack overflow into a guard region?" },
+  { 5, 1, "MLSPERR: MPU fault during lazy FP state preservation" },
+  { 7, 1, "MMARVALID: mmfar holds the faulting data address" },
+  // BFSR
+  { 8, 1, "IBUSERR: bus error on instruction fetch" },
+  { 9, 1, "PRECISERR: bus error on data access, at s.pc, see bfar" },
+  { 10, 1, "IMPRECISERR: bus error on a buffered write, s.pc is "
+	"AFTER the faulting store" },
+  { 11, 1, "UNSTKERR: bus error unstacking on exception return" },
+  { 12, 1, "STKERR: bus error stacking on exception entry, "
+	"stack pointer out of RAM?" },
+  { 13, 1, "LSPERR: bus error during lazy FP state preservation" },
+  { 15, 1, "BFARVALID: bfar holds the faulting data address" },
+  // UFSR
+  { 16, 1, "UNDEFINSTR: undefined instruction" },
+  { 17, 1, "INVSTATE: Thumb bit clear, branch to an even address "
+	"(a function pointer not from a symbol?)" },
+  { 18, 1, "INVPC: bad EXC_RETURN on exception return, "
+	"corrupted LR in an ISR?" },
+  { 19, 1, "NOCP: coprocessor (FPU) instruction with the FPU off" },
+  { 24, 1, "UNALIGNED: unaligned access, with CCR.UNALIGN_TRP set" },
+  { 25, 1, "DIVBYZERO: divide by zero, with CCR.DIV_0_TRP set" },
+  { -1, 0, NULL }
+};
+
+static const bitMeaning shcsrBits[] = {
+  { 0, 1, "MemManage handler was active" },
+  { 1, 1, "BusFault handler was active" },
+  { 3, 1, "UsageFault handler was active" },
+  { 7, 1, "SVCall handler was active" },
+  { 8, 1, "DebugMonitor was active" },
+  { 10, 1, "PendSV handler was active" },
+  { 11, 1, "SysTick handler was active" },
+  { 12, 1, "UsageFault was pending" },
+  { 13, 1, "MemManage fault was pending" },
+  { 14, 1, "BusFault was pending" },
+  { 15, 1, "SVCall was pending" },
+  { 16, 1, "MemManage handler enabled" },
+  { 17, 1, "BusFault handler enabled" },
+  { 18, 1, "UsageFault handler enabled" },
+  { -1, 0, NULL }
+};
+
+static int findings = 0;
+
+static void finding( const char* label, int bit, int value,
+					 const char* meaning ) {
+  char lhs[32];
+  if( bit >= 0 )
+	snprintf( lhs, sizeof lhs, "%s[%d] = %d", label, bit, value );
+  else
+	snprintf( lhs, sizeof lhs, "%s", label );
+  printf( "%d: %-14s:  %s\n", ++findings, lhs, meaning );
+}
+
+static void decodeBits( const dumpParsed* d, const char* label,
+						const bitMeaning* bits ) {
+  const dumpParseReg* r = dumpParseFind( d, label );
+  if( !r )
+	return;
+  for( const bitMeaning* b = bits; b->meaning; b++ ) {
+	int v = (int)((r->value >> b->bit) & 1);
+	if( v == b->set )
+	  finding( label, b->bit, v, b->meaning );
+  }
+}
+
+/*
+  Host dumps: Linux signals, and their si_codes, by number, as the
+  dump has them, whatever host we run on.
+*/
+typedef struct {
+  int number;
+  const char* name;
+  const char* const* codes;		// by si_code, 1 up
+  int codeCount;
+} signalMeaning;
+
+static const char* const segvCodes[] = {
+  "SEGV_MAPERR: nothing mapped at the address",
+  "SEGV_ACCERR: no permission for the access"
+};
+
+static const char* const busCodes[] = {
+  "BUS_ADRALN: misaligned address",
+  "BUS_ADRERR: no backing store, e.g. past the end of a mapped file",
+  "BUS_OBJERR: hardware error"
+};
+
+static const char* const illCodes[] = {
+  "ILL_ILLOPC: illegal opcode", "ILL_ILLOPN: illegal operand",
+  "ILL_ILLADR: illegal addressing mode", "ILL_ILLTRP: illegal trap",
+  "ILL_PRVOPC: privileged opcode", "ILL_PRVREG: privileged register",
+  "ILL_COPROC: coprocessor error", "ILL_BADSTK: internal stack error"
+};
+
+static const char* const fpeCodes[] = {
+  "FPE_INTDIV: integer divide by zero", "FPE_INTOVF: integer overflow",
+  "FPE_FLTDIV: floating point divide by zero",
+  "FPE_FLTOVF: floating point overflow",
+  "FPE_FLTUND: floating point underflow",
+  "FPE_FLTRES: floating point inexact result",
+  "FPE_FLTINV: floating point invalid operation",
+  "FPE_FLTSUB: subscript out of range"
+};
+
+#define CODES(c) c, (int)(sizeof c / sizeof c[0])
+
+static const signalMeaning signalMeanings[] = {
+  { 4, "SIGILL", CODES( illCodes ) },
+  { 6, "SIGABRT", NULL, 0 },
+  { 7, "SIGBUS", CODES( busCodes ) },
+  { 8, "SIGFPE", CODES( fpeCodes ) },
+  { 11, "SIGSEGV", CODES( segvCodes ) },
+  { 0, NULL, NULL, 0 }
+};
+
+static const signalMeaning* signalOf( const dumpParsed* d ) {
+  const dumpParseReg* sig = dumpParseFind( d, "sig" );
+  if( !sig )
+	return NULL;
+  for( const signalMeaning* s = signalMeanings; s->name; s++ )
+	if( (uint32_t)s->number == sig->value )
+	  return s;
+  return NULL;
+}
+
+// A host dump's 64-bit value, its row and the 'h.' row which follows
+static uint64_t hostValue( const dumpParsed* d, const char* label ) {
+  size_t n = strlen( label );
+  for( int i = 0; i + 1 < d->regCount; i++ ) {
+	if( memcmp( d->regs[i].label, label, n ) == 0 &&
+		(n == 5 || d->regs[i].label[n] == ' ') )
+	  return d->regs[i].value |
+		((uint64_t)d->regs[i+1].value << 32);
+  }
+  return 0;
+}
+
+static const char* archName( uint32_t machine ) {
+  // ELF e_machine values
+  switch( machine ) {
+  case 3:
+	return "x86";
+  case 40:
+	return "arm";
+  case 62:
+	return "x86-64";
+  case 183:
+	return "aarch64";
+  default:
+	return "unknown";
+  }
+}
+
+static void decodeHost( const dumpParsed* d ) {
+  char msg[128];
+
+  const dumpParseReg* arch = dumpParseFind( d, "arch" );
+  snprintf( msg, sizeof msg, "Host dump (faultHandlingHost.c), %s",
+			archName( arch->value ) );
+  finding( "arch", -1, 0, msg );
+
+  const dumpParseReg* sig = dumpParseFind( d, "sig" );
+  const dumpParseReg* code = dumpParseFind( d, "code" );
+  const signalMeaning* s = signalOf( d );
+  if( sig ) {
+	if( s )
+	  snprintf( msg, sizeof msg, "%s", s->name );
+	else
+	  snprintf( msg, sizeof msg, "Signal %u", (unsigned)sig->value );
+	finding( "sig", -1, 0, msg );
+  }
+  if( code ) {
+	int c = (int)code->value;
+	if( s && c >= 1 && c <= s->codeCount )
+	  snprintf( msg, sizeof msg, "%s", s->codes[c-1] );
+	else if( c <= 0 )
+	  snprintf( msg, sizeof msg, "Sent, by kill/raise/abort, not a "
+				"fault" );
+	else
+	  snprintf( msg, sizeof msg, "si_code %d", c );
+	finding( "code", -1, 0, msg );
+  }
+  if( s && s->number != 6 ) {
+	snprintf( msg, sizeof msg, "Faulting %s address %016llX",
+			  s->number == 4 || s->number == 8 ? "instruction" : "data",
+			  (unsigned long long)hostValue( d, "addr" ) );
+	finding( "addr", -1, 0, msg );
+  }
+  snprintf( msg, sizeof msg, "pc %016llX, sp %016llX",
+			(unsigned long long)hostValue( d, "s.pc" ),
+			(unsigned long long)hostValue( d, "sp" ) );
+  finding( "s.pc", -1, 0, msg );
+
+  const dumpParseReg* build = dumpParseFind( d, "build" );
+  if( build ) {
+	snprintf( msg, sizeof msg, "Firmware build %08X%s", (unsigned)build->value,
+			  build->value ? "" : ", not stamped" );
+	finding( "build", -1, 0, msg );
+  }
+}
+
+/*
+  A class name is the meaning's leading upper-case word, so skip
+  the VALID bits, which say where, not what.
+*/
+static int className( const bitMeaning* bits, unsigned long value,
+					  char* buf, size_t len ) {
+  for( const bitMeaning* b = bits; b->meaning; b++ ) {
+	if( !((value >> b->bit) & 1) || strstr( b->meaning, "VALID:" ) )
+	  continue;
+	size_t n = strcspn( b->meaning, ":" );
+	if( n >= len || b->meaning[n] != ':' )
+	  continue;
+	memcpy( buf, b->meaning, n );
+	buf[n] = 0;
+	return 1;
+  }
   return 0;
 }
 
+const char* faultGuruFaultClass( const dumpParsed* d, char* buf,
+								 size_t len ) {
+  static const bitMeaning hfsrClasses[] = {
+	{ 1, 1, "VECTTBL:" },
+	{ 31, 1, "DEBUGEVT:" },
+	{ -1, 0, NULL }
+  };
+
+  if( d->layout.host ) {
+	const signalMeaning* s = signalOf( d );
+	return s ? s->name : "signal";
+  }
+  if( d->kind & FAULT_HANDLING_KIND_HANG )
+	return "hang";
+  if( d->kind & FAULT_HANDLING_KIND_OVERFLOW )
+	return "overflow";
+  const dumpParseReg* cfsr = dumpParseFind( d, "cfsr" );
+  if( cfsr && className( cfsrBits, cfsr->value, buf, len ) )
+	return buf;
+  const dumpParseReg* hfsr = dumpParseFind( d, "hfsr" );
+  if( hfsr && className( hfsrClasses, hfsr->value, buf, len ) )
+	return buf;
+  return "HardFault";
+}
+
+static const char* exceptionName( unsigned n, char* buf, size_t len ) {
+  static const char* const names[16] = {
+	"Thread", "Reset", "NMI", "HardFault", "MemManage", "BusFault",
+	"UsageFault", NULL, NULL, NULL, NULL, "SVCall", "DebugMon", NULL,
+	"PendSV", "SysTick"
+  };
+  if( n < 16 && names[n] )
+	return names[n];
+  if( n >= 16 )
+	snprintf( buf, len, "IRQ %u", n - 16 );
+  else
+	snprintf( buf, len, "reserved exception %u", n );
+  return buf;
+}
+
+static void decode( const dumpParsed* d ) {
+  char msg[128], name[32];
+
+  if( d->layout.host ) {
+	decodeHost( d );
+	return;
+  }
+
+  int hang = (d->kind & FAULT_HANDLING_KIND_HANG) != 0;
+  const dumpParseReg* now = dumpParseFind( d, hang ? "hang" : "psr" );
+  if( now ) {
+	snprintf( msg, sizeof msg, "%s, dump taken in the %s handler",
+			  hang ? "Hang detected (watchdog/timer)" : "Fault",
+			  exceptionName( (unsigned)(now->value & 0x1ff), name,
+							 sizeof name ) );
+	finding( hang ? "hang[8:0]" : "psr[8:0]", -1, 0, msg );
+  }
+
+  if( d->kind & FAULT_HANDLING_KIND_OVERFLOW ) {
+	unsigned stack = FAULT_HANDLING_KIND_STACK( d->kind );
+	char label[6];
+	snprintf( label, sizeof label, "ovf.%X", stack );
+	snprintf( msg, sizeof msg, "Stack overflow, into the guard "
+			  "region of stack %X", stack );
+	finding( label, -1, 0, msg );
+  }
+
+  decodeBits( d, "excrt", excrtBits );
+
+  const dumpParseReg* spsr = dumpParseFind( d, "s.psr" );
+  if( spsr ) {
+	unsigned ipsr = (unsigned)(spsr->value & 0x1ff);
+	if( ipsr ) {
+	  snprintf( msg, sizeof msg, "Faulting code was the %s handler",
+				exceptionName( ipsr, name, sizeof name ) );
+	  finding( "s.psr[8:0]", -1, 0, msg );
+	}
+	if( !(spsr->value & (1 << 24)) )
+	  finding( "s.psr", 24, 0, "Thumb bit clear: INVSTATE, "
+			   "or a corrupted exception frame" );
+  }
+
+  // CM3/4 only: CM0 dumps have no such rows
+  decodeBits( d, "hfsr", hfsrBits );
+  decodeBits( d, "cfsr", cfsrBits );
+
+  const dumpParseReg* cfsr = dumpParseFind( d, "cfsr" );
+  const dumpParseReg* mmfar = dumpParseFind( d, "mmfar" );
+  const dumpParseReg* bfar = dumpParseFind( d, "bfar" );
+  if( cfsr && (cfsr->value & (1 << 7)) && mmfar ) {
+	snprintf( msg, sizeof msg, "Faulting data address %08X",
+			  (unsigned)mmfar->value );
+	finding( "mmfar", -1, 0, msg );
+  }
+  if( cfsr && (cfsr->value & (1 << 15)) && bfar ) {
+	snprintf( msg, sizeof msg, "Faulting data address %08X",
+			  (unsigned)bfar->value );
+	finding( "bfar", -1, 0, msg );
+  }
+
+  decodeBits( d, "shcsr", shcsrBits );
+
+  const dumpParseReg* build = dumpParseFind( d, "build" );
+  if( build ) {
+	snprintf( msg, sizeof msg, "Firmware build %08X%s", (unsigned)build->value,
+			  build->value ? "" : ", not stamped" );
+	finding( "build", -1, 0, msg );
+  }
+
+  const dumpParseReg* sfree = dumpParseFind( d, "sfree" );
+  if( sfree && sfree->value < 64 ) {
+	snprintf( msg, sizeof msg, "Only %u stack bytes never used, "
+			  "stack overflow likely", (unsigned)sfree->value );
+	finding( "sfree", -1, 0, msg );
+  }
+}
+
+static void symbolize( const dumpParsed* d, const elfSymbols* es ) {
+  char buf[256];
+
+  printf( "\n" );
+  const dumpParseReg* pc = dumpParseFind( d, "s.pc" );
+  if( pc )
+	printf( "s.pc  %08X : %s\n", (unsigned)pc->value,
+			elfSymbolsDescribe( es, pc->value, 0, buf, sizeof buf ) );
+  const dumpParseReg* lr = dumpParseFind( d, "s.lr" );
+  if( lr )
+	printf( "s.lr  %08X : %s\n", (unsigned)lr->value,
+			elfSymbolsDescribe( es, lr->value, 1, buf, sizeof buf ) );
+
+  for( int i = 0; i < d->stackCount; i++ ) {
+	// Unused call stack rows are all zero
+	if( !d->stackAddrs[i] )
+	  continue;
+	// A code address, but not after a call: stale, or data
+	int stale = es->returnSiteCount &&
+	  !elfSymbolsIsReturnSite( es, d->stackVals[i] );
+	printf( "%08X %08X : %s%s\n", (unsigned)d->stackAddrs[i],
+			(unsigned)d->stackVals[i],
+			elfSymbolsDescribe( es, d->stackVals[i], 1, buf, sizeof buf ),
+			stale ? " (not a return site)" : "" );
+  }
+}
+
+static double elapsed( const struct timespec* t0 ) {
+  struct timespec t1;
+  clock_gettime( CLOCK_MONOTONIC, &t1 );
+  return (double)(t1.tv_sec - t0->tv_sec) +
+	(double)(t1.tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+static void benchmark( const elfSymbols* es, long n, double loadSecs ) {
+  if( !es->functionCount ) {
+	fprintf( stderr, "No functions to benchmark against\n" );
+	return;
+  }
+  uint64_t lo = es->functions[0].lo;
+  uint64_t span = es->functions[es->functionCount-1].hi - lo;
+  unsigned long hits = 0;
+
+  struct timespec t0;
+  clock_gettime( CLOCK_MONOTONIC, &t0 );
+  srand( 1 );
+  for( long i = 0; i < n; i++ ) {
+	uint64_t addr = lo + (uint64_t)rand() % (span ? span : 1);
+	hits += elfSymbolsFunction( es, addr ) && elfSymbolsLine( es, addr );
+  }
+  double secs = elapsed( &t0 );
+
+  printf( "\nindex %s in %.3f ms\n", es->mapping ? "mapped" : "built",
+		  loadSecs * 1e3 );
+  printf( "%ld lookups (%lu resolved) against %zu functions, %zu "
+		  "lines: %.3f ms, %.0f ns/lookup\n", n, hits, es->functionCount,
+		  es->lineCount, secs * 1e3, n ? secs * 1e9 / (double)n : 0.0 );
+}
+
+/*
+  Builds seen so far.  Only ever appended to, under the lock, so
+  readers need only an acquire load of the count.
+*/
+#define MAX_BUILDS 64
+
+static struct {
+  uint32_t id;
+  int loaded;
+  elfSymbols es;
+} builds[MAX_BUILDS];
+static int buildCount = 0;
+static pthread_mutex_t buildsLock = PTHREAD_MUTEX_INITIALIZER;
+
+const elfSymbols* faultGuruStoreLookup( const char* store,
+										const dumpParsed* d ) {
+  const dumpParseReg* build = dumpParseFind( d, "build" );
+  if( !store || !build )
+	return NULL;
+  uint32_t id = (uint32_t)build->value;
+
+  int n = __atomic_load_n( &buildCount, __ATOMIC_ACQUIRE );
+  for( int i = 0; i < n; i++ )
+	if( builds[i].id == id )
+	  return builds[i].loaded ? &builds[i].es : NULL;
+
+  pthread_mutex_lock( &buildsLock );
+  const elfSymbols* result = NULL;
+  int i;
+  for( i = 0; i < buildCount; i++ )
+	if( builds[i].id == id )
+	  break;
+  if( i < buildCount )
+	result = builds[i].loaded ? &builds[i].es : NULL;
+  else if( i < MAX_BUILDS ) {
+	// A missing .axf is remembered too, so reported just the once
+	char path[4096];
+	snprintf( path, sizeof path, "%s/%08X.axf", store, (unsigned)id );
+	builds[i].id = id;
+	builds[i].loaded = elfSymbolsLoad( &builds[i].es, path ) == 0;
+	result = builds[i].loaded ? &builds[i].es : NULL;
+	__atomic_store_n( &buildCount, i+1, __ATOMIC_RELEASE );
+  }
+  pthread_mutex_unlock( &buildsLock );
+  return result;
+}
+
+/*
+  Read the dump in @p path (stdin if NULL), starting at its r7 row,
+  whatever console chatter precedes it.  Labels in @p d point into a
+  static buffer, so valid only until the next call.
+*/
+static int readDump( const char* path, dumpParsed* d ) {
+  FILE* fp = stdin;
+  if( path ) {
+	fp = fopen( path, "r" );
+	if( !fp ) {
+	  perror( path );
+	  return 1;
+	}
+  }
+
+  static char text[1 << 16];
+  size_t length = fread( text, 1, sizeof text - 1, fp );
+  if( fp != stdin )
+	fclose( fp );
+  text[length] = 0;
+
+  const char* start = text;
+  while( start && strncmp( start, "r7   ", 5 ) != 0 ) {
+	start = strchr( start, '\n' );
+	if( start )
+	  start++;
+  }
+  if( !start ) {
+	fprintf( stderr, "%s: No fault dump found\n", path ? path : "stdin" );
+	return 1;
+  }
+  int result = dumpParseText( start, length - (size_t)(start - text), d );
+  if( result ) {
+	fprintf( stderr, "%s: Bad fault dump: %s\n", path ? path : "stdin",
+			 dumpParseError( result ) );
+	return 1;
+  }
+  return 0;
+}
+
+#define MAX_DIAGNOSES 8
+
+// Explanations are wrapped to fit 72 columns, under the first line's
+static void printWrapped( const char* text, int indent ) {
+  int column = indent;
+  while( *text ) {
+	int word = (int)strcspn( text, " " );
+	if( column > indent && column + 1 + word > 72 ) {
+	  printf( "\n%*s", indent, "" );
+	  column = indent;
+	} else if( column > indent ) {
+	  putchar( ' ' );
+	  column++;
+	}
+	printf( "%.*s", word, text );
+	column += word;
+	text += word;
+	text += strspn( text, " " );
+  }
+  printf( "\n" );
+}
+
+static void diagnose( const dumpParsed* d ) {
+  faultGuruDiagnosis diagnoses[MAX_DIAGNOSES];
+  int n = faultGuruDiagnose( d, diagnoses, MAX_DIAGNOSES );
+  if( !n )
+	return;
+  char buf[512];
+  printf( "\nDiagnosis, most likely first:\n\n" );
+  for( int i = 0; i < n; i++ ) {
+	printf( "%3d %-18s : ", diagnoses[i].score, diagnoses[i].name );
+	printWrapped( faultGuruExplain( d, diagnoses + i, buf, sizeof buf ),
+				  25 );
+  }
+}
+
+/*
+  The regression corpus: each line of @p path names a dump file
+  (relative to @p path's directory) and the diagnosis it must get
+  first.  Any other outcome fails.
+*/
+static int corpus( const char* path ) {
+  FILE* fp = fopen( path, "r" );
+  if( !fp ) {
+	perror( path );
+	return 1;
+  }
+  const char* slash = strrchr( path, '/' );
+  int dirLen = slash ? (int)(slash - path + 1) : 0;
+
+  char line[1024], file[512], expected[64];
+  int dumps = 0, passed = 0;
+  while( fgets( line, sizeof line, fp ) ) {
+	if( sscanf( line, "%511s %63s", file, expected ) != 2 ||
+		file[0] == '#' )
+	  continue;
+	char dumpPath[1024];
+	snprintf( dumpPath, sizeof dumpPath, "%.*s%s", dirLen, path, file );
+	dumps++;
+	dumpParsed d;
+	faultGuruDiagnosis first;
+	const char* got = "unreadable";
+	if( readDump( dumpPath, &d ) == 0 )
+	  got = faultGuruDiagnose( &d, &first, 1 ) ? first.name : "none";
+	int ok = strcmp( got, expected ) == 0;
+	passed += ok;
+	if( ok )
+	  printf( "ok    %-32s %s\n", file, got );
+	else
+	  printf( "FAIL  %-32s %s, expected %s\n", file, got, expected );
+  }
+  fclose( fp );
+  printf( "\n%d dumps, %d diagnosed as expected\n", dumps, passed );
+  return passed == dumps ? 0 : 1;
+}
+
+/*
+  The original mode: one dump, decoded in full.
+*/
+static int single( const char* path, const elfSymbols* es,
+				   const char* store, long benchCount, double loadSecs ) {
+  dumpParsed d;
+  if( readDump( path, &d ) )
+	return 1;
+
+  decode( &d );
+  diagnose( &d );
+
+  const elfSymbols* built = faultGuruStoreLookup( store, &d );
+  if( built )
+	es = built;
+  if( es ) {
+	symbolize( &d, es );
+	if( benchCount > 0 )
+	  benchmark( es, benchCount, loadSecs );
+  }
+  return 0;
+}
+
+int main( int argc, char* argv[] ) {
+
+  const char* elf = NULL;
+  const char* store = NULL;
+  const char* corpusPath = NULL;
+  long benchCount = 0;
+  long synthCount = 0;
+  int batch = 0;
+  int threads = (int)sysconf( _SC_NPROCESSORS_ONLN );
+
+  int i;
+  for( i = 1; i < argc && argv[i][0] == '-'; i++ ) {
+	if( strcmp( argv[i], "-e" ) == 0 && i+1 < argc )
+	  elf = argv[++i];
+	else if( strcmp( argv[i], "-E" ) == 0 && i+1 < argc )
+	  store = argv[++i];
+	else if( strcmp( argv[i], "-b" ) == 0 && i+1 < argc )
+	  benchCount = atol( argv[++i] );
+	else if( strcmp( argv[i], "-B" ) == 0 )
+	  batch = 1;
+	else if( strcmp( argv[i], "-j" ) == 0 && i+1 < argc )
+	  threads = atoi( argv[++i] );
+	else if( strcmp( argv[i], "-S" ) == 0 && i+1 < argc )
+	  synthCount = atol( argv[++i] );
+	else if( strcmp( argv[i], "-T" ) == 0 && i+1 < argc )
+	  corpusPath = argv[++i];
+	else
+	  break;
+  }
+  if( (!batch && i < argc-1) || (i < argc && argv[i][0] == '-') ) {
+	fprintf( stderr, "Usage: %s [-e app.axf] [-E store] [-b lookups] "
+			 "[dumpFile]\n"
+			 "       %s -B [-e app.axf] [-E store] [-j threads] "
+			 "[dumpFile|dir]...\n"
+			 "       %s -S count [-e app.axf]\n"
+			 "       %s -T corpus\n",
+			 argv[0], argv[0], argv[0], argv[0] );
+	return 1;
+  }
+
+  elfSymbols es;
+  memset( &es, 0, sizeof es );
+  struct timespec t0;
+  clock_gettime( CLOCK_MONOTONIC, &t0 );
+  if( elf && elfSymbolsLoad( &es, elf ) )
+	return 1;
+  double loadSecs = elapsed( &t0 );
+
+  int result = 0;
+  if( corpusPath )
+	result = corpus( corpusPath );
+  else if( synthCount > 0 )
+	faultGuruSynthesize( synthCount, &es );
+  else if( batch )
+	result = faultGuruBatch( argv + i, argc - i, &es, store,
+							 threads > 0 ? threads : 1 );
+  else
+	result = single( i < argc ? argv[i] : NULL, elf ? &es : NULL, store,
+					 benchCount, loadSecs );
+
+  elfSymbolsFree( &es );
+  for( int b = 0; b < buildCount; b++ )
+	if( builds[b].loaded )
+	  elfSymbolsFree( &builds[b].es );
+  return result;
+}
+
 // eof
@@ -0,0 +1,117 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#ifndef CORTEXM_FAULT_HANDLING_FAULT_GURU_H
+#define CORTEXM_FAULT_HANDLING_FAULT_GURU_H
+
+#include <stddef.h>
+
+#include "elfSymbols.h"
+#include "dumpParse.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host side: the pieces of faultGuru (faultGuru.c) shared with its
+ * batch mode (faultGuruBatch.c).  Dumps are parsed by dumpParse.c.
+ */
+
+/**
+ * The one-word class of the fault: the first fault status bit set,
+ * by cfsr then hfsr, e.g. PRECISERR, or 'hang', 'overflow', or just
+ * HardFault (all a CM0 dump can say).
+ *
+ * @return buf, or a string constant
+ */
+const char* faultGuruFaultClass( const dumpParsed* d, char* buf,
+								 size_t len );
+
+/**
+ * A diagnosis: what a rule of faultGuruRules.c concludes from a dump.
+ */
+typedef struct {
+  const char* name;			// e.g. null-fnptr
+  int score;				// 0-100, higher is surer
+  const char* explanation;	// template, see faultGuruExplain
+} faultGuruDiagnosis;
+
+/**
+ * Diagnose @p d by every rule in faultGuruRules.c, keeping the @p max
+ * best, highest score first.
+ *
+ * @return the number of diagnoses in @p out, 0 if no rule matched.
+ */
+int faultGuruDiagnose( const dumpParsed* d, faultGuruDiagnosis* out,
+					   int max );
+
+/**
+ * The explanation of @p diagnosis, with @p d's values filled in.
+ *
+ * @return buf
+ */
+const char* faultGuruExplain( const dumpParsed* d,
+							  const faultGuruDiagnosis* diagnosis,
+							  char* buf, size_t len );
+
+/**
+ * The symbols of the build which produced @p d, found by its 'build'
+ * row (see faultHandlingBuildId) as @p store/XXXXXXXX.axf, loaded on
+ * first use, then kept.  Thread safe.
+ *
+ * @return NULL if no store, no build row, or no such .axf.
+ */
+const elfSymbols* faultGuruStoreLookup( const char* store,
+										const dumpParsed* d );
+
+/**
+ * Batch mode: triage every dump in @p paths (files, or directories
+ * of files, or stdin if @p count is 0) across @p threads threads,
+ * printing a cluster report.  Symbols come from @p store, if given,
+ * else @p es.
+ *
+ * @return 0, or 1 on error.
+ */
+int faultGuruBatch( char* const paths[], int count, const elfSymbols* es,
+					const char* store, int threads );
+
+/**
+ * Write @p n synthetic dumps to stdout, as one stream, for
+ * benchmarking batch mode.  Addresses are taken from @p es's
+ * functions, if it has any.
+ */
+void faultGuruSynthesize( long n, const elfSymbols* es );
+
+#endif
+
+// eof
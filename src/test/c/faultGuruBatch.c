@@ -0,0 +1,592 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "faultGuru.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * faultGuru's batch mode: triage a fleet's worth of dumps at once.
+ * Each dump is reduced to a crash signature: its fault class (see
+ * faultGuruFaultClass), then the function names of stacked pc,
+ * stacked lr and the call stack entries, e.g.
+ *
+ * PRECISERR readSensor < poll < main
+ *
+ * Offsets within functions are dropped, so the same bug hit via a
+ * slightly different path, or in a slightly different build, still
+ * lands in one cluster.  Without an .axf, raw addresses stand in for
+ * names.  Clusters are reported most frequent first, each with a few
+ * example unit IDs.  With a build store (-E), each dump is
+ * symbolized against its own build's .axf, so one bug spanning
+ * several firmware versions is still one cluster.
+ *
+ * Input: files, directories of files (one unit's dumps per file, the
+ * unit ID being the file name less any extension), or a stream on
+ * stdin.  In any of these, a line 'unit ID' sets the unit ID for the
+ * dumps which follow, so a ground station can simply concatenate
+ * what it receives.  A new dump starts at each r7 row.
+ *
+ * Dumps are split into jobs, files or chunks of the stream, handed out
+ * to one thread per host core.  Each thread keeps its own cluster
+ * table, merged at the end, so there is no locking per dump.
+ *
+ * Each cluster is labelled with the diagnosis (see faultGuruRules.c)
+ * of its first dump, and the report says how many dumps the rules
+ * were sure of, i.e. need no human to look at them.
+ */
+
+// Call stack frames, after pc, that go into a signature
+#define SIGNATURE_FRAMES 3
+
+#define SIGNATURE_LEN    192
+#define UNIT_LEN         32
+#define EXAMPLE_UNITS    3
+
+// A diagnosis this sure, or surer, counts as diagnosed
+#define DIAGNOSED_SCORE  60
+
+// Stream chunk size, so each thread gets a good many jobs
+#define CHUNK_SIZE       (64 * 1024)
+
+typedef struct {
+  uint32_t hash;
+  unsigned long count;
+  char signature[SIGNATURE_LEN];
+  char units[EXAMPLE_UNITS][UNIT_LEN];
+  int unitCount;
+  const char* diagnosis;	// a rule's name, or NULL
+} cluster;
+
+// Open addressing, linear probing, hash 0 marks an empty slot
+typedef struct {
+  cluster* slots;
+  size_t capacity;
+  size_t used;
+  unsigned long dumps;
+  unsigned long rejected;	// r7 rows not starting a valid dump
+  unsigned long diagnosed;	// dumps with a DIAGNOSED_SCORE diagnosis
+} clusterTable;
+
+typedef struct {
+  const char* path;		// a file to read, or...
+  const char* text;		// ...a chunk of the stream
+  size_t length;
+  char unit[UNIT_LEN];	// default unit ID
+} job;
+
+typedef struct {
+  job* jobs;
+  size_t jobCount;
+  size_t next;			// claimed via __atomic_fetch_add
+  const elfSymbols* es;
+  const char* store;	// of .axf files by build id, or NULL
+} workQueue;
+
+typedef struct {
+  workQueue* queue;
+  clusterTable table;
+  pthread_t thread;
+} worker;
+
+static uint32_t hashOf( const char* s ) {
+  uint32_t hash = 2166136261u;
+  for( ; *s; s++ ) {
+	hash ^= (uint8_t)*s;
+	hash *= 16777619u;
+  }
+  return hash ? hash : 1;
+}
+
+static cluster* tableFind( clusterTable* t, const char* signature,
+						   uint32_t hash );
+
+static void tableGrow( clusterTable* t ) {
+  cluster* old = t->slots;
+  size_t oldCapacity = t->capacity;
+  t->capacity = oldCapacity ? 2 * oldCapacity : 256;
+  t->slots = calloc( t->capacity, sizeof(cluster) );
+  t->used = 0;
+  for( size_t i = 0; i < oldCapacity; i++ )
+	if( old[i].hash ) {
+	  cluster* c = tableFind( t, old[i].signature, old[i].hash );
+	  *c = old[i];
+	}
+  free( old );
+}
+
+// The cluster for signature, a new (zero count) one if none yet
+static cluster* tableFind( clusterTable* t, const char* signature,
+						   uint32_t hash ) {
+  if( 2 * (t->used + 1) > t->capacity )
+	tableGrow( t );
+  size_t i = hash & (t->capacity - 1);
+  while( t->slots[i].hash ) {
+	if( t->slots[i].hash == hash &&
+		strcmp( t->slots[i].signature, signature ) == 0 )
+	  return t->slots + i;
+	i = (i + 1) & (t->capacity - 1);
+  }
+  cluster* c = t->slots + i;
+  c->hash = hash;
+  snprintf( c->signature, sizeof c->signature, "%s", signature );
+  t->used++;
+  return c;
+}
+
+static void addUnit( cluster* c, const char* unit ) {
+  for( int i = 0; i < c->unitCount; i++ )
+	if( strcmp( c->units[i], unit ) == 0 )
+	  return;
+  if( c->unitCount < EXAMPLE_UNITS )
+	snprintf( c->units[c->unitCount++], UNIT_LEN, "%s", unit );
+}
+
+static int appendFrame( char* buf, size_t len, int n, const char* sep,
+						const elfSymbols* es, unsigned long addr,
+						char* last, size_t lastLen ) {
+  char name[64];
+  const elfFunction* fn = elfSymbolsFunction( es, addr );
+  if( fn )
+	snprintf( name, sizeof name, "%s", es->strings + fn->name );
+  else
+	snprintf( name, sizeof name, "%08lX", addr & ~1UL );
+  // A non-leaf's lr is back into itself, say nothing new
+  if( strcmp( name, last ) == 0 )
+	return n;
+  snprintf( last, lastLen, "%s", name );
+  if( n >= 0 && (size_t)n < len )
+	n += snprintf( buf + n, len - n, "%s%s", sep, name );
+  return n;
+}
+
+static void signatureOf( const dumpParsed* d, const elfSymbols* es,
+						 char* buf, size_t len ) {
+  char klass[16], last[64] = "";
+  int n = snprintf( buf, len, "%s",
+					faultGuruFaultClass( d, klass, sizeof klass ) );
+
+  const dumpParseReg* pc = dumpParseFind( d, "s.pc" );
+  const dumpParseReg* lr = dumpParseFind( d, "s.lr" );
+  if( pc )
+	n = appendFrame( buf, len, n, " ", es, pc->value, last, sizeof last );
+  int frames = 0;
+  if( lr ) {
+	n = appendFrame( buf, len, n, " < ", es, lr->value, last,
+					 sizeof last );
+	frames++;
+  }
+  for( int i = 0; i < d->stackCount && frames < SIGNATURE_FRAMES; i++ ) {
+	// Unused call stack rows are all zero, stale entries are noise
+	if( !d->stackAddrs[i] || (es->returnSiteCount &&
+		!elfSymbolsIsReturnSite( es, d->stackVals[i] )) )
+	  continue;
+	n = appendFrame( buf, len, n, " < ", es, d->stackVals[i], last,
+					 sizeof last );
+	frames++;
+  }
+}
+
+static void triageDump( clusterTable* t, const dumpParsed* d,
+						const elfSymbols* es, const char* store,
+						const char* unit ) {
+  // The dump's own build, if known, else whatever -e said
+  const elfSymbols* built = faultGuruStoreLookup( store, d );
+  if( built )
+	es = built;
+  char signature[SIGNATURE_LEN];
+  signatureOf( d, es, signature, sizeof signature );
+  cluster* c = tableFind( t, signature, hashOf( signature ) );
+  faultGuruDiagnosis first;
+  int diagnosed = faultGuruDiagnose( d, &first, 1 );
+  if( !c->count && diagnosed )
+	c->diagnosis = first.name;
+  c->count++;
+  addUnit( c, unit );
+  t->dumps++;
+  if( diagnosed && first.score >= DIAGNOSED_SCORE )
+	t->diagnosed++;
+}
+
+static int startsWith( const char* line, size_t n, const char* prefix ) {
+  size_t p = strlen( prefix );
+  return n >= p && memcmp( line, prefix, p ) == 0;
+}
+
+static void triageText( clusterTable* t, const char* text, size_t length,
+						const elfSymbols* es, const char* store,
+						const char* defaultUnit ) {
+  dumpParsed d;
+  char unit[UNIT_LEN];
+  snprintf( unit, sizeof unit, "%s", defaultUnit );
+
+  const char* end = text + length;
+  for( const char* line = text; line < end; ) {
+	const char* eol = memchr( line, '\n', end - line );
+	size_t n = (eol ? eol : end) - line;
+
+	if( startsWith( line, n, "unit " ) ) {
+	  size_t u = n - 5;
+	  while( u && (line[5+u-1] == '\r' || line[5+u-1] == ' ') )
+		u--;
+	  if( u >= sizeof unit )
+		u = sizeof unit - 1;
+	  memcpy( unit, line + 5, u );
+	  unit[u] = 0;
+	} else if( startsWith( line, n, "r7   " ) ) {
+	  // A whole dump, else just this line is skipped
+	  if( dumpParseText( line, end - line, &d ) == DUMP_PARSE_OK ) {
+		triageDump( t, &d, es, store, unit );
+		line += d.length;
+		continue;
+	  }
+	  t->rejected++;
+	}
+	line += n + 1;
+  }
+}
+
+static char* readAll( FILE* fp, size_t* length ) {
+  size_t capacity = 1 << 16;
+  char* buf = malloc( capacity );
+  *length = 0;
+  size_t n;
+  while( (n = fread( buf + *length, 1, capacity - *length, fp )) > 0 ) {
+	*length += n;
+	if( *length == capacity )
+	  buf = realloc( buf, capacity *= 2 );
+  }
+  return buf;
+}
+
+static void* workerThread( void* arg ) {
+  worker* w = arg;
+  workQueue* q = w->queue;
+  while( 1 ) {
+	size_t i = __atomic_fetch_add( &q->next, 1, __ATOMIC_RELAXED );
+	if( i >= q->jobCount )
+	  break;
+	job* j = q->jobs + i;
+	if( j->path ) {
+	  FILE* fp = fopen( j->path, "r" );
+	  if( !fp ) {
+		perror( j->path );
+		continue;
+	  }
+	  size_t length;
+	  char* text = readAll( fp, &length );
+	  fclose( fp );
+	  triageText( &w->table, text, length, q->es, q->store,
+				  j->unit );
+	  free( text );
+	} else
+	  triageText( &w->table, j->text, j->length, q->es, q->store,
+				  j->unit );
+  }
+  return NULL;
+}
+
+static void addJob( workQueue* q, size_t* capacity, const char* path,
+					const char* text, size_t length ) {
+  if( q->jobCount == *capacity ) {
+	*capacity = *capacity ? 2 * *capacity : 1024;
+	q->jobs = realloc( q->jobs, *capacity * sizeof(job) );
+  }
+  job* j = q->jobs + q->jobCount++;
+  j->path = path;
+  j->text = text;
+  j->length = length;
+  j->unit[0] = 0;
+  if( path ) {
+	// Unit ID from the file name, less directory and extension
+	const char* base = strrchr( path, '/' );
+	base = base ? base + 1 : path;
+	const char* dot = strrchr( base, '.' );
+	size_t n = dot && dot != base ? (size_t)(dot - base) : strlen( base );
+	if( n >= UNIT_LEN )
+	  n = UNIT_LEN - 1;
+	memcpy( j->unit, base, n );
+	j->unit[n] = 0;
+  } else
+	strcpy( j->unit, "-" );
+}
+
+/*
+  Split a stream into chunks, each ending just before a 'unit' or r7
+  row, so no dump straddles two jobs.  A chunk starting mid unit
+  loses its unit ID, so chunks prefer to break at 'unit' lines.
+*/
+static void addStreamJobs( workQueue* q, size_t* capacity, const char* text,
+						   size_t length ) {
+  const char* end = text + length;
+  const char* start = text;
+  while( start < end ) {
+	const char* cut = start + CHUNK_SIZE < end ? start + CHUNK_SIZE : end;
+	const char* r7 = NULL;
+	while( cut < end ) {
+	  const char* eol = memchr( cut, '\n', end - cut );
+	  if( !eol ) {
+		cut = end;
+		break;
+	  }
+	  cut = eol + 1;
+	  if( startsWith( cut, end - cut, "unit " ) )
+		break;
+	  if( !r7 && startsWith( cut, end - cut, "r7   " ) )
+		r7 = cut;
+	  // No unit lines in sight, settle for a dump boundary
+	  if( r7 && cut - r7 > CHUNK_SIZE ) {
+		cut = r7;
+		break;
+	  }
+	}
+	addJob( q, capacity, NULL, start, cut - start );
+	start = cut;
+  }
+}
+
+static int addPath( workQueue* q, size_t* capacity, const char* path,
+					char*** owned, size_t* ownedCount ) {
+  struct stat st;
+  if( stat( path, &st ) ) {
+	perror( path );
+	return -1;
+  }
+  if( !S_ISDIR( st.st_mode ) ) {
+	addJob( q, capacity, path, NULL, 0 );
+	return 0;
+  }
+  DIR* dir = opendir( path );
+  if( !dir ) {
+	perror( path );
+	return -1;
+  }
+  struct dirent* de;
+  while( (de = readdir( dir )) ) {
+	if( de->d_name[0] == '.' )
+	  continue;
+	size_t n = strlen( path ) + strlen( de->d_name ) + 2;
+	char* file = malloc( n );
+	snprintf( file, n, "%s/%s", path, de->d_name );
+	if( stat( file, &st ) || !S_ISREG( st.st_mode ) ) {
+	  free( file );
+	  continue;
+	}
+	*owned = realloc( *owned, (*ownedCount + 1) * sizeof(char*) );
+	(*owned)[(*ownedCount)++] = file;
+	addJob( q, capacity, file, NULL, 0 );
+  }
+  closedir( dir );
+  return 0;
+}
+
+static int byCount( const void* a, const void* b ) {
+  const cluster* ca = a;
+  const cluster* cb = b;
+  if( ca->count != cb->count )
+	return ca->count > cb->count ? -1 : 1;
+  return strcmp( ca->signature, cb->signature );
+}
+
+static void report( clusterTable* all ) {
+  cluster* ranked = malloc( (all->used ? all->used : 1) * sizeof(cluster) );
+  size_t n = 0;
+  for( size_t i = 0; i < all->capacity; i++ )
+	if( all->slots[i].hash )
+	  ranked[n++] = all->slots[i];
+  qsort( ranked, n, sizeof(cluster), byCount );
+
+  printf( "%lu dumps, %zu clusters", all->dumps, n );
+  if( all->rejected )
+	printf( ", %lu malformed dumps skipped", all->rejected );
+  printf( "\n%lu dumps (%.1f%%) diagnosed by rule\n\n", all->diagnosed,
+		  all->dumps ? 100.0 * (double)all->diagnosed /
+		  (double)all->dumps : 0.0 );
+  printf( "%4s %7s %6s  %s\n", "rank", "count", "%", "signature" );
+  for( size_t i = 0; i < n; i++ ) {
+	cluster* c = ranked + i;
+	printf( "%4zu %7lu %5.1f%%  %s\n", i+1, c->count,
+			100.0 * (double)c->count / (double)all->dumps, c->signature );
+	printf( "%20s units:", "" );
+	for( int u = 0; u < c->unitCount; u++ )
+	  printf( " %s", c->units[u] );
+	printf( "%s\n", c->count > (unsigned long)c->unitCount ? " ..." : "" );
+	if( c->diagnosis )
+	  printf( "%20s diagnosis: %s\n", "", c->diagnosis );
+  }
+  free( ranked );
+}
+
+int faultGuruBatch( char* const paths[], int count, const elfSymbols* es,
+					const char* store, int threads ) {
+  workQueue q = { NULL, 0, 0, es, store };
+  size_t capacity = 0;
+  char** owned = NULL;
+  size_t ownedCount = 0;
+  char* stream = NULL;
+
+  struct timespec t0, t1;
+  clock_gettime( CLOCK_MONOTONIC, &t0 );
+
+  if( count == 0 ) {
+	size_t length;
+	stream = readAll( stdin, &length );
+	addStreamJobs( &q, &capacity, stream, length );
+  }
+  for( int i = 0; i < count; i++ )
+	if( addPath( &q, &capacity, paths[i], &owned, &ownedCount ) )
+	  return 1;
+
+  worker* workers = calloc( threads, sizeof(worker) );
+  for( int i = 0; i < threads; i++ ) {
+	workers[i].queue = &q;
+	pthread_create( &workers[i].thread, NULL, workerThread, workers + i );
+  }
+
+  // Merge the per-thread tables
+  clusterTable all = { NULL, 0, 0, 0, 0, 0 };
+  for( int i = 0; i < threads; i++ ) {
+	pthread_join( workers[i].thread, NULL );
+	clusterTable* t = &workers[i].table;
+	for( size_t s = 0; s < t->capacity; s++ ) {
+	  cluster* c = t->slots + s;
+	  if( !c->hash )
+		continue;
+	  cluster* into = tableFind( &all, c->signature, c->hash );
+	  if( !into->count )
+		into->diagnosis = c->diagnosis;
+	  into->count += c->count;
+	  for( int u = 0; u < c->unitCount; u++ )
+		addUnit( into, c->units[u] );
+	}
+	all.dumps += t->dumps;
+	all.rejected += t->rejected;
+	all.diagnosed += t->diagnosed;
+	free( t->slots );
+  }
+  clock_gettime( CLOCK_MONOTONIC, &t1 );
+
+  report( &all );
+
+  double secs = (double)(t1.tv_sec - t0.tv_sec) +
+	(double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+  fprintf( stderr, "%lu dumps in %.1f ms, %.0f dumps/s, %d threads\n",
+		   all.dumps, secs * 1e3, secs > 0 ? (double)all.dumps / secs : 0.0,
+		   threads );
+
+  free( all.slots );
+  free( workers );
+  for( size_t i = 0; i < ownedCount; i++ )
+	free( owned[i] );
+  free( owned );
+  free( q.jobs );
+  free( stream );
+  return 0;
+}
+
+/*
+  Synthetic dumps: a few 'bugs', each a fault class and a call chain,
+  hit at very different rates, across a few hundred units.  The
+  dumps are CM3 layout, as faultHandling.c formats them.
+*/
+
+#define SYNTH_BUGS  24
+#define SYNTH_UNITS 500
+
+static unsigned long synthAddress( const elfSymbols* es, int ret ) {
+  if( !es->functionCount )
+	return 0x1000 + 0x40 * (unsigned long)(rand() % 64) + (ret ? 1 : 0);
+  const elfFunction* fn = es->functions + rand() % es->functionCount;
+  return (unsigned long)fn->lo + (ret ? 1 : 0);
+}
+
+/*
+  Somewhere in the same function as addr.  With no functions to go
+  on, exactly addr, else every dump would be a cluster of its own.
+*/
+static unsigned long synthNear( const elfSymbols* es, unsigned long addr ) {
+  const elfFunction* fn = elfSymbolsFunction( es, addr );
+  if( !fn || fn->hi - fn->lo <= 8 )
+	return addr;
+  return addr + 2 * (unsigned long)(rand() % 4);
+}
+
+void faultGuruSynthesize( long n, const elfSymbols* es ) {
+  static const unsigned long cfsrs[] = {
+	0x00008200, 0x00000082, 0x00020000, 0x00000001, 0x02000000,
+	0x01000000, 0x00000400, 0x00010000
+  };
+  struct {
+	unsigned long cfsr;
+	unsigned long frames[4];
+  } bugs[SYNTH_BUGS];
+
+  srand( 1 );
+  for( int b = 0; b < SYNTH_BUGS; b++ ) {
+	bugs[b].cfsr = cfsrs[rand() % (sizeof cfsrs / sizeof cfsrs[0])];
+	for( int f = 0; f < 4; f++ )
+	  bugs[b].frames[f] = synthAddress( es, f > 0 );
+  }
+
+  for( long i = 0; i < n; i++ ) {
+	// Low numbered bugs much the most common
+	int b = (rand() % SYNTH_BUGS) * (rand() % SYNTH_BUGS) / SYNTH_BUGS;
+	unsigned long cfsr = bugs[b].cfsr;
+	printf( "unit U%04d\n", rand() % SYNTH_UNITS );
+	printf( "r7    2001FFF0\nsp    2001FFD0\nexcrt FFFFFFF9\n"
+			"psr   20000003\nhfsr  40000000\ncfsr  %08lX\n"
+			"mmfar %08lX\nbfar  %08lX\nshcsr 00000000\n"
+			"s.r0  00000000\ns.r1  00003588\ns.r2  200005D4\n"
+			"s.r3  20202020\ns.r12 2000056A\n", cfsr,
+			cfsr & 0x80 ? 0x20000100UL : 0xE000ED34UL,
+			cfsr & 0x8000 ? 0x20202020UL : 0xE000ED38UL );
+	printf( "s.lr  %08lX\ns.pc  %08lX\ns.psr 01000000\n",
+			synthNear( es, bugs[b].frames[1] ),
+			synthNear( es, bugs[b].frames[0] ) );
+	printf( "2001FFF4 %08lX\n2001FFFC %08lX\n"
+			"00000000 00000000\n00000000 00000000\n",
+			synthNear( es, bugs[b].frames[2] ),
+			synthNear( es, bugs[b].frames[3] ) );
+  }
+}
+
+// eof
@@ -0,0 +1,623 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "faultGuru.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * faultGuru's diagnosis: what the findings of faultGuru.c add up to.
+ * Where the findings say what each status bit means, a diagnosis says
+ * what the program most likely did, e.g. called through a NULL
+ * function pointer, as a human reading the dump would conclude (see
+ * the README's Quiz).
+ *
+ * The knowledge is all in the rules table below, not in code.  Each
+ * rule is a score (0-100, how sure a match makes us), up to
+ * RULE_TESTS tests on a dump's fields, all of which must pass, and an
+ * explanation.  A field is a dump row (r7, cfsr, s.pc...) or one
+ * derived from rows (the memory region s.pc lies in, whether r7 is a
+ * value some stacked register also holds...).  A test on a field the
+ * dump lacks fails, so e.g. cfsr tests never match a CM0 dump.  Every
+ * rule which matches is a diagnosis, ranked by score, so a specific
+ * rule (INVSTATE with s.pc 0) outranks a general one (INVSTATE).
+ *
+ * To teach the guru something new, add a rule, and a dump which shows
+ * it to the corpus (src/test/resources/diagnosis), then
+ *
+ * $ ./faultGuru -T src/test/resources/diagnosis/corpus.txt
+ *
+ * A host dump (faultHandlingHost.c) has fields of its own, sig and
+ * code, and a 64-bit value is a field only if it fits 32 bits (its
+ * 'h.' row is 0), else the dump lacks it.  Host rules test sig, so
+ * never match a target dump, and target rules test status registers
+ * or regions, which a host dump lacks, so never match a host dump.
+ */
+
+typedef enum {
+  F_NONE,						// ends a rule's tests
+  F_R7, F_SP, F_OVF, F_EXCRT, F_PSR, F_HANG,	// dump row order
+  F_HFSR, F_CFSR, F_MMFAR, F_BFAR, F_SHCSR,
+  F_SR0, F_SR1, F_SR2, F_SR3, F_SR12, F_SLR, F_SPC, F_SPSR,
+  F_SFREE,
+  F_SIG, F_CODE,				// host dumps only
+  // Derived
+  F_ADDR,						// mmfar or bfar, if cfsr says valid
+  F_PC_REGION, F_LR_REGION, F_R7_REGION,	// see regionOf
+  F_PC_FROM_REG,				// s.pc is what some s.rN held
+  F_R7_FROM_REG,				// r7 is what some s.rN held
+  F_ADDR_FROM_REG,				// addr is what some s.rN held
+  F_ADDR_NEAR_SP,				// host: addr within STACK_NEAR of sp
+  F_COUNT
+} field;
+
+// The labels of the dump rows, as padded, and names for the derived
+static const char* const fieldNames[F_COUNT] = {
+  "", "r7   ", "sp   ", "ovf.", "excrt", "psr  ", "hang ",
+  "hfsr ", "cfsr ", "mmfar", "bfar ", "shcsr",
+  "s.r0 ", "s.r1 ", "s.r2 ", "s.r3 ", "s.r12", "s.lr ", "s.pc ", "s.psr",
+  "sfree",
+  "sig  ", "code ",
+  "addr", "pc.region", "lr.region", "r7.region",
+  "pc~reg", "r7~reg", "addr~reg", "addr~sp"
+};
+
+/*
+  Regions of the ARMv6-M/ARMv7-M memory map, one per 512MB, by the
+  top three address bits.  Code and SRAM may be executed from, the
+  rest is execute-never.
+*/
+enum { CODE, SRAM, PERIPH, EXTRAM, EXTDEV, SYSTEM };
+
+static const int regionOf[8] = {
+  CODE, SRAM, PERIPH, EXTRAM, EXTRAM, EXTDEV, EXTDEV, SYSTEM
+};
+
+typedef enum {
+  ABSENT,						// no such field
+  PRESENT,
+  EQ, NE, LT, GE,
+  ANY,							// any of the operand's bits set
+  ALL,							// all of them set
+  NONE							// none of them set
+} op;
+
+typedef struct {
+  field field;
+  op op;
+  uint32_t operand;
+} ruleTest;
+
+#define RULE_TESTS 4
+
+typedef struct {
+  const char* name;
+  int score;
+  ruleTest tests[RULE_TESTS];
+  const char* explanation;		// {field} is replaced by its value
+} rule;
+
+// Status bits the rules test, see faultGuru.c for all of them
+#define IACCVIOL    (1u << 0)
+#define DACCVIOL    (1u << 1)
+#define MSTKERR     (1u << 4)
+#define IBUSERR     (1u << 8)
+#define PRECISERR   (1u << 9)
+#define IMPRECISERR (1u << 10)
+#define STKERR      (1u << 12)
+#define UNDEFINSTR  (1u << 16)
+#define INVSTATE    (1u << 17)
+#define INVPC       (1u << 18)
+#define NOCP        (1u << 19)
+#define UNALIGNED   (1u << 24)
+#define DIVBYZERO   (1u << 25)
+#define VECTTBL     (1u << 1)
+#define FORCED      (1u << 30)
+#define DEBUGEVT    (1u << 31)
+#define ENABLES     (7u << 16)	// shcsr: MemManage, BusFault, UsageFault
+#define THUMB       (1u << 24)	// psr
+#define IPSR        0x1FFu
+
+// Host dumps: Linux signal numbers, and si_codes, whatever our host
+#define SIGILL_      4
+#define SIGABRT_     6
+#define SIGBUS_      7
+#define SIGFPE_      8
+#define SIGSEGV_     11
+#define BUS_ADRALN_  1
+#define BUS_ADRERR_  2
+#define FPE_INTDIV_  1
+
+// Host: a fault this close below (or above) sp hit the stack's limit
+#define STACK_NEAR   0x10000
+
+static const rule rules[] = {
+
+  // Stack corruption, see stackSmashing.c, quizA.txt
+  { "stack-smashed", 95,
+	{ { F_PC_REGION, NE, CODE }, { F_R7_REGION, NE, SRAM },
+	  { F_R7_FROM_REG, EQ, 1 } },
+	"Stack corruption: a function returned through a frame its own "
+	"locals overwrote. Its epilogue popped pc {s.pc}, not code, and r7 "
+	"{r7}, not a stack address but a value the code was just storing. "
+	"Look for an array overrun in the function which called s.lr "
+	"{s.lr}" },
+
+  { "stack-corrupt", 70,
+	{ { F_PC_REGION, NE, CODE }, { F_R7_REGION, NE, SRAM } },
+	"Stack corruption, likely: pc {s.pc} is not code and r7 {r7} is "
+	"not a stack address, as if both were popped from an overwritten "
+	"frame (if built -O0/-Og, where r7 is the frame pointer)" },
+
+  // Bad function pointers, see invstate.c, iaccviol.c, busFault.c
+  { "null-fnptr", 95,
+	{ { F_SPC, EQ, 0 }, { F_SPSR, NONE, THUMB } },
+	"Call through a NULL function pointer: s.pc is 0, Thumb bit clear. "
+	"The call was made just before s.lr {s.lr}" },
+
+  { "fnptr-thumb", 90,
+	{ { F_CFSR, ALL, INVSTATE }, { F_SPC, NE, 0 }, { F_SPC, NONE, 1 } },
+	"INVSTATE with an even pc: a call through a function pointer, to "
+	"{s.pc}, whose Thumb bit (bit 0) is clear, so not taken from a "
+	"symbol. The call was made just before s.lr {s.lr}" },
+
+  { "fnptr-thumb", 80,
+	{ { F_CFSR, ABSENT, 0 }, { F_SPSR, NONE, THUMB }, { F_SPC, NE, 0 } },
+	"Thumb bit clear: a branch to even address {s.pc}, most likely a "
+	"bad function pointer (on CM0, a HardFault). The call was made "
+	"just before s.lr {s.lr}" },
+
+  { "fnptr-xn", 90,
+	{ { F_CFSR, ALL, IACCVIOL }, { F_PC_REGION, GE, PERIPH },
+	  { F_PC_FROM_REG, EQ, 1 } },
+	"Call through a bad function pointer into execute-never memory: "
+	"s.pc {s.pc} is the value of a stacked register, so was branched "
+	"to (BLX) from just before s.lr {s.lr}" },
+
+  { "fnptr-unmapped", 90,
+	{ { F_CFSR, ALL, IBUSERR }, { F_PC_FROM_REG, EQ, 1 } },
+	"Call through a bad function pointer to memory which is not "
+	"there: s.pc {s.pc} is the value of a stacked register, so was "
+	"branched to (BLX) from just before s.lr {s.lr}" },
+
+  { "xn-fetch", 60,
+	{ { F_CFSR, ALL, IACCVIOL } },
+	"Instruction fetch from {s.pc}, execute-never memory or an "
+	"MPU-protected region: a bad function pointer or return address" },
+
+  { "bad-fetch", 60,
+	{ { F_CFSR, ALL, IBUSERR } },
+	"Instruction fetch from {s.pc}, where no memory answers: a bad "
+	"function pointer or return address" },
+
+  // Bad data pointers, see mpuFault.c, quizC.txt
+  { "null-deref", 92,
+	{ { F_CFSR, ANY, DACCVIOL | PRECISERR }, { F_ADDR, LT, 0x400 } },
+	"NULL pointer dereference: data access at {addr}, i.e. of a member "
+	"at that offset of a NULL struct pointer, by the code at s.pc "
+	"{s.pc}" },
+
+  { "bad-dataptr", 85,
+	{ { F_CFSR, ANY, DACCVIOL | PRECISERR }, { F_ADDR_FROM_REG, EQ, 1 } },
+	"Bad data pointer: the code at s.pc {s.pc} accessed {addr}, a value "
+	"held in a stacked register, so a wild or uninitialised pointer" },
+
+  { "bad-access", 70,
+	{ { F_CFSR, ANY, DACCVIOL | PRECISERR }, { F_ADDR, PRESENT, 0 } },
+	"Bad data access, to {addr}, by the code at s.pc {s.pc}" },
+
+  { "imprecise-write", 70,
+	{ { F_CFSR, ALL, IMPRECISERR } },
+	"A buffered write went to bad memory. s.pc {s.pc} is somewhere "
+	"after the faulting store: set ACTLR.DISDEFWBUF to make it precise" },
+
+  // Stack overflow
+  { "stack-guard", 95,
+	{ { F_OVF, PRESENT, 0 } },
+	"Stack overflow, into the guard region: reduce stack use (large "
+	"locals, deep recursion) or enlarge the stack" },
+
+  // Outranks everything: the stacked registers are garbage
+  { "stack-overflow", 98,
+	{ { F_CFSR, ANY, MSTKERR | STKERR } },
+	"Stack overflow, likely: exception entry could not push its frame, "
+	"so sp {sp} had run out of RAM or into an MPU guard region" },
+
+  { "stack-low", 80,
+	{ { F_SFREE, LT, 64 } },
+	"Stack nearly exhausted: only {sfree} bytes were never used, so an "
+	"overflow may have corrupted data below the stack" },
+
+  // Usage faults
+  { "div-by-zero", 95,
+	{ { F_CFSR, ALL, DIVBYZERO } },
+	"Integer divide by zero at s.pc {s.pc}" },
+
+  { "unaligned", 90,
+	{ { F_CFSR, ALL, UNALIGNED } },
+	"Unaligned access at s.pc {s.pc}: a pointer cast from a byte "
+	"buffer, or a packed struct member" },
+
+  { "no-fpu", 95,
+	{ { F_CFSR, ALL, NOCP } },
+	"Floating point instruction at s.pc {s.pc} with the FPU off: "
+	"enable it (CPACR) before any float code runs" },
+
+  { "bad-exc-return", 85,
+	{ { F_CFSR, ALL, INVPC } },
+	"Bad EXC_RETURN: an ISR returned with a corrupted lr, or with its "
+	"stack unbalanced" },
+
+  { "undefined-instr", 70,
+	{ { F_CFSR, ALL, UNDEFINSTR } },
+	"Undefined instruction at s.pc {s.pc}: executing data, corrupted "
+	"code, or code built for another core" },
+
+  { "bad-fnptr", 60,
+	{ { F_CFSR, ALL, INVSTATE } },
+	"INVSTATE: a branch cleared the Thumb bit, a bad function pointer "
+	"or a corrupted return address" },
+
+  // Hard fault escalation
+  { "vector-table", 95,
+	{ { F_HFSR, ALL, VECTTBL } },
+	"Bus fault reading the vector table for an exception: VTOR points "
+	"at no memory, or the table is not where it was linked" },
+
+  { "breakpoint", 90,
+	{ { F_HFSR, ALL, DEBUGEVT } },
+	"A BKPT instruction, at s.pc {s.pc}, with no debugger attached" },
+
+  { "svc-escalated", 75,
+	{ { F_HFSR, ALL, FORCED }, { F_HFSR, NONE, VECTTBL },
+	  { F_CFSR, EQ, 0 } },
+	"Escalated to HardFault, yet cfsr is clear: an SVC at s.pc {s.pc} "
+	"where it could not be taken (faults masked, or in an ISR of higher "
+	"priority than SVCall)" },
+
+  { "escalated-priority", 50,
+	{ { F_HFSR, ALL, FORCED }, { F_HFSR, NONE, VECTTBL },
+	  { F_SHCSR, ANY, ENABLES } },
+	"Escalated to HardFault though fault handlers are enabled: the "
+	"fault came at or above its handler's priority, or in a fault "
+	"handler itself" },
+
+  { "escalated", 30,
+	{ { F_HFSR, ALL, FORCED }, { F_HFSR, NONE, VECTTBL },
+	  { F_SHCSR, NONE, ENABLES } },
+	"Escalated to HardFault, as the MemManage, BusFault and UsageFault "
+	"handlers are not enabled (shcsr[18:16]). cfsr says what happened" },
+
+  // Context
+  { "hang", 90,
+	{ { F_HANG, PRESENT, 0 } },
+	"Hang: the watchdog/timer found the code stuck, at s.pc {s.pc}" },
+
+  { "in-isr", 40,
+	{ { F_SPSR, ANY, IPSR } },
+	"The faulting code was an interrupt handler (s.psr {s.psr})" },
+
+  { "pc-in-ram", 40,
+	{ { F_PC_REGION, EQ, SRAM } },
+	"Executing from RAM, at {s.pc}: intended, or a function pointer or "
+	"return address into data" },
+
+  { "rtos-thread", 20,
+	{ { F_EXCRT, ALL, 4 } },
+	"Fault in a thread on the process stack, an RTOS task" },
+
+  // Host dumps, by signal, see hostFaults.c
+  { "null-fnptr", 95,
+	{ { F_SIG, EQ, SIGSEGV_ }, { F_SPC, EQ, 0 } },
+	"Call through a NULL function pointer: pc is 0. The call's return "
+	"address is the first call stack row (or s.lr {s.lr}, on a host "
+	"with a link register)" },
+
+  { "stack-overflow", 98,
+	{ { F_SIG, EQ, SIGSEGV_ }, { F_ADDR_NEAR_SP, EQ, 1 } },
+	"Stack overflow: the faulting access was at the stack pointer, in "
+	"the guard page below the stack. Look for deep recursion or large "
+	"locals" },
+
+  { "null-deref", 92,
+	{ { F_SIG, EQ, SIGSEGV_ }, { F_ADDR, LT, 0x1000 } },
+	"NULL pointer dereference: data access at {addr}, i.e. of a member "
+	"at that offset of a NULL struct pointer" },
+
+  { "fnptr-unmapped", 90,
+	{ { F_SIG, EQ, SIGSEGV_ }, { F_SPC, NE, 0 }, { F_PC_FROM_REG, EQ, 1 } },
+	"Call through a bad function pointer: pc {s.pc} is the value of an "
+	"argument register, so was branched to" },
+
+  { "bad-dataptr", 85,
+	{ { F_SIG, EQ, SIGSEGV_ }, { F_ADDR_FROM_REG, EQ, 1 } },
+	"Bad data pointer: the access to {addr} was through a value held "
+	"in an argument register, so a wild or uninitialised pointer" },
+
+  { "segv", 50,
+	{ { F_SIG, EQ, SIGSEGV_ } },
+	"Segmentation violation: a bad pointer, or a write to read-only "
+	"memory (code {code}: 1 nothing mapped there, 2 no permission)" },
+
+  { "unaligned", 90,
+	{ { F_SIG, EQ, SIGBUS_ }, { F_CODE, EQ, BUS_ADRALN_ } },
+	"Unaligned access, to {addr}: a pointer cast from a byte buffer, or "
+	"a packed struct member" },
+
+  { "mmap-truncated", 90,
+	{ { F_SIG, EQ, SIGBUS_ }, { F_CODE, EQ, BUS_ADRERR_ } },
+	"Access to {addr}, mapped but with nothing behind it: past the end "
+	"of an mmap'd file, or one truncated since it was mapped" },
+
+  { "div-by-zero", 95,
+	{ { F_SIG, EQ, SIGFPE_ }, { F_CODE, EQ, FPE_INTDIV_ } },
+	"Integer divide by zero, at pc {s.pc}" },
+
+  { "arithmetic", 60,
+	{ { F_SIG, EQ, SIGFPE_ } },
+	"Arithmetic exception (code {code}), at pc {s.pc}" },
+
+  { "undefined-instr", 70,
+	{ { F_SIG, EQ, SIGILL_ } },
+	"Illegal instruction: executing data, a __builtin_trap() (a "
+	"compiler-proven bug, or -fsanitize-trap), or code built for "
+	"another cpu" },
+
+  { "abort", 80,
+	{ { F_SIG, EQ, SIGABRT_ } },
+	"abort(): a failed assert, or the C library finding its heap "
+	"corrupt. Its message went to stderr" },
+};
+
+#define RULE_COUNT (sizeof rules / sizeof rules[0])
+
+typedef struct {
+  uint32_t values[F_COUNT];
+  uint64_t known;				// bit f set: values[f] is valid
+} fields;
+
+static void set( fields* f, field i, uint32_t value ) {
+  f->values[i] = value;
+  f->known |= (uint64_t)1 << i;
+}
+
+static int has( const fields* f, field i ) {
+  return (f->known >> i) & 1;
+}
+
+// Is v held, bar the Thumb bit, in any of the stacked r0-r3, r12?
+static int fromReg( const fields* f, uint32_t v ) {
+  for( field i = F_SR0; i <= F_SR12; i++ )
+	if( has( f, i ) && (f->values[i] & ~1u) == (v & ~1u) )
+	  return 1;
+  return 0;
+}
+
+/*
+  A host dump's rows, each 64-bit value a row and its 'h.' row, are
+  matched to fields by label (not in field order), and a value is
+  known only if its high word is 0, bar addr~sp, which needs all 64
+  bits.
+*/
+static void decodeHostFields( const dumpParsed* d, fields* f ) {
+  static const field hostFields[] = {
+	F_R7, F_SP, F_SIG, F_CODE, F_ADDR, F_SR0, F_SR1, F_SR2, F_SR3, F_SLR,
+	F_SPC
+  };
+  uint64_t addr = 0, sp = 0;
+  int haveAddr = 0, haveSp = 0;
+  for( int r = 0; r < d->regCount; r++ ) {
+	const char* label = d->regs[r].label;
+	uint64_t value = d->regs[r].value;
+	int wide = r + 1 < d->regCount &&
+	  memcmp( d->regs[r+1].label, "h.", 2 ) == 0;
+	if( wide )
+	  value |= (uint64_t)d->regs[r+1].value << 32;
+	for( size_t k = 0; k < sizeof hostFields / sizeof hostFields[0];
+		 k++ ) {
+	  field i = hostFields[k];
+	  if( strncmp( label, fieldNames[i], strlen( fieldNames[i] ) ) )
+		continue;
+	  if( (value >> 32) == 0 )
+		set( f, i, (uint32_t)value );
+	  if( i == F_ADDR ) {
+		addr = value;
+		haveAddr = 1;
+	  } else if( i == F_SP ) {
+		sp = value;
+		haveSp = 1;
+	  }
+	  break;
+	}
+  }
+
+  if( has( f, F_SPC ) )
+	set( f, F_PC_FROM_REG, (uint32_t)fromReg( f, f->values[F_SPC] ) );
+  if( has( f, F_ADDR ) )
+	set( f, F_ADDR_FROM_REG, (uint32_t)fromReg( f, f->values[F_ADDR] ) );
+  if( haveAddr && haveSp && addr )
+	set( f, F_ADDR_NEAR_SP, addr + STACK_NEAR > sp &&
+		 addr < sp + STACK_NEAR );
+}
+
+/*
+  Rows come in field order, so each label is looked for from where the
+  last was found, one pass for the whole dump: batch mode diagnoses
+  every dump.
+*/
+static void decodeFields( const dumpParsed* d, fields* f ) {
+  memset( f, 0, sizeof *f );
+  if( d->layout.host ) {
+	decodeHostFields( d, f );
+	return;
+  }
+  field next = F_R7;
+  for( int r = 0; r < d->regCount; r++ ) {
+	const char* label = d->regs[r].label;
+	for( field i = next; i <= F_SFREE; i++ ) {
+	  // ovf.N, for any stack N
+	  size_t n = i == F_OVF ? 4 : 5;
+	  if( memcmp( label, fieldNames[i], n ) == 0 ) {
+		set( f, i, d->regs[r].value );
+		next = i + 1;
+		break;
+	  }
+	}
+  }
+
+  if( has( f, F_CFSR ) ) {
+	uint32_t cfsr = f->values[F_CFSR];
+	if( (cfsr & (1u << 7)) && has( f, F_MMFAR ) )
+	  set( f, F_ADDR, f->values[F_MMFAR] );
+	else if( (cfsr & (1u << 15)) && has( f, F_BFAR ) )
+	  set( f, F_ADDR, f->values[F_BFAR] );
+  }
+  if( has( f, F_SPC ) ) {
+	set( f, F_PC_REGION, (uint32_t)regionOf[f->values[F_SPC] >> 29] );
+	set( f, F_PC_FROM_REG, (uint32_t)fromReg( f, f->values[F_SPC] ) );
+  }
+  if( has( f, F_SLR ) )
+	set( f, F_LR_REGION, (uint32_t)regionOf[f->values[F_SLR] >> 29] );
+  if( has( f, F_R7 ) ) {
+	set( f, F_R7_REGION, (uint32_t)regionOf[f->values[F_R7] >> 29] );
+	set( f, F_R7_FROM_REG, (uint32_t)fromReg( f, f->values[F_R7] ) );
+  }
+  if( has( f, F_ADDR ) )
+	set( f, F_ADDR_FROM_REG, (uint32_t)fromReg( f, f->values[F_ADDR] ) );
+}
+
+static int passes( const fields* f, const ruleTest* t ) {
+  if( t->op == ABSENT )
+	return !has( f, t->field );
+  if( !has( f, t->field ) )
+	return 0;
+  uint32_t v = f->values[t->field];
+  switch( t->op ) {
+  case PRESENT:
+	return 1;
+  case EQ:
+	return v == t->operand;
+  case NE:
+	return v != t->operand;
+  case LT:
+	return v < t->operand;
+  case GE:
+	return v >= t->operand;
+  case ANY:
+	return (v & t->operand) != 0;
+  case ALL:
+	return (v & t->operand) == t->operand;
+  case NONE:
+	return (v & t->operand) == 0;
+  default:
+	return 0;
+  }
+}
+
+static int matches( const fields* f, const rule* r ) {
+  for( int i = 0; i < RULE_TESTS && r->tests[i].field != F_NONE; i++ )
+	if( !passes( f, r->tests + i ) )
+	  return 0;
+  return 1;
+}
+
+int faultGuruDiagnose( const dumpParsed* d, faultGuruDiagnosis* out,
+					   int max ) {
+  fields f;
+  decodeFields( d, &f );
+
+  int n = 0;
+  for( size_t i = 0; i < RULE_COUNT; i++ ) {
+	const rule* r = rules + i;
+	if( !matches( &f, r ) )
+	  continue;
+	// A name matched twice, by variants of one rule, counts once
+	int j;
+	for( j = 0; j < n; j++ )
+	  if( strcmp( out[j].name, r->name ) == 0 )
+		break;
+	if( j < n )
+	  continue;
+	// Insertion by score, ties keep table order
+	if( n == max && (n == 0 || out[n-1].score >= r->score) )
+	  continue;
+	if( n < max )
+	  n++;
+	for( j = n-1; j > 0 && out[j-1].score < r->score; j-- )
+	  out[j] = out[j-1];
+	out[j].name = r->name;
+	out[j].score = r->score;
+	out[j].explanation = r->explanation;
+  }
+  return n;
+}
+
+const char* faultGuruExplain( const dumpParsed* d,
+							  const faultGuruDiagnosis* diagnosis,
+							  char* buf, size_t len ) {
+  fields f;
+  decodeFields( d, &f );
+
+  size_t n = 0;
+  const char* s = diagnosis->explanation;
+  while( *s && n + 1 < len ) {
+	const char* close = *s == '{' ? strchr( s, '}' ) : NULL;
+	if( !close ) {
+	  buf[n++] = *s++;
+	  continue;
+	}
+	size_t nameLen = (size_t)(close - s - 1);
+	field i;
+	for( i = F_R7; i < F_COUNT; i++ )
+	  if( strcspn( fieldNames[i], " " ) == nameLen &&
+		  strncmp( fieldNames[i], s+1, nameLen ) == 0 )
+		break;
+	if( i < F_COUNT && has( &f, i ) )
+	  n += (size_t)snprintf( buf + n, len - n, "%08X",
+							 (unsigned)f.values[i] );
+	else
+	  n += (size_t)snprintf( buf + n, len - n, "?" );
+	if( n >= len )
+	  n = len - 1;
+	s = close + 1;
+  }
+  buf[n] = 0;
+  return buf;
+}
+
+// eof
@@ -0,0 +1,113 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+
+#include "faultHandling.h"
+
+#include "em_chip.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+#include "em_usart.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * As per ./stk3700.c (or ./stk3200.c) in terms of console printf setup.
+
+ * Full register capture.  Loads r4..r11 with recognisable values,
+ * then reads from an unmapped address.  Build (lib and test!) with
+ *
+ * $ make clean; make FULL_REGS=1 fullRegs.bin
+ *
+ * and expect dump rows r4 44444444 through r11 BBBBBBBB, plus msp,
+ * psp, ctrl, pmask (and bpri on CM3).  Without FULL_REGS, the dump
+ * is the usual one, no r4..r11.  Builds for both stk3700 and stk3200.
+ */
+
+void initConsole(void);
+void consoleWrite( char* s );
+
+// A place to hold the formatted fault dump, of correct size.
+static char faultDumpBuffer[FAULT_HANDLING_DUMP_SIZE];
+
+void consoleDumpProcessor(void) {
+  consoleWrite( faultDumpBuffer );
+}
+
+/*
+  Naked, so the compiler neither saves nor uses r4-r11 here.  We never
+  return (POSTHANDLER_LOOP), so trashing callee-saved regs is OK.  CM0
+  can only set r8-r11 via MOV from a low reg.
+*/
+__attribute__((naked))
+static void faultWithKnownRegs(void) {
+  __asm__( "LDR R0,=0x88888888\n"
+		   "MOV R8,R0\n"
+		   "LDR R0,=0x99999999\n"
+		   "MOV R9,R0\n"
+		   "LDR R0,=0xAAAAAAAA\n"
+		   "MOV R10,R0\n"
+		   "LDR R0,=0xBBBBBBBB\n"
+		   "MOV R11,R0\n"
+		   "LDR R4,=0x44444444\n"
+		   "LDR R5,=0x55555555\n"
+		   "LDR R6,=0x66666666\n"
+		   "LDR R7,=0x77777777\n"
+		   "LDR R0,=0x20202020\n"
+		   "LDR R0,[R0]\n"
+		   "BX LR\n"
+		   ".ltorg\n" );
+}
+
+int main(void) {
+
+  CHIP_Init();
+
+  initConsole();
+
+  faultHandlingSetDumpProcessor( faultDumpBuffer, consoleDumpProcessor );
+  faultHandlingSetPostFaultAction( POSTHANDLER_LOOP );
+
+  faultWithKnownRegs();
+
+  return 0;
+}
+
+__attribute__((naked))
+void HardFault_Handler(void) {
+  __asm__( "B FaultHandler\n" );
+}
+
+// eof
@@ -0,0 +1,129 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+
+#include "faultHandling.h"
+
+#include "em_chip.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+#include "em_usart.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * As per ./stk3700.c (or ./stk3200.c) in terms of console printf setup.
+
+ * Hang capture.  The main loop bumps a heartbeat, until it waits on
+ * a 'device ready' flag that never comes.  A 10Hz SysTick liveness
+ * check sees the heartbeat stall and branches to HangHandler. Expect
+ * a dump with 'hang  0000000F' (IPSR 15 = SysTick) and s.pc in
+ * waitReady.
+ */
+
+void initConsole(void);
+void consoleWrite( char* s );
+
+// A place to hold the formatted fault dump, of correct size.
+static char faultDumpBuffer[FAULT_HANDLING_DUMP_SIZE];
+
+void consoleDumpProcessor(void) {
+  consoleWrite( faultDumpBuffer );
+}
+
+static volatile uint32_t heartbeat;
+static volatile int deviceReady;
+
+// Called from SysTick_Handler (asm) below, non-zero means hung
+__attribute__((used))
+int livenessCheck(void) {
+  static uint32_t lastBeat = 0;
+  int hung = heartbeat == lastBeat;
+  lastBeat = heartbeat;
+  return hung;
+}
+
+__attribute__((noinline))
+static void waitReady(void) {
+  while( !deviceReady )
+	;
+}
+
+int main(void) {
+
+  CHIP_Init();
+
+  initConsole();
+
+  faultHandlingSetDumpProcessor( faultDumpBuffer, consoleDumpProcessor );
+
+  extern uint32_t __etext;
+  extern uint32_t __StackTop;
+  faultHandlingSetCallStackParameters( (uint32_t*)4, &__etext,
+									   &__StackTop, 0 );
+  faultHandlingSetPostFaultAction( POSTHANDLER_LOOP );
+
+  SysTick_Config( SystemCoreClock / 10 );
+
+  for( int i = 0; i < 1000000; i++ )
+	heartbeat++;
+
+  waitReady();
+
+  return 0;
+}
+
+/*
+  Branch to HangHandler only if the liveness check fails.  A plain
+  branch, so HangHandler sees the exception frame.
+*/
+__attribute__((naked))
+void SysTick_Handler(void) {
+  __asm__( "PUSH {R0,LR}\n"
+		   "BL livenessCheck\n"
+		   "POP {R1,R2}\n"
+		   "MOV LR,R2\n"
+		   "CMP R0,#0\n"
+		   "BEQ 1f\n"
+		   "B HangHandler\n"
+		   "1: BX LR\n" );
+}
+
+__attribute__((naked))
+void HardFault_Handler(void) {
+  __asm__( "B FaultHandler\n" );
+}
+
+// eof
@@ -0,0 +1,179 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "faultHandlingHistory.h"
+#include "testCheck.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: test the fault history (see faultHandlingHistory.c), the
+ * very code the target's fault handler runs, over simulated boots:
+ * signature recording, and the escalation policy's choice of action.
+ *
+ * $ make tools
+ * $ ./historyTest
+ */
+
+static faultHandlingSignature* slotOf( faultHandlingHistory* h,
+									   uint32_t signature ) {
+  for( int i = 0; i < FAULT_HANDLING_SIGNATURES; i++ )
+	if( h->signatures[i].signature == signature )
+	  return h->signatures + i;
+  return NULL;
+}
+
+static void testBoot(void) {
+  faultHandlingHistory h;
+
+  // Junk, as after power-on
+  memset( &h, 0xA5, sizeof h );
+  faultHandlingHistoryBoot( &h );
+  check( h.boots == 1 && slotOf( &h, 0xA5A5A5A5 ) == NULL &&
+		 slotOf( &h, 0 ) != NULL, "power-on clears history" );
+
+  faultHandlingHistoryRecord( &h, 7 );
+  faultHandlingHistoryBoot( &h );
+  check( h.boots == 2 && slotOf( &h, 7 ) != NULL,
+		 "reboot keeps history" );
+
+  h.bootsCheck ^= 1;
+  faultHandlingHistoryBoot( &h );
+  check( h.boots == 1 && slotOf( &h, 7 ) == NULL,
+		 "corrupt history cleared" );
+
+  uint32_t v[] = { 0, 0 };
+  check( faultHandlingSignatureOf( v, 0 ) != 0 &&
+		 faultHandlingSignatureOf( v, 2 ) != 0, "signature never 0" );
+}
+
+static void testRecord(void) {
+  faultHandlingHistory h;
+  memset( &h, 0, sizeof h );
+  faultHandlingHistoryBoot( &h );
+
+  check( faultHandlingHistoryRecord( &h, 100 ) == 1, "new signature" );
+  check( faultHandlingHistoryRecord( &h, 100 ) == 2 &&
+		 faultHandlingHistoryRecord( &h, 100 ) == 3, "repeats counted" );
+
+  // Fill the table, one new signature per boot
+  for( uint32_t s = 101; s < 100 + FAULT_HANDLING_SIGNATURES; s++ ) {
+	faultHandlingHistoryBoot( &h );
+	faultHandlingHistoryRecord( &h, s );
+  }
+  check( slotOf( &h, 0 ) == NULL, "table full" );
+
+  // 100 was seen least recently, despite its count
+  faultHandlingHistoryBoot( &h );
+  check( faultHandlingHistoryRecord( &h, 200 ) == 1 &&
+		 slotOf( &h, 100 ) == NULL, "full table, least recent replaced" );
+  faultHandlingSignature* s = slotOf( &h, 200 );
+  check( s && s->count == 1 && s->firstBoot == h.boots &&
+		 s->lastBoot == h.boots, "replacement slot reset" );
+
+  // A storm of the new fault is now suppressed, as a repeat
+  check( faultHandlingHistoryRecord( &h, 200 ) == 2,
+		 "new fault in a full table repeats" );
+
+  // Same lastBoot: the least counted goes
+  memset( &h, 0, sizeof h );
+  faultHandlingHistoryBoot( &h );
+  for( uint32_t s = 1; s <= FAULT_HANDLING_SIGNATURES; s++ )
+	for( int n = 0; n < (s == 2 ? 1 : 3); n++ )
+	  faultHandlingHistoryRecord( &h, s );
+  faultHandlingHistoryRecord( &h, 300 );
+  check( slotOf( &h, 2 ) == NULL && slotOf( &h, 1 ) != NULL &&
+		 slotOf( &h, 300 ) != NULL, "same boot, least counted replaced" );
+
+  // An unused slot beats any used one
+  memset( &h, 0, sizeof h );
+  faultHandlingHistoryBoot( &h );
+  faultHandlingHistoryRecord( &h, 1 );
+  faultHandlingHistoryBoot( &h );
+  faultHandlingHistoryRecord( &h, 2 );
+  check( slotOf( &h, 1 ) != NULL && slotOf( &h, 2 ) != NULL,
+		 "unused slot taken first" );
+}
+
+/*
+  The handler's choice of post-fault action, with actions as numbered
+  in faultHandling.h: 1 reset, 4 safemode, 5 sleep.
+*/
+static void testEscalate(void) {
+  static const faultHandlingEscalation policy[] = {
+	{ 2, 1 }, { 3, 4 }, { 5, 5 } };
+  faultHandlingHistory h;
+  memset( &h, 0, sizeof h );
+
+  faultHandlingHistoryBoot( &h );
+  check( faultHandlingHistoryEscalate( &h, NULL, 0, 3 ) == 3 &&
+		 h.windowFaults == 0, "no policy, configured action" );
+  check( faultHandlingHistoryEscalate( &h, policy, 3, 3 ) == 3 &&
+		 h.level == 0, "below policy, configured action" );
+
+  faultHandlingHistoryBoot( &h );
+  check( faultHandlingHistoryEscalate( &h, policy, 3, 3 ) == 1 &&
+		 h.level == 1, "level 1" );
+
+  faultHandlingHistoryBoot( &h );
+  uint32_t action = faultHandlingHistoryEscalate( &h, policy, 3, 3 );
+  check( action == 4 && h.level == 2, "level 2" );
+  h.safeMode = 1;
+  faultHandlingHistoryBoot( &h );
+  check( faultHandlingHistorySafeMode( &h ) &&
+		 !faultHandlingHistorySafeMode( &h ), "safe mode seen once" );
+
+  faultHandlingHistoryEscalate( &h, policy, 3, 3 );
+  check( faultHandlingHistoryEscalate( &h, policy, 3, 3 ) == 5 &&
+		 h.level == 3, "level 3" );
+
+  // A quiet window drops the level
+  for( int i = 0; i <= FAULT_HANDLING_STORM_WINDOW; i++ )
+	faultHandlingHistoryBoot( &h );
+  check( h.level == 0 &&
+		 faultHandlingHistoryEscalate( &h, policy, 3, 3 ) == 3,
+		 "quiet window, back to configured action" );
+}
+
+int main(void) {
+  testBoot();
+  testRecord();
+  testEscalate();
+  return checkSummary();
+}
+
+// eof
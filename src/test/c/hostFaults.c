@@ -0,0 +1,370 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "faultHandling.h"
+#include "faultHandlingTrace.h"
+#include "faultGuru.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: test the Linux host port (faultHandlingHost.c) with real
+ * faults.  Each case runs in a child process, which faults, for real:
+ * a NULL pointer dereference, a call through a NULL function pointer,
+ * a stack overflow and more.  The child's dump processor writes the
+ * dump down a pipe, then the child dies of its signal (post-fault
+ * action RESET).  The parent parses the dump (dumpParse.c) and checks
+ * signal, si_code and fault address, that the call stack rows found
+ * the function which faulted, that the trace rows hold the case's
+ * last event, and that faultGuru's rules diagnose it rightly.
+ *
+ * Last, the RECOVER action: one process faults over and over, each
+ * time longjmp'd back to its recovery point.
+ *
+ * $ make tools
+ * $ ./hostFaults [-v]
+ *
+ * -v prints each dump.  Build with FAULT_HANDLING_HOST and trace rows,
+ * see the Makefile.
+ */
+
+#if (FAULT_HANDLING_TRACE_DUMP_ENTRIES == 0)
+#error hostFaults checks trace rows, build with FAULT_HANDLING_TRACE_DUMP_ENTRIES
+#endif
+
+static char dumpBuffer[FAULT_HANDLING_DUMP_SIZE];
+static int dumpFd = -1;
+
+// write(), not stdio: we are in a signal handler
+static void dumpToPipe(void) {
+  size_t n = strlen( dumpBuffer );
+  const char* p = dumpBuffer;
+  while( n ) {
+	ssize_t w = write( dumpFd, p, n );
+	if( w <= 0 )
+	  return;
+	p += w;
+	n -= (size_t)w;
+  }
+}
+
+/*
+  The faults.  Each is noinline, and called through faultVia, so a
+  return address into faultVia is on the stack at the fault.
+*/
+struct record {
+  int header[4];
+  int member;
+};
+
+static __attribute__((noinline)) int nullDeref( void* arg ) {
+  struct record* volatile r = arg;
+  return r->member;
+}
+
+static __attribute__((noinline)) int nullFnptr( void* arg ) {
+  int (* volatile fp)( int ) = arg;
+  return fp( 42 ) + 1;
+}
+
+static __attribute__((noinline)) int wildPointer( void* arg ) {
+  return *(volatile int*)arg;
+}
+
+// Always, but the compiler cannot know it
+static volatile int bottomless = 1;
+
+static __attribute__((noinline)) int recurse( void* arg ) {
+  volatile char frame[512];
+  frame[0] = (char)(uintptr_t)arg;
+  if( !bottomless )
+	return 0;
+  return recurse( (void*)frame ) + frame[1];
+}
+
+// Beyond the end of a file, truncated since it was mapped
+static __attribute__((noinline)) int truncatedMap( void* arg ) {
+  (void)arg;
+  char path[] = "/tmp/hostFaultsXXXXXX";
+  int fd = mkstemp( path );
+  if( fd < 0 || ftruncate( fd, 4096 ) )
+	return -1;
+  volatile int* map = mmap( NULL, 4096, PROT_READ, MAP_SHARED, fd, 0 );
+  unlink( path );
+  if( map == MAP_FAILED || ftruncate( fd, 0 ) )
+	return -1;
+  return map[1];
+}
+
+static __attribute__((noinline)) int failedAssert( void* arg ) {
+  (void)arg;
+  abort();
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Only x86 traps these, arm's udiv gives 0, its trap is a SIGTRAP
+static __attribute__((noinline)) int divideByZero( void* arg ) {
+  volatile int zero = (int)(uintptr_t)arg;
+  return 1000 / zero;
+}
+
+static __attribute__((noinline)) int illegalInstruction( void* arg ) {
+  (void)arg;
+  __builtin_trap();
+}
+#endif
+
+static __attribute__((noinline)) int faultVia( int (*f)( void* ),
+											   void* arg ) {
+  int result = f( arg );
+  faultHandlingTraceLog( 0xDEAD, (uint32_t)result );
+  return result;
+}
+
+// What a case should dump: sig, code, addr, and diagnosis
+#define ANY_CODE  0x7fffffff
+#define ANY_ADDR  ((uintptr_t)-1)
+#define AT_ARG    ((uintptr_t)-2)
+#define AT_PC     ((uintptr_t)-3)
+
+typedef struct {
+  const char* name;
+  int (*f)( void* );
+  void* arg;
+  int sig;
+  int code;
+  uintptr_t addr;
+  int (*caller)( void* );		// whose return address the stack holds
+  const char* diagnosis;		// faultGuru's first
+} faultCase;
+
+static const faultCase cases[] = {
+  { "null-deref", nullDeref, NULL, SIGSEGV, SEGV_MAPERR,
+	offsetof( struct record, member ), NULL, "null-deref" },
+  { "null-fnptr", nullFnptr, NULL, SIGSEGV, SEGV_MAPERR, 0, NULL,
+	"null-fnptr" },
+  { "wild-pointer", wildPointer, (void*)0xDEAD0000, SIGSEGV, SEGV_MAPERR,
+	AT_ARG, NULL, "bad-dataptr" },
+  { "stack-overflow", recurse, NULL, SIGSEGV, ANY_CODE, ANY_ADDR,
+	recurse, "stack-overflow" },
+  { "truncated-map", truncatedMap, NULL, SIGBUS, BUS_ADRERR, ANY_ADDR,
+	NULL, "mmap-truncated" },
+  { "abort", failedAssert, NULL, SIGABRT, ANY_CODE, 0, NULL, "abort" },
+#if defined(__x86_64__) || defined(__i386__)
+  { "div-by-zero", divideByZero, NULL, SIGFPE, FPE_INTDIV, AT_PC, NULL,
+	"div-by-zero" },
+  { "illegal-instr", illegalInstruction, NULL, SIGILL, ANY_CODE, AT_PC,
+	NULL, "undefined-instr" },
+#endif
+};
+
+#define CASES ((int)(sizeof cases / sizeof cases[0]))
+
+static int verbose = 0;
+
+// A host dump's 64-bit value, a row then its 'h.' row
+static uint64_t wide( const dumpParsed* d, const char* label ) {
+  const dumpParseReg* r = dumpParseFind( d, label );
+  if( !r )
+	return 0;
+  return r->value | ((uint64_t)r[1].value << 32);
+}
+
+/*
+  A call stack row in @p f: a return address between f and a generous
+  guess at its end.  Functions here are small.
+*/
+static int stackHolds( const dumpParsed* d, uintptr_t f ) {
+  uint64_t lo = (uint64_t)f;
+  uint64_t high = (uint64_t)dumpParseFind( d, "h.txt" )->value << 32;
+  for( int i = 0; i < d->stackCount; i++ ) {
+	uint64_t v = high | d->stackVals[i];
+	if( d->stackAddrs[i] && v > lo && v < lo + 0x200 )
+	  return 1;
+  }
+  return 0;
+}
+
+static int check( const faultCase* c, const char* text, size_t len,
+				  int status ) {
+  int errors = 0;
+#define FAIL(...) do { printf( "%s: ", c->name ); printf( __VA_ARGS__ ); \
+	printf( "\n" ); errors++; } while( 0 )
+
+  if( !WIFSIGNALED( status ) || WTERMSIG( status ) != c->sig )
+	FAIL( "child did not die of signal %d (status %X)", c->sig,
+		  (unsigned)status );
+
+  static dumpParsed d;
+  int result = dumpParseText( text, len, &d );
+  if( result ) {
+	FAIL( "bad dump: %s", dumpParseError( result ) );
+	return errors;
+  }
+  if( verbose )
+	printf( "%.*s\n", (int)len, text );
+  if( !d.layout.host )
+	FAIL( "not a host dump" );
+
+  uint32_t sig = dumpParseFind( &d, "sig" )->value;
+  uint32_t code = dumpParseFind( &d, "code" )->value;
+  uint64_t addr = wide( &d, "addr" );
+  uint64_t pc = wide( &d, "s.pc" );
+  if( sig != (uint32_t)c->sig )
+	FAIL( "sig %u, not %d", (unsigned)sig, c->sig );
+  if( c->code != ANY_CODE && code != (uint32_t)c->code )
+	FAIL( "code %d, not %d", (int)code, c->code );
+  uint64_t want = c->addr == AT_ARG ? (uint64_t)(uintptr_t)c->arg :
+	c->addr == AT_PC ? pc : (uint64_t)c->addr;
+  if( c->addr != ANY_ADDR && addr != want )
+	FAIL( "addr %llX, not %llX", (unsigned long long)addr,
+		  (unsigned long long)want );
+  if( c->f == nullFnptr && pc != 0 )
+	FAIL( "pc %llX, not 0", (unsigned long long)pc );
+
+  uintptr_t caller = c->caller ? (uintptr_t)c->caller : (uintptr_t)faultVia;
+  if( !stackHolds( &d, caller ) )
+	FAIL( "no call stack row in the caller" );
+
+  if( d.traceCount != FAULT_HANDLING_TRACE_DUMP_ENTRIES ||
+	  d.traceIds[d.traceCount-1] != 0xCA5E ||
+	  d.traceArgs[d.traceCount-1] != (uint32_t)(c - cases) )
+	FAIL( "last trace row not the case's event" );
+
+  faultGuruDiagnosis diagnoses[4];
+  int n = faultGuruDiagnose( &d, diagnoses, 4 );
+  if( n == 0 || strcmp( diagnoses[0].name, c->diagnosis ) )
+	FAIL( "diagnosed %s, not %s", n ? diagnoses[0].name : "nothing",
+		  c->diagnosis );
+#undef FAIL
+  return errors;
+}
+
+static int runCase( const faultCase* c ) {
+  int fds[2];
+  if( pipe( fds ) ) {
+	perror( "pipe" );
+	return 1;
+  }
+  fflush( stdout );
+  pid_t pid = fork();
+  if( pid == 0 ) {
+	close( fds[0] );
+	dumpFd = fds[1];
+	faultHandlingSetDumpProcessor( dumpBuffer, dumpToPipe );
+	faultHandlingSetPostFaultAction( POSTHANDLER_RESET );
+	faultHandlingTraceInit();
+	faultHandlingTraceLog( 0xCA5E, (uint32_t)(c - cases) );
+	faultVia( c->f, c->arg );
+	_exit( 0 );
+  }
+  close( fds[1] );
+  static char text[FAULT_HANDLING_DUMP_SIZE];
+  size_t len = 0;
+  ssize_t n;
+  while( len < sizeof text &&
+		 (n = read( fds[0], text + len, sizeof text - len )) > 0 )
+	len += (size_t)n;
+  close( fds[0] );
+  int status;
+  waitpid( pid, &status, 0 );
+  return check( c, text, len, status );
+}
+
+// RECOVER: fault, dump, longjmp back, again and again
+#define RECOVERIES 100
+
+static int recoveries( void ) {
+  static jmp_buf env;
+  static volatile int faults;
+  static volatile int dumps;
+
+  faults = dumps = 0;
+  dumpFd = open( "/dev/null", O_WRONLY );
+  faultHandlingSetDumpProcessor( dumpBuffer, dumpToPipe );
+  faultHandlingSetPostFaultAction( POSTHANDLER_RECOVER );
+  faultHandlingSetRecoveryPoint( &env );
+  if( setjmp( env ) )
+	dumps++;
+  if( faults < RECOVERIES ) {
+	faults++;
+	faultVia( nullDeref, NULL );
+  }
+  faultHandlingSetRecoveryPoint( NULL );
+  close( dumpFd );
+  if( dumps != RECOVERIES ) {
+	printf( "recover: %d faults, %d recoveries\n", faults, dumps );
+	return 1;
+  }
+  return 0;
+}
+
+int main( int argc, char* argv[] ) {
+
+  for( int i = 1; i < argc; i++ ) {
+	if( strcmp( argv[i], "-v" ) == 0 )
+	  verbose = 1;
+	else {
+	  fprintf( stderr, "Usage: %s [-v]\n", argv[0] );
+	  return 1;
+	}
+  }
+
+  int failed = 0;
+  for( int i = 0; i < CASES; i++ ) {
+	int errors = runCase( cases + i );
+	printf( "%-16s %s\n", cases[i].name, errors ? "FAIL" : "ok" );
+	failed += errors != 0;
+  }
+  int errors = recoveries();
+  printf( "%-16s %s\n", "recover", errors ? "FAIL" : "ok" );
+  failed += errors;
+
+  printf( "%d/%d passed\n", CASES + 1 - failed, CASES + 1 );
+  return failed != 0;
+}
+
+// eof
@@ -0,0 +1,427 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "faultHandlingCompress.h"
+#include "dumpParse.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: test the dump ingest daemon (dumpIngest.c) end to end,
+ * pseudo-terminals standing in for the boards.  Opens -p ptys, starts
+ * the daemon on their slave sides, then plays each board's console
+ * into its master side: boot banners and debug prints, with -n fault
+ * dumps among them, text and binary, some '\r\n' terminated, some cut
+ * short by a 'reset'.  Bytes go out in random sized pieces, round
+ * robin over the ptys, so every device's dumps arrive fragmented and
+ * interleaved with everyone else's.
+ *
+ * Then checks the dump store: every whole dump each board sent is in
+ * its unit's file, in order, exactly, and nothing else is.
+ *
+ * $ make dumpIngest ingestTest
+ * $ ./ingestTest [-d ./dumpIngest] [-p ptys] [-n dumpsPerPty] [-v]
+ *     [dumpFile...]
+ *
+ * Dumps are drawn from the given files, default the README's and the
+ * diagnosis corpus's, so run from the top directory.  -v shows the
+ * daemon's output.
+ */
+
+#define MAX_PTYS    64
+#define MAX_SOURCES 64
+#define WAIT_MS     10000
+
+static const char* const defaultSources[] = {
+  "src/test/resources/dumps/quizA.txt",
+  "src/test/resources/dumps/quizB.txt",
+  "src/test/resources/dumps/quizC.txt",
+  "src/test/resources/dumps/quizD.txt",
+  "src/test/resources/dumps/quizE.txt",
+  "src/test/resources/dumps/readme.txt",
+  "src/test/resources/diagnosis/branchZero.txt",
+  "src/test/resources/diagnosis/hang.txt",
+  "src/test/resources/diagnosis/stackGuard.txt",
+  "src/test/resources/diagnosis/hostNullDeref.txt",
+};
+
+// A dump, as the daemon should store it, and as a board may send it
+typedef struct {
+  char text[4096];		// canonical, dumpParseFormat's
+  size_t textLength;
+  uint8_t binary[FAULT_HANDLING_COMPRESS_SIZE(DUMP_PARSE_MAX_VALUES)];
+  int binaryLength;		// 0: no binary form, not a default layout
+} source;
+
+static source sources[MAX_SOURCES];
+static int sourceCount = 0;
+
+// What one board sends, and what of it should be stored
+typedef struct {
+  int master;
+  char slave[64];
+  char* out;
+  size_t outLength, outSent;
+  char* want;
+  size_t wantLength;
+  int dumps;
+} board;
+
+static board boards[MAX_PTYS];
+
+static int loadSource( const char* path ) {
+  static char text[1 << 16];
+  FILE* fp = fopen( path, "r" );
+  if( !fp ) {
+	perror( path );
+	return -1;
+  }
+  size_t length = fread( text, 1, sizeof text - 1, fp );
+  fclose( fp );
+  text[length] = 0;
+
+  static dumpParsed d;
+  const char* start = strstr( text, "r7   " );
+  int result = start ? dumpParseText( start, length -
+									  (size_t)(start - text), &d ) :
+	DUMP_PARSE_BAD_ROW;
+  if( result ) {
+	fprintf( stderr, "%s: %s\n", path, dumpParseError( result ) );
+	return -1;
+  }
+  source* s = sources + sourceCount++;
+  s->textLength = (size_t)dumpParseFormat( &d, s->text, sizeof s->text );
+
+  faultHandlingCompressBases bases = { 0, 0x20020000, d.regs[1].value };
+  s->binaryLength = faultHandlingCompress( s->text, &bases, s->binary,
+										   (int)sizeof s->binary );
+  // Binary only where the daemon can tell the layout, see dumpParseBinary
+  static dumpParsed back;
+  if( s->binaryLength < 0 ||
+	  dumpParseBinary( s->binary, (size_t)s->binaryLength, NULL, &back ) ||
+	  back.regCount != d.regCount ) {
+	s->binaryLength = 0;
+	return 0;
+  }
+
+  // Stored as the text would be, labels and all
+  static char backText[4096];
+  size_t backLength = (size_t)dumpParseFormat( &back, backText,
+											   sizeof backText );
+  if( backLength != s->textLength ||
+	  memcmp( backText, s->text, backLength ) ) {
+	fprintf( stderr, "%s: compressed, does not parse back the same\n",
+			 path );
+	return -1;
+  }
+  return 0;
+}
+
+static void append( char** buf, size_t* length, size_t* capacity,
+					const void* data, size_t n ) {
+  if( *length + n > *capacity ) {
+	*capacity = 2 * (*length + n);
+	*buf = realloc( *buf, *capacity );
+  }
+  memcpy( *buf + *length, data, n );
+  *length += n;
+}
+
+static const char* const chatter[] = {
+  "boot: stk3700 v1.4.2\r\n",
+  "radio: tx 42 bytes\r\n",
+  "sensor 3: 21.5C\n",
+  "watchdog armed, 4000 ms\n",
+  "r7 is not a dump row, just chatter\n",
+  "a line far too long to be any row of a fault dump, so it must be "
+  "noise, and any dump it interrupts is done................\n",
+};
+
+#define CHATTER (sizeof chatter / sizeof chatter[0])
+
+/*
+  A board's console: chatter, dumps, chatter.  One dump in five is cut
+  short, by a 'reset', so not stored.
+*/
+static void script( board* b, int dumps ) {
+  size_t outCapacity = 0, wantCapacity = 0;
+  for( int k = 0; k < dumps; k++ ) {
+	const char* c = chatter[rand() % CHATTER];
+	append( &b->out, &b->outLength, &outCapacity, c, strlen( c ) );
+
+	const source* s = sources + rand() % sourceCount;
+	int cut = rand() % 5 == 0;
+	if( s->binaryLength && rand() % 2 ) {
+	  size_t n = (size_t)s->binaryLength;
+	  if( cut )
+		n = (size_t)(rand() % s->binaryLength);
+	  append( &b->out, &b->outLength, &outCapacity, s->binary, n );
+	} else if( cut ) {
+	  // A few rows, then the 'reset'
+	  size_t n = 15 * (size_t)(1 + rand() % 8);
+	  append( &b->out, &b->outLength, &outCapacity, s->text, n );
+	} else if( rand() % 2 ) {
+	  append( &b->out, &b->outLength, &outCapacity, s->text,
+			  s->textLength );
+	} else {
+	  // As a terminal program would save it
+	  for( size_t i = 0; i < s->textLength; i++ ) {
+		if( s->text[i] == '\n' )
+		  append( &b->out, &b->outLength, &outCapacity, "\r", 1 );
+		append( &b->out, &b->outLength, &outCapacity, s->text + i, 1 );
+	  }
+	}
+	if( cut )
+	  continue;
+	append( &b->want, &b->wantLength, &wantCapacity, s->text,
+			s->textLength );
+	b->dumps++;
+  }
+}
+
+static int openPty( board* b ) {
+  b->master = posix_openpt( O_RDWR | O_NOCTTY );
+  if( b->master < 0 || grantpt( b->master ) || unlockpt( b->master ) ) {
+	perror( "posix_openpt" );
+	return -1;
+  }
+  snprintf( b->slave, sizeof b->slave, "%s", ptsname( b->master ) );
+
+  /*
+	Raw from the start, else the line discipline would echo back, and
+	map '\r's, whatever arrived before the daemon set raw mode
+  */
+  int fd = open( b->slave, O_RDWR | O_NOCTTY );
+  struct termios t;
+  if( fd < 0 || tcgetattr( fd, &t ) ) {
+	perror( b->slave );
+	return -1;
+  }
+  cfmakeraw( &t );
+  tcsetattr( fd, TCSANOW, &t );
+  close( fd );
+  return 0;
+}
+
+static long now( void ) {
+  struct timespec t;
+  clock_gettime( CLOCK_MONOTONIC, &t );
+  return t.tv_sec * 1000L + t.tv_nsec / 1000000L;
+}
+
+static char* readFile( const char* path, size_t* length ) {
+  *length = 0;
+  FILE* fp = fopen( path, "r" );
+  if( !fp )
+	return NULL;
+  char* buf = NULL;
+  size_t capacity = 0;
+  char chunk[4096];
+  size_t n;
+  while( (n = fread( chunk, 1, sizeof chunk, fp )) > 0 )
+	append( &buf, length, &capacity, chunk, n );
+  fclose( fp );
+  return buf;
+}
+
+int main( int argc, char* argv[] ) {
+
+  const char* daemon = "./dumpIngest";
+  int ptys = 8, dumpsPerPty = 50, verbose = 0;
+  int i;
+  for( i = 1; i < argc && argv[i][0] == '-'; i++ ) {
+	if( strcmp( argv[i], "-d" ) == 0 && i+1 < argc )
+	  daemon = argv[++i];
+	else if( strcmp( argv[i], "-p" ) == 0 && i+1 < argc )
+	  ptys = atoi( argv[++i] );
+	else if( strcmp( argv[i], "-n" ) == 0 && i+1 < argc )
+	  dumpsPerPty = atoi( argv[++i] );
+	else if( strcmp( argv[i], "-v" ) == 0 )
+	  verbose = 1;
+	else {
+	  fprintf( stderr, "Usage: %s [-d ./dumpIngest] [-p ptys] "
+			   "[-n dumpsPerPty] [-v] [dumpFile...]\n", argv[0] );
+	  return 1;
+	}
+  }
+  if( ptys < 1 || ptys > MAX_PTYS ) {
+	fprintf( stderr, "%s: 1 to %d ptys\n", argv[0], MAX_PTYS );
+	return 1;
+  }
+  if( i == argc ) {
+	for( size_t k = 0; k < sizeof defaultSources /
+		   sizeof defaultSources[0]; k++ )
+	  if( loadSource( defaultSources[k] ) )
+		return 1;
+  } else
+	for( ; i < argc && sourceCount < MAX_SOURCES; i++ )
+	  if( loadSource( argv[i] ) )
+		return 1;
+
+  srand( 1234 );
+  for( int p = 0; p < ptys; p++ ) {
+	if( openPty( boards + p ) )
+	  return 1;
+	script( boards + p, dumpsPerPty );
+  }
+
+  char store[] = "/tmp/ingestTestXXXXXX";
+  if( !mkdtemp( store ) ) {
+	perror( "mkdtemp" );
+	return 1;
+  }
+
+  // The daemon: board00=/dev/pts/N ...
+  char* args[MAX_PTYS + 8];
+  char units[MAX_PTYS][96];
+  int a = 0;
+  args[a++] = (char*)daemon;
+  args[a++] = "-s";
+  args[a++] = store;
+  args[a++] = "-q";
+  args[a++] = "500";
+  for( int p = 0; p < ptys; p++ ) {
+	snprintf( units[p], sizeof units[p], "board%02d=%s", p,
+			  boards[p].slave );
+	args[a++] = units[p];
+  }
+  args[a] = NULL;
+  pid_t pid = fork();
+  if( pid == 0 ) {
+	if( !verbose ) {
+	  int null = open( "/dev/null", O_WRONLY );
+	  dup2( null, 1 );
+	  dup2( null, 2 );
+	}
+	execv( daemon, args );
+	perror( daemon );
+	_exit( 127 );
+  }
+  // Let it open the ptys: bytes before that are not lost, just queued
+  usleep( 100000 );
+
+  // Round robin, random sized pieces, until every board is done
+  long t0 = now();
+  size_t total = 0;
+  for( int busy = 1; busy; ) {
+	busy = 0;
+	for( int p = 0; p < ptys; p++ ) {
+	  board* b = boards + p;
+	  size_t left = b->outLength - b->outSent;
+	  if( !left )
+		continue;
+	  size_t n = 1 + (size_t)(rand() % 64);
+	  if( n > left )
+		n = left;
+	  ssize_t w = write( b->master, b->out + b->outSent, n );
+	  if( w < 0 ) {
+		perror( "write" );
+		return 1;
+	  }
+	  b->outSent += (size_t)w;
+	  total += (size_t)w;
+	  busy = 1;
+	}
+  }
+
+  // Wait for the store to hold what it should, or time out
+  int failed = 0, stored = 0, wanted = 0;
+  for( int p = 0; p < ptys; p++ )
+	wanted += boards[p].dumps;
+  long deadline = now() + WAIT_MS;
+  while( 1 ) {
+	int complete = 1;
+	for( int p = 0; p < ptys && complete; p++ ) {
+	  char path[128];
+	  struct stat st;
+	  snprintf( path, sizeof path, "%s/board%02d.txt", store, p );
+	  if( stat( path, &st ) ? boards[p].wantLength > 0 :
+		  (size_t)st.st_size < boards[p].wantLength )
+		complete = 0;
+	}
+	if( complete || now() > deadline )
+	  break;
+	usleep( 10000 );
+  }
+  long elapsed = now() - t0;
+
+  kill( pid, SIGTERM );
+  int status;
+  waitpid( pid, &status, 0 );
+  if( !WIFEXITED( status ) || WEXITSTATUS( status ) ) {
+	printf( "daemon exit status %X\n", (unsigned)status );
+	failed++;
+  }
+
+  for( int p = 0; p < ptys; p++ ) {
+	board* b = boards + p;
+	char path[128];
+	snprintf( path, sizeof path, "%s/board%02d.txt", store, p );
+	size_t length;
+	char* got = readFile( path, &length );
+	if( length != b->wantLength ||
+		(length && memcmp( got, b->want, length )) ) {
+	  printf( "board%02d: stored %zu bytes, not the %zu of its %d dumps\n",
+			  p, length, b->wantLength, b->dumps );
+	  failed++;
+	} else
+	  stored += b->dumps;
+	free( got );
+	unlink( path );
+	close( b->master );
+	free( b->out );
+	free( b->want );
+  }
+  rmdir( store );
+
+  printf( "%d ptys, %zu bytes, %d/%d dumps stored in %ld ms%s\n", ptys,
+		  total, stored, wanted, elapsed, failed ? ", FAILED" : "" );
+  return failed != 0;
+}
+
+// eof
@@ -0,0 +1,125 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <setjmp.h>
+
+#include "faultHandling.h"
+
+#include "em_chip.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+#include "em_usart.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * As per ./stk3700.c in terms of console printf setup.
+
+ * Memory windows.  Build (lib and test) with
+ *
+ * $ make clean; make MEMORY_WINDOWS=1 memoryWindows.bin
+ *
+ * Two bus faults, recovered from (see recovery.c), so two dumps:
+ *
+ * 1: a read just beyond the end of RAM. The bfar window starts at
+ * the last RAM word, readable, the rest is not: mask 1.
+ *
+ * 2: a read of an unmapped address, nothing around it readable:
+ * mask 0.
+ *
+ * In both, the first (pc) window holds the LDR that faulted, at
+ * s.pc, plus its neighbours: disassemble it, see README.md.
+ */
+
+void initConsole(void);
+void consoleWrite( char* s );
+
+// A place to hold the formatted fault dump, of correct size.
+static char faultDumpBuffer[FAULT_HANDLING_DUMP_SIZE];
+
+void consoleDumpProcessor(void) {
+  consoleWrite( faultDumpBuffer );
+}
+
+static jmp_buf mainLoop;
+
+__attribute__((noinline))
+static uint32_t readWord( uint32_t addr ) {
+  return *(volatile uint32_t*)addr;
+}
+
+int main(void) {
+
+  CHIP_Init();
+
+  initConsole();
+
+  faultHandlingSetDumpProcessor( faultDumpBuffer, consoleDumpProcessor );
+
+  extern uint32_t __etext;
+  extern uint32_t __StackTop;
+  faultHandlingSetCallStackParameters( 0, &__etext, &__StackTop, 0 );
+
+  faultHandlingSetPostFaultAction( POSTHANDLER_RECOVER );
+  faultHandlingSetRecoveryPoint( &mainLoop );
+
+  // volatile, since modified between setjmp and longjmp
+  volatile int faults = 0;
+
+  if( setjmp( mainLoop ) )
+	faults++;
+
+  // __StackTop is also the end of RAM, see the linker script
+  if( faults == 0 )
+	readWord( (uint32_t)&__StackTop );
+  else if( faults == 1 )
+	readWord( 0x20202020 );
+
+  consoleWrite( "Done\r\n" );
+
+  faultHandlingSetRecoveryPoint( NULL );
+
+  while( 1 )
+	;
+
+  return 0;
+}
+
+__attribute__((naked))
+void HardFault_Handler(void) {
+  __asm__( "B FaultHandler\n" );
+}
+
+// eof
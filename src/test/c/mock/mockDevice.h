@@ -0,0 +1,79 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#ifndef FAULT_HANDLING_MOCK_DEVICE_H
+#define FAULT_HANDLING_MOCK_DEVICE_H
+
+#include <stdint.h>
+
+/**
+ * @author Stuart Maclean
+ *
+ * A host-side stand-in for a CMSIS device header, just enough for
+ * faultHandlingExport.c to build and run on the host, see
+ * exportTest.c:
+ *
+ * $ cc -DCMSIS_device_header=\"mockDevice.h\" -Isrc/test/c/mock ...
+ *
+ * The ITM's enable registers are plain memory.  Stimulus port
+ * accesses, which on a real ITM have side effects (a write queues a
+ * packet, a read reports FIFO space), go through the mock functions
+ * instead, which the test defines.
+ */
+
+#define __CORTEX_M (3)
+
+typedef struct {
+  volatile uint32_t TER;
+  volatile uint32_t TCR;
+} ITM_Type;
+
+extern ITM_Type mockITM;
+
+#define ITM (&mockITM)
+
+#define ITM_TCR_ITMENA_Msk (1UL)
+
+int mockITMReady( uint32_t port );
+void mockITMWrite( uint32_t port, uint32_t value, int bytes );
+
+#define ITM_PORT_READY( port )       mockITMReady( port )
+#define ITM_PORT_WRITE32( port, w )  mockITMWrite( port, w, 4 )
+#define ITM_PORT_WRITE8( port, c )   mockITMWrite( port, c, 1 )
+
+#define __DMB() __sync_synchronize()
+
+#endif
+
+// eof
@@ -0,0 +1,117 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+
+#include "faultHandling.h"
+
+#include "em_chip.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+#include "em_usart.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * As per ./stk3700.c (or ./stk3200.c) in terms of console printf setup.
+
+ * Safe memory probes: read and write words at addresses which may or
+ * may not exist, getting an error code back rather than a fault
+ * dump. Builds for both stk3700 (CM3, probes via BFHFNMIGN) and
+ * stk3200 (CM0+, probes via the fault handler skipping the access).
+ * No fault dump should appear on the console, only probe results.
+ */
+
+void initConsole(void);
+void consoleWrite( char* s );
+
+// A place to hold the formatted fault dump, of correct size.
+static char faultDumpBuffer[FAULT_HANDLING_DUMP_SIZE];
+
+void consoleDumpProcessor(void) {
+  consoleWrite( faultDumpBuffer );
+}
+
+static void probe( uint32_t addr ) {
+  char msg[48];
+  uint32_t value = 0;
+  int result = faultHandlingProbeRead32( addr, &value );
+  sprintf( msg, "read  %08lX: %s %08lX\r\n", (unsigned long)addr,
+		   result == FAULT_HANDLING_PROBE_OK ? "ok   " : "FAULT",
+		   (unsigned long)value );
+  consoleWrite( msg );
+
+  result = faultHandlingProbeWrite32( addr, value );
+  sprintf( msg, "write %08lX: %s\r\n", (unsigned long)addr,
+		   result == FAULT_HANDLING_PROBE_OK ? "ok   " : "FAULT" );
+  consoleWrite( msg );
+}
+
+int main(void) {
+
+  CHIP_Init();
+
+  initConsole();
+
+  faultHandlingSetDumpProcessor( faultDumpBuffer, consoleDumpProcessor );
+  faultHandlingSetPostFaultAction( POSTHANDLER_LOOP );
+
+  // Start of RAM: exists on every part
+  probe( 0x20000000 );
+
+  // Well beyond the RAM of either board
+  probe( 0x20202020 );
+
+  // Start of the 'external RAM' region, nothing fitted on these boards
+  probe( 0x60000000 );
+
+  // Unaligned, refused without any access, on either board
+  probe( 0x20000002 );
+
+  consoleWrite( "Done\r\n" );
+
+  return 0;
+}
+
+/*
+  We MUST define a HardFault_Handler.  It just vectors to
+  faultHandling's provided FaultHandler, which on CM0+ is where the
+  probes' faults are caught.
+*/
+__attribute__((naked))
+void HardFault_Handler(void) {
+  __asm__( "B FaultHandler\n" );
+}
+
+// eof
@@ -0,0 +1,150 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+
+#include "faultHandling.h"
+
+#include "em_chip.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+#include "em_usart.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * As per ./stk3700.c in terms of console printf setup.
+
+ * The sampling profiler: SysTick at 1kHz vectors to our
+ * ProfileHandler, while main runs a known workload.  Then the samples
+ * are printed to the console, one per line, for profileReport (with
+ * this program's .map) to chew on. The header line gives the measured
+ * overhead, in cycles per sample.
+ *
+ * Expect filterStep to dominate, checksum next, both called by work.
+ */
+
+void initConsole(void);
+void consoleWrite( char* s );
+
+// A place to hold the formatted fault dump, of correct size.
+static char faultDumpBuffer[FAULT_HANDLING_DUMP_SIZE];
+
+void consoleDumpProcessor(void) {
+  consoleWrite( faultDumpBuffer );
+}
+
+#define SAMPLES 256
+
+static uint32_t samples[SAMPLES*FAULT_HANDLING_PROFILE_RECORD];
+
+static volatile uint32_t sink;
+
+// Not inlined, else nothing to attribute
+__attribute__((noinline))
+static uint32_t filterStep( uint32_t x ) {
+  for( int i = 0; i < 200; i++ )
+	x = x * 1103515245 + 12345;
+  return x;
+}
+
+__attribute__((noinline))
+static uint32_t checksum( uint32_t x ) {
+  for( int i = 0; i < 100; i++ )
+	x ^= x << 3;
+  return x;
+}
+
+__attribute__((noinline))
+static void work(void) {
+  sink = checksum( filterStep( sink ) );
+}
+
+int main(void) {
+
+  CHIP_Init();
+
+  initConsole();
+
+  faultHandlingSetDumpProcessor( faultDumpBuffer, consoleDumpProcessor );
+
+  extern uint32_t __etext;
+  extern uint32_t __StackTop;
+  faultHandlingSetCallStackParameters( (uint32_t*)4, &__etext,
+									   &__StackTop, 0 );
+
+  faultHandlingSetProfileBuffer( samples, SAMPLES );
+  SysTick_Config( SystemCoreClock / 1000 );
+
+  while( faultHandlingProfileCount() < SAMPLES )
+	work();
+
+  SysTick->CTRL = 0;
+  faultHandlingSetProfileBuffer( NULL, 0 );
+
+  // A sample may land between our loop test and the SysTick stop
+  uint32_t count = faultHandlingProfileCount();
+  char line[64];
+  sprintf( line, "Profile: %lu samples, %lu cycles/sample\r\n",
+		   (unsigned long)count,
+		   (unsigned long)(faultHandlingProfileCycles() / count) );
+  consoleWrite( line );
+
+  for( int i = 0; i < SAMPLES; i++ ) {
+	uint32_t* s = samples + i * FAULT_HANDLING_PROFILE_RECORD;
+	char* cp = line;
+	for( int w = 0; w < FAULT_HANDLING_PROFILE_RECORD; w++ )
+	  cp += sprintf( cp, "%08lX ", (unsigned long)s[w] );
+	sprintf( cp, "\r\n" );
+	consoleWrite( line );
+  }
+
+  return 0;
+}
+
+/*
+  SysTick, just like HardFault below, is a simple branch to a
+  faultHandling-provided asm routine.
+*/
+__attribute__((naked))
+void SysTick_Handler(void) {
+  __asm__( "B ProfileHandler\n" );
+}
+
+__attribute__((naked))
+void HardFault_Handler(void) {
+  __asm__( "B FaultHandler\n" );
+}
+
+// eof
@@ -0,0 +1,322 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: turn samples from the target's sampling profiler (see
+ * faultHandlingSetProfileBuffer) into a flat profile and a
+ * caller/callee profile, resolving addresses against the GNU ld .map
+ * file of the profiled program.
+ *
+ * $ make tools
+ * $ ./profileReport profile.map samples.txt
+ *
+ * src/test/resources/profile holds a synthetic map and samples, to
+ * try it on.
+ *
+ * Samples file: one sample per line, hex words, as the application
+ * prints its profile buffer: pc lr lr1 lr2 ...  Other lines ignored.
+ *
+ * Attribution: pc gives the 'self' function.  The interrupted lr is
+ * the caller only in a leaf function, in a non-leaf it typically
+ * points back into the function itself (the return from its last
+ * call), so any address resolving to the function already at the top
+ * of the chain is skipped.  The pushed LRs then give the callers
+ * further up.  A heuristic, as is the fault dump's call stack.
+ */
+
+#define MAX_SYMBOLS 8192
+#define MAX_WORDS   16
+#define MAX_EDGES   8192
+
+typedef struct {
+  unsigned long addr;
+  char* name;
+  unsigned long self, total;
+} symbol;
+
+typedef struct {
+  int caller, callee;
+  unsigned long count;
+} edge;
+
+static symbol symbols[MAX_SYMBOLS];
+static int symbolCount = 0;
+
+static edge edges[MAX_EDGES];
+static int edgeCount = 0;
+
+static void addSymbol( unsigned long addr, const char* name ) {
+  if( symbolCount == MAX_SYMBOLS || addr == 0 )
+	return;
+  symbols[symbolCount].addr = addr;
+  symbols[symbolCount].name = strdup( name );
+  symbolCount++;
+}
+
+static int isIdentifier( const char* s ) {
+  if( !(isalpha( (unsigned char)*s ) || *s == '_') )
+	return 0;
+  for( ; *s; s++ )
+	if( !(isalnum( (unsigned char)*s ) || *s == '_' || *s == '.' ||
+		  *s == '$') )
+	  return 0;
+  return 1;
+}
+
+/*
+  Two kinds of .map line give us function addresses:
+
+  '                0x00000110                main'
+	a global symbol, address then name, nothing else.
+
+  ' .text.helper   0x00000150       0x1c ./obj/main.o'
+	an input section, with -ffunction-sections this names static
+	functions too. A long section name puts the address on the
+	following line.
+*/
+static int readMap( const char* path ) {
+  FILE* fp = fopen( path, "r" );
+  if( !fp ) {
+	perror( path );
+	return -1;
+  }
+  char line[1024], pending[512] = "";
+  while( fgets( line, sizeof line, fp ) ) {
+	char a[512], b[512], c[512];
+	unsigned long addr, size;
+	int n = sscanf( line, "%511s %511s %511s", a, b, c );
+
+	if( pending[0] ) {
+	  if( sscanf( line, " 0x%lx 0x%lx", &addr, &size ) == 2 && size )
+		addSymbol( addr, pending );
+	  pending[0] = 0;
+	}
+
+	if( n == 2 && sscanf( a, "0x%lx", &addr ) == 1 && isIdentifier( b ) )
+	  addSymbol( addr, b );
+	else if( strncmp( a, ".text.", 6 ) == 0 && isIdentifier( a+6 ) ) {
+	  if( n == 1 )
+		strcpy( pending, a+6 );
+	  else if( n >= 3 && sscanf( b, "0x%lx", &addr ) == 1 &&
+			   sscanf( c, "0x%lx", &size ) == 1 && size )
+		addSymbol( addr, a+6 );
+	}
+  }
+  fclose( fp );
+  return symbolCount;
+}
+
+static int byAddr( const void* a, const void* b ) {
+  const symbol* sa = a;
+  const symbol* sb = b;
+  if( sa->addr != sb->addr )
+	return sa->addr < sb->addr ? -1 : 1;
+  return strcmp( sa->name, sb->name );
+}
+
+// Symbol containing addr, i.e. the last at or below it, or -1
+static int lookup( unsigned long addr ) {
+  addr &= ~1UL;
+  int lo = 0, hi = symbolCount-1, found = -1;
+  while( lo <= hi ) {
+	int mid = (lo + hi) / 2;
+	if( symbols[mid].addr <= addr ) {
+	  found = mid;
+	  lo = mid+1;
+	} else
+	  hi = mid-1;
+  }
+  return found;
+}
+
+static void addEdge( int caller, int callee ) {
+  for( int i = 0; i < edgeCount; i++ )
+	if( edges[i].caller == caller && edges[i].callee == callee ) {
+	  edges[i].count++;
+	  return;
+	}
+  if( edgeCount == MAX_EDGES )
+	return;
+  edges[edgeCount].caller = caller;
+  edges[edgeCount].callee = callee;
+  edges[edgeCount].count = 1;
+  edgeCount++;
+}
+
+static void addSample( unsigned long* words, int n ) {
+  int chain[MAX_WORDS];
+  int depth = 0;
+
+  for( int i = 0; i < n; i++ ) {
+	if( i > 0 && words[i] == 0 )
+	  continue;
+	int s = lookup( words[i] );
+	if( i == 0 ) {
+	  chain[depth++] = s;
+	  continue;
+	}
+	// Unresolved, or the function we are already in (see above)
+	if( s < 0 || s == chain[depth-1] )
+	  continue;
+	chain[depth++] = s;
+  }
+
+  if( chain[0] >= 0 )
+	symbols[chain[0]].self++;
+
+  for( int i = 0; i < depth; i++ ) {
+	if( chain[i] < 0 )
+	  continue;
+	// Recursion: count a function once per sample in its total
+	int seen = 0;
+	for( int j = 0; j < i; j++ )
+	  if( chain[j] == chain[i] )
+		seen = 1;
+	if( !seen )
+	  symbols[chain[i]].total++;
+	if( i > 0 && chain[i-1] >= 0 )
+	  addEdge( chain[i], chain[i-1] );
+  }
+}
+
+static int readSamples( const char* path, unsigned long* unknown ) {
+  FILE* fp = fopen( path, "r" );
+  if( !fp ) {
+	perror( path );
+	return -1;
+  }
+  char line[1024];
+  int samples = 0;
+  while( fgets( line, sizeof line, fp ) ) {
+	unsigned long words[MAX_WORDS];
+	int n = 0;
+	char* end;
+	for( char* cp = line; n < MAX_WORDS; cp = end ) {
+	  while( *cp == ' ' || *cp == '\t' )
+		cp++;
+	  if( !isxdigit( (unsigned char)*cp ) )
+		break;
+	  words[n] = strtoul( cp, &end, 16 );
+	  if( end == cp || !isspace( (unsigned char)*end ) )
+		break;
+	  n++;
+	}
+	// Need at least pc and lr, and nothing but hex on the line
+	if( n < 2 || line[strspn( line, "0123456789abcdefABCDEF \t\r\n" )] )
+	  continue;
+	if( lookup( words[0] ) < 0 )
+	  (*unknown)++;
+	addSample( words, n );
+	samples++;
+  }
+  fclose( fp );
+  return samples;
+}
+
+static int bySelf( const void* a, const void* b ) {
+  const symbol* sa = *(const symbol* const*)a;
+  const symbol* sb = *(const symbol* const*)b;
+  if( sa->self != sb->self )
+	return sa->self > sb->self ? -1 : 1;
+  if( sa->total != sb->total )
+	return sa->total > sb->total ? -1 : 1;
+  return strcmp( sa->name, sb->name );
+}
+
+static int byCount( const void* a, const void* b ) {
+  const edge* ea = a;
+  const edge* eb = b;
+  if( ea->count != eb->count )
+	return ea->count > eb->count ? -1 : 1;
+  return strcmp( symbols[ea->caller].name, symbols[eb->caller].name );
+}
+
+int main( int argc, char* argv[] ) {
+
+  if( argc != 3 ) {
+	fprintf( stderr, "Usage: %s program.map samples.txt\n", argv[0] );
+	return 1;
+  }
+
+  if( readMap( argv[1] ) <= 0 ) {
+	fprintf( stderr, "%s: no symbols\n", argv[1] );
+	return 1;
+  }
+  qsort( symbols, symbolCount, sizeof(symbol), byAddr );
+
+  unsigned long unknown = 0;
+  int samples = readSamples( argv[2], &unknown );
+  if( samples <= 0 ) {
+	fprintf( stderr, "%s: no samples\n", argv[2] );
+	return 1;
+  }
+
+  symbol* flat[MAX_SYMBOLS];
+  int n = 0;
+  for( int i = 0; i < symbolCount; i++ )
+	if( symbols[i].total )
+	  flat[n++] = symbols + i;
+  qsort( flat, n, sizeof(flat[0]), bySelf );
+
+  printf( "Flat profile, %d samples\n\n", samples );
+  printf( "%6s %6s %6s %6s  %s\n", "self", "self%", "total", "total%",
+		  "function" );
+  for( int i = 0; i < n; i++ )
+	printf( "%6lu %5.1f%% %6lu %5.1f%%  %s\n",
+			flat[i]->self, 100.0 * flat[i]->self / samples,
+			flat[i]->total, 100.0 * flat[i]->total / samples,
+			flat[i]->name );
+  if( unknown )
+	printf( "%6lu %5.1f%% %6s %6s  ??\n",
+			unknown, 100.0 * unknown / samples, "", "" );
+
+  qsort( edges, edgeCount, sizeof(edge), byCount );
+
+  printf( "\nCaller/callee profile\n\n" );
+  printf( "%6s  %s\n", "count", "caller -> callee" );
+  for( int i = 0; i < edgeCount; i++ )
+	printf( "%6lu  %s -> %s\n", edges[i].count,
+			symbols[edges[i].caller].name, symbols[edges[i].callee].name );
+
+  return 0;
+}
+
+// eof
@@ -0,0 +1,135 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <setjmp.h>
+
+#include "faultHandling.h"
+
+#include "em_chip.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+#include "em_usart.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * As per ./stk3700.c in terms of console printf setup.
+
+ * Recovery from a fault, via POSTHANDLER_RECOVER, rather than a
+ * reboot.  Our 'sensor driver' reads from an unmapped address, a bus
+ * fault.  The fault dump is exported as usual, then we land back at
+ * our main loop's recovery point, count the recovery, and carry on.
+ */
+
+void initConsole(void);
+void consoleWrite( char* s );
+
+// A place to hold the formatted fault dump, of correct size.
+static char faultDumpBuffer[FAULT_HANDLING_DUMP_SIZE];
+
+/**
+ * Dump the fault to the serial console, so a user can 'see' what went wrong.
+ */
+void consoleDumpProcessor(void) {
+  consoleWrite( faultDumpBuffer );
+}
+
+static jmp_buf mainLoop;
+
+// A sensor driver with a bad register address...
+static uint32_t readSensor(void) {
+  volatile uint32_t* reg = (volatile uint32_t*)0x20202020;
+  return *reg;
+}
+
+int main(void) {
+
+  CHIP_Init();
+
+  initConsole();
+
+  // Use of the faultHandling api itself...
+
+  // 1: a buffer to hold the dump and the function to be called to process it
+  faultHandlingSetDumpProcessor( faultDumpBuffer, consoleDumpProcessor );
+
+  // 2: stack search parameters
+  extern uint32_t __etext;
+  extern uint32_t __StackTop;
+
+  faultHandlingSetCallStackParameters( 0, &__etext, &__StackTop, 0 );
+
+  // 3: what to do once the fault has occurred: recover to our main loop
+  faultHandlingSetPostFaultAction( POSTHANDLER_RECOVER );
+  faultHandlingSetRecoveryPoint( &mainLoop );
+
+  // volatile, since modified between setjmp and longjmp
+  volatile int recoveries = 0;
+
+  if( setjmp( mainLoop ) ) {
+	char msg[32];
+	recoveries++;
+	sprintf( msg, "Recovered %d\r\n", recoveries );
+	consoleWrite( msg );
+  }
+
+  // The 'main loop', which faults every time, until we give up
+  if( recoveries < 3 )
+	readSensor();
+
+  consoleWrite( "Done\r\n" );
+
+  faultHandlingSetRecoveryPoint( NULL );
+
+  while( 1 )
+	;
+
+  return 0;
+}
+
+/*
+  We MUST define a HardFault_Handler.  It just vectors to
+  faultHandling's provided FaultHandler.  This overrides the weak
+  version in startup_efm32gg.c.
+
+  The 'naked' attribute ensures that this function has no
+  prolog/epilog that affect the stack (e.g. push r7,lr).
+*/
+__attribute__((naked))
+void HardFault_Handler(void) {
+  __asm__( "B FaultHandler\n" );
+}
+
+// eof
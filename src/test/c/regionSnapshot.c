@@ -0,0 +1,102 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+
+#include "faultHandling.h"
+
+#include "em_chip.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+#include "em_usart.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * As per ./stk3700.c in terms of console printf setup.
+
+ * Peripheral register snapshots.  Our console USART's configuration
+ * and status, and the peripheral clock enables, are registered via a
+ * const table, then we bus fault.  Build (lib and test) with
+ *
+ * $ make clean; make REGION_ROWS=3 regionSnapshot.bin
+ *
+ * and expect, after the call stack rows, a row each for USART1
+ * CTRL/FRAME, USART1 STATUS/CLKDIV and CMU HFPERCLKEN0, e.g.
+ *
+ * 4000C400 3 00000000 00001005 00000000 00000000
+ *
+ * USART RXDATA is NOT registered: reading it pops the receive FIFO.
+ */
+
+void initConsole(void);
+void consoleWrite( char* s );
+
+// A place to hold the formatted fault dump, of correct size.
+static char faultDumpBuffer[FAULT_HANDLING_DUMP_SIZE];
+
+void consoleDumpProcessor(void) {
+  consoleWrite( faultDumpBuffer );
+}
+
+// const, so in flash, registering costs no RAM
+static const faultHandlingRegion regions[] = {
+  { (uint32_t)&USART1->CTRL, 2 },
+  { (uint32_t)&USART1->STATUS, 2 },
+  { (uint32_t)&CMU->HFPERCLKEN0, 1 },
+};
+
+int main(void) {
+
+  CHIP_Init();
+
+  initConsole();
+
+  faultHandlingSetDumpProcessor( faultDumpBuffer, consoleDumpProcessor );
+  faultHandlingSetPostFaultAction( POSTHANDLER_LOOP );
+
+  if( faultHandlingSetRegions( regions, 3 ) )
+	consoleWrite( "Regions refused, built with REGION_ROWS=3?\r\n" );
+
+  // An unmapped address, a bus fault
+  volatile uint32_t* bad = (volatile uint32_t*)0x20202020;
+  return (int)*bad;
+}
+
+__attribute__((naked))
+void HardFault_Handler(void) {
+  __asm__( "B FaultHandler\n" );
+}
+
+// eof
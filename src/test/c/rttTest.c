@@ -0,0 +1,95 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include "faultHandling.h"
+#include "faultHandlingExport.h"
+
+#include "em_chip.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Fault dump export via a SEGGER-RTT compatible ring in RAM, read by
+ * the on-board J-Link of the STK3700 (CM3) or STK3200 (CM0+) as the
+ * cpu runs, so no pins at all. Export takes as long as a memcpy.
+ *
+ * To view, e.g. with SEGGER's tools:
+ *
+ * $ JLinkRTTLogger -device EFM32GG990F1024 -if SWD -speed 4000 -rttchannel 0 dump.txt
+ *
+ * Blocking mode, so a dump is never lost, but the fault handler waits
+ * for a probe.  Use FAULT_HANDLING_RTT_NO_BLOCK_TRIM for a unit that
+ * may run without one.
+ */
+
+// A place to hold the formatted fault dump, of correct size.
+static char faultDumpBuffer[FAULT_HANDLING_DUMP_SIZE];
+
+static faultHandlingRTT rtt;
+static char rttRing[512];
+
+void rttDumpProcessor(void) {
+  faultHandlingRTTWrite( &rtt, faultDumpBuffer );
+}
+
+int main(void) {
+
+  CHIP_Init();
+
+  faultHandlingRTTInit( &rtt, rttRing, sizeof rttRing,
+						FAULT_HANDLING_RTT_BLOCK );
+
+  faultHandlingSetDumpProcessor( faultDumpBuffer, rttDumpProcessor );
+
+  extern uint32_t __etext;
+  extern uint32_t __StackTop;
+  faultHandlingSetCallStackParameters( (uint32_t*)4, &__etext,
+									   &__StackTop, 0 );
+  faultHandlingSetPostFaultAction( POSTHANDLER_LOOP );
+
+  faultHandlingRTTWrite( &rtt, "rttTest: expect a fault dump\n" );
+
+  // A call through a bad function pointer, faults on both CM0+, CM3
+  void (*f)(void) = (void(*)(void))0x87654321;
+  f();
+
+  return 0;
+}
+
+__attribute__((naked))
+void HardFault_Handler(void) {
+  __asm__( "B FaultHandler\n" );
+}
+
+// eof
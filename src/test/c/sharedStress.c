@@ -0,0 +1,195 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "faultHandlingShared.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: stress test the multi-core shared dump log (see
+ * faultHandlingShared.c), the very same code the target cores run.
+ * Each thread plays a core, faulting over and over, i.e. putting
+ * dumps into the one shared log.  The main thread reads them out,
+ * oldest first, checking that no dump is lost, duplicated or torn.
+ * Ordering is NOT checked: a slot published while the reader is
+ * mid-scan can be overtaken by a newer one.
+ *
+ * $ make tools
+ * $ ./sharedStress [-c cores] [-n dumpsPerCore]
+ *
+ * To test the partitioned (ARMv6-M) claim protocol:
+ *
+ * $ HOST_CFLAGS="-O2 -Wall -DFAULT_HANDLING_SHARED_PARTITIONED=1" make -B sharedStress
+ */
+
+#define MAX_CORES 16
+
+static faultHandlingSharedLog sharedLog;
+
+static int cores = FAULT_HANDLING_SHARED_CORES;
+static int dumpsPerCore = 20000;
+
+static volatile int coresDone = 0;
+static unsigned long fullRetries[MAX_CORES];
+
+/*
+  A 'dump' whose every row repeats the core and count, so a torn
+  copy (part from one dump, part from another) is detectable.
+*/
+static void formatDump( char* buf, int core, int count ) {
+  char* cp = buf;
+  for( int row = 0; row < 8; row++ )
+	cp += sprintf( cp, "core %02d %08X\n", core, count );
+}
+
+static void* coreThread( void* arg ) {
+  int core = (int)(long)arg;
+  char dump[FAULT_HANDLING_SHARED_DUMP_SIZE];
+  for( int count = 0; count < dumpsPerCore; count++ ) {
+	formatDump( dump, core, count );
+	while( faultHandlingSharedPut( &sharedLog, (uint32_t)core, dump ) < 0 ) {
+	  fullRetries[core]++;
+	  sched_yield();
+	}
+  }
+  __atomic_add_fetch( &coresDone, 1, __ATOMIC_RELEASE );
+  return NULL;
+}
+
+int main( int argc, char* argv[] ) {
+
+  for( int i = 1; i < argc; i++ ) {
+	if( strcmp( argv[i], "-c" ) == 0 && i+1 < argc )
+	  cores = atoi( argv[++i] );
+	else if( strcmp( argv[i], "-n" ) == 0 && i+1 < argc )
+	  dumpsPerCore = atoi( argv[++i] );
+	else {
+	  fprintf( stderr, "Usage: %s [-c cores] [-n dumpsPerCore]\n", argv[0] );
+	  return 1;
+	}
+  }
+  if( cores < 1 || cores > MAX_CORES ) {
+	fprintf( stderr, "%s: 1 to %d cores\n", argv[0], MAX_CORES );
+	return 1;
+  }
+
+  // Junk, as after power-on
+  memset( &sharedLog, 0xA5, sizeof sharedLog );
+  faultHandlingSharedInit( &sharedLog );
+
+  long total = 0, errors = 0;
+
+  // A dump that just fits a slot is put whole, one byte more is refused
+  static char big[FAULT_HANDLING_SHARED_DUMP_SIZE+1];
+  memset( big, 'x', FAULT_HANDLING_SHARED_DUMP_SIZE );
+  if( faultHandlingSharedPut( &sharedLog, 0, big ) >= 0 ||
+	  faultHandlingSharedOldest( &sharedLog ) >= 0 ) {
+	printf( "oversize dump not refused\n" );
+	errors++;
+  }
+  big[FAULT_HANDLING_SHARED_DUMP_SIZE-1] = 0;
+  int slot = faultHandlingSharedPut( &sharedLog, 0, big );
+  if( slot < 0 || strcmp( sharedLog.slots[slot].dump, big ) != 0 ) {
+	printf( "full-size dump not put whole\n" );
+	errors++;
+  }
+  if( slot >= 0 )
+	faultHandlingSharedRelease( &sharedLog, slot );
+
+  pthread_t threads[MAX_CORES];
+  for( int c = 0; c < cores; c++ )
+	pthread_create( threads + c, NULL, coreThread, (void*)(long)c );
+
+  // Times each core's each dump was read, should end up all 1s
+  uint8_t* seen[MAX_CORES];
+  for( int c = 0; c < cores; c++ )
+	seen[c] = calloc( dumpsPerCore, 1 );
+
+  char want[FAULT_HANDLING_SHARED_DUMP_SIZE];
+
+  while( 1 ) {
+	int done = __atomic_load_n( &coresDone, __ATOMIC_ACQUIRE ) == cores;
+	slot = faultHandlingSharedOldest( &sharedLog );
+	if( slot < 0 ) {
+	  if( done )
+		break;
+	  sched_yield();
+	  continue;
+	}
+	faultHandlingSharedSlot* s = sharedLog.slots + slot;
+	int core = (int)s->core;
+	int count = -1;
+	sscanf( s->dump, "core %*d %X", &count );
+	if( core < 0 || core >= cores || count < 0 || count >= dumpsPerCore ) {
+	  printf( "slot %d: bad core %d or count %d\n", slot, core, count );
+	  errors++;
+	} else {
+	  formatDump( want, core, count );
+	  if( strcmp( s->dump, want ) != 0 ) {
+		printf( "slot %d: core %d torn dump:\n%s", slot, core, s->dump );
+		errors++;
+	  }
+	  if( seen[core][count]++ ) {
+		printf( "slot %d: core %d dump %d duplicated\n", slot, core, count );
+		errors++;
+	  }
+	}
+	total++;
+	faultHandlingSharedRelease( &sharedLog, slot );
+  }
+
+  for( int c = 0; c < cores; c++ ) {
+	pthread_join( threads[c], NULL );
+	int read = 0;
+	for( int i = 0; i < dumpsPerCore; i++ )
+	  read += seen[c][i] != 0;
+	printf( "core %d: %d dumps read, %lu retries on full log\n", c,
+			read, fullRetries[c] );
+	if( read != dumpsPerCore )
+	  errors++;
+	free( seen[c] );
+  }
+
+  printf( "%ld dumps, %ld errors, %s\n", total, errors,
+		  FAULT_HANDLING_SHARED_PARTITIONED ? "partitioned" : "compare-and-swap" );
+  return errors ? 1 : 0;
+}
+
+// eof
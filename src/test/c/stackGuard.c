@@ -0,0 +1,108 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+
+#include "faultHandling.h"
+
+#include "em_chip.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+#include "em_usart.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * As per ./stk3700.c in terms of console printf setup.
+
+ * Stack overflow, trapped by an MPU guard region at the bottom of the
+ * main stack.  Unbounded recursion runs the stack down into the
+ * guard, and the fault dump shows 'ovf.0' in place of 'sp   ', i.e.
+ * stack 0 (the main stack) overflowed.  Without the guard, the
+ * recursion would run on into .bss and fault, much later, elsewhere.
+ */
+
+void initConsole(void);
+void consoleWrite( char* s );
+
+// A place to hold the formatted fault dump, of correct size.
+static char faultDumpBuffer[FAULT_HANDLING_DUMP_SIZE];
+
+void consoleDumpProcessor(void) {
+  consoleWrite( faultDumpBuffer );
+}
+
+__attribute__((noinline))
+static int recurse( int depth ) {
+  volatile uint32_t local[4];
+  local[0] = depth;
+  return recurse( depth + 1 ) + local[0];
+}
+
+int main(void) {
+
+  CHIP_Init();
+
+  initConsole();
+
+  faultHandlingSetDumpProcessor( faultDumpBuffer, consoleDumpProcessor );
+
+  extern uint32_t __etext;
+  extern uint32_t __StackTop;
+  extern uint32_t __StackLimit;
+  faultHandlingSetCallStackParameters( (uint32_t*)4, &__etext,
+									   &__StackTop, 0 );
+  faultHandlingSetPostFaultAction( POSTHANDLER_LOOP );
+
+  int mainStack = faultHandlingStackRegister( &__StackLimit, NULL );
+  if( faultHandlingStackGuard( mainStack, 7 ) != 0 ) {
+	consoleWrite( "No guard!\r\n" );
+	return 1;
+  }
+
+  recurse( 0 );
+
+  return 0;
+}
+
+/*
+  NO MemManage_Handler: the guard hit escalates to HardFault, where
+  the MPU is off, so the handler can run on the overflowed stack.
+*/
+__attribute__((naked))
+void HardFault_Handler(void) {
+  __asm__( "B FaultHandler\n" );
+}
+
+// eof
@@ -0,0 +1,113 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+
+#include "faultHandling.h"
+
+#include "em_chip.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+#include "em_usart.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * As per ./stk3700.c (or ./stk3200.c) in terms of console printf setup.
+
+ * Stack high-water marks. The main stack is registered (so painted),
+ * then calls of increasing depth each push the mark down, the free
+ * space printed after each should shrink by roughly the depth's extra
+ * frames.  Build with 'make clean; make STACK_WATERMARK=1' to see the
+ * 'sfree' row in the dump from the final, deliberate, fault.
+ */
+
+void initConsole(void);
+void consoleWrite( char* s );
+
+// A place to hold the formatted fault dump, of correct size.
+static char faultDumpBuffer[FAULT_HANDLING_DUMP_SIZE];
+
+void consoleDumpProcessor(void) {
+  consoleWrite( faultDumpBuffer );
+}
+
+// Each level uses 64+ bytes of stack
+__attribute__((noinline))
+static int recurse( int depth ) {
+  volatile uint8_t local[64];
+  local[0] = (uint8_t)depth;
+  if( depth == 0 )
+	return local[0];
+  return recurse( depth - 1 ) + local[0];
+}
+
+int main(void) {
+
+  CHIP_Init();
+
+  initConsole();
+
+  faultHandlingSetDumpProcessor( faultDumpBuffer, consoleDumpProcessor );
+
+  extern uint32_t __etext;
+  extern uint32_t __StackTop;
+  extern uint32_t __StackLimit;
+  faultHandlingSetCallStackParameters( (uint32_t*)4, &__etext,
+									   &__StackTop, 0 );
+  faultHandlingSetPostFaultAction( POSTHANDLER_LOOP );
+
+  int mainStack = faultHandlingStackRegister( &__StackLimit, NULL );
+
+  char msg[48];
+  for( int depth = 1; depth <= 16; depth *= 2 ) {
+	recurse( depth );
+	sprintf( msg, "depth %2d: %lu bytes free\r\n", depth,
+			 (unsigned long)faultHandlingStackFree( mainStack ) );
+	consoleWrite( msg );
+  }
+
+  // A bus fault, just to get a dump
+  volatile uint32_t* p = (volatile uint32_t*)0x20202020;
+  *p = 0;
+
+  return 0;
+}
+
+__attribute__((naked))
+void HardFault_Handler(void) {
+  __asm__( "B FaultHandler\n" );
+}
+
+// eof
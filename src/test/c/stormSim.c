@@ -0,0 +1,165 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "faultHandlingHistory.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: simulate a fault escalation policy over a sequence of
+ * boots, using the very same history code the target runs (see
+ * faultHandlingHistory.c), so a policy can be tuned before it ships.
+ *
+ * $ make tools
+ * $ ./stormSim FFFFFFFFFFFF
+ * $ ./stormSim -p 2:reset,4:safemode,8:sleep F.F.F...F.........FF
+ *
+ * Each char of the pattern is one boot: 'F' the boot faults, '.' it
+ * runs clean (and is at some point reset, by watchdog, by the app,
+ * we don't care).  A 'sleep' or 'loop' action ends the simulation,
+ * that unit needs a visit.
+ */
+
+/*
+  Names for faultHandlingPostFaultAction values, in enum order, see
+  faultHandling.h (which we cannot include here, it needs CMSIS).
+*/
+static const char* const actionNames[] = {
+  "loop", "reset", "debug", "return", "safemode", "sleep", "recover"
+};
+
+#define ACTIONS ((int)(sizeof(actionNames)/sizeof(actionNames[0])))
+
+#define MAX_LEVELS 8
+
+static int actionOf( const char* name ) {
+  for( int i = 0; i < ACTIONS; i++ )
+	if( strcmp( name, actionNames[i] ) == 0 )
+	  return i;
+  return -1;
+}
+
+/*
+  Policy spec is faults:action,faults:action,...
+*/
+static int parsePolicy( char* spec, faultHandlingEscalation* policy ) {
+  int levels = 0;
+  char* save;
+  for( char* tok = strtok_r( spec, ",", &save ); tok;
+	   tok = strtok_r( NULL, ",", &save ) ) {
+	char* colon = strchr( tok, ':' );
+	if( !colon || levels == MAX_LEVELS )
+	  return -1;
+	*colon = 0;
+	int action = actionOf( colon+1 );
+	if( action < 0 )
+	  return -1;
+	policy[levels].faults = (uint32_t)atoi( tok );
+	policy[levels].action = (uint32_t)action;
+	levels++;
+  }
+  return levels;
+}
+
+int main( int argc, char* argv[] ) {
+
+  char defaultSpec[] = "1:reset,3:safemode,6:sleep";
+  char* spec = defaultSpec;
+  int baseAction = actionOf( "reset" );
+
+  int i;
+  for( i = 1; i < argc && argv[i][0] == '-'; i++ ) {
+	if( strcmp( argv[i], "-p" ) == 0 && i+1 < argc )
+	  spec = argv[++i];
+	else if( strcmp( argv[i], "-a" ) == 0 && i+1 < argc )
+	  baseAction = actionOf( argv[++i] );
+	else
+	  break;
+  }
+
+  faultHandlingEscalation policy[MAX_LEVELS];
+  int levels = parsePolicy( spec, policy );
+  if( i != argc-1 || levels < 0 || baseAction < 0 ) {
+	fprintf( stderr, "Usage: %s [-p faults:action,...] [-a baseAction] "
+			 "pattern\n", argv[0] );
+	return 1;
+  }
+  const char* pattern = argv[i];
+
+  // Junk, as after power-on
+  faultHandlingHistory history;
+  memset( &history, 0xA5, sizeof history );
+
+  printf( "%5s %5s %6s %5s %s\n", "boot", "fault", "window", "level",
+		  "action" );
+
+  for( const char* cp = pattern; *cp; cp++ ) {
+
+	faultHandlingHistoryBoot( &history );
+
+	// As faultHandlingSetEscalationPolicy does
+	const char* entered = "";
+	if( faultHandlingHistorySafeMode( &history ) )
+	  entered = " (safe mode entered)";
+
+	if( *cp != 'F' ) {
+	  printf( "%5u %5s %6u %5u -%s\n", history.boots, "",
+			  history.windowFaults, history.level, entered );
+	  continue;
+	}
+
+	// As the fault handler does, then POSTHANDLER_SAFEMODE's reset
+	int action = (int)faultHandlingHistoryEscalate( &history, policy, levels,
+													(uint32_t)baseAction );
+	if( action == actionOf( "safemode" ) )
+	  history.safeMode = 1;
+
+	printf( "%5u %5s %6u %5u %s%s\n", history.boots, "F",
+			history.windowFaults, history.level, actionNames[action],
+			entered );
+
+	if( action == actionOf( "sleep" ) || action == actionOf( "loop" ) ) {
+	  printf( "Unit halted after %u boots\n", history.boots );
+	  break;
+	}
+  }
+
+  return 0;
+}
+
+// eof
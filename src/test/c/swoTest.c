@@ -0,0 +1,117 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include "faultHandling.h"
+#include "faultHandlingExport.h"
+
+#include "em_chip.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Fault dump export via ITM stimulus port 0, out the SWO pin, on the
+ * SiliconLabs STK3700 (the on-board J-Link reads SWO).  No uart, no
+ * wiring, and the 328-byte dump leaves in ~84 port writes, not ~30ms
+ * of 115200 baud.
+ *
+ * To view, e.g. with SEGGER's tools, at the 875kHz SWO rate below:
+ *
+ * $ JLinkSWOViewerCL -device EFM32GG990F1024 -swofreq 875000 -itmport 0
+ */
+
+// A place to hold the formatted fault dump, of correct size.
+static char faultDumpBuffer[FAULT_HANDLING_DUMP_SIZE];
+
+void swoDumpProcessor(void) {
+  faultHandlingITMWrite( 0, faultDumpBuffer );
+}
+
+/*
+  SWO on PF2 (location 0), clocked by AUXHFRCO (14MHz) / 16, NRZ
+  (uart-like) encoding, ITM port 0 enabled.  As per SiliconLabs'
+  own BSP trace setup.
+*/
+static void initSWO(void) {
+
+  CMU_ClockEnable( cmuClock_GPIO, true );
+  GPIO->ROUTE = (GPIO->ROUTE & ~_GPIO_ROUTE_SWLOCATION_MASK) |
+	GPIO_ROUTE_SWLOCATION_LOC0 | GPIO_ROUTE_SWOPEN;
+  GPIO_PinModeSet( gpioPortF, 2, gpioModePushPull, 0 );
+
+  CMU_OscillatorEnable( cmuOsc_AUXHFRCO, true, true );
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+
+  TPI->ACPR = 15;			// prescaler 16
+  TPI->SPPR = 2;			// NRZ
+  TPI->FFCR = 0x100;		// no formatter
+
+  ITM->LAR = 0xC5ACCE55;	// unlock
+  ITM->TCR = ITM_TCR_ITMENA_Msk | ITM_TCR_DWTENA_Msk |
+	(1UL << ITM_TCR_TraceBusID_Pos);
+  ITM->TER = 1;
+}
+
+int main(void) {
+
+  CHIP_Init();
+
+  initSWO();
+
+  faultHandlingSetDumpProcessor( faultDumpBuffer, swoDumpProcessor );
+
+  extern uint32_t __etext;
+  extern uint32_t __StackTop;
+  faultHandlingSetCallStackParameters( (uint32_t*)4, &__etext,
+									   &__StackTop, 0 );
+  faultHandlingSetPostFaultAction( POSTHANDLER_LOOP );
+
+  faultHandlingITMWrite( 0, "swoTest: expect a bus fault dump\n" );
+
+  // A read of unmapped memory, a bus fault
+  volatile uint32_t* p = (volatile uint32_t*)0x20202020;
+  uint32_t v = *p;
+  (void)v;
+
+  return 0;
+}
+
+__attribute__((naked))
+void HardFault_Handler(void) {
+  __asm__( "B FaultHandler\n" );
+}
+
+// eof
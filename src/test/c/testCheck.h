@@ -0,0 +1,73 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#ifndef CORTEXM_FAULT_HANDLING_TEST_CHECK_H
+#define CORTEXM_FAULT_HANDLING_TEST_CHECK_H
+
+#include <stdio.h>
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host side: the pass/FAIL checks shared by the self-checking test
+ * tools (historyTest, exportTest, coreTest).  Each check prints one
+ * line, so a failure is seen in context, and main returns
+ * checkSummary(), non-zero if any check failed, for make or CI.
+ */
+
+static int failures = 0;
+
+// One check, about @p subject, e.g. the dump file under test
+static inline void checkOf( int ok, const char* subject,
+							const char* what ) {
+  if( subject )
+	printf( "%s: %s: %s\n", ok ? "pass" : "FAIL", subject, what );
+  else
+	printf( "%s: %s\n", ok ? "pass" : "FAIL", what );
+  if( !ok )
+	failures++;
+}
+
+static inline void check( int ok, const char* what ) {
+  checkOf( ok, NULL, what );
+}
+
+static inline int checkSummary(void) {
+  printf( "%d failures\n", failures );
+  return failures ? 1 : 0;
+}
+
+#endif
+
+// eof
@@ -0,0 +1,142 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+
+#include "faultHandling.h"
+
+#include "em_chip.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+#include "em_usart.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * As per ./stk3700.c (or ./stk3200.c) in terms of console printf setup.
+
+ * Benchmark for the flight recorder (faultHandlingTrace.h): cpu
+ * cycles per FAULT_HANDLING_TRACE event.  SysTick, free running at
+ * the core clock with its interrupt off, is the cycle counter, since
+ * CM0/0+ has no DWT CYCCNT.  A loop of traces is timed against the
+ * same loop doing a plain store, the difference is the trace cost.
+ *
+ * Then a deliberate fault, so the latest events show in the dump
+ * (build with e.g. CPPFLAGS += -DFAULT_HANDLING_TRACE_DUMP_ENTRIES=4).
+ */
+
+void initConsole(void);
+void consoleWrite( char* s );
+
+// A place to hold the formatted fault dump, of correct size.
+static char faultDumpBuffer[FAULT_HANDLING_DUMP_SIZE];
+
+void consoleDumpProcessor(void) {
+  consoleWrite( faultDumpBuffer );
+}
+
+#define EVENTS 256
+
+static volatile uint32_t sink;
+
+// SysTick counts DOWN, and is 24 bits wide
+static uint32_t elapsed( uint32_t start, uint32_t end ) {
+  return (start - end) & 0xFFFFFF;
+}
+
+__attribute__((noinline))
+static uint32_t baseline(void) {
+  uint32_t start = SysTick->VAL;
+  for( int i = 0; i < EVENTS; i++ )
+	sink = i;
+  return elapsed( start, SysTick->VAL );
+}
+
+__attribute__((noinline))
+static uint32_t traced(void) {
+  uint32_t start = SysTick->VAL;
+  for( int i = 0; i < EVENTS; i++ ) {
+	sink = i;
+	FAULT_HANDLING_TRACE( 0x42, i );
+  }
+  return elapsed( start, SysTick->VAL );
+}
+
+int main(void) {
+
+  CHIP_Init();
+
+  initConsole();
+
+  faultHandlingSetDumpProcessor( faultDumpBuffer, consoleDumpProcessor );
+  faultHandlingSetPostFaultAction( POSTHANDLER_LOOP );
+  faultHandlingTraceInit();
+
+  SysTick->LOAD = 0xFFFFFF;
+  SysTick->VAL = 0;
+  SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+
+  // Warm up, then time each twice, take the best
+  baseline();
+  traced();
+  uint32_t b = baseline(), t = traced();
+  uint32_t b2 = baseline(), t2 = traced();
+  if( b2 < b )
+	b = b2;
+  if( t2 < t )
+	t = t2;
+
+  char msg[64];
+  sprintf( msg, "Trace: %lu.%02lu cycles/event\r\n",
+		   (unsigned long)((t - b) / EVENTS),
+		   (unsigned long)((t - b) % EVENTS * 100 / EVENTS) );
+  consoleWrite( msg );
+
+  // The last few events, then the fault, should be in the dump
+  FAULT_HANDLING_TRACE( 0xDEAD, 0x20202020 );
+  sink = *(volatile uint32_t*)0x20202020;
+
+  return 0;
+}
+
+/*
+  We MUST define a HardFault_Handler.  It just vectors to
+  faultHandling's provided FaultHandler.
+*/
+__attribute__((naked))
+void HardFault_Handler(void) {
+  __asm__( "B FaultHandler\n" );
+}
+
+// eof
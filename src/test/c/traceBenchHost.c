@@ -0,0 +1,159 @@
+/**
+ * Copyright © 2022 Stuart Maclean
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER NOR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "faultHandlingTrace.h"
+
+/**
+ * @author Stuart Maclean
+ *
+ * Host tool: traceBench.c, on the host.  Cost per FAULT_HANDLING_TRACE
+ * event of the host build (FAULT_HANDLING_HOST, an atomic increment
+ * claims the slot), as time and, on x86, TSC cycles.  A loop of
+ * traces is timed against the same loop doing a plain store, the
+ * difference is the trace cost, best of several runs.
+ *
+ * A target's cost, LDREX/STREX or PRIMASK, differs: run traceBench
+ * on the board for that.
+ *
+ * $ make traceBenchHost
+ * $ ./traceBenchHost -n 10000000
+ *
+ * Options:
+ *
+ * -n N   events per run (default 1000000)
+ * -r N   runs, report the best (default 9)
+ */
+
+static volatile uint32_t sink;
+
+static double now( void ) {
+  struct timespec t;
+  clock_gettime( CLOCK_MONOTONIC, &t );
+  return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+static uint64_t ticks( void ) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+typedef struct {
+  double seconds;
+  uint64_t ticks;
+} timing;
+
+__attribute__((noinline))
+static timing baseline( int events ) {
+  double t0 = now();
+  uint64_t c0 = ticks();
+  for( int i = 0; i < events; i++ )
+	sink = (uint32_t)i;
+  timing t = { now() - t0, ticks() - c0 };
+  return t;
+}
+
+__attribute__((noinline))
+static timing traced( int events ) {
+  double t0 = now();
+  uint64_t c0 = ticks();
+  for( int i = 0; i < events; i++ ) {
+	sink = (uint32_t)i;
+	FAULT_HANDLING_TRACE( 0x42, i );
+  }
+  timing t = { now() - t0, ticks() - c0 };
+  return t;
+}
+
+int main( int argc, char* argv[] ) {
+
+  int events = 1000000, runs = 9;
+  for( int i = 1; i < argc; i++ ) {
+	if( strcmp( argv[i], "-n" ) == 0 && i+1 < argc )
+	  events = atoi( argv[++i] );
+	else if( strcmp( argv[i], "-r" ) == 0 && i+1 < argc )
+	  runs = atoi( argv[++i] );
+	else {
+	  fprintf( stderr, "Usage: %s [-n events] [-r runs]\n", argv[0] );
+	  return 1;
+	}
+  }
+  if( events < 1 || runs < 1 ) {
+	fprintf( stderr, "%s: events, runs must be > 0\n", argv[0] );
+	return 1;
+  }
+
+  faultHandlingTraceClear();
+
+  // Warm up, then best of each
+  baseline( events );
+  traced( events );
+  timing b = baseline( events ), t = traced( events );
+  for( int r = 1; r < runs; r++ ) {
+	timing b2 = baseline( events ), t2 = traced( events );
+	if( b2.seconds < b.seconds )
+	  b = b2;
+	if( t2.seconds < t.seconds )
+	  t = t2;
+  }
+
+  // The loop's own cost may vary more than the trace's, clamp at 0
+  double ns = (t.seconds - b.seconds) * 1e9 / events;
+  printf( "Trace: %.2f ns/event", ns > 0 ? ns : 0 );
+  if( t.ticks ) {
+	double cycles = ((double)t.ticks - (double)b.ticks) / events;
+	printf( ", %.2f TSC cycles/event", cycles > 0 ? cycles : 0 );
+  }
+  printf( " (%d events, best of %d)\n", events, runs );
+
+  faultHandlingTraceEvent latest[1];
+  if( faultHandlingTraceLatest( latest, 1 ) != 1 ||
+	  latest[0].id != 0x42 || latest[0].arg != (uint32_t)(events-1) ) {
+	printf( "FAIL: last event not as logged\n" );
+	return 1;
+  }
+  return 0;
+}
+
+// eof
@@ -0,0 +1,56 @@
+/*
+  A fault guru demo: readSensor reads an unmapped address, a precise
+  bus fault.  Stands in for a real .axf, so faultGuru's symbol lookup
+  can be tried without building for the target:
+
+  $ arm-none-eabi-as -o guruDemo.o guruDemo.s
+  $ ./faultGuru -e guruDemo.o src/test/resources/guru/guruDemo.txt
+
+  The .file/.loc directives give it a .debug_line, as gcc -g would.
+*/
+
+	.syntax unified
+	.cpu cortex-m3
+	.thumb
+	.text
+
+	.file 1 "guruDemo.c"
+
+	.globl readSensor
+	.type readSensor, %function
+	.thumb_func
+readSensor:
+	.loc 1 10 0
+	ldr r3, =0x20202020
+	.loc 1 11 0
+	ldr r0, [r3]
+	.loc 1 12 0
+	bx lr
+	.ltorg
+	.size readSensor, .-readSensor
+
+	.globl poll
+	.type poll, %function
+	.thumb_func
+poll:
+	.loc 1 20 0
+	push {r7, lr}
+	.loc 1 21 0
+	bl readSensor
+	.loc 1 22 0
+	adds r0, r0, #1
+	.loc 1 23 0
+	pop {r7, pc}
+	.size poll, .-poll
+
+	.globl main
+	.type main, %function
+	.thumb_func
+main:
+	.loc 1 30 0
+	push {r7, lr}
+	.loc 1 31 0
+	bl poll
+	.loc 1 32 0
+	b main
+	.size main, .-main
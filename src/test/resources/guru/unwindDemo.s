@@ -0,0 +1,104 @@
+/*
+  An unwinding demo: main calls poll calls dispatch calls handler,
+  which faults reading an unmapped address.  dispatch keeps a
+  callback, onEvent, in a local: an odd word in the code range, so
+  the on-target pushed-LR search takes it for a return address.  The
+  .cfi directives give it a .debug_frame, as gcc -g would, so
+  dumpUnwind can tell:
+
+  $ arm-none-eabi-as -o unwindDemo.o unwindDemo.s
+  $ ./dumpUnwind -e unwindDemo.o src/test/resources/guru/unwindDemo.txt
+*/
+
+	.syntax unified
+	.cpu cortex-m3
+	.thumb
+	.text
+	.cfi_sections .debug_frame
+
+	.file 1 "unwindDemo.c"
+
+	.globl handler
+	.type handler, %function
+	.thumb_func
+handler:
+	.cfi_startproc
+	.loc 1 10 0
+	ldr r3, =0x20202020
+	.loc 1 11 0
+	ldr r0, [r3]
+	.loc 1 12 0
+	bx lr
+	.ltorg
+	.cfi_endproc
+	.size handler, .-handler
+
+	.globl dispatch
+	.type dispatch, %function
+	.thumb_func
+dispatch:
+	.cfi_startproc
+	.loc 1 20 0
+	push {r4, r7, lr}
+	.cfi_def_cfa_offset 12
+	.cfi_offset r4, -12
+	.cfi_offset r7, -8
+	.cfi_offset lr, -4
+	sub sp, #12
+	.cfi_def_cfa_offset 24
+	.loc 1 21 0
+	ldr r3, =onEvent
+	str r3, [sp]
+	.loc 1 22 0
+	bl handler
+	.loc 1 23 0
+	add sp, #12
+	.cfi_def_cfa_offset 12
+	pop {r4, r7, pc}
+	.ltorg
+	.cfi_endproc
+	.size dispatch, .-dispatch
+
+	.globl poll
+	.type poll, %function
+	.thumb_func
+poll:
+	.cfi_startproc
+	.loc 1 30 0
+	push {r7, lr}
+	.cfi_def_cfa_offset 8
+	.cfi_offset r7, -8
+	.cfi_offset lr, -4
+	.loc 1 31 0
+	bl dispatch
+	.loc 1 32 0
+	pop {r7, pc}
+	.cfi_endproc
+	.size poll, .-poll
+
+	.globl main
+	.type main, %function
+	.thumb_func
+main:
+	.cfi_startproc
+	.loc 1 40 0
+	push {r7, lr}
+	.cfi_def_cfa_offset 8
+	.cfi_offset r7, -8
+	.cfi_offset lr, -4
+	.loc 1 41 0
+	bl poll
+	.loc 1 42 0
+	b main
+	.cfi_endproc
+	.size main, .-main
+
+	.globl onEvent
+	.type onEvent, %function
+	.thumb_func
+onEvent:
+	.cfi_startproc
+	.loc 1 5 0
+	bx lr
+	.cfi_endproc
+	.size onEvent, .-onEvent